@@ -10,26 +10,20 @@
 
 #define NUM_BUFFERS 10
 
-void apuInitBufs();
-void apuDeinitBufs();
-void apuInit();
-bool apuCycle();
-void apuClockTimers();
-uint8_t *apuGetBuf();
-uint32_t apuGetBufSize();
-uint32_t apuGetFrequency();
-void apuSetReg8(uint16_t addr, uint8_t val);
-uint8_t apuGetReg8(uint16_t addr);
+void apuInitBufs(gb_t *gb);
+void apuDeinitBufs(gb_t *gb);
+void apuInit(gb_t *gb);
+bool apuCycle(gb_t *gb);
+void apuClockTimers(gb_t *gb);
+void apuCatchUp(gb_t *gb, uint8_t clock, uint32_t clocks);
+uint32_t apuNextEvent(gb_t *gb);
+uint8_t *apuGetBuf(gb_t *gb);
+uint32_t apuGetBufSize(gb_t *gb);
+uint32_t apuGetFrequency(gb_t *gb);
+void apuSetReg8(gb_t *gb, uint16_t addr, uint8_t val);
+uint8_t apuGetReg8(gb_t *gb, uint16_t addr);
 
 
-typedef struct _envelope_t {
-	bool modeadd;
-	uint8_t vol;
-	uint8_t curVol;
-	uint8_t period;
-	uint8_t divider;
-} envelope_t;
-
 void doEnvelopeLogic(envelope_t *env);
 
 #endif
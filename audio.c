@@ -7,6 +7,7 @@
 #include "AL/alc.h"
 #include "AL/alext.h"
 #include "alhelpers.h"
+#include "gb.h"
 #include "apu.h"
 #if WINDOWS_BUILD
 #include <windows.h>
@@ -79,7 +80,7 @@ static void DeletePlayer(StreamPlayer *player)
     free(player);
 }
 
-static int StartPlayer(StreamPlayer *player)
+static int StartPlayer(gb_t *gb, StreamPlayer *player)
 {
     size_t i;
 
@@ -93,11 +94,11 @@ static int StartPlayer(StreamPlayer *player)
         uint8_t *data;
 
         /* Get some data to give it to the buffer */
-        data = apuGetBuf();
+        data = apuGetBuf(gb);
         if(!data) break;
 
         alBufferSamplesSOFT(player->buffers[i], player->rate, player->format,
-                            BytesToFrames(apuGetBufSize(), player->channels, player->type),
+                            BytesToFrames(apuGetBufSize(gb), player->channels, player->type),
                             player->channels, player->type, data);
     }
     if(alGetError() != AL_NO_ERROR)
@@ -120,7 +121,7 @@ static int StartPlayer(StreamPlayer *player)
 
 StreamPlayer *player = NULL;
 
-int audioInit()
+int audioInit(gb_t *gb)
 {
     if(InitAL() != 0)
         goto error;
@@ -134,7 +135,7 @@ int audioInit()
     player = NewPlayer();
 
 	player->channels = AL_STEREO_SOFT;
-	player->rate = apuGetFrequency();
+	player->rate = apuGetFrequency(gb);
 #if AUDIO_FLOAT
     player->type = AL_FLOAT_SOFT;
 #else
@@ -147,14 +148,14 @@ int audioInit()
                 ChannelsName(player->channels), TypeName(player->type));
         goto error;
     }
-	StartPlayer(player);
+	StartPlayer(gb, player);
     return 0;
 
 error:
     return 1;
 }
 
-int audioUpdate()
+int audioUpdate(gb_t *gb)
 {
     ALint processed = 0, state;
 
@@ -177,11 +178,11 @@ int audioUpdate()
 
 	/* Read the next chunk of data, refill the buffer, and queue it
 	 * back on the source */
-	data = apuGetBuf();
+	data = apuGetBuf(gb);
 	if(data != NULL)
 	{
 		alBufferSamplesSOFT(bufid, player->rate, player->format,
-							BytesToFrames(apuGetBufSize(), player->channels, player->type),
+							BytesToFrames(apuGetBufSize(gb), player->channels, player->type),
 							player->channels, player->type, data);
 		alSourceQueueBuffers(player->source, 1, &bufid);
 	}
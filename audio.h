@@ -2,8 +2,8 @@
 #ifndef _audio_h_
 #define _audio_h_
 
-int audioInit();
-int audioUpdate();
+int audioInit(gb_t *gb);
+int audioUpdate(gb_t *gb);
 void audioDeinit();
 void audioSleep();
 
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <inttypes.h>
+#include "gb.h"
 #include "cpu.h"
 #include "apu.h"
 #include "ppu.h"
@@ -19,746 +20,696 @@
 #define P_FLAG_N (1<<6)
 #define P_FLAG_Z (1<<7)
 
-//from main.c
-extern bool gbEmuGBSPlayback;
-extern uint16_t gbsLoadAddr;
-extern uint16_t gbsInitAddr;
-extern uint16_t gbsPlayAddr;
-extern uint16_t gbsSP;
-extern uint8_t cpuTimer;
-extern bool gbCgbMode;
-extern bool gbCgbBootrom;
-//initalized elsewhere
-uint8_t cpuAddSpeed = 1;
-bool cpuCgbSpeed = false;
-//used externally
-bool cpuDoStopSwitch;
-bool cpu_oam_dma;
-bool cpu_oam_dma_running;
-uint16_t cpu_oam_dma_addr;
-
-static uint16_t sp, pc, cpuTmp16;
-static uint8_t a,b,c,d,e,f,h,l,cpuTmp;
-
-//gbs stuff
-static bool gbsInitRet, gbsPlayRet;
-
-static uint8_t sub_in_val;
-static bool irqEnable;
-static bool cpuHaltLoop,cpuStopLoop,cpuHaltBug,cpuPrevInAny;
-
-static uint8_t curInstr;
-
-static bool cpu_oam_dma_started;
-static uint8_t cpu_oam_dma_pos;
-bool cpuDmaHalt;
-
-static void cpuSetupActionArr();
-static const uint8_t *cpu_action_arr;
-static uint8_t cpu_arr_pos;
-static inline void cpuSetNopArr();
-
-void cpuInit()
-{
-	sub_in_val=0,cpuTmp=0,cpuTmp16=0;
-	if(gbCgbBootrom)
+//in catch-up mode run simple instructions as a whole
+//instead of going through their cycle arrays
+#ifndef CPU_FAST_EXEC
+#define CPU_FAST_EXEC 1
+#endif
+
+//skip ahead in loops that only poll LY/STAT/DIV/IF until
+//whatever they poll can change, needs CPU_FAST_EXEC, the
+//timing rom of "make check" waits on LY 0 in such a loop
+#ifndef CPU_IDLE_SKIP
+#define CPU_IDLE_SKIP 1
+#endif
+
+//GCC and clang can dispatch cycle actions through a label
+//table, build with CPU_THREADED=0 for the plain switch
+#ifndef CPU_THREADED
+#ifdef __GNUC__
+#define CPU_THREADED 1
+#else
+#define CPU_THREADED 0
+#endif
+#endif
+
+static void cpuNoAction(gb_t *gb, uint8_t *reg);
+static inline void cpuSetNopArr(gb_t *gb);
+static inline void cpuSetF(gb_t *gb, uint8_t f);
+
+//in catch-up mode the other parts lag behind the cpu, so
+//they have to be synced before anything depending on them
+static inline void cpuSync(gb_t *gb)
+{
+	//nothing can have changed before the next event
+	if(gb->cpu.cpuRunAhead && gb->emuClock+gb->emuClocksAhead >= gb->emuNextEvent)
+		gbEmuCatchUp(gb);
+}
+
+//VRAM, OAM, I/O and IE depend on the current ppu/apu/timer
+//state, everything else can be accessed without syncing
+static inline bool cpuTimedAddr(uint16_t addr)
+{
+	if(addr >= 0xFE00)
+		return (addr < 0xFF80 || addr == 0xFFFF);
+	return ((addr&0xE000) == 0x8000);
+}
+
+static inline uint8_t cpuGet8(gb_t *gb, uint16_t addr)
+{
+	if(gb->cpu.cpuRunAhead && cpuTimedAddr(addr))
+		gbEmuCatchUp(gb);
+	return memGet8(gb, addr);
+}
+
+static inline void cpuSet8(gb_t *gb, uint16_t addr, uint8_t val)
+{
+	if(gb->cpu.cpuRunAhead && cpuTimedAddr(addr))
+	{
+		gbEmuCatchUp(gb);
+		memSet8(gb, addr, val);
+		//write may have changed when things happen
+		gbEmuReschedule(gb);
+	}
+	else
+		memSet8(gb, addr, val);
+}
+
+void cpuInit(gb_t *gb)
+{
+	gb->cpu.cpuTmp=0,gb->cpu.cpuTmp16=0;
+	if(gb->gbCgbBootrom)
 	{
 		//will get set up in Bootrom
-		a=0,b=0,c=0,d=0,e=0,f=0,h=0,l=0;
-		sp=0;
-		pc=0;
+		gb->cpu.a=0,gb->cpu.b=0,gb->cpu.c=0,gb->cpu.d=0,gb->cpu.e=0,gb->cpu.h=0,gb->cpu.l=0;
+		cpuSetF(gb, 0);
+		gb->cpu.sp=0;
+		gb->cpu.pc=0;
 	}
 	else
 	{
-		if(gbCgbMode) //From GBC Bootrom
-			a=0x11,b=0,c=0,d=0,e=0x08,f=0x80,h=0,l=0x7C;
+		if(gb->gbCgbMode) //From GBC Bootrom
+			gb->cpu.a=0x11,gb->cpu.b=0,gb->cpu.c=0,gb->cpu.d=0,gb->cpu.e=0x08,gb->cpu.h=0,gb->cpu.l=0x7C,cpuSetF(gb, 0x80);
 		else //From GB Bootrom
-			a=0x01,b=0,c=0x13,d=0,e=0xD8,f=0xB0,h=1,l=0x4D;
-		sp = 0xFFFE; //Boot Stack Pointer
-		pc = 0x0100; //hardcoded ROM entrypoint
+			gb->cpu.a=0x01,gb->cpu.b=0,gb->cpu.c=0x13,gb->cpu.d=0,gb->cpu.e=0xD8,gb->cpu.h=1,gb->cpu.l=0x4D,cpuSetF(gb, 0xB0);
+		gb->cpu.sp = 0xFFFE; //Boot Stack Pointer
+		gb->cpu.pc = 0x0100; //hardcoded ROM entrypoint
 	}
-	irqEnable = false;
-	cpuHaltLoop = false;
-	cpuStopLoop = false;
-	cpuHaltBug = false;
-	cpuPrevInAny = false;
-	cpuDoStopSwitch = false;
-	cpu_oam_dma = false;
-	cpu_oam_dma_running = false;
-	cpu_oam_dma_addr = 0;
-	cpuSetupActionArr();
+	gb->cpu.irqEnable = false;
+	gb->cpu.cpuHaltLoop = false;
+	gb->cpu.cpuStopLoop = false;
+	gb->cpu.cpuHaltBug = false;
+	gb->cpu.cpuPrevInAny = false;
+	gb->cpu.cpuDoStopSwitch = false;
+	gb->cpu.cpu_oam_dma = false;
+	gb->cpu.cpu_oam_dma_running = false;
+	gb->cpu.cpu_oam_dma_addr = 0;
+	gb->cpu.cpu_action_func = cpuNoAction;
 	//gbs stuff
-	gbsInitRet = false; //for first init
-	gbsPlayRet = true; //for first play call
-
-	curInstr = 0;
-	cpu_oam_dma_started = false;
-	cpu_oam_dma_pos = 0;
-	cpuDmaHalt = false;
-
-	cpuSetNopArr();
+	gb->cpu.gbsInitRet = false; //for first init
+	gb->cpu.gbsPlayRet = true; //for first play call
+
+	gb->cpu.curInstr = 0;
+	gb->cpu.cpu_oam_dma_started = false;
+	gb->cpu.cpu_oam_dma_pos = 0;
+	gb->cpu.cpuDmaHalt = false;
+	gb->cpu.cpuRunAhead = false;
+	gb->cpu.cpuFetched = false;
+	gb->cpu.cpuCode = NULL;
+	gb->cpu.cpuIdleLoopPC = 0;
+	gb->cpu.cpuIdleLoopTime = 0;
+
+	cpuSetNopArr(gb);
 }
 
-static inline void setAImmRegStats()
+//flags stay unpacked as whatever they get derived from, zero in
+//cpuFlagZ means Z is set, H and C are bit 4 and 8 of cpuFlagHC,
+//the packed f byte only gets built for push af
+static inline bool cpuIsZ(gb_t *gb)
 {
-	f &= ~(P_FLAG_C|P_FLAG_H|P_FLAG_N|P_FLAG_Z);
-	if(a == 0) f |= P_FLAG_Z;
+	return !gb->cpu.cpuFlagZ;
 }
 
-static inline void cpuAdd16(uint16_t x)
+static inline bool cpuIsC(gb_t *gb)
 {
-	uint32_t r1,r2;
-	r1=((h<<8)|l)+(x);
-	r2=(((h<<8)|l)&0xFFF)+((x)&0xFFF);
-
-	uint8_t tf = (uint8_t)(f&P_FLAG_Z);
-	if(r1 > 0xFFFF)
-		tf |= P_FLAG_C;
-	if(r2 > 0x0FFF)
-		tf |= P_FLAG_H;
-	l = r1;
-	h = r1 >> 8;
-	f = tf;
+	return (gb->cpu.cpuFlagHC&0x100) != 0;
 }
 
-static inline int16_t cpuAddSp16(uint8_t add)
+static inline uint8_t cpuGetF(gb_t *gb)
 {
-	int32_t n = (int8_t)add;
-	uint32_t r1,r2,r3;
-	r1=sp+n;
-	r2=(sp&0xFF)+(n&0xFF);
-	r3=(sp&0xF)+(n&0xF);
-
-	uint8_t tf = 0;
-
-	if(r2 > 0xFF)
-		tf |= P_FLAG_C;
-	if(r3 > 0x0F)
-		tf |= P_FLAG_H;
+	return (gb->cpu.cpuFlagZ ? 0 : P_FLAG_Z) | gb->cpu.cpuFlagN |
+		((gb->cpu.cpuFlagHC&0x10)<<1) | ((gb->cpu.cpuFlagHC&0x100)>>4);
+}
 
-	f = tf;
+static inline void cpuSetF(gb_t *gb, uint8_t f)
+{
+	gb->cpu.cpuFlagZ = !(f&P_FLAG_Z);
+	gb->cpu.cpuFlagN = f&P_FLAG_N;
+	gb->cpu.cpuFlagHC = ((f&P_FLAG_H)>>1) | ((f&P_FLAG_C)<<4);
+}
 
-	return (uint16_t)r1;
+static inline void setAImmRegStats(gb_t *gb)
+{
+	gb->cpu.cpuFlagZ = gb->cpu.a;
+	gb->cpu.cpuFlagN = 0;
+	gb->cpu.cpuFlagHC = 0;
 }
 
-static inline void setAddSubCmpFlags(uint16_t r1, uint16_t r2)
+static inline void cpuAdd16(gb_t *gb, uint16_t x)
 {
-	if(((uint8_t)r2)==0)
-		f |= P_FLAG_Z;
-	else
-		f &= ~P_FLAG_Z;
+	uint32_t hl = (gb->cpu.h<<8)|gb->cpu.l;
+	uint32_t r = hl+x;
+	//carries out of bit 11 and 15
+	gb->cpu.cpuFlagN = 0;
+	gb->cpu.cpuFlagHC = (((hl^x^r)>>8)&0x10) | ((r>>8)&0x100);
+	gb->cpu.l = r;
+	gb->cpu.h = r >> 8;
+}
 
-	if(r2>0xFF)
-		f |= P_FLAG_C;
-	else
-		f &= ~P_FLAG_C;
+static inline int16_t cpuAddSp16(gb_t *gb, uint8_t add)
+{
+	int32_t n = (int8_t)add;
+	uint32_t r = gb->cpu.sp+n;
+	//carries out of bit 3 and 7
+	gb->cpu.cpuFlagZ = 1;
+	gb->cpu.cpuFlagN = 0;
+	gb->cpu.cpuFlagHC = (gb->cpu.sp^n^r)&0x110;
 
-	if(r1>0xF)
-		f |= P_FLAG_H;
-	else
-		f &= ~P_FLAG_H;
+	return (uint16_t)r;
 }
 
-static inline uint8_t cpuDoAdd8(uint8_t x, uint8_t y)
+//r is the 16bit result, bit 8 of it is the carry and
+//bit 4 of x^y^r the carry/borrow into the high nibble
+static inline void setAddSubCmpFlags(gb_t *gb, uint8_t x, uint8_t y, uint16_t r, uint8_t n)
 {
-	uint16_t r1,r2;
-	r1=(uint16_t)((x&0xF)+(y&0xF));
-	r2=(uint16_t)(x+y);
+	gb->cpu.cpuFlagZ = (uint8_t)r;
+	gb->cpu.cpuFlagN = n;
+	gb->cpu.cpuFlagHC = (x^y^r)&0x110;
+}
 
-	setAddSubCmpFlags(r1, r2);
+static inline uint8_t cpuDoAdd8(gb_t *gb, uint8_t x, uint8_t y)
+{
+	uint16_t r = (uint16_t)(x+y);
 
-	f &= ~P_FLAG_N;
+	setAddSubCmpFlags(gb, x, y, r, 0);
 
-	return (uint8_t)r2;
+	return (uint8_t)r;
 }
 
-static void cpuAdd8(uint8_t *reg)
+static void cpuAdd8(gb_t *gb, uint8_t *reg)
 {
-	a = cpuDoAdd8(a,*reg);
+	gb->cpu.a = cpuDoAdd8(gb, gb->cpu.a,*reg);
 }
 
-static inline uint8_t cpuDoSub8(uint8_t x, uint8_t y)
+static inline uint8_t cpuDoSub8(gb_t *gb, uint8_t x, uint8_t y)
 {
-	uint16_t r1,r2;
-	r1=(uint16_t)((x&0xF)-(y&0xF));
-	r2=(uint16_t)(x-y);
-
-	setAddSubCmpFlags(r1, r2);
+	uint16_t r = (uint16_t)(x-y);
 
-	f |= P_FLAG_N;
+	setAddSubCmpFlags(gb, x, y, r, P_FLAG_N);
 
-	return (uint8_t)r2;
+	return (uint8_t)r;
 }
 
-static void cpuSub8(uint8_t *reg)
+static void cpuSub8(gb_t *gb, uint8_t *reg)
 {
-	a = cpuDoSub8(a,*reg);
+	gb->cpu.a = cpuDoSub8(gb, gb->cpu.a,*reg);
 }
 
-static void cpuCmp8(uint8_t *reg)
+static void cpuCmp8(gb_t *gb, uint8_t *reg)
 {
-	cpuDoSub8(a,*reg);
+	cpuDoSub8(gb, gb->cpu.a,*reg);
 }
 
-static void cpuSbc8(uint8_t *reg)
+static void cpuSbc8(gb_t *gb, uint8_t *reg)
 {
-	uint16_t r1,r2;
 	uint8_t x = *reg;
-	r1=(uint16_t)((a&0xF)-((x)&0xF)-((f&P_FLAG_C)?1:0));
-	r2=(uint16_t)(a-(x)-((f&P_FLAG_C)?1:0));
+	uint16_t r = (uint16_t)(gb->cpu.a-x-cpuIsC(gb));
 
-	a=(uint8_t)r2;
+	setAddSubCmpFlags(gb, gb->cpu.a, x, r, P_FLAG_N);
 
-	setAddSubCmpFlags(r1, r2);
-
-	f |= P_FLAG_N;
+	gb->cpu.a=(uint8_t)r;
 }
 
-static void cpuAdc8(uint8_t *reg)
+static void cpuAdc8(gb_t *gb, uint8_t *reg)
 {
-	uint16_t r1,r2;
 	uint8_t x = *reg;
-	r1=(uint16_t)((a&0xF)+((x)&0xF)+((f&P_FLAG_C)?1:0));
-	r2=(uint16_t)(a+(x)+((f&P_FLAG_C)?1:0));
-
-	a=(uint8_t)r2;
+	uint16_t r = (uint16_t)(gb->cpu.a+x+cpuIsC(gb));
 
-	setAddSubCmpFlags(r1, r2);
+	setAddSubCmpFlags(gb, gb->cpu.a, x, r, 0);
 
-	f &= ~P_FLAG_N;
+	gb->cpu.a=(uint8_t)r;
 }
 
-static void cpuXOR(uint8_t *reg)
+static void cpuXOR(gb_t *gb, uint8_t *reg)
 {
-	a ^= (*reg);
-	setAImmRegStats();
+	gb->cpu.a ^= (*reg);
+	setAImmRegStats(gb);
 }
 
-static void cpuOR(uint8_t *reg)
+static void cpuOR(gb_t *gb, uint8_t *reg)
 {
-	a |= (*reg);
-	setAImmRegStats();
+	gb->cpu.a |= (*reg);
+	setAImmRegStats(gb);
 }
 
-static void cpuAND(uint8_t *reg)
+static void cpuAND(gb_t *gb, uint8_t *reg)
 {
-	a &= (*reg);
-	setAImmRegStats();
-	f |= P_FLAG_H;
+	gb->cpu.a &= (*reg);
+	setAImmRegStats(gb);
+	gb->cpu.cpuFlagHC = 0x10;
 }
 
-static void cpuCPL(uint8_t *reg)
+static void cpuCPL(gb_t *gb, uint8_t *reg)
 {
 	uint8_t val = (*reg);
-	f |= (P_FLAG_H|P_FLAG_N);
+	gb->cpu.cpuFlagN = P_FLAG_N;
+	gb->cpu.cpuFlagHC |= 0x10;
 	*reg = ~val;
 }
 
+//shifts and rotates all clear N and H, set Z from the
+//result and C from the bit that got shifted out
+static inline void setShiftFlags(gb_t *gb, uint8_t val, uint8_t carry)
+{
+	gb->cpu.cpuFlagZ = val;
+	gb->cpu.cpuFlagN = 0;
+	gb->cpu.cpuFlagHC = carry<<8;
+}
+
 //rotate WITHOUT old carry used
-static void cpuRLC(uint8_t *reg)
+static void cpuRLC(gb_t *gb, uint8_t *reg)
 {
 	uint8_t val = (*reg);
+	uint8_t carry = val>>7;
 
-	f &= ~(P_FLAG_H|P_FLAG_N);
-
-	if(val&0x80)
-		f |= P_FLAG_C;
-	else
-		f &= ~P_FLAG_C;
-
-	val <<= 1;
-
-	if(f & P_FLAG_C)
-		val |= 1;
-
-	if(val == 0)
-		f |= P_FLAG_Z;
-	else
-		f &= ~P_FLAG_Z;
+	val = (val<<1)|carry;
+	setShiftFlags(gb, val, carry);
 
 	*reg = val;
 }
 
 //rotate WITHOUT old carry used
-static void cpuRRC(uint8_t *reg)
+static void cpuRRC(gb_t *gb, uint8_t *reg)
 {
 	uint8_t val = (*reg);
+	uint8_t carry = val&1;
 
-	f &= ~(P_FLAG_H|P_FLAG_N);
-
-	if(val&1)
-		f |= P_FLAG_C;
-	else
-		f &= ~P_FLAG_C;
-
-	val >>= 1;
-
-	if(f & P_FLAG_C)
-		val |= 0x80;
-
-	if(val == 0)
-		f |= P_FLAG_Z;
-	else
-		f &= ~P_FLAG_Z;
+	val = (val>>1)|(carry<<7);
+	setShiftFlags(gb, val, carry);
 
 	*reg = val;
 }
 
 //rotate WITH old carry used
-static void cpuRL(uint8_t *reg)
+static void cpuRL(gb_t *gb, uint8_t *reg)
 {
 	uint8_t val = (*reg);
-	uint8_t oldF = f;
-
-	f &= ~(P_FLAG_H|P_FLAG_N);
-
-	if(val&0x80)
-		f |= P_FLAG_C;
-	else
-		f &= ~P_FLAG_C;
-
-	val <<= 1;
-
-	if(oldF & P_FLAG_C)
-		val |= 1;
+	uint8_t carry = val>>7;
 
-	if(val == 0)
-		f |= P_FLAG_Z;
-	else
-		f &= ~P_FLAG_Z;
+	val = (val<<1)|cpuIsC(gb);
+	setShiftFlags(gb, val, carry);
 
 	*reg = val;
 }
 
 //rotate WITH old carry used
-static void cpuRR(uint8_t *reg)
+static void cpuRR(gb_t *gb, uint8_t *reg)
 {
 	uint8_t val = (*reg);
-	uint8_t oldF = f;
-
-	f &= ~(P_FLAG_H|P_FLAG_N);
-
-	if(val&1)
-		f |= P_FLAG_C;
-	else
-		f &= ~P_FLAG_C;
-
-	val >>= 1;
+	uint8_t carry = val&1;
 
-	if(oldF & P_FLAG_C)
-		val |= 0x80;
-
-	if(val == 0)
-		f |= P_FLAG_Z;
-	else
-		f &= ~P_FLAG_Z;
+	val = (val>>1)|(cpuIsC(gb)<<7);
+	setShiftFlags(gb, val, carry);
 
 	*reg = val;
 }
 
 //Direct calls for a
-static void cpuRLCA()
+static void cpuRLCA(gb_t *gb, uint8_t *none)
 {
-	cpuRLC(&a);
-	f &= ~P_FLAG_Z;
+	(void)none;
+	cpuRLC(gb, &gb->cpu.a);
+	gb->cpu.cpuFlagZ = 1;
 }
 
-static void cpuRRCA()
+static void cpuRRCA(gb_t *gb, uint8_t *none)
 {
-	cpuRRC(&a);
-	f &= ~P_FLAG_Z;
+	(void)none;
+	cpuRRC(gb, &gb->cpu.a);
+	gb->cpu.cpuFlagZ = 1;
 }
 
-static void cpuRLA()
+static void cpuRLA(gb_t *gb, uint8_t *none)
 {
-	cpuRL(&a);
-	f &= ~P_FLAG_Z;
+	(void)none;
+	cpuRL(gb, &gb->cpu.a);
+	gb->cpu.cpuFlagZ = 1;
 }
 
-static void cpuRRA()
+static void cpuRRA(gb_t *gb, uint8_t *none)
 {
-	cpuRR(&a);
-	f &= ~P_FLAG_Z;
+	(void)none;
+	cpuRR(gb, &gb->cpu.a);
+	gb->cpu.cpuFlagZ = 1;
 }
 
 //shift left
-static void cpuSLA(uint8_t *reg)
+static void cpuSLA(gb_t *gb, uint8_t *reg)
 {
 	uint8_t val = (*reg);
-
-	f &= ~(P_FLAG_H|P_FLAG_N);
-
-	if(val&0x80)
-		f |= P_FLAG_C;
-	else
-		f &= ~P_FLAG_C;
+	uint8_t carry = val>>7;
 
 	val <<= 1;
-
-	if(val == 0)
-		f |= P_FLAG_Z;
-	else
-		f &= ~P_FLAG_Z;
+	setShiftFlags(gb, val, carry);
 
 	*reg = val;
 }
 
 //shift right arithmetic
-static void cpuSRA(uint8_t *reg)
+static void cpuSRA(gb_t *gb, uint8_t *reg)
 {
 	uint8_t val = (*reg);
-	uint8_t oldSign = (val&0x80);
-
-	f &= ~(P_FLAG_H|P_FLAG_N);
-
-	if(val&1)
-		f |= P_FLAG_C;
-	else
-		f &= ~P_FLAG_C;
+	uint8_t carry = val&1;
 
-	val >>= 1;
-	val |= oldSign;
-
-	if(val == 0)
-		f |= P_FLAG_Z;
-	else
-		f &= ~P_FLAG_Z;
+	val = (val>>1)|(val&0x80);
+	setShiftFlags(gb, val, carry);
 
 	*reg = val;
 }
 
 //shift right logical
-static void cpuSRL(uint8_t *reg)
+static void cpuSRL(gb_t *gb, uint8_t *reg)
 {
 	uint8_t val = (*reg);
-
-	f &= ~(P_FLAG_H|P_FLAG_N);
-
-	if(val&1)
-		f |= P_FLAG_C;
-	else
-		f &= ~P_FLAG_C;
+	uint8_t carry = val&1;
 
 	val >>= 1;
-
-	if(val == 0)
-		f |= P_FLAG_Z;
-	else
-		f &= ~P_FLAG_Z;
+	setShiftFlags(gb, val, carry);
 
 	*reg = val;
 }
 
-static void cpuSWAP(uint8_t *reg)
-{
-	uint8_t val = (*reg);
-
-	f &= ~(P_FLAG_H|P_FLAG_N|P_FLAG_C);
-
-	uint8_t vL = val&0xF;
-	val>>=4;
-	val|=vL<<4;
-
-	if(val == 0)
-		f |= P_FLAG_Z;
-	else
-		f &= ~P_FLAG_Z;
-
-	*reg = val;
-}
-
-static void cpuBIT(uint8_t *reg)
-{
-	uint8_t val = (*reg);
-
-	f &= ~P_FLAG_N;
-	f |= P_FLAG_H;
-
-	if((val&(1<<sub_in_val)) == 0)
-		f |= P_FLAG_Z;
-	else
-		f &= ~P_FLAG_Z;
-}
-
-static void cpuSET(uint8_t *reg)
+static void cpuSWAP(gb_t *gb, uint8_t *reg)
 {
 	uint8_t val = (*reg);
 
-	val |= (1<<sub_in_val);
+	val = (val>>4)|(val<<4);
+	setShiftFlags(gb, val, 0);
 
 	*reg = val;
 }
 
-static void cpuRES(uint8_t *reg)
-{
-	uint8_t val = (*reg);
-
-	val &= ~(1<<sub_in_val);
-
-	*reg = val;
+//one set per bit so CB opcodes need no decoding when run
+#define CPU_BIT_FUNCS(n) \
+static void cpuBIT##n(gb_t *gb, uint8_t *reg) \
+{ \
+	gb->cpu.cpuFlagZ = (*reg)&(1<<n); \
+	gb->cpu.cpuFlagN = 0; \
+	gb->cpu.cpuFlagHC = (gb->cpu.cpuFlagHC&0x100)|0x10; \
+} \
+static void cpuSET##n(gb_t *gb, uint8_t *reg) \
+{ \
+	(void)gb; \
+	*reg |= (1<<n); \
+} \
+static void cpuRES##n(gb_t *gb, uint8_t *reg) \
+{ \
+	(void)gb; \
+	*reg &= ~(1<<n); \
 }
+CPU_BIT_FUNCS(0) CPU_BIT_FUNCS(1) CPU_BIT_FUNCS(2) CPU_BIT_FUNCS(3)
+CPU_BIT_FUNCS(4) CPU_BIT_FUNCS(5) CPU_BIT_FUNCS(6) CPU_BIT_FUNCS(7)
 
-static void cpuHALT(uint8_t *none)
+static void cpuHALT(gb_t *gb, uint8_t *none)
 {
 	(void)none;
+	cpuSync(gb);
 	//HALT bug, PC wont increase next instruction!
-	if(!irqEnable && memGetCurIrqList())
-		cpuHaltBug = true;
+	if(!gb->cpu.irqEnable && memGetCurIrqList(gb))
+		gb->cpu.cpuHaltBug = true;
 	else //enters HALT mode normall
-		cpuHaltLoop = true;
+		gb->cpu.cpuHaltLoop = true;
 }
 
-static void cpuBcInc()
+static void cpuBcInc(gb_t *gb, uint8_t *none)
 {
-	uint16_t tmp = c | b<<8;
+	(void)none;
+	uint16_t tmp = gb->cpu.c | gb->cpu.b<<8;
 	tmp++;
-	c = tmp&0xFF;
-	b = tmp>>8;
+	gb->cpu.c = tmp&0xFF;
+	gb->cpu.b = tmp>>8;
 }
 
-static void cpuDeInc()
+static void cpuDeInc(gb_t *gb, uint8_t *none)
 {
-	uint16_t tmp = e | d<<8;
+	(void)none;
+	uint16_t tmp = gb->cpu.e | gb->cpu.d<<8;
 	tmp++;
-	e = tmp&0xFF;
-	d = tmp>>8;
+	gb->cpu.e = tmp&0xFF;
+	gb->cpu.d = tmp>>8;
 }
 
-static void cpuHlInc()
+static void cpuHlInc(gb_t *gb, uint8_t *none)
 {
-	uint16_t tmp = l | h<<8;
+	(void)none;
+	uint16_t tmp = gb->cpu.l | gb->cpu.h<<8;
 	tmp++;
-	l = tmp&0xFF;
-	h = tmp>>8;
+	gb->cpu.l = tmp&0xFF;
+	gb->cpu.h = tmp>>8;
 }
 
-static void cpuSpInc()
+static void cpuSpInc(gb_t *gb, uint8_t *none)
 {
-	sp++;
+	(void)none;
+	gb->cpu.sp++;
 }
 
-static void cpuBcDec()
+static void cpuBcDec(gb_t *gb, uint8_t *none)
 {
-	uint16_t tmp = c | b<<8;
+	(void)none;
+	uint16_t tmp = gb->cpu.c | gb->cpu.b<<8;
 	tmp--;
-	c = tmp&0xFF;
-	b = tmp>>8;
+	gb->cpu.c = tmp&0xFF;
+	gb->cpu.b = tmp>>8;
 }
 
-static void cpuDeDec()
+static void cpuDeDec(gb_t *gb, uint8_t *none)
 {
-	uint16_t tmp = e | d<<8;
+	(void)none;
+	uint16_t tmp = gb->cpu.e | gb->cpu.d<<8;
 	tmp--;
-	e = tmp&0xFF;
-	d = tmp>>8;
+	gb->cpu.e = tmp&0xFF;
+	gb->cpu.d = tmp>>8;
 }
 
-static void cpuHlDec()
+static void cpuHlDec(gb_t *gb, uint8_t *none)
 {
-	uint16_t tmp = l | h<<8;
+	(void)none;
+	uint16_t tmp = gb->cpu.l | gb->cpu.h<<8;
 	tmp--;
-	l = tmp&0xFF;
-	h = tmp>>8;
+	gb->cpu.l = tmp&0xFF;
+	gb->cpu.h = tmp>>8;
 }
 
-static void cpuSpDec()
+static void cpuSpDec(gb_t *gb, uint8_t *none)
 {
-	sp--;
+	(void)none;
+	gb->cpu.sp--;
 }
 
-static void cpuNoAction(uint8_t *reg) { (void)reg; };
+static void cpuNoAction(gb_t *gb, uint8_t *reg) { (void)gb; (void)reg; };
 
-static void cpuLDa(uint8_t *reg) { a = (*reg); }
-static void cpuLDb(uint8_t *reg) { b = (*reg); }
-static void cpuLDc(uint8_t *reg) { c = (*reg); }
-static void cpuLDd(uint8_t *reg) { d = (*reg); }
-static void cpuLDe(uint8_t *reg) { e = (*reg); }
-static void cpuLDl(uint8_t *reg) { l = (*reg); }
-static void cpuLDh(uint8_t *reg) { h = (*reg); }
+static void cpuLDa(gb_t *gb, uint8_t *reg) { gb->cpu.a = (*reg); }
+static void cpuLDb(gb_t *gb, uint8_t *reg) { gb->cpu.b = (*reg); }
+static void cpuLDc(gb_t *gb, uint8_t *reg) { gb->cpu.c = (*reg); }
+static void cpuLDd(gb_t *gb, uint8_t *reg) { gb->cpu.d = (*reg); }
+static void cpuLDe(gb_t *gb, uint8_t *reg) { gb->cpu.e = (*reg); }
+static void cpuLDl(gb_t *gb, uint8_t *reg) { gb->cpu.l = (*reg); }
+static void cpuLDh(gb_t *gb, uint8_t *reg) { gb->cpu.h = (*reg); }
 
-static void cpuSTbc(uint8_t *reg) { memSet8(c | b<<8, (*reg)); }
-static void cpuSTde(uint8_t *reg) { memSet8(e | d<<8, (*reg)); }
-static void cpuSThl(uint8_t *reg) { memSet8(l | h<<8, (*reg)); }
-static void cpuSTt16(uint8_t *reg) { memSet8(cpuTmp16, (*reg)); }
+static void cpuSTbc(gb_t *gb, uint8_t *reg) { cpuSet8(gb, gb->cpu.c | gb->cpu.b<<8, (*reg)); }
+static void cpuSTde(gb_t *gb, uint8_t *reg) { cpuSet8(gb, gb->cpu.e | gb->cpu.d<<8, (*reg)); }
+static void cpuSThl(gb_t *gb, uint8_t *reg) { cpuSet8(gb, gb->cpu.l | gb->cpu.h<<8, (*reg)); }
+static void cpuSTt16(gb_t *gb, uint8_t *reg) { cpuSet8(gb, gb->cpu.cpuTmp16, (*reg)); }
 
-static void cpuSThlInc(uint8_t *reg) { cpuSThl(reg); cpuHlInc(); }
-static void cpuSThlDec(uint8_t *reg) { cpuSThl(reg); cpuHlDec(); }
+static void cpuSThlInc(gb_t *gb, uint8_t *reg) { cpuSThl(gb, reg); cpuHlInc(gb, reg); }
+static void cpuSThlDec(gb_t *gb, uint8_t *reg) { cpuSThl(gb, reg); cpuHlDec(gb, reg); }
 
-static void cpuInc(uint8_t *reg)
+static void cpuInc(gb_t *gb, uint8_t *reg)
 {
-	uint8_t tf = f&P_FLAG_C;
-	*reg = cpuDoAdd8(*reg,1);
-	f&=~P_FLAG_C;
-	f|=tf;
+	uint8_t val = (*reg)+1;
+	//keeps C
+	gb->cpu.cpuFlagZ = val;
+	gb->cpu.cpuFlagN = 0;
+	gb->cpu.cpuFlagHC = (gb->cpu.cpuFlagHC&0x100) | (((*reg)^val)&0x10);
+	*reg = val;
 }
 
-static void cpuDec(uint8_t *reg)
+static void cpuDec(gb_t *gb, uint8_t *reg)
 {
-	uint8_t tf = f&P_FLAG_C;
-	*reg = cpuDoSub8(*reg,1);
-	f&=~P_FLAG_C;
-	f|=tf;
+	uint8_t val = (*reg)-1;
+	//keeps C
+	gb->cpu.cpuFlagZ = val;
+	gb->cpu.cpuFlagN = P_FLAG_N;
+	gb->cpu.cpuFlagHC = (gb->cpu.cpuFlagHC&0x100) | (((*reg)^val)&0x10);
+	*reg = val;
 }
 
-static void cpuDAA(uint8_t *reg)
+static void cpuDAA(gb_t *gb, uint8_t *reg)
 {
 	int16_t in = *reg;
 
-	if (!(f & P_FLAG_N))
+	if (!gb->cpu.cpuFlagN)
 	{
-		if ((f & P_FLAG_H) || (in & 0xF) > 9)
+		if ((gb->cpu.cpuFlagHC&0x10) || (in & 0xF) > 9)
 			in += 0x06;
 
-		if ((f & P_FLAG_C) || in > 0x9F)
+		if (cpuIsC(gb) || in > 0x9F)
 			in += 0x60;
 	}
 	else
 	{
-		if (f & P_FLAG_H)
+		if (gb->cpu.cpuFlagHC&0x10)
 			in = (in - 6) & 0xFF;
 
-		if (f & P_FLAG_C)
+		if (cpuIsC(gb))
 			in -= 0x60;
 	}
 
-	f &= ~(P_FLAG_H | P_FLAG_Z);
-
-	if ((in & 0x100) == 0x100)
-		f |= P_FLAG_C;
+	//clears H, C only ever gets set
+	gb->cpu.cpuFlagHC = (gb->cpu.cpuFlagHC|in)&0x100;
 
 	in &= 0xFF;
 
-	if (in == 0)
-		f |= P_FLAG_Z;
+	gb->cpu.cpuFlagZ = (uint8_t)in;
 
 	*reg = (uint8_t)in;
 }
 
-static void cpuSetStopLoop()
+static void cpuSetStopLoop(gb_t *gb)
 {
 	printf("CPU: Frozen until Button is pressed\n");
-	cpuStopLoop = true;
+	gb->cpu.cpuStopLoop = true;
 }
 
-static void cpuSTOP(uint8_t *none)
+static void cpuSTOP(gb_t *gb, uint8_t *none)
 {
 	(void)none;
 	//printf("CPU called STOP instruction\n");
-	if(cpuDoStopSwitch)
+	if(gb->cpu.cpuDoStopSwitch)
 	{
-		cpuSetSpeed(!cpuCgbSpeed);
-		cpuDoStopSwitch = false;
+		//div runs at the old speed up to here
+		memTimerRunTo(gb, gb->emuClock+1);
+		cpuSetSpeed(gb, !gb->cpu.cpuCgbSpeed);
+		gb->cpu.cpuDoStopSwitch = false;
 	}
 	else
-		cpuSetStopLoop();
+		cpuSetStopLoop(gb);
 	//takes up 2 instructions?
-	pc++;
+	gb->cpu.pc++;
 }
 
+//every cycle action the interpreter knows, listed once so the
+//enum and the jump table of the threaded interpreter match up
+#define CPU_ACTION_LIST(X) \
+	X(CPU_GET_INSTRUCTION) \
+	X(CPU_GET_SUBINSTRUCTION) \
+	X(CPU_DELAY_CYCLE) \
+	X(CPU_ACTION_GET_INSTRUCTION) \
+	X(CPU_A_ACTION_GET_INSTRUCTION) \
+	X(CPU_B_ACTION_GET_INSTRUCTION) \
+	X(CPU_C_ACTION_GET_INSTRUCTION) \
+	X(CPU_D_ACTION_GET_INSTRUCTION) \
+	X(CPU_E_ACTION_GET_INSTRUCTION) \
+	X(CPU_H_ACTION_GET_INSTRUCTION) \
+	X(CPU_L_ACTION_GET_INSTRUCTION) \
+	X(CPU_ACTION_WRITE) \
+	X(CPU_A_ACTION_WRITE) \
+	X(CPU_B_ACTION_WRITE) \
+	X(CPU_C_ACTION_WRITE) \
+	X(CPU_D_ACTION_WRITE) \
+	X(CPU_E_ACTION_WRITE) \
+	X(CPU_H_ACTION_WRITE) \
+	X(CPU_L_ACTION_WRITE) \
+	X(CPU_BC_ACTION_ADD) \
+	X(CPU_DE_ACTION_ADD) \
+	X(CPU_HL_ACTION_ADD) \
+	X(CPU_SP_ACTION_ADD) \
+	X(CPU_HL_ADD_SPECIAL) \
+	X(CPU_SP_ADD_SPECIAL) \
+	X(CPU_ACTION_WRITE8_HL) \
+	X(CPU_TMP_ADD_PC) \
+	X(CPU_TMP_READ8_BC) \
+	X(CPU_TMP_READ8_DE) \
+	X(CPU_TMP_READ8_HL) \
+	X(CPU_TMP_READ8_HL_INC) \
+	X(CPU_TMP_READ8_HL_DEC) \
+	X(CPU_TMP_READ8_PC_INC) \
+	X(CPU_TMP_READ8_PC_INC_JRNZ_CHK) \
+	X(CPU_TMP_READ8_PC_INC_JRZ_CHK) \
+	X(CPU_TMP_READ8_PC_INC_JRNC_CHK) \
+	X(CPU_TMP_READ8_PC_INC_JRC_CHK) \
+	X(CPU_TMP_READ8_SP_INC) \
+	X(CPU_PCL_FROM_TMP_PCH_READ8_SP_INC) \
+	X(CPU_C_FROM_TMP_B_READ8_SP_INC) \
+	X(CPU_E_FROM_TMP_D_READ8_SP_INC) \
+	X(CPU_L_FROM_TMP_H_READ8_SP_INC) \
+	X(CPU_F_FROM_TMP_A_READ8_SP_INC) \
+	X(CPU_TMP_READHIGH_A) \
+	X(CPU_TMP_WRITEHIGH_A) \
+	X(CPU_C_READHIGH_A) \
+	X(CPU_C_WRITEHIGH_A) \
+	X(CPU_SP_FROM_HL) \
+	X(CPU_SP_WRITE8_A_DEC) \
+	X(CPU_SP_WRITE8_B_DEC) \
+	X(CPU_SP_WRITE8_C_DEC) \
+	X(CPU_SP_WRITE8_D_DEC) \
+	X(CPU_SP_WRITE8_E_DEC) \
+	X(CPU_SP_WRITE8_F_DEC) \
+	X(CPU_SP_WRITE8_H_DEC) \
+	X(CPU_SP_WRITE8_L_DEC) \
+	X(CPU_SP_WRITE8_PCH_DEC) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_T16) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_00) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_08) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_10) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_18) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_20) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_28) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_30) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_38) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_40) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_48) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_50) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_58) \
+	X(CPU_SP_WRITE8_PCL_DEC_PC_FROM_60) \
+	X(CPU_A_READ8_TMP16) \
+	X(CPU_A_READ8_PC_INC) \
+	X(CPU_B_READ8_PC_INC) \
+	X(CPU_C_READ8_PC_INC) \
+	X(CPU_D_READ8_PC_INC) \
+	X(CPU_E_READ8_PC_INC) \
+	X(CPU_L_READ8_PC_INC) \
+	X(CPU_H_READ8_PC_INC) \
+	X(CPU_PCL_FROM_TMP_PCH_READ8_PC) \
+	X(CPU_SPL_FROM_TMP_SPH_READ8_PC_INC) \
+	X(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC) \
+	X(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CNZ_CHK) \
+	X(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CNC_CHK) \
+	X(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CZ_CHK) \
+	X(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CC_CHK) \
+	X(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPNZ_CHK) \
+	X(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPNC_CHK) \
+	X(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPZ_CHK) \
+	X(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPC_CHK) \
+	X(CPU_TMP16_WRITE8_SPL_INC) \
+	X(CPU_TMP16_WRITE8_SPH) \
+	X(CPU_DI_GET_INSTRUCTION) \
+	X(CPU_EI_GET_INSTRUCTION) \
+	X(CPU_GET_INSTRUCTION_EI) \
+	X(CPU_SCF_GET_INSTRUCTION) \
+	X(CPU_CCF_GET_INSTRUCTION) \
+	X(CPU_PC_FROM_HL_GET_INSTRUCTION) \
+	X(CPU_PC_FROM_T16) \
+	X(CPU_RET_NZ_CHK) \
+	X(CPU_RET_NC_CHK) \
+	X(CPU_RET_Z_CHK) \
+	X(CPU_RET_C_CHK)
+
 enum {
-	CPU_GET_INSTRUCTION = 0,
-	CPU_GET_SUBINSTRUCTION,
-	CPU_DELAY_CYCLE,
-	CPU_ACTION_GET_INSTRUCTION,
-	CPU_A_ACTION_GET_INSTRUCTION,
-	CPU_B_ACTION_GET_INSTRUCTION,
-	CPU_C_ACTION_GET_INSTRUCTION,
-	CPU_D_ACTION_GET_INSTRUCTION,
-	CPU_E_ACTION_GET_INSTRUCTION,
-	CPU_H_ACTION_GET_INSTRUCTION,
-	CPU_L_ACTION_GET_INSTRUCTION,
-	CPU_ACTION_WRITE,
-	CPU_A_ACTION_WRITE,
-	CPU_B_ACTION_WRITE,
-	CPU_C_ACTION_WRITE,
-	CPU_D_ACTION_WRITE,
-	CPU_E_ACTION_WRITE,
-	CPU_H_ACTION_WRITE,
-	CPU_L_ACTION_WRITE,
-	CPU_BC_ACTION_ADD,
-	CPU_DE_ACTION_ADD,
-	CPU_HL_ACTION_ADD,
-	CPU_SP_ACTION_ADD,
-	CPU_HL_ADD_SPECIAL,
-	CPU_SP_ADD_SPECIAL,
-	CPU_ACTION_WRITE8_HL,
-	CPU_TMP_ADD_PC,
-	CPU_TMP_READ8_BC,
-	CPU_TMP_READ8_DE,
-	CPU_TMP_READ8_HL,
-	CPU_TMP_READ8_HL_INC,
-	CPU_TMP_READ8_HL_DEC,
-	CPU_TMP_READ8_PC_INC,
-	CPU_TMP_READ8_PC_INC_JRNZ_CHK,
-	CPU_TMP_READ8_PC_INC_JRZ_CHK,
-	CPU_TMP_READ8_PC_INC_JRNC_CHK,
-	CPU_TMP_READ8_PC_INC_JRC_CHK,
-	CPU_TMP_READ8_SP_INC,
-	CPU_PCL_FROM_TMP_PCH_READ8_SP_INC,
-	CPU_C_FROM_TMP_B_READ8_SP_INC,
-	CPU_E_FROM_TMP_D_READ8_SP_INC,
-	CPU_L_FROM_TMP_H_READ8_SP_INC,
-	CPU_F_FROM_TMP_A_READ8_SP_INC,
-	CPU_TMP_READHIGH_A,
-	CPU_TMP_WRITEHIGH_A,
-	CPU_C_READHIGH_A,
-	CPU_C_WRITEHIGH_A,
-	CPU_SP_FROM_HL,
-	CPU_SP_WRITE8_A_DEC,
-	CPU_SP_WRITE8_B_DEC,
-	CPU_SP_WRITE8_C_DEC,
-	CPU_SP_WRITE8_D_DEC,
-	CPU_SP_WRITE8_E_DEC,
-	CPU_SP_WRITE8_F_DEC,
-	CPU_SP_WRITE8_H_DEC,
-	CPU_SP_WRITE8_L_DEC,
-	CPU_SP_WRITE8_PCH_DEC,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_T16,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_00,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_08,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_10,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_18,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_20,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_28,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_30,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_38,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_40,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_48,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_50,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_58,
-	CPU_SP_WRITE8_PCL_DEC_PC_FROM_60,
-	CPU_A_READ8_TMP16,
-	CPU_A_READ8_PC_INC,
-	CPU_B_READ8_PC_INC,
-	CPU_C_READ8_PC_INC,
-	CPU_D_READ8_PC_INC,
-	CPU_E_READ8_PC_INC,
-	CPU_L_READ8_PC_INC,
-	CPU_H_READ8_PC_INC,
-	CPU_PCL_FROM_TMP_PCH_READ8_PC,
-	CPU_SPL_FROM_TMP_SPH_READ8_PC_INC,
-	CPU_T16L_FROM_TMP_T16H_READ8_PC_INC,
-	CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CNZ_CHK,
-	CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CNC_CHK,
-	CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CZ_CHK,
-	CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CC_CHK,
-	CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPNZ_CHK,
-	CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPNC_CHK,
-	CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPZ_CHK,
-	CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPC_CHK,
-	CPU_TMP16_WRITE8_SPL_INC,
-	CPU_TMP16_WRITE8_SPH,
-	CPU_DI_GET_INSTRUCTION,
-	CPU_EI_GET_INSTRUCTION,
-	CPU_GET_INSTRUCTION_EI,
-	CPU_SCF_GET_INSTRUCTION,
-	CPU_CCF_GET_INSTRUCTION,
-	CPU_PC_FROM_HL_GET_INSTRUCTION,
-	CPU_PC_FROM_T16,
-	CPU_RET_NZ_CHK,
-	CPU_RET_NC_CHK,
-	CPU_RET_Z_CHK,
-	CPU_RET_C_CHK,
+#define CPU_ACTION_ENUM(x) x,
+	CPU_ACTION_LIST(CPU_ACTION_ENUM)
+#undef CPU_ACTION_ENUM
 };
 
 /* arrays for multiple similar instructions */
@@ -881,10 +832,10 @@ static const uint8_t cpu_add_sp_arr[2] = { CPU_SP_ACTION_ADD, CPU_GET_INSTRUCTIO
 static const uint8_t cpu_ld_hl_add_sp_imm_arr[3] = { CPU_TMP_READ8_PC_INC, CPU_HL_ADD_SPECIAL, CPU_GET_INSTRUCTION };
 static const uint8_t cpu_add_sp_imm_arr[4] = { CPU_TMP_READ8_PC_INC, CPU_SP_ADD_SPECIAL, CPU_DELAY_CYCLE, CPU_GET_INSTRUCTION };
 
-static inline void cpuSetNopArr()
+static inline void cpuSetNopArr(gb_t *gb)
 {
-	cpu_action_arr = cpu_nop_arr;
-	cpu_arr_pos = 0;
+	gb->cpu.cpu_action_arr = cpu_nop_arr;
+	gb->cpu.cpu_arr_pos = 0;
 }
 
 static const uint8_t *cpu_instr_arr[256] = {
@@ -969,780 +920,1307 @@ static const uint8_t *cpu_instr_arr[256] = {
 	NULL, NULL, cpu_imm_pc_arr, cpu_rst38_arr, //0xFC-0xFF (0xFC=Invalid, 0xFD=Invalid)
 };
 
-typedef void (*cpu_action_t)(uint8_t*);
-static cpu_action_t cpu_actions_arr[256];
-static cpu_action_t cpu_action_func;
-
-static void cpuSetupActionArr()
-{
-	cpu_actions_arr[0x00] = cpuNoAction; cpu_actions_arr[0x01] = cpuNoAction; cpu_actions_arr[0x02] = cpuSTbc; cpu_actions_arr[0x03] = cpuBcInc;
-	cpu_actions_arr[0x04] = cpuInc; cpu_actions_arr[0x05] = cpuDec; cpu_actions_arr[0x06] = cpuNoAction; cpu_actions_arr[0x07] = cpuRLCA;
-	cpu_actions_arr[0x08] = cpuNoAction; cpu_actions_arr[0x09] = cpuNoAction; cpu_actions_arr[0x0A] = cpuLDa; cpu_actions_arr[0x0B] = cpuBcDec; 
-	cpu_actions_arr[0x0C] = cpuInc; cpu_actions_arr[0x0D] = cpuDec; cpu_actions_arr[0x0E] = cpuNoAction; cpu_actions_arr[0x0F] = cpuRRCA;
-
-	cpu_actions_arr[0x10] = cpuSTOP; cpu_actions_arr[0x11] = cpuNoAction; cpu_actions_arr[0x12] = cpuSTde; cpu_actions_arr[0x13] = cpuDeInc;
-	cpu_actions_arr[0x14] = cpuInc; cpu_actions_arr[0x15] = cpuDec; cpu_actions_arr[0x16] = cpuNoAction; cpu_actions_arr[0x17] = cpuRLA;
-	cpu_actions_arr[0x18] = cpuNoAction; cpu_actions_arr[0x19] = cpuNoAction; cpu_actions_arr[0x1A] = cpuLDa; cpu_actions_arr[0x1B] = cpuDeDec; 
-	cpu_actions_arr[0x1C] = cpuInc; cpu_actions_arr[0x1D] = cpuDec; cpu_actions_arr[0x1E] = cpuNoAction; cpu_actions_arr[0x1F] = cpuRRA;
-
-	cpu_actions_arr[0x20] = cpuNoAction; cpu_actions_arr[0x21] = cpuNoAction; cpu_actions_arr[0x22] = cpuSThlInc; cpu_actions_arr[0x23] = cpuHlInc;
-	cpu_actions_arr[0x24] = cpuInc; cpu_actions_arr[0x25] = cpuDec; cpu_actions_arr[0x26] = cpuNoAction; cpu_actions_arr[0x27] = cpuDAA;
-	cpu_actions_arr[0x28] = cpuNoAction; cpu_actions_arr[0x29] = cpuNoAction; cpu_actions_arr[0x2A] = cpuLDa; cpu_actions_arr[0x2B] = cpuHlDec; 
-	cpu_actions_arr[0x2C] = cpuInc; cpu_actions_arr[0x2D] = cpuDec; cpu_actions_arr[0x2E] = cpuNoAction; cpu_actions_arr[0x2F] = cpuCPL;
-
-	cpu_actions_arr[0x30] = cpuNoAction; cpu_actions_arr[0x31] = cpuNoAction; cpu_actions_arr[0x32] = cpuSThlDec; cpu_actions_arr[0x33] = cpuSpInc;
-	cpu_actions_arr[0x34] = cpuInc; cpu_actions_arr[0x35] = cpuDec; cpu_actions_arr[0x36] = cpuSThl; cpu_actions_arr[0x37] = cpuNoAction;
-	cpu_actions_arr[0x38] = cpuNoAction; cpu_actions_arr[0x39] = cpuNoAction; cpu_actions_arr[0x3A] = cpuLDa; cpu_actions_arr[0x3B] = cpuSpDec; 
-	cpu_actions_arr[0x3C] = cpuInc; cpu_actions_arr[0x3D] = cpuDec; cpu_actions_arr[0x3E] = cpuNoAction; cpu_actions_arr[0x3F] = cpuNoAction;
-
-	cpu_actions_arr[0x40] = cpuLDb; cpu_actions_arr[0x41] = cpuLDb; cpu_actions_arr[0x42] = cpuLDb; cpu_actions_arr[0x43] = cpuLDb;
-	cpu_actions_arr[0x44] = cpuLDb; cpu_actions_arr[0x45] = cpuLDb; cpu_actions_arr[0x46] = cpuLDb; cpu_actions_arr[0x47] = cpuLDb;
-	cpu_actions_arr[0x48] = cpuLDc; cpu_actions_arr[0x49] = cpuLDc; cpu_actions_arr[0x4A] = cpuLDc; cpu_actions_arr[0x4B] = cpuLDc; 
-	cpu_actions_arr[0x4C] = cpuLDc; cpu_actions_arr[0x4D] = cpuLDc; cpu_actions_arr[0x4E] = cpuLDc; cpu_actions_arr[0x4F] = cpuLDc;
-
-	cpu_actions_arr[0x50] = cpuLDd; cpu_actions_arr[0x51] = cpuLDd; cpu_actions_arr[0x52] = cpuLDd; cpu_actions_arr[0x53] = cpuLDd;
-	cpu_actions_arr[0x54] = cpuLDd; cpu_actions_arr[0x55] = cpuLDd; cpu_actions_arr[0x56] = cpuLDd; cpu_actions_arr[0x57] = cpuLDd;
-	cpu_actions_arr[0x58] = cpuLDe; cpu_actions_arr[0x59] = cpuLDe; cpu_actions_arr[0x5A] = cpuLDe; cpu_actions_arr[0x5B] = cpuLDe; 
-	cpu_actions_arr[0x5C] = cpuLDe; cpu_actions_arr[0x5D] = cpuLDe; cpu_actions_arr[0x5E] = cpuLDe; cpu_actions_arr[0x5F] = cpuLDe;
-
-	cpu_actions_arr[0x60] = cpuLDh; cpu_actions_arr[0x61] = cpuLDh; cpu_actions_arr[0x62] = cpuLDh; cpu_actions_arr[0x63] = cpuLDh;
-	cpu_actions_arr[0x64] = cpuLDh; cpu_actions_arr[0x65] = cpuLDh; cpu_actions_arr[0x66] = cpuLDh; cpu_actions_arr[0x67] = cpuLDh;
-	cpu_actions_arr[0x68] = cpuLDl; cpu_actions_arr[0x69] = cpuLDl; cpu_actions_arr[0x6A] = cpuLDl; cpu_actions_arr[0x6B] = cpuLDl; 
-	cpu_actions_arr[0x6C] = cpuLDl; cpu_actions_arr[0x6D] = cpuLDl; cpu_actions_arr[0x6E] = cpuLDl; cpu_actions_arr[0x6F] = cpuLDl;
-
-	cpu_actions_arr[0x70] = cpuSThl; cpu_actions_arr[0x71] = cpuSThl; cpu_actions_arr[0x72] = cpuSThl; cpu_actions_arr[0x73] = cpuSThl;
-	cpu_actions_arr[0x74] = cpuSThl; cpu_actions_arr[0x75] = cpuSThl; cpu_actions_arr[0x76] = cpuHALT; cpu_actions_arr[0x77] = cpuSThl;
-	cpu_actions_arr[0x78] = cpuLDa; cpu_actions_arr[0x79] = cpuLDa; cpu_actions_arr[0x7A] = cpuLDa; cpu_actions_arr[0x7B] = cpuLDa; 
-	cpu_actions_arr[0x7C] = cpuLDa; cpu_actions_arr[0x7D] = cpuLDa; cpu_actions_arr[0x7E] = cpuLDa; cpu_actions_arr[0x7F] = cpuLDa;
-
-	cpu_actions_arr[0x80] = cpuAdd8; cpu_actions_arr[0x81] = cpuAdd8; cpu_actions_arr[0x82] = cpuAdd8; cpu_actions_arr[0x83] = cpuAdd8;
-	cpu_actions_arr[0x84] = cpuAdd8; cpu_actions_arr[0x85] = cpuAdd8; cpu_actions_arr[0x86] = cpuAdd8; cpu_actions_arr[0x87] = cpuAdd8;
-	cpu_actions_arr[0x88] = cpuAdc8; cpu_actions_arr[0x89] = cpuAdc8; cpu_actions_arr[0x8A] = cpuAdc8; cpu_actions_arr[0x8B] = cpuAdc8; 
-	cpu_actions_arr[0x8C] = cpuAdc8; cpu_actions_arr[0x8D] = cpuAdc8; cpu_actions_arr[0x8E] = cpuAdc8; cpu_actions_arr[0x8F] = cpuAdc8;
-
-	cpu_actions_arr[0x90] = cpuSub8; cpu_actions_arr[0x91] = cpuSub8; cpu_actions_arr[0x92] = cpuSub8; cpu_actions_arr[0x93] = cpuSub8;
-	cpu_actions_arr[0x94] = cpuSub8; cpu_actions_arr[0x95] = cpuSub8; cpu_actions_arr[0x96] = cpuSub8; cpu_actions_arr[0x97] = cpuSub8;
-	cpu_actions_arr[0x98] = cpuSbc8; cpu_actions_arr[0x99] = cpuSbc8; cpu_actions_arr[0x9A] = cpuSbc8; cpu_actions_arr[0x9B] = cpuSbc8; 
-	cpu_actions_arr[0x9C] = cpuSbc8; cpu_actions_arr[0x9D] = cpuSbc8; cpu_actions_arr[0x9E] = cpuSbc8; cpu_actions_arr[0x9F] = cpuSbc8;
-
-	cpu_actions_arr[0xA0] = cpuAND; cpu_actions_arr[0xA1] = cpuAND; cpu_actions_arr[0xA2] = cpuAND; cpu_actions_arr[0xA3] = cpuAND;
-	cpu_actions_arr[0xA4] = cpuAND; cpu_actions_arr[0xA5] = cpuAND; cpu_actions_arr[0xA6] = cpuAND; cpu_actions_arr[0xA7] = cpuAND;
-	cpu_actions_arr[0xA8] = cpuXOR; cpu_actions_arr[0xA9] = cpuXOR; cpu_actions_arr[0xAA] = cpuXOR; cpu_actions_arr[0xAB] = cpuXOR; 
-	cpu_actions_arr[0xAC] = cpuXOR; cpu_actions_arr[0xAD] = cpuXOR; cpu_actions_arr[0xAE] = cpuXOR; cpu_actions_arr[0xAF] = cpuXOR;
-
-	cpu_actions_arr[0xB0] = cpuOR; cpu_actions_arr[0xB1] = cpuOR; cpu_actions_arr[0xB2] = cpuOR; cpu_actions_arr[0xB3] = cpuOR;
-	cpu_actions_arr[0xB4] = cpuOR; cpu_actions_arr[0xB5] = cpuOR; cpu_actions_arr[0xB6] = cpuOR; cpu_actions_arr[0xB7] = cpuOR;
-	cpu_actions_arr[0xB8] = cpuCmp8; cpu_actions_arr[0xB9] = cpuCmp8; cpu_actions_arr[0xBA] = cpuCmp8; cpu_actions_arr[0xBB] = cpuCmp8; 
-	cpu_actions_arr[0xBC] = cpuCmp8; cpu_actions_arr[0xBD] = cpuCmp8; cpu_actions_arr[0xBE] = cpuCmp8; cpu_actions_arr[0xBF] = cpuCmp8;
-
-	cpu_actions_arr[0xC0] = cpuNoAction; cpu_actions_arr[0xC1] = cpuNoAction; cpu_actions_arr[0xC2] = cpuNoAction; cpu_actions_arr[0xC3] = cpuNoAction;
-	cpu_actions_arr[0xC4] = cpuNoAction; cpu_actions_arr[0xC5] = cpuNoAction; cpu_actions_arr[0xC6] = cpuAdd8; cpu_actions_arr[0xC7] = cpuNoAction;
-	cpu_actions_arr[0xC8] = cpuNoAction; cpu_actions_arr[0xC9] = cpuNoAction; cpu_actions_arr[0xCA] = cpuNoAction; cpu_actions_arr[0xCB] = cpuNoAction; 
-	cpu_actions_arr[0xCC] = cpuNoAction; cpu_actions_arr[0xCD] = cpuNoAction; cpu_actions_arr[0xCE] = cpuAdc8; cpu_actions_arr[0xCF] = cpuNoAction;
-
-	cpu_actions_arr[0xD0] = cpuNoAction; cpu_actions_arr[0xD1] = cpuNoAction; cpu_actions_arr[0xD2] = cpuNoAction; cpu_actions_arr[0xD3] = cpuNoAction;
-	cpu_actions_arr[0xD4] = cpuNoAction; cpu_actions_arr[0xD5] = cpuNoAction; cpu_actions_arr[0xD6] = cpuSub8; cpu_actions_arr[0xD7] = cpuNoAction;
-	cpu_actions_arr[0xD8] = cpuNoAction; cpu_actions_arr[0xD9] = cpuNoAction; cpu_actions_arr[0xDA] = cpuNoAction; cpu_actions_arr[0xDB] = cpuNoAction; 
-	cpu_actions_arr[0xDC] = cpuNoAction; cpu_actions_arr[0xDD] = cpuNoAction; cpu_actions_arr[0xDE] = cpuSbc8; cpu_actions_arr[0xDF] = cpuNoAction;
-
-	cpu_actions_arr[0xE0] = cpuNoAction; cpu_actions_arr[0xE1] = cpuNoAction; cpu_actions_arr[0xE2] = cpuNoAction; cpu_actions_arr[0xE3] = cpuNoAction;
-	cpu_actions_arr[0xE4] = cpuNoAction; cpu_actions_arr[0xE5] = cpuNoAction; cpu_actions_arr[0xE6] = cpuAND; cpu_actions_arr[0xE7] = cpuNoAction;
-	cpu_actions_arr[0xE8] = cpuNoAction; cpu_actions_arr[0xE9] = cpuNoAction; cpu_actions_arr[0xEA] = cpuSTt16; cpu_actions_arr[0xEB] = cpuNoAction; 
-	cpu_actions_arr[0xEC] = cpuNoAction; cpu_actions_arr[0xED] = cpuNoAction; cpu_actions_arr[0xEE] = cpuXOR; cpu_actions_arr[0xEF] = cpuNoAction;
-
-	cpu_actions_arr[0xF0] = cpuNoAction; cpu_actions_arr[0xF1] = cpuNoAction; cpu_actions_arr[0xF2] = cpuNoAction; cpu_actions_arr[0xF3] = cpuNoAction;
-	cpu_actions_arr[0xF4] = cpuNoAction; cpu_actions_arr[0xF5] = cpuNoAction; cpu_actions_arr[0xF6] = cpuOR; cpu_actions_arr[0xF7] = cpuNoAction;
-	cpu_actions_arr[0xF8] = cpuNoAction; cpu_actions_arr[0xF9] = cpuNoAction; cpu_actions_arr[0xFA] = cpuNoAction; cpu_actions_arr[0xFB] = cpuNoAction; 
-	cpu_actions_arr[0xFC] = cpuNoAction; cpu_actions_arr[0xFD] = cpuNoAction; cpu_actions_arr[0xFE] = cpuCmp8; cpu_actions_arr[0xFF] = cpuNoAction;
-
-	cpu_action_func = cpuNoAction;
-}
-
-bool cpuHandleIrqUpdates()
-{
-	if(gbEmuGBSPlayback) return false;
-	if(!irqEnable) return false;
-	uint8_t irqList = (memGetCurIrqList());
+//instruction length in bytes including the opcode
+static const uint8_t cpu_instr_len[256] = {
+	1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1, //0x00-0x0F
+	2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, //0x10-0x1F
+	2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, //0x20-0x2F
+	2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, //0x30-0x3F
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, //0x40-0x4F
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, //0x50-0x5F
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, //0x60-0x6F
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, //0x70-0x7F
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, //0x80-0x8F
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, //0x90-0x9F
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, //0xA0-0xAF
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, //0xB0-0xBF
+	1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1, //0xC0-0xCF
+	1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 1, 2, 1, //0xD0-0xDF
+	2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1, //0xE0-0xEF
+	2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1, //0xF0-0xFF
+};
+
+static const cpu_action_t cpu_actions_arr[256] = {
+	[0x00] = cpuNoAction, [0x01] = cpuNoAction, [0x02] = cpuSTbc, [0x03] = cpuBcInc,
+	[0x04] = cpuInc, [0x05] = cpuDec, [0x06] = cpuNoAction, [0x07] = cpuRLCA,
+	[0x08] = cpuNoAction, [0x09] = cpuNoAction, [0x0A] = cpuLDa, [0x0B] = cpuBcDec,
+	[0x0C] = cpuInc, [0x0D] = cpuDec, [0x0E] = cpuNoAction, [0x0F] = cpuRRCA,
+
+	[0x10] = cpuSTOP, [0x11] = cpuNoAction, [0x12] = cpuSTde, [0x13] = cpuDeInc,
+	[0x14] = cpuInc, [0x15] = cpuDec, [0x16] = cpuNoAction, [0x17] = cpuRLA,
+	[0x18] = cpuNoAction, [0x19] = cpuNoAction, [0x1A] = cpuLDa, [0x1B] = cpuDeDec,
+	[0x1C] = cpuInc, [0x1D] = cpuDec, [0x1E] = cpuNoAction, [0x1F] = cpuRRA,
+
+	[0x20] = cpuNoAction, [0x21] = cpuNoAction, [0x22] = cpuSThlInc, [0x23] = cpuHlInc,
+	[0x24] = cpuInc, [0x25] = cpuDec, [0x26] = cpuNoAction, [0x27] = cpuDAA,
+	[0x28] = cpuNoAction, [0x29] = cpuNoAction, [0x2A] = cpuLDa, [0x2B] = cpuHlDec,
+	[0x2C] = cpuInc, [0x2D] = cpuDec, [0x2E] = cpuNoAction, [0x2F] = cpuCPL,
+
+	[0x30] = cpuNoAction, [0x31] = cpuNoAction, [0x32] = cpuSThlDec, [0x33] = cpuSpInc,
+	[0x34] = cpuInc, [0x35] = cpuDec, [0x36] = cpuSThl, [0x37] = cpuNoAction,
+	[0x38] = cpuNoAction, [0x39] = cpuNoAction, [0x3A] = cpuLDa, [0x3B] = cpuSpDec,
+	[0x3C] = cpuInc, [0x3D] = cpuDec, [0x3E] = cpuNoAction, [0x3F] = cpuNoAction,
+
+	[0x40] = cpuLDb, [0x41] = cpuLDb, [0x42] = cpuLDb, [0x43] = cpuLDb,
+	[0x44] = cpuLDb, [0x45] = cpuLDb, [0x46] = cpuLDb, [0x47] = cpuLDb,
+	[0x48] = cpuLDc, [0x49] = cpuLDc, [0x4A] = cpuLDc, [0x4B] = cpuLDc,
+	[0x4C] = cpuLDc, [0x4D] = cpuLDc, [0x4E] = cpuLDc, [0x4F] = cpuLDc,
+
+	[0x50] = cpuLDd, [0x51] = cpuLDd, [0x52] = cpuLDd, [0x53] = cpuLDd,
+	[0x54] = cpuLDd, [0x55] = cpuLDd, [0x56] = cpuLDd, [0x57] = cpuLDd,
+	[0x58] = cpuLDe, [0x59] = cpuLDe, [0x5A] = cpuLDe, [0x5B] = cpuLDe,
+	[0x5C] = cpuLDe, [0x5D] = cpuLDe, [0x5E] = cpuLDe, [0x5F] = cpuLDe,
+
+	[0x60] = cpuLDh, [0x61] = cpuLDh, [0x62] = cpuLDh, [0x63] = cpuLDh,
+	[0x64] = cpuLDh, [0x65] = cpuLDh, [0x66] = cpuLDh, [0x67] = cpuLDh,
+	[0x68] = cpuLDl, [0x69] = cpuLDl, [0x6A] = cpuLDl, [0x6B] = cpuLDl,
+	[0x6C] = cpuLDl, [0x6D] = cpuLDl, [0x6E] = cpuLDl, [0x6F] = cpuLDl,
+
+	[0x70] = cpuSThl, [0x71] = cpuSThl, [0x72] = cpuSThl, [0x73] = cpuSThl,
+	[0x74] = cpuSThl, [0x75] = cpuSThl, [0x76] = cpuHALT, [0x77] = cpuSThl,
+	[0x78] = cpuLDa, [0x79] = cpuLDa, [0x7A] = cpuLDa, [0x7B] = cpuLDa,
+	[0x7C] = cpuLDa, [0x7D] = cpuLDa, [0x7E] = cpuLDa, [0x7F] = cpuLDa,
+
+	[0x80] = cpuAdd8, [0x81] = cpuAdd8, [0x82] = cpuAdd8, [0x83] = cpuAdd8,
+	[0x84] = cpuAdd8, [0x85] = cpuAdd8, [0x86] = cpuAdd8, [0x87] = cpuAdd8,
+	[0x88] = cpuAdc8, [0x89] = cpuAdc8, [0x8A] = cpuAdc8, [0x8B] = cpuAdc8,
+	[0x8C] = cpuAdc8, [0x8D] = cpuAdc8, [0x8E] = cpuAdc8, [0x8F] = cpuAdc8,
+
+	[0x90] = cpuSub8, [0x91] = cpuSub8, [0x92] = cpuSub8, [0x93] = cpuSub8,
+	[0x94] = cpuSub8, [0x95] = cpuSub8, [0x96] = cpuSub8, [0x97] = cpuSub8,
+	[0x98] = cpuSbc8, [0x99] = cpuSbc8, [0x9A] = cpuSbc8, [0x9B] = cpuSbc8,
+	[0x9C] = cpuSbc8, [0x9D] = cpuSbc8, [0x9E] = cpuSbc8, [0x9F] = cpuSbc8,
+
+	[0xA0] = cpuAND, [0xA1] = cpuAND, [0xA2] = cpuAND, [0xA3] = cpuAND,
+	[0xA4] = cpuAND, [0xA5] = cpuAND, [0xA6] = cpuAND, [0xA7] = cpuAND,
+	[0xA8] = cpuXOR, [0xA9] = cpuXOR, [0xAA] = cpuXOR, [0xAB] = cpuXOR,
+	[0xAC] = cpuXOR, [0xAD] = cpuXOR, [0xAE] = cpuXOR, [0xAF] = cpuXOR,
+
+	[0xB0] = cpuOR, [0xB1] = cpuOR, [0xB2] = cpuOR, [0xB3] = cpuOR,
+	[0xB4] = cpuOR, [0xB5] = cpuOR, [0xB6] = cpuOR, [0xB7] = cpuOR,
+	[0xB8] = cpuCmp8, [0xB9] = cpuCmp8, [0xBA] = cpuCmp8, [0xBB] = cpuCmp8,
+	[0xBC] = cpuCmp8, [0xBD] = cpuCmp8, [0xBE] = cpuCmp8, [0xBF] = cpuCmp8,
+
+	[0xC0] = cpuNoAction, [0xC1] = cpuNoAction, [0xC2] = cpuNoAction, [0xC3] = cpuNoAction,
+	[0xC4] = cpuNoAction, [0xC5] = cpuNoAction, [0xC6] = cpuAdd8, [0xC7] = cpuNoAction,
+	[0xC8] = cpuNoAction, [0xC9] = cpuNoAction, [0xCA] = cpuNoAction, [0xCB] = cpuNoAction,
+	[0xCC] = cpuNoAction, [0xCD] = cpuNoAction, [0xCE] = cpuAdc8, [0xCF] = cpuNoAction,
+
+	[0xD0] = cpuNoAction, [0xD1] = cpuNoAction, [0xD2] = cpuNoAction, [0xD3] = cpuNoAction,
+	[0xD4] = cpuNoAction, [0xD5] = cpuNoAction, [0xD6] = cpuSub8, [0xD7] = cpuNoAction,
+	[0xD8] = cpuNoAction, [0xD9] = cpuNoAction, [0xDA] = cpuNoAction, [0xDB] = cpuNoAction,
+	[0xDC] = cpuNoAction, [0xDD] = cpuNoAction, [0xDE] = cpuSbc8, [0xDF] = cpuNoAction,
+
+	[0xE0] = cpuNoAction, [0xE1] = cpuNoAction, [0xE2] = cpuNoAction, [0xE3] = cpuNoAction,
+	[0xE4] = cpuNoAction, [0xE5] = cpuNoAction, [0xE6] = cpuAND, [0xE7] = cpuNoAction,
+	[0xE8] = cpuNoAction, [0xE9] = cpuNoAction, [0xEA] = cpuSTt16, [0xEB] = cpuNoAction,
+	[0xEC] = cpuNoAction, [0xED] = cpuNoAction, [0xEE] = cpuXOR, [0xEF] = cpuNoAction,
+
+	[0xF0] = cpuNoAction, [0xF1] = cpuNoAction, [0xF2] = cpuNoAction, [0xF3] = cpuNoAction,
+	[0xF4] = cpuNoAction, [0xF5] = cpuNoAction, [0xF6] = cpuOR, [0xF7] = cpuNoAction,
+	[0xF8] = cpuNoAction, [0xF9] = cpuNoAction, [0xFA] = cpuNoAction, [0xFB] = cpuNoAction,
+	[0xFC] = cpuNoAction, [0xFD] = cpuNoAction, [0xFE] = cpuCmp8, [0xFF] = cpuNoAction,
+};
+
+//CB opcodes have the register in the low 3 bits
+//and the operation plus bit number above that
+#define CPU_CB_REGS(hl) cpu_imm_b_arr, cpu_imm_c_arr, cpu_imm_d_arr, cpu_imm_e_arr, \
+	cpu_imm_h_arr, cpu_imm_l_arr, hl, cpu_imm_a_arr,
+#define CPU_CB_OP(f) f, f, f, f, f, f, f, f,
+
+//CB opcodes resolved up front instead of on every use, BIT only reads
+static const uint8_t *const cpu_cb_instr_arr[256] = {
+	CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) //0x00-0x1F
+	CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) //0x20-0x3F
+	CPU_CB_REGS(cpu_imm_hl_arr) CPU_CB_REGS(cpu_imm_hl_arr) CPU_CB_REGS(cpu_imm_hl_arr) CPU_CB_REGS(cpu_imm_hl_arr) //0x40-0x5F
+	CPU_CB_REGS(cpu_imm_hl_arr) CPU_CB_REGS(cpu_imm_hl_arr) CPU_CB_REGS(cpu_imm_hl_arr) CPU_CB_REGS(cpu_imm_hl_arr) //0x60-0x7F
+	CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) //0x80-0x9F
+	CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) //0xA0-0xBF
+	CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) //0xC0-0xDF
+	CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) CPU_CB_REGS(cpu_imm_hl_st_arr) //0xE0-0xFF
+};
+
+static const cpu_action_t cpu_cb_actions_arr[256] = {
+	CPU_CB_OP(cpuRLC) CPU_CB_OP(cpuRRC) CPU_CB_OP(cpuRL) CPU_CB_OP(cpuRR) //0x00-0x1F
+	CPU_CB_OP(cpuSLA) CPU_CB_OP(cpuSRA) CPU_CB_OP(cpuSWAP) CPU_CB_OP(cpuSRL) //0x20-0x3F
+	CPU_CB_OP(cpuBIT0) CPU_CB_OP(cpuBIT1) CPU_CB_OP(cpuBIT2) CPU_CB_OP(cpuBIT3) //0x40-0x5F
+	CPU_CB_OP(cpuBIT4) CPU_CB_OP(cpuBIT5) CPU_CB_OP(cpuBIT6) CPU_CB_OP(cpuBIT7) //0x60-0x7F
+	CPU_CB_OP(cpuRES0) CPU_CB_OP(cpuRES1) CPU_CB_OP(cpuRES2) CPU_CB_OP(cpuRES3) //0x80-0x9F
+	CPU_CB_OP(cpuRES4) CPU_CB_OP(cpuRES5) CPU_CB_OP(cpuRES6) CPU_CB_OP(cpuRES7) //0xA0-0xBF
+	CPU_CB_OP(cpuSET0) CPU_CB_OP(cpuSET1) CPU_CB_OP(cpuSET2) CPU_CB_OP(cpuSET3) //0xC0-0xDF
+	CPU_CB_OP(cpuSET4) CPU_CB_OP(cpuSET5) CPU_CB_OP(cpuSET6) CPU_CB_OP(cpuSET7) //0xE0-0xFF
+};
+
+#undef CPU_CB_REGS
+#undef CPU_CB_OP
+
+bool cpuHandleIrqUpdates(gb_t *gb)
+{
+	if(gb->gbEmuGBSPlayback) return false;
+	if(!gb->cpu.irqEnable) return false;
+	cpuSync(gb);
+	uint8_t irqList = (memGetCurIrqList(gb));
 	if(irqList & 1)
 	{
-		memClearCurIrqList(1);
+		memClearCurIrqList(gb, 1);
 		//printf("Beep Bop Interrupt 40 and jmp from %04x\n", pc);
-		cpu_action_arr = cpu_rst40_arr;
-		irqEnable = false;
+		gb->cpu.cpu_action_arr = cpu_rst40_arr;
+		gb->cpu.irqEnable = false;
 		return true;
 	}
 	else if(irqList & 2)
 	{
-		memClearCurIrqList(2);
+		memClearCurIrqList(gb, 2);
 		//printf("Beep Bop Interrupt 48 and jmp from %04x\n", pc);
-		cpu_action_arr = cpu_rst48_arr;
-		irqEnable = false;
+		gb->cpu.cpu_action_arr = cpu_rst48_arr;
+		gb->cpu.irqEnable = false;
 		return true;
 	}
 	else if(irqList & 4)
 	{
-		memClearCurIrqList(4);
+		memClearCurIrqList(gb, 4);
 		//printf("Beep Bop Interrupt 50 and jmp from %04x\n", pc);
-		cpu_action_arr = cpu_rst50_arr;
-		irqEnable = false;
+		gb->cpu.cpu_action_arr = cpu_rst50_arr;
+		gb->cpu.irqEnable = false;
 		return true;
 	}
 	else if(irqList & 8)
 	{
-		memClearCurIrqList(8);
+		memClearCurIrqList(gb, 8);
 		//printf("Beep Bop Interrupt 58 and jmp from %04x\n", pc);
-		cpu_action_arr = cpu_rst58_arr;
-		irqEnable = false;
+		gb->cpu.cpu_action_arr = cpu_rst58_arr;
+		gb->cpu.irqEnable = false;
 		return true;
 	}
 	else if(irqList & 0x10)
 	{
-		memClearCurIrqList(0x10);
+		memClearCurIrqList(gb, 0x10);
 		//printf("Beep Bop Interrupt 60 and jmp from %04x\n", pc);
-		cpu_action_arr = cpu_rst60_arr;
-		irqEnable = false;
+		gb->cpu.cpu_action_arr = cpu_rst60_arr;
+		gb->cpu.irqEnable = false;
 		return true;
 	}
 	return false;
 }
 
-void cpuGetInstruction()
+//looks up the decoded instruction at pc and decodes it if
+//needed, NULL if it has to be read from memory every time
+static memcode_t *cpuGetCode(gb_t *gb)
 {
-	if(cpuHandleIrqUpdates())
+	uint16_t pc = gb->cpu.pc;
+	memcode_t *code = memGetCode(gb, pc);
+	if(!code || code->len)
+		return code;
+	uint8_t op = memGet8(gb, pc);
+	uint8_t len = cpu_instr_len[op];
+	uint16_t end = pc+len-1;
+	//operands have to come from the same block, otherwise
+	//a bank switch could change them behind our back
+	if(len > 1 && (((pc^end)&0xF000) || !memGetCode(gb, end)))
+		return NULL;
+	code->op = op;
+	code->imm[0] = (len > 1) ? memGet8(gb, pc+1) : 0;
+	code->imm[1] = (len > 2) ? memGet8(gb, pc+2) : 0;
+	code->len = len;
+	return code;
+}
+
+void cpuGetInstruction(gb_t *gb)
+{
+	gb->cpu.cpuFetched = true;
+	gb->cpu.cpuCode = NULL;
+	if(cpuHandleIrqUpdates(gb))
 	{
-		cpuHaltLoop = false;
-		cpu_arr_pos = 0;
+		gb->cpu.cpuHaltLoop = false;
+		gb->cpu.cpu_arr_pos = 0;
 		return;
 	}
-	if(gbEmuGBSPlayback)
+	if(gb->gbEmuGBSPlayback)
 	{
 		//init return
-		if(pc == 0x8764)
+		if(gb->cpu.pc == 0x8764)
 		{
 			//if(!gbsInitRet)
 			//	printf("Init return\n");
-			gbsInitRet = true; //allow play call
-			cpuSetNopArr();
+			gb->cpu.gbsInitRet = true; //allow play call
+			cpuSetNopArr(gb);
 			return;
 		} //play return
-		else if(pc == 0x8765)
+		else if(gb->cpu.pc == 0x8765)
 		{
 			//if(!gbsPlayRet)
 			//	printf("Play return\n");
-			gbsPlayRet = true; //allow next play call
-			cpuSetNopArr();
+			gb->cpu.gbsPlayRet = true; //allow next play call
+			cpuSetNopArr(gb);
 			return;
 		}
 	}
-	if(cpuHaltLoop)
+	if(gb->cpu.cpuHaltLoop)
 	{
-		cpuSetNopArr();
+		cpuSetNopArr(gb);
 		//happens when IME=0
-		if(!irqEnable && memGetCurIrqList())
-			cpuHaltLoop = false;
+		if(!gb->cpu.irqEnable)
+			cpuSync(gb);
+		if(!gb->cpu.irqEnable && memGetCurIrqList(gb))
+			gb->cpu.cpuHaltLoop = false;
 		else //keep waiting
 			return;
 	}
-	if(cpuStopLoop)
+	if(gb->cpu.cpuStopLoop)
 	{
-		bool cpuInAny = inputAny();
-		if(cpuInAny && !cpuPrevInAny)
-			cpuStopLoop = false;
-		cpuPrevInAny = cpuInAny;
-		cpuSetNopArr();
+		bool cpuInAny = inputAny(gb);
+		if(cpuInAny && !gb->cpu.cpuPrevInAny)
+			gb->cpu.cpuStopLoop = false;
+		gb->cpu.cpuPrevInAny = cpuInAny;
+		cpuSetNopArr(gb);
 		return;
 	}
-	curInstr = memGet8(pc);
-	cpu_action_arr = cpu_instr_arr[curInstr];
-	cpu_arr_pos = 0;
-	if(cpu_action_arr == NULL)
+	gb->cpu.cpuCode = cpuGetCode(gb);
+	if(gb->cpu.cpuCode)
+		gb->cpu.curInstr = gb->cpu.cpuCode->op;
+	else
+		gb->cpu.curInstr = cpuGet8(gb, gb->cpu.pc);
+	gb->cpu.cpu_action_arr = cpu_instr_arr[gb->cpu.curInstr];
+	gb->cpu.cpu_arr_pos = 0;
+	if(gb->cpu.cpu_action_arr == NULL)
 	{
-		printf("CPU Error: Unsupported Instruction at %04x:%02x!\n", pc-1,curInstr);
-		cpuSetNopArr();
-		cpuSetStopLoop();
+		printf("CPU Error: Unsupported Instruction at %04x:%02x!\n", gb->cpu.pc-1,gb->cpu.curInstr);
+		cpuSetNopArr(gb);
+		cpuSetStopLoop(gb);
 	}
-	cpu_action_func = cpu_actions_arr[curInstr];
+	gb->cpu.cpu_action_func = cpu_actions_arr[gb->cpu.curInstr];
 
 	//if(pc==0xABC || pc == 0xAC1 || pc == 0x5E0E || pc == 0x5E0F)
 	//	printf("%04x %02x a %02x b %02x hl %04x\n", pc, curInstr, a, b, (l|(h<<8)));
 	//HALT bug: PC doesnt increase after instruction is parsed!
-	if(!cpuHaltBug) pc++;
-	cpuHaltBug = false;
+	//so the operands are not the ones that got decoded
+	if(gb->cpu.cpuHaltBug) gb->cpu.cpuCode = NULL;
+	else gb->cpu.pc++;
+	gb->cpu.cpuHaltBug = false;
 }
 
-static void cpuHandleOAMDMA()
+//the whole transfer gets copied once it starts, after that only
+//the 160 cycles oam stays blocked for are left to count down
+static void cpuHandleOAMDMA(gb_t *gb)
 {
-	if(cpu_oam_dma)
+	if(gb->cpu.cpu_oam_dma)
 	{
-		if(!cpu_oam_dma_started)
-			cpu_oam_dma_started = true;
+		if(!gb->cpu.cpu_oam_dma_started)
+			gb->cpu.cpu_oam_dma_started = true;
 		else
 		{
-			cpu_oam_dma = false;
-			cpu_oam_dma_started = false;
-			cpu_oam_dma_running = true;
-			cpu_oam_dma_pos = 0;
+			gb->cpu.cpu_oam_dma = false;
+			gb->cpu.cpu_oam_dma_started = false;
+			gb->cpu.cpu_oam_dma_running = true;
+			gb->cpu.cpu_oam_dma_pos = 0;
+			//rom and main ram pages can be copied from directly
+			const uint8_t *src = gb->mem.memReadPage[gb->cpu.cpu_oam_dma_addr>>8];
+			uint8_t buf[0xA0];
+			if(!src)
+			{
+				uint8_t i;
+				for(i = 0; i < 0xA0; i++)
+					buf[i] = memGet8(gb, gb->cpu.cpu_oam_dma_addr+i);
+				src = buf;
+			}
+			ppuSetOAMDMA(gb, src);
 		}
 	}
-	if(cpu_oam_dma_running)
+	if(gb->cpu.cpu_oam_dma_running)
 	{
-		if(cpu_oam_dma_pos == 0xA0)
-			cpu_oam_dma_running = false;
+		if(gb->cpu.cpu_oam_dma_pos == 0xA0)
+			gb->cpu.cpu_oam_dma_running = false;
 		else
-		{
-			//printf("OAM Copying %02x\n", cpu_oam_dma_pos);
-			ppuSetOAMDMAVal(cpu_oam_dma_pos,memGet8(cpu_oam_dma_addr+cpu_oam_dma_pos));
-			cpu_oam_dma_pos++;
-		}
+			gb->cpu.cpu_oam_dma_pos++;
 	}
 }
 
 /* Main CPU Interpreter */
 
-void cpuCycle()
+//moves on to the next clock the cpu runs on in catch-up mode,
+//returns if the next action of the same instruction can run
+static inline bool cpuNextAction(gb_t *gb)
+{
+	uint8_t curClock = gb->mainClock + gb->emuClocksAhead;
+	gb->emuClocksAhead += (gb->cpuTimer+1) - (curClock&gb->cpuTimer);
+	//DMA needs the cpu clocked along with it
+	if(gb->cpu.cpu_oam_dma || gb->mem.cgbDmaActive || gb->cpu.cpuDmaHalt)
+		return false;
+	return !gb->cpu.cpuFetched;
+}
+
+//runs one cycle action, or in catch-up mode all of them up to
+//and including the next fetch, the threaded version jumps from
+//each action straight to the next one instead of going through
+//one shared switch
+static inline void cpuDoActions(gb_t *gb, bool runAhead)
 {
-	if(cpuDmaHalt)
+	uint8_t sub_instr;
+#if CPU_THREADED
+	static const void *const cpu_action_labels[] = {
+#define CPU_ACTION_LABEL(x) &&x##_LABEL,
+		CPU_ACTION_LIST(CPU_ACTION_LABEL)
+#undef CPU_ACTION_LABEL
+	};
+#define CPU_ACTION(x) x##_LABEL:
+#define CPU_ACTION_END \
+	if(!runAhead || !cpuNextAction(gb)) \
+		return; \
+	goto *cpu_action_labels[gb->cpu.cpu_action_arr[gb->cpu.cpu_arr_pos++]];
+	goto *cpu_action_labels[gb->cpu.cpu_action_arr[gb->cpu.cpu_arr_pos++]];
+	{
+#else
+#define CPU_ACTION(x) case x:
+#define CPU_ACTION_END break;
+	do switch(gb->cpu.cpu_action_arr[gb->cpu.cpu_arr_pos++])
+	{
+#endif
+		CPU_ACTION(CPU_GET_INSTRUCTION)
+			cpuGetInstruction(gb);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_GET_SUBINSTRUCTION)
+			sub_instr = cpuGet8(gb, gb->cpu.pc++);
+			//set sub array and func
+			gb->cpu.cpu_action_arr = cpu_cb_instr_arr[sub_instr];
+			gb->cpu.cpu_action_func = cpu_cb_actions_arr[sub_instr];
+			gb->cpu.cpu_arr_pos = 0;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_DELAY_CYCLE)
+			CPU_ACTION_END
+		CPU_ACTION(CPU_ACTION_GET_INSTRUCTION)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.cpuTmp);
+			cpuGetInstruction(gb);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_A_ACTION_GET_INSTRUCTION)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.a);
+			cpuGetInstruction(gb);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_B_ACTION_GET_INSTRUCTION)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.b);
+			cpuGetInstruction(gb);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_C_ACTION_GET_INSTRUCTION)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.c);
+			cpuGetInstruction(gb);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_D_ACTION_GET_INSTRUCTION)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.d);
+			cpuGetInstruction(gb);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_E_ACTION_GET_INSTRUCTION)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.e);
+			cpuGetInstruction(gb);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_H_ACTION_GET_INSTRUCTION)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.h);
+			cpuGetInstruction(gb);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_L_ACTION_GET_INSTRUCTION)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.l);
+			cpuGetInstruction(gb);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_ACTION_WRITE)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.cpuTmp);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_A_ACTION_WRITE)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.a);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_B_ACTION_WRITE)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.b);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_C_ACTION_WRITE)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.c);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_D_ACTION_WRITE)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.d);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_E_ACTION_WRITE)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.e);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_H_ACTION_WRITE)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.h);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_L_ACTION_WRITE)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.l);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_BC_ACTION_ADD)
+			cpuAdd16(gb, gb->cpu.c|gb->cpu.b<<8);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_DE_ACTION_ADD)
+			cpuAdd16(gb, gb->cpu.e|gb->cpu.d<<8);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_HL_ACTION_ADD)
+			cpuAdd16(gb, gb->cpu.l|gb->cpu.h<<8);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_ACTION_ADD)
+			cpuAdd16(gb, gb->cpu.sp);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_HL_ADD_SPECIAL)
+			gb->cpu.cpuTmp16 = cpuAddSp16(gb, gb->cpu.cpuTmp);
+			gb->cpu.h = gb->cpu.cpuTmp16>>8;
+			gb->cpu.l = gb->cpu.cpuTmp16&0xFF;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_ADD_SPECIAL)
+			gb->cpu.sp = cpuAddSp16(gb, gb->cpu.cpuTmp);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_ACTION_WRITE8_HL)
+			gb->cpu.cpu_action_func(gb, &gb->cpu.cpuTmp);
+			cpuSet8(gb, gb->cpu.l | gb->cpu.h<<8, gb->cpu.cpuTmp);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_ADD_PC)
+			gb->cpu.pc += (int8_t)gb->cpu.cpuTmp;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_READ8_BC)
+			gb->cpu.cpuTmp = cpuGet8(gb, gb->cpu.c | gb->cpu.b<<8);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_READ8_DE)
+			gb->cpu.cpuTmp = cpuGet8(gb, gb->cpu.e | gb->cpu.d<<8);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_READ8_HL)
+			gb->cpu.cpuTmp = cpuGet8(gb, gb->cpu.l | gb->cpu.h<<8);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_READ8_HL_INC)
+			gb->cpu.cpuTmp = cpuGet8(gb, gb->cpu.l | gb->cpu.h<<8);
+			cpuHlInc(gb, NULL);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_READ8_HL_DEC)
+			gb->cpu.cpuTmp = cpuGet8(gb, gb->cpu.l | gb->cpu.h<<8);
+			cpuHlDec(gb, NULL);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_READ8_PC_INC)
+			gb->cpu.cpuTmp = cpuGet8(gb, gb->cpu.pc++);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_READ8_PC_INC_JRNZ_CHK)
+			gb->cpu.cpuTmp = cpuGet8(gb, gb->cpu.pc++);
+			if(cpuIsZ(gb)) gb->cpu.cpu_arr_pos++;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_READ8_PC_INC_JRZ_CHK)
+			gb->cpu.cpuTmp = cpuGet8(gb, gb->cpu.pc++);
+			if(!cpuIsZ(gb)) gb->cpu.cpu_arr_pos++;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_READ8_PC_INC_JRNC_CHK)
+			gb->cpu.cpuTmp = cpuGet8(gb, gb->cpu.pc++);
+			if(cpuIsC(gb)) gb->cpu.cpu_arr_pos++;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_READ8_PC_INC_JRC_CHK)
+			gb->cpu.cpuTmp = cpuGet8(gb, gb->cpu.pc++);
+			if(!cpuIsC(gb)) gb->cpu.cpu_arr_pos++;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_READ8_SP_INC)
+			gb->cpu.cpuTmp = cpuGet8(gb, gb->cpu.sp++);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_PCL_FROM_TMP_PCH_READ8_SP_INC)
+			gb->cpu.pc = (gb->cpu.cpuTmp | (cpuGet8(gb, gb->cpu.sp++)<<8));
+			CPU_ACTION_END
+		CPU_ACTION(CPU_C_FROM_TMP_B_READ8_SP_INC)
+			gb->cpu.c = gb->cpu.cpuTmp;
+			gb->cpu.b = cpuGet8(gb, gb->cpu.sp++);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_E_FROM_TMP_D_READ8_SP_INC)
+			gb->cpu.e = gb->cpu.cpuTmp;
+			gb->cpu.d = cpuGet8(gb, gb->cpu.sp++);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_L_FROM_TMP_H_READ8_SP_INC)
+			gb->cpu.l = gb->cpu.cpuTmp;
+			gb->cpu.h = cpuGet8(gb, gb->cpu.sp++);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_F_FROM_TMP_A_READ8_SP_INC)
+			cpuSetF(gb, gb->cpu.cpuTmp);
+			gb->cpu.a = cpuGet8(gb, gb->cpu.sp++);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_READHIGH_A)
+			gb->cpu.a = cpuGet8(gb, 0xFF00 | gb->cpu.cpuTmp);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP_WRITEHIGH_A)
+			cpuSet8(gb, 0xFF00 | gb->cpu.cpuTmp, gb->cpu.a);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_C_READHIGH_A)
+			gb->cpu.a = cpuGet8(gb, 0xFF00 | gb->cpu.c);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_C_WRITEHIGH_A)
+			cpuSet8(gb, 0xFF00 | gb->cpu.c, gb->cpu.a);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_FROM_HL)
+			gb->cpu.sp = (gb->cpu.l | gb->cpu.h<<8);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_A_DEC)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.a);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_B_DEC)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.b);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_C_DEC)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.c);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_D_DEC)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.d);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_E_DEC)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.e);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_F_DEC)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, cpuGetF(gb));
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_H_DEC)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.h);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_L_DEC)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.l);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCH_DEC)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc>>8);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_T16)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = gb->cpu.cpuTmp16;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_00)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = 0x00+gb->gbsLoadAddr;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_08)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = 0x08+gb->gbsLoadAddr;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_10)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = 0x10+gb->gbsLoadAddr;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_18)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = 0x18+gb->gbsLoadAddr;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_20)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = 0x20+gb->gbsLoadAddr;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_28)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = 0x28+gb->gbsLoadAddr;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_30)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = 0x30+gb->gbsLoadAddr;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_38)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = 0x38+gb->gbsLoadAddr;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_40)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = 0x40;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_48)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = 0x48;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_50)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = 0x50;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_58)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = 0x58;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SP_WRITE8_PCL_DEC_PC_FROM_60)
+			gb->cpu.sp--;
+			cpuSet8(gb, gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = 0x60;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_A_READ8_TMP16)
+			gb->cpu.a = cpuGet8(gb, gb->cpu.cpuTmp16);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_A_READ8_PC_INC)
+			gb->cpu.a = cpuGet8(gb, gb->cpu.pc++);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_B_READ8_PC_INC)
+			gb->cpu.b = cpuGet8(gb, gb->cpu.pc++);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_C_READ8_PC_INC)
+			gb->cpu.c = cpuGet8(gb, gb->cpu.pc++);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_D_READ8_PC_INC)
+			gb->cpu.d = cpuGet8(gb, gb->cpu.pc++);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_E_READ8_PC_INC)
+			gb->cpu.e = cpuGet8(gb, gb->cpu.pc++);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_L_READ8_PC_INC)
+			gb->cpu.l = cpuGet8(gb, gb->cpu.pc++);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_H_READ8_PC_INC)
+			gb->cpu.h = cpuGet8(gb, gb->cpu.pc++);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_PCL_FROM_TMP_PCH_READ8_PC)
+			gb->cpu.pc = (gb->cpu.cpuTmp | (cpuGet8(gb, gb->cpu.pc)<<8));
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SPL_FROM_TMP_SPH_READ8_PC_INC)
+			gb->cpu.sp = (gb->cpu.cpuTmp | (cpuGet8(gb, gb->cpu.pc++)<<8));
+			CPU_ACTION_END
+		CPU_ACTION(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC)
+			gb->cpu.cpuTmp16 = (gb->cpu.cpuTmp | (cpuGet8(gb, gb->cpu.pc++)<<8));
+			CPU_ACTION_END
+		CPU_ACTION(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CNZ_CHK)
+			gb->cpu.cpuTmp16 = (gb->cpu.cpuTmp | (cpuGet8(gb, gb->cpu.pc++)<<8));
+			if(cpuIsZ(gb)) gb->cpu.cpu_arr_pos+=3;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CNC_CHK)
+			gb->cpu.cpuTmp16 = (gb->cpu.cpuTmp | (cpuGet8(gb, gb->cpu.pc++)<<8));
+			if(cpuIsC(gb)) gb->cpu.cpu_arr_pos+=3;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CZ_CHK)
+			gb->cpu.cpuTmp16 = (gb->cpu.cpuTmp | (cpuGet8(gb, gb->cpu.pc++)<<8));
+			if(!cpuIsZ(gb)) gb->cpu.cpu_arr_pos+=3;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CC_CHK)
+			gb->cpu.cpuTmp16 = (gb->cpu.cpuTmp | (cpuGet8(gb, gb->cpu.pc++)<<8));
+			if(!cpuIsC(gb)) gb->cpu.cpu_arr_pos+=3;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPNZ_CHK)
+			gb->cpu.cpuTmp16 = (gb->cpu.cpuTmp | (cpuGet8(gb, gb->cpu.pc++)<<8));
+			if(cpuIsZ(gb)) gb->cpu.cpu_arr_pos++;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPNC_CHK)
+			gb->cpu.cpuTmp16 = (gb->cpu.cpuTmp | (cpuGet8(gb, gb->cpu.pc++)<<8));
+			if(cpuIsC(gb)) gb->cpu.cpu_arr_pos++;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPZ_CHK)
+			gb->cpu.cpuTmp16 = (gb->cpu.cpuTmp | (cpuGet8(gb, gb->cpu.pc++)<<8));
+			if(!cpuIsZ(gb)) gb->cpu.cpu_arr_pos++;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPC_CHK)
+			gb->cpu.cpuTmp16 = (gb->cpu.cpuTmp | (cpuGet8(gb, gb->cpu.pc++)<<8));
+			if(!cpuIsC(gb)) gb->cpu.cpu_arr_pos++;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP16_WRITE8_SPL_INC)
+			cpuSet8(gb, gb->cpu.cpuTmp16++, gb->cpu.sp&0xFF);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_TMP16_WRITE8_SPH)
+			cpuSet8(gb, gb->cpu.cpuTmp16, gb->cpu.sp>>8);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_DI_GET_INSTRUCTION)
+			//printf("Disabled IRQs at %04x\n", pc);
+			gb->cpu.irqEnable = false;
+			cpuGetInstruction(gb);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_EI_GET_INSTRUCTION)
+			gb->cpu.irqEnable = true;
+			//printf("Enabled IRQs and jmp to %04x ",pc);
+			cpuGetInstruction(gb);
+			//printf("%04x\n",pc);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_GET_INSTRUCTION_EI)
+			//printf("Enabled IRQs and jmp to %04x ",pc);
+			cpuGetInstruction(gb);
+			//printf("%04x\n",pc);
+			gb->cpu.irqEnable = true;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_SCF_GET_INSTRUCTION)
+			gb->cpu.cpuFlagN = 0;
+			gb->cpu.cpuFlagHC = 0x100;
+			cpuGetInstruction(gb);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_CCF_GET_INSTRUCTION)
+			gb->cpu.cpuFlagN = 0;
+			gb->cpu.cpuFlagHC = (gb->cpu.cpuFlagHC^0x100)&0x100;
+			cpuGetInstruction(gb);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_PC_FROM_HL_GET_INSTRUCTION)
+			gb->cpu.pc = (gb->cpu.l|(gb->cpu.h<<8));
+			cpuGetInstruction(gb);
+			CPU_ACTION_END
+		CPU_ACTION(CPU_PC_FROM_T16)
+			gb->cpu.pc = gb->cpu.cpuTmp16;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_RET_NZ_CHK)
+			if(cpuIsZ(gb)) gb->cpu.cpu_arr_pos+=3;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_RET_NC_CHK)
+			if(cpuIsC(gb)) gb->cpu.cpu_arr_pos+=3;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_RET_Z_CHK)
+			if(!cpuIsZ(gb)) gb->cpu.cpu_arr_pos+=3;
+			CPU_ACTION_END
+		CPU_ACTION(CPU_RET_C_CHK)
+			if(!cpuIsC(gb)) gb->cpu.cpu_arr_pos+=3;
+			CPU_ACTION_END
+	}
+#if !CPU_THREADED
+	while(runAhead && cpuNextAction(gb));
+#endif
+#undef CPU_ACTION
+#undef CPU_ACTION_END
+}
+
+void cpuCycle(gb_t *gb)
+{
+	if(gb->cpu.cpuDmaHalt)
 		return;
-	cpuHandleOAMDMA();
-	uint8_t cpu_action, sub_instr;
-	cpu_action = cpu_action_arr[cpu_arr_pos];
-	cpu_arr_pos++;
-	switch(cpu_action)
+	cpuHandleOAMDMA(gb);
+	cpuDoActions(gb, false);
+}
+
+#if CPU_FAST_EXEC
+static inline uint8_t *cpuReg8(gb_t *gb, uint8_t idx)
+{
+	switch(idx)
 	{
-		case CPU_GET_INSTRUCTION:
-			cpuGetInstruction();
-			break;
-		case CPU_GET_SUBINSTRUCTION:
-			sub_instr = memGet8(pc++);
-			//set sub array
-			switch(sub_instr&7)
+		case 0: return &gb->cpu.b;
+		case 1: return &gb->cpu.c;
+		case 2: return &gb->cpu.d;
+		case 3: return &gb->cpu.e;
+		case 4: return &gb->cpu.h;
+		case 5: return &gb->cpu.l;
+		default: return &gb->cpu.a;
+	}
+}
+
+//condition in bits 3-4 of jr/jp/call/ret cc
+static inline bool cpuCond(gb_t *gb, uint8_t op)
+{
+	switch((op>>3)&3)
+	{
+		case 0: return !cpuIsZ(gb);
+		case 1: return cpuIsZ(gb);
+		case 2: return !cpuIsC(gb);
+		default: return cpuIsC(gb);
+	}
+}
+
+//same as all cycles of the current instruction except for its
+//last fetch, done in one go since none of its memory accesses
+//depend on timing, returns the cycles used or 0 if it cant be
+//done this way, in which case nothing got changed yet
+static uint8_t cpuFastExec(gb_t *gb)
+{
+	uint8_t op = gb->cpu.curInstr;
+	uint16_t pc = gb->cpu.pc;
+	uint16_t hl = gb->cpu.l | gb->cpu.h<<8;
+	uint16_t sp = gb->cpu.sp;
+	uint16_t addr;
+	uint8_t tmp;
+	uint8_t imm[2] = { 0, 0 };
+	if(gb->cpu.cpuCode)
+	{
+		imm[0] = gb->cpu.cpuCode->imm[0];
+		imm[1] = gb->cpu.cpuCode->imm[1];
+	}
+	else if(cpu_instr_len[op] > 1)
+	{
+		if(cpuTimedAddr(pc) || (cpu_instr_len[op] > 2 && cpuTimedAddr(pc+1)))
+			return 0;
+		imm[0] = memGet8(gb, pc);
+		imm[1] = (cpu_instr_len[op] > 2) ? memGet8(gb, pc+1) : 0;
+	}
+	if(op >= 0x40 && op < 0xC0)
+	{
+		uint8_t src = op&7;
+		if(op == 0x76) //HALT
+			return 0;
+		if(src == 6)
+		{
+			if(cpuTimedAddr(hl))
+				return 0;
+			tmp = memGet8(gb, hl);
+		}
+		else
+			tmp = *cpuReg8(gb, src);
+		if(op < 0x80)
+		{
+			uint8_t dst = (op>>3)&7;
+			if(dst != 6)
+				*cpuReg8(gb, dst) = tmp;
+			else
 			{
-				case 0:
-					cpu_action_arr = cpu_imm_b_arr;
-					break;
-				case 1:
-					cpu_action_arr = cpu_imm_c_arr;
-					break;
-				case 2:
-					cpu_action_arr = cpu_imm_d_arr;
-					break;
-				case 3:
-					cpu_action_arr = cpu_imm_e_arr;
-					break;
-				case 4:
-					cpu_action_arr = cpu_imm_h_arr;
-					break;
-				case 5:
-					cpu_action_arr = cpu_imm_l_arr;
-					break;
-				case 6:
-					if((sub_instr&0xC0) == 0x40) //BIT only reads
-						cpu_action_arr = cpu_imm_hl_arr;
-					else //all other CB instructions do I/O
-						cpu_action_arr = cpu_imm_hl_st_arr;
-					break;
-				case 7:
-					cpu_action_arr = cpu_imm_a_arr;
-					break;
-				default: //should never happen
-					printf("CPU Error: Unknown sub %02x\n", sub_instr);
-					cpuSetNopArr();
-					cpuSetStopLoop();
-					break;
+				if(cpuTimedAddr(hl))
+					return 0;
+				memSet8(gb, hl, tmp);
+			}
+			return (src == 6 || dst == 6) ? 2 : 1;
+		}
+		cpu_actions_arr[op](gb, &tmp);
+		return (src == 6) ? 2 : 1;
+	}
+	switch(op)
+	{
+		case 0x00: //NOP
+			return 1;
+		case 0x04: case 0x05: case 0x0C: case 0x0D: //INC/DEC r
+		case 0x14: case 0x15: case 0x1C: case 0x1D:
+		case 0x24: case 0x25: case 0x2C: case 0x2D:
+		case 0x3C: case 0x3D:
+			cpu_actions_arr[op](gb, cpuReg8(gb, (op>>3)&7));
+			return 1;
+		case 0x07: case 0x0F: case 0x17: case 0x1F: //rotates on A
+		case 0x27: case 0x2F: //DAA, CPL
+			cpu_actions_arr[op](gb, &gb->cpu.a);
+			return 1;
+		case 0x34: case 0x35: //INC/DEC (HL)
+			if(cpuTimedAddr(hl))
+				return 0;
+			tmp = memGet8(gb, hl);
+			cpu_actions_arr[op](gb, &tmp);
+			memSet8(gb, hl, tmp);
+			return 3;
+		case 0x37: //SCF
+			gb->cpu.cpuFlagN = 0;
+			gb->cpu.cpuFlagHC = 0x100;
+			return 1;
+		case 0x3F: //CCF
+			gb->cpu.cpuFlagN = 0;
+			gb->cpu.cpuFlagHC = (gb->cpu.cpuFlagHC^0x100)&0x100;
+			return 1;
+		case 0x06: case 0x0E: case 0x16: case 0x1E: //LD r,n
+		case 0x26: case 0x2E: case 0x3E:
+			*cpuReg8(gb, (op>>3)&7) = imm[0];
+			gb->cpu.pc++;
+			return 2;
+		case 0x36: //LD (HL),n
+			if(cpuTimedAddr(hl))
+				return 0;
+			memSet8(gb, hl, imm[0]);
+			gb->cpu.pc++;
+			return 3;
+		case 0xC6: case 0xCE: case 0xD6: case 0xDE: //ALU A,n
+		case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+			tmp = imm[0];
+			gb->cpu.pc++;
+			cpu_actions_arr[op](gb, &tmp);
+			return 2;
+		case 0x03: case 0x13: case 0x23: case 0x33: //INC/DEC rr
+		case 0x0B: case 0x1B: case 0x2B: case 0x3B:
+			cpu_actions_arr[op](gb, NULL);
+			return 2;
+		case 0x09: //ADD HL,rr
+			cpuAdd16(gb, gb->cpu.c|gb->cpu.b<<8);
+			return 2;
+		case 0x19:
+			cpuAdd16(gb, gb->cpu.e|gb->cpu.d<<8);
+			return 2;
+		case 0x29:
+			cpuAdd16(gb, hl);
+			return 2;
+		case 0x39:
+			cpuAdd16(gb, sp);
+			return 2;
+		case 0x01: case 0x11: case 0x21: case 0x31: //LD rr,nn
+			tmp = imm[0];
+			addr = tmp | imm[1]<<8;
+			gb->cpu.pc += 2;
+			if(op == 0x01) { gb->cpu.c = tmp; gb->cpu.b = addr>>8; }
+			else if(op == 0x11) { gb->cpu.e = tmp; gb->cpu.d = addr>>8; }
+			else if(op == 0x21) { gb->cpu.l = tmp; gb->cpu.h = addr>>8; }
+			else gb->cpu.sp = addr;
+			return 3;
+		case 0x02: case 0x12: //LD (BC/DE),A
+			addr = (op == 0x02) ? (gb->cpu.c|gb->cpu.b<<8) : (gb->cpu.e|gb->cpu.d<<8);
+			if(cpuTimedAddr(addr))
+				return 0;
+			memSet8(gb, addr, gb->cpu.a);
+			return 2;
+		case 0x0A: case 0x1A: //LD A,(BC/DE)
+			addr = (op == 0x0A) ? (gb->cpu.c|gb->cpu.b<<8) : (gb->cpu.e|gb->cpu.d<<8);
+			if(cpuTimedAddr(addr))
+				return 0;
+			gb->cpu.a = memGet8(gb, addr);
+			return 2;
+		case 0x22: case 0x32: //LD (HL+/-),A
+			if(cpuTimedAddr(hl))
+				return 0;
+			memSet8(gb, hl, gb->cpu.a);
+			hl = (op == 0x22) ? hl+1 : hl-1;
+			gb->cpu.l = hl&0xFF; gb->cpu.h = hl>>8;
+			return 2;
+		case 0x2A: case 0x3A: //LD A,(HL+/-)
+			if(cpuTimedAddr(hl))
+				return 0;
+			gb->cpu.a = memGet8(gb, hl);
+			hl = (op == 0x2A) ? hl+1 : hl-1;
+			gb->cpu.l = hl&0xFF; gb->cpu.h = hl>>8;
+			return 2;
+		case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: //JR
+			tmp = imm[0];
+			gb->cpu.pc++;
+			if(op != 0x18 && !cpuCond(gb, op))
+				return 2;
+			gb->cpu.pc += (int8_t)tmp;
+			return 3;
+		case 0xC3: case 0xC2: case 0xCA: case 0xD2: case 0xDA: //JP
+			addr = imm[0] | imm[1]<<8;
+			gb->cpu.pc += 2;
+			if(op != 0xC3 && !cpuCond(gb, op))
+				return 3;
+			gb->cpu.pc = addr;
+			return 4;
+		case 0xE9: //JP (HL)
+			gb->cpu.pc = hl;
+			return 1;
+		case 0xCD: case 0xC4: case 0xCC: case 0xD4: case 0xDC: //CALL
+			if(cpuTimedAddr(sp-1) || cpuTimedAddr(sp-2))
+				return 0;
+			addr = imm[0] | imm[1]<<8;
+			gb->cpu.pc += 2;
+			if(op != 0xCD && !cpuCond(gb, op))
+				return 3;
+			memSet8(gb, --gb->cpu.sp, gb->cpu.pc>>8);
+			memSet8(gb, --gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = addr;
+			return 6;
+		case 0xC9: case 0xC0: case 0xC8: case 0xD0: case 0xD8: //RET
+			if(op != 0xC9 && !cpuCond(gb, op))
+				return 2;
+			if(cpuTimedAddr(sp) || cpuTimedAddr(sp+1))
+				return 0;
+			tmp = memGet8(gb, gb->cpu.sp++);
+			gb->cpu.pc = tmp | memGet8(gb, gb->cpu.sp++)<<8;
+			return (op == 0xC9) ? 4 : 5;
+		case 0xC7: case 0xCF: case 0xD7: case 0xDF: //RST
+		case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+			if(cpuTimedAddr(sp-1) || cpuTimedAddr(sp-2))
+				return 0;
+			memSet8(gb, --gb->cpu.sp, gb->cpu.pc>>8);
+			memSet8(gb, --gb->cpu.sp, gb->cpu.pc&0xFF);
+			gb->cpu.pc = (op&0x38)+gb->gbsLoadAddr;
+			return 4;
+		case 0xC5: case 0xD5: case 0xE5: case 0xF5: //PUSH
+			if(cpuTimedAddr(sp-1) || cpuTimedAddr(sp-2))
+				return 0;
+			if(op == 0xC5) { memSet8(gb, --gb->cpu.sp, gb->cpu.b); memSet8(gb, --gb->cpu.sp, gb->cpu.c); }
+			else if(op == 0xD5) { memSet8(gb, --gb->cpu.sp, gb->cpu.d); memSet8(gb, --gb->cpu.sp, gb->cpu.e); }
+			else if(op == 0xE5) { memSet8(gb, --gb->cpu.sp, gb->cpu.h); memSet8(gb, --gb->cpu.sp, gb->cpu.l); }
+			else { memSet8(gb, --gb->cpu.sp, gb->cpu.a); memSet8(gb, --gb->cpu.sp, cpuGetF(gb)); }
+			return 4;
+		case 0xC1: case 0xD1: case 0xE1: case 0xF1: //POP
+			if(cpuTimedAddr(sp) || cpuTimedAddr(sp+1))
+				return 0;
+			tmp = memGet8(gb, gb->cpu.sp++);
+			if(op == 0xC1) { gb->cpu.c = tmp; gb->cpu.b = memGet8(gb, gb->cpu.sp++); }
+			else if(op == 0xD1) { gb->cpu.e = tmp; gb->cpu.d = memGet8(gb, gb->cpu.sp++); }
+			else if(op == 0xE1) { gb->cpu.l = tmp; gb->cpu.h = memGet8(gb, gb->cpu.sp++); }
+			else { cpuSetF(gb, tmp); gb->cpu.a = memGet8(gb, gb->cpu.sp++); }
+			return 3;
+		case 0xE0: case 0xF0: //LDH (n),A and LDH A,(n)
+			addr = 0xFF00 | imm[0];
+			if(cpuTimedAddr(addr))
+				return 0;
+			gb->cpu.pc++;
+			if(op == 0xE0)
+				memSet8(gb, addr, gb->cpu.a);
+			else
+				gb->cpu.a = memGet8(gb, addr);
+			return 3;
+		case 0xEA: case 0xFA: //LD (nn),A and LD A,(nn)
+			addr = imm[0] | imm[1]<<8;
+			if(cpuTimedAddr(addr))
+				return 0;
+			gb->cpu.pc += 2;
+			if(op == 0xEA)
+				memSet8(gb, addr, gb->cpu.a);
+			else
+				gb->cpu.a = memGet8(gb, addr);
+			return 4;
+		case 0xF9: //LD SP,HL
+			gb->cpu.sp = hl;
+			return 2;
+		case 0xCB: //CB prefixed
+			if((imm[0]&7) == 6 && cpuTimedAddr(hl))
+				return 0;
+			gb->cpu.pc++;
+			if((imm[0]&7) != 6)
+			{
+				cpu_cb_actions_arr[imm[0]](gb, cpuReg8(gb, imm[0]&7));
+				return 2;
 			}
-			//set sub func
-			switch(sub_instr>>3)
+			tmp = memGet8(gb, hl);
+			cpu_cb_actions_arr[imm[0]](gb, &tmp);
+			if((imm[0]&0xC0) == 0x40) //BIT only reads
+				return 3;
+			memSet8(gb, hl, tmp);
+			return 4;
+		default:
+			return 0;
+	}
+}
+#endif
+
+#if (CPU_FAST_EXEC && CPU_IDLE_SKIP)
+//cycles of one pass through a loop from start up to and including
+//its taken branch at end, 0 unless all it does is read a register
+//and test the value so every pass ends up doing the same thing,
+//the register and the cycle it gets read on go into reg and readCycle
+static uint8_t cpuIdleLoopCycles(gb_t *gb, uint16_t start, uint16_t end, uint16_t *reg, uint8_t *readCycle)
+{
+	uint16_t hl = gb->cpu.l | gb->cpu.h<<8;
+	uint16_t addr = start;
+	uint8_t cycles = 0;
+	bool loadA = false;
+	while(addr != end)
+	{
+		if(cpuTimedAddr(addr))
+			return 0;
+		uint8_t op = memGet8(gb, addr);
+		uint8_t len = cpu_instr_len[op];
+		if(cpuTimedAddr(addr+1) || (len > 2 && cpuTimedAddr(addr+2)))
+			return 0;
+		uint8_t imm[2] = { 0, 0 };
+		if(len > 1)
+			imm[0] = memGet8(gb, addr+1);
+		if(len > 2)
+			imm[1] = memGet8(gb, addr+2);
+		//has to start with the one read
+		if(addr == start)
+		{
+			switch(op)
 			{
-				case 0:
-					cpu_action_func = cpuRLC;
-					break;
-				case 1:
-					cpu_action_func = cpuRRC;
-					break;
-				case 2:
-					cpu_action_func = cpuRL;
-					break;
-				case 3:
-					cpu_action_func = cpuRR;
-					break;
-				case 4:
-					cpu_action_func = cpuSLA;
+				case 0xF0: //LDH A,(n)
+					*reg = 0xFF00|imm[0];
+					*readCycle = 1;
+					cycles = 3;
 					break;
-				case 5:
-					cpu_action_func = cpuSRA;
+				case 0xFA: //LD A,(nn)
+					*reg = imm[0] | imm[1]<<8;
+					*readCycle = 2;
+					cycles = 4;
 					break;
-				case 6:
-					cpu_action_func = cpuSWAP;
+				case 0xF2: //LD A,(C)
+					*reg = 0xFF00|gb->cpu.c;
+					*readCycle = 0;
+					cycles = 2;
 					break;
-				case 7:
-					cpu_action_func = cpuSRL;
-					break;
-				case  8: case  9: case 10: case 11:
-				case 12: case 13: case 14: case 15:
-					sub_in_val = ((sub_instr&0x3F)>>3)&7;
-					cpu_action_func = cpuBIT;
-					break;
-				case 16: case 17: case 18: case 19:
-				case 20: case 21: case 22: case 23:
-					sub_in_val = ((sub_instr&0x3F)>>3)&7;
-					cpu_action_func = cpuRES;
+				case 0x7E: //LD A,(HL)
+				case 0xBE: //CP (HL)
+					*reg = hl;
+					*readCycle = 0;
+					cycles = 2;
 					break;
 				default:
-					sub_in_val = ((sub_instr&0x3F)>>3)&7;
-					cpu_action_func = cpuSET;
-					break;
+					return 0;
 			}
-			cpu_arr_pos = 0;
-			break;
-		case CPU_DELAY_CYCLE:
-			break;
-		case CPU_ACTION_GET_INSTRUCTION:
-			cpu_action_func(&cpuTmp);
-			cpuGetInstruction();
-			break;
-		case CPU_A_ACTION_GET_INSTRUCTION:
-			cpu_action_func(&a);
-			cpuGetInstruction();
-			break;
-		case CPU_B_ACTION_GET_INSTRUCTION:
-			cpu_action_func(&b);
-			cpuGetInstruction();
-			break;
-		case CPU_C_ACTION_GET_INSTRUCTION:
-			cpu_action_func(&c);
-			cpuGetInstruction();
-			break;
-		case CPU_D_ACTION_GET_INSTRUCTION:
-			cpu_action_func(&d);
-			cpuGetInstruction();
-			break;
-		case CPU_E_ACTION_GET_INSTRUCTION:
-			cpu_action_func(&e);
-			cpuGetInstruction();
-			break;
-		case CPU_H_ACTION_GET_INSTRUCTION:
-			cpu_action_func(&h);
-			cpuGetInstruction();
-			break;
-		case CPU_L_ACTION_GET_INSTRUCTION:
-			cpu_action_func(&l);
-			cpuGetInstruction();
-			break;
-		case CPU_ACTION_WRITE:
-			cpu_action_func(&cpuTmp);
-			break;
-		case CPU_A_ACTION_WRITE:
-			cpu_action_func(&a);
-			break;
-		case CPU_B_ACTION_WRITE:
-			cpu_action_func(&b);
-			break;
-		case CPU_C_ACTION_WRITE:
-			cpu_action_func(&c);
-			break;
-		case CPU_D_ACTION_WRITE:
-			cpu_action_func(&d);
-			break;
-		case CPU_E_ACTION_WRITE:
-			cpu_action_func(&e);
-			break;
-		case CPU_H_ACTION_WRITE:
-			cpu_action_func(&h);
-			break;
-		case CPU_L_ACTION_WRITE:
-			cpu_action_func(&l);
-			break;
-		case CPU_BC_ACTION_ADD:
-			cpuAdd16(c|b<<8);
-			break;
-		case CPU_DE_ACTION_ADD:
-			cpuAdd16(e|d<<8);
-			break;
-		case CPU_HL_ACTION_ADD:
-			cpuAdd16(l|h<<8);
-			break;
-		case CPU_SP_ACTION_ADD:
-			cpuAdd16(sp);
-			break;
-		case CPU_HL_ADD_SPECIAL:
-			cpuTmp16 = cpuAddSp16(cpuTmp);
-			h = cpuTmp16>>8;
-			l = cpuTmp16&0xFF;
-			break;
-		case CPU_SP_ADD_SPECIAL:
-			sp = cpuAddSp16(cpuTmp);
-			break;
-		case CPU_ACTION_WRITE8_HL:
-			cpu_action_func(&cpuTmp);
-			memSet8(l | h<<8, cpuTmp);
-			break;
-		case CPU_TMP_ADD_PC:
-			pc += (int8_t)cpuTmp;
-			break;
-		case CPU_TMP_READ8_BC:
-			cpuTmp = memGet8(c | b<<8);
-			break;
-		case CPU_TMP_READ8_DE:
-			cpuTmp = memGet8(e | d<<8);
-			break;
-		case CPU_TMP_READ8_HL:
-			cpuTmp = memGet8(l | h<<8);
-			break;
-		case CPU_TMP_READ8_HL_INC:
-			cpuTmp = memGet8(l | h<<8);
-			cpuHlInc();
-			break;
-		case CPU_TMP_READ8_HL_DEC:
-			cpuTmp = memGet8(l | h<<8);
-			cpuHlDec();
-			break;
-		case CPU_TMP_READ8_PC_INC:
-			cpuTmp = memGet8(pc++);
-			break;
-		case CPU_TMP_READ8_PC_INC_JRNZ_CHK:
-			cpuTmp = memGet8(pc++);
-			if(f & P_FLAG_Z) cpu_arr_pos++;
-			break;
-		case CPU_TMP_READ8_PC_INC_JRZ_CHK:
-			cpuTmp = memGet8(pc++);
-			if(!(f & P_FLAG_Z)) cpu_arr_pos++;
-			break;
-		case CPU_TMP_READ8_PC_INC_JRNC_CHK:
-			cpuTmp = memGet8(pc++);
-			if(f & P_FLAG_C) cpu_arr_pos++;
-			break;
-		case CPU_TMP_READ8_PC_INC_JRC_CHK:
-			cpuTmp = memGet8(pc++);
-			if(!(f & P_FLAG_C)) cpu_arr_pos++;
-			break;
-		case CPU_TMP_READ8_SP_INC:
-			cpuTmp = memGet8(sp++);
-			break;
-		case CPU_PCL_FROM_TMP_PCH_READ8_SP_INC:
-			pc = (cpuTmp | (memGet8(sp++)<<8));
-			break;
-		case CPU_C_FROM_TMP_B_READ8_SP_INC:
-			c = cpuTmp;
-			b = memGet8(sp++);
-			break;
-		case CPU_E_FROM_TMP_D_READ8_SP_INC:
-			e = cpuTmp;
-			d = memGet8(sp++);
-			break;
-		case CPU_L_FROM_TMP_H_READ8_SP_INC:
-			l = cpuTmp;
-			h = memGet8(sp++);
-			break;
-		case CPU_F_FROM_TMP_A_READ8_SP_INC:
-			f = cpuTmp&0xF0;
-			a = memGet8(sp++);
-			break;
-		case CPU_TMP_READHIGH_A:
-			a = memGet8(0xFF00 | cpuTmp);
-			break;
-		case CPU_TMP_WRITEHIGH_A:
-			memSet8(0xFF00 | cpuTmp, a);
-			break;
-		case CPU_C_READHIGH_A:
-			a = memGet8(0xFF00 | c);
-			break;
-		case CPU_C_WRITEHIGH_A:
-			memSet8(0xFF00 | c, a);
-			break;
-		case CPU_SP_FROM_HL:
-			sp = (l | h<<8);
-			break;
-		case CPU_SP_WRITE8_A_DEC:
-			sp--;
-			memSet8(sp, a);
-			break;
-		case CPU_SP_WRITE8_B_DEC:
-			sp--;
-			memSet8(sp, b);
-			break;
-		case CPU_SP_WRITE8_C_DEC:
-			sp--;
-			memSet8(sp, c);
-			break;
-		case CPU_SP_WRITE8_D_DEC:
-			sp--;
-			memSet8(sp, d);
-			break;
-		case CPU_SP_WRITE8_E_DEC:
-			sp--;
-			memSet8(sp, e);
-			break;
-		case CPU_SP_WRITE8_F_DEC:
-			sp--;
-			memSet8(sp, f);
-			break;
-		case CPU_SP_WRITE8_H_DEC:
-			sp--;
-			memSet8(sp, h);
-			break;
-		case CPU_SP_WRITE8_L_DEC:
-			sp--;
-			memSet8(sp, l);
-			break;
-		case CPU_SP_WRITE8_PCH_DEC:
-			sp--;
-			memSet8(sp, pc>>8);
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_T16:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = cpuTmp16;
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_00:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = 0x00+gbsLoadAddr;
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_08:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = 0x08+gbsLoadAddr;
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_10:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = 0x10+gbsLoadAddr;
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_18:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = 0x18+gbsLoadAddr;
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_20:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = 0x20+gbsLoadAddr;
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_28:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = 0x28+gbsLoadAddr;
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_30:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = 0x30+gbsLoadAddr;
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_38:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = 0x38+gbsLoadAddr;
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_40:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = 0x40;
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_48:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = 0x48;
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_50:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = 0x50;
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_58:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = 0x58;
-			break;
-		case CPU_SP_WRITE8_PCL_DEC_PC_FROM_60:
-			sp--;
-			memSet8(sp, pc&0xFF);
-			pc = 0x60;
-			break;
-		case CPU_A_READ8_TMP16:
-			a = memGet8(cpuTmp16);
-			break;
-		case CPU_A_READ8_PC_INC:
-			a = memGet8(pc++);
-			break;
-		case CPU_B_READ8_PC_INC:
-			b = memGet8(pc++);
-			break;
-		case CPU_C_READ8_PC_INC:
-			c = memGet8(pc++);
-			break;
-		case CPU_D_READ8_PC_INC:
-			d = memGet8(pc++);
-			break;
-		case CPU_E_READ8_PC_INC:
-			e = memGet8(pc++);
-			break;
-		case CPU_L_READ8_PC_INC:
-			l = memGet8(pc++);
-			break;
-		case CPU_H_READ8_PC_INC:
-			h = memGet8(pc++);
-			break;
-		case CPU_PCL_FROM_TMP_PCH_READ8_PC:
-			pc = (cpuTmp | (memGet8(pc)<<8));
-			break;
-		case CPU_SPL_FROM_TMP_SPH_READ8_PC_INC:
-			sp = (cpuTmp | (memGet8(pc++)<<8));
-			break;
-		case CPU_T16L_FROM_TMP_T16H_READ8_PC_INC:
-			cpuTmp16 = (cpuTmp | (memGet8(pc++)<<8));
-			break;
-		case CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CNZ_CHK:
-			cpuTmp16 = (cpuTmp | (memGet8(pc++)<<8));
-			if(f & P_FLAG_Z) cpu_arr_pos+=3;
-			break;
-		case CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CNC_CHK:
-			cpuTmp16 = (cpuTmp | (memGet8(pc++)<<8));
-			if(f & P_FLAG_C) cpu_arr_pos+=3;
-			break;
-		case CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CZ_CHK:
-			cpuTmp16 = (cpuTmp | (memGet8(pc++)<<8));
-			if(!(f & P_FLAG_Z)) cpu_arr_pos+=3;
-			break;
-		case CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_CC_CHK:
-			cpuTmp16 = (cpuTmp | (memGet8(pc++)<<8));
-			if(!(f & P_FLAG_C)) cpu_arr_pos+=3;
-			break;
-		case CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPNZ_CHK:
-			cpuTmp16 = (cpuTmp | (memGet8(pc++)<<8));
-			if(f & P_FLAG_Z) cpu_arr_pos++;
-			break;
-		case CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPNC_CHK:
-			cpuTmp16 = (cpuTmp | (memGet8(pc++)<<8));
-			if(f & P_FLAG_C) cpu_arr_pos++;
-			break;
-		case CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPZ_CHK:
-			cpuTmp16 = (cpuTmp | (memGet8(pc++)<<8));
-			if(!(f & P_FLAG_Z)) cpu_arr_pos++;
-			break;
-		case CPU_T16L_FROM_TMP_T16H_READ8_PC_INC_JPC_CHK:
-			cpuTmp16 = (cpuTmp | (memGet8(pc++)<<8));
-			if(!(f & P_FLAG_C)) cpu_arr_pos++;
-			break;
-		case CPU_TMP16_WRITE8_SPL_INC:
-			memSet8(cpuTmp16++, sp&0xFF);
-			break;
-		case CPU_TMP16_WRITE8_SPH:
-			memSet8(cpuTmp16, sp>>8);
-			break;
-		case CPU_DI_GET_INSTRUCTION:
-			//printf("Disabled IRQs at %04x\n", pc);
-			irqEnable = false;
-			cpuGetInstruction();
-			break;
-		case CPU_EI_GET_INSTRUCTION:
-			irqEnable = true;
-			//printf("Enabled IRQs and jmp to %04x ",pc);
-			cpuGetInstruction();
-			//printf("%04x\n",pc);
-			break;
-		case CPU_GET_INSTRUCTION_EI:
-			//printf("Enabled IRQs and jmp to %04x ",pc);
-			cpuGetInstruction();
-			//printf("%04x\n",pc);
-			irqEnable = true;
-			break;
-		case CPU_SCF_GET_INSTRUCTION:
-			f |= P_FLAG_C;
-			f &= ~(P_FLAG_H|P_FLAG_N);
-			cpuGetInstruction();
-			break;
-		case CPU_CCF_GET_INSTRUCTION:
-			f ^= P_FLAG_C;
-			f &= ~(P_FLAG_H|P_FLAG_N);
-			cpuGetInstruction();
-			break;
-		case CPU_PC_FROM_HL_GET_INSTRUCTION:
-			pc = (l|(h<<8));
-			cpuGetInstruction();
-			break;
-		case CPU_PC_FROM_T16:
-			pc = cpuTmp16;
-			break;
-		case CPU_RET_NZ_CHK:
-			if(f & P_FLAG_Z) cpu_arr_pos+=3;
+			loadA = (op != 0xBE);
+		}
+		else switch(op)
+		{
+			case 0xE6: //AND n
+				if(!loadA)
+					return 0;
+				cycles += 2;
+				break;
+			case 0xFE: //CP n
+				cycles += 2;
+				break;
+			case 0xA7: //AND A
+			case 0xB7: //OR A
+				cycles++;
+				break;
+			case 0xCB: //BIT n,A
+				if((imm[0]&0xC7) != 0x47)
+					return 0;
+				cycles += 2;
+				break;
+			default:
+				return 0;
+		}
+		addr += len;
+	}
+	if(cpuTimedAddr(end))
+		return 0;
+	uint8_t op = memGet8(gb, end);
+	if(op == 0x18 || (op&0xE7) == 0x20) //JR
+		return cycles+3;
+	if(op == 0xC3 || (op&0xE7) == 0xC2) //JP
+		return cycles+4;
+	return 0;
+}
+
+//called right after a taken branch, if the cpu keeps running the
+//same polling loop then skip all passes that end before the polled
+//register or anything else that could break the loop changes
+static void cpuIdleLoopSkip(gb_t *gb, uint16_t branch)
+{
+	uint64_t cpuClock = gb->emuClock+gb->emuClocksAhead;
+	uint16_t start = gb->cpu.pc-1;
+	uint16_t prevPC = gb->cpu.cpuIdleLoopPC;
+	uint64_t prevTime = gb->cpu.cpuIdleLoopTime;
+	gb->cpu.cpuIdleLoopPC = start;
+	gb->cpu.cpuIdleLoopTime = cpuClock;
+	if(start >= branch || branch-start > 16 || gb->cpu.cpuHaltBug || gb->cpu.cpu_action_arr != cpu_instr_arr[gb->cpu.curInstr])
+		return;
+	if(gb->cpu.cpu_oam_dma || gb->cpu.cpu_oam_dma_running || gb->mem.cgbDmaActive || gb->cpu.cpuDmaHalt)
+		return;
+	switch(gb->cpu.curInstr)
+	{
+		case 0xF0: case 0xFA: case 0xF2: case 0x7E: case 0xBE:
 			break;
-		case CPU_RET_NC_CHK:
-			if(f & P_FLAG_C) cpu_arr_pos+=3;
+		default:
+			return;
+	}
+	uint16_t reg = 0;
+	uint8_t readCycle = 0;
+	uint8_t cycles = cpuIdleLoopCycles(gb, start, branch, &reg, &readCycle);
+	uint32_t step = gb->cpuTimer+1;
+	//the last pass has to have been a full one without any irqs
+	if(!cycles || prevPC != start || cpuClock-prevTime != cycles*step)
+		return;
+	//and nothing may have been synced since its read, else the
+	//value it read could already be outdated
+	if(gb->emuClock != prevTime+readCycle*step)
+		return;
+	uint64_t until = gb->emuNextEvent;
+	uint32_t clocks;
+	switch(reg)
+	{
+		case 0xFF04: //DIV
+			clocks = memDivNextChange(gb);
 			break;
-		case CPU_RET_Z_CHK:
-			if(!(f & P_FLAG_Z)) cpu_arr_pos+=3;
+		case 0xFF41: //STAT
+		case 0xFF44: //LY
+			clocks = ppuNextRegChange(gb);
 			break;
-		case CPU_RET_C_CHK:
-			if(!(f & P_FLAG_C)) cpu_arr_pos+=3;
+		case 0xFF0F: //IF
+			clocks = EMU_EVENT_NONE;
 			break;
+		default:
+			return;
+	}
+	if(clocks != EMU_EVENT_NONE && gb->emuClock+clocks < until)
+		until = gb->emuClock+clocks;
+	if(cpuClock >= until)
+		return;
+	uint64_t skip = ((until-cpuClock)/(cycles*step))*(cycles*step);
+	gb->emuClocksAhead += skip;
+	gb->cpu.cpuIdleLoopTime += skip;
+}
+#endif
+
+//catch-up mode, runs all cycles up to and including the
+//next instruction fetch without clocking anything else,
+//gb->emuClocksAhead tells the main loop how much to catch up
+void cpuRunInstr(gb_t *gb)
+{
+	gb->cpu.cpuRunAhead = true;
+	gb->cpu.cpuFetched = false;
+	#if CPU_FAST_EXEC
+	if(gb->cpu.cpu_arr_pos == 0 && gb->cpu.cpu_action_arr == cpu_instr_arr[gb->cpu.curInstr])
+	{
+		uint16_t pc = gb->cpu.pc;
+		uint8_t cycles = cpuFastExec(gb);
+		if(cycles)
+		{
+			//last cycle fetches the next instruction
+			gb->emuClocksAhead += (cycles-1)*(gb->cpuTimer+1);
+			cpuGetInstruction(gb);
+			gb->emuClocksAhead += gb->cpuTimer+1;
+			#if CPU_IDLE_SKIP
+			//jumped backwards, may be a polling loop
+			if(gb->cpu.pc <= pc)
+				cpuIdleLoopSkip(gb, pc-1);
+			#endif
+			gb->cpu.cpuRunAhead = false;
+			return;
+		}
+	}
+	#endif
+	cpuDoActions(gb, true);
+	//still halted after checking for irqs, nothing can wake the
+	//cpu up before the next event so skip all cycles up to it
+	if(gb->cpu.cpuHaltLoop && gb->cpu.cpuFetched && !gb->cpu.cpu_oam_dma && !gb->mem.cgbDmaActive && !gb->cpu.cpuDmaHalt)
+	{
+		uint64_t cpuClock = gb->emuClock+gb->emuClocksAhead;
+		if(cpuClock < gb->emuNextEvent)
+		{
+			uint32_t step = gb->cpuTimer+1;
+			gb->emuClocksAhead += ((gb->emuNextEvent-cpuClock+step-1)/step)*step;
+		}
 	}
+	gb->cpu.cpuRunAhead = false;
 }
 
-uint16_t cpuCurPC()
+uint16_t cpuCurPC(gb_t *gb)
 {
-	return pc;
+	return gb->cpu.pc;
 }
 
-void cpuSetSpeed(bool cgb)
+void cpuSetSpeed(gb_t *gb, bool cgb)
 {
 	if(cgb)
 	{
 		//printf("CPU: CGB Speed\n");
-		cpuCgbSpeed = true;
-		cpuAddSpeed = 2;
-		cpuTimer = 1;
+		gb->cpu.cpuCgbSpeed = true;
+		gb->cpu.cpuAddSpeed = 2;
+		gb->cpuTimer = 1;
 	}
 	else
 	{
 		//printf("CPU: DMG Speed\n");
-		cpuCgbSpeed = false;
-		cpuAddSpeed = 1;
-		cpuTimer = 3;
+		gb->cpu.cpuCgbSpeed = false;
+		gb->cpu.cpuAddSpeed = 1;
+		gb->cpuTimer = 3;
 	}
 }
 
-void cpuPlayGBS()
+void cpuPlayGBS(gb_t *gb)
 {
-	if(!gbsInitRet || !gbsPlayRet)
+	if(!gb->cpu.gbsInitRet || !gb->cpu.gbsPlayRet)
 		return;
-	gbsPlayRet = false;
+	gb->cpu.gbsPlayRet = false;
 	//push back detect pc
-	sp--;
-	memSet8(sp, 0x87);
-	sp--;
-	memSet8(sp, 0x65);
+	gb->cpu.sp--;
+	memSet8(gb, gb->cpu.sp, 0x87);
+	gb->cpu.sp--;
+	memSet8(gb, gb->cpu.sp, 0x65);
 	//IMPORTANT: some GBS files dont work without this
 	//Keep HL though, some GBS files use them as global address
-	a = 0, b = 0, c = 0, d = 0, e = 0;//, h = 0, l = 0;
+	gb->cpu.a = 0, gb->cpu.b = 0, gb->cpu.c = 0, gb->cpu.d = 0, gb->cpu.e = 0;//, h = 0, l = 0;
 	//jump to play
-	pc = gbsPlayAddr;
-	cpuSetNopArr();
+	gb->cpu.pc = gb->gbsPlayAddr;
+	cpuSetNopArr(gb);
 	//printf("Playback Start at %04x\n", pc);
 }
-extern uint8_t gbsTMA, gbsTAC;
-void cpuLoadGBS(uint8_t song)
+void cpuLoadGBS(gb_t *gb, uint8_t song)
 {
 	//full reset
-	cpuInit();
-	ppuInit();
-	apuInit();
-	inputInit();
-	memInit(false,true);
-	memSet8(0xFF06,gbsTMA);
-	memSet8(0xFF07,gbsTAC);
+	cpuInit(gb);
+	ppuInit(gb);
+	apuInit(gb);
+	inputInit(gb);
+	memInit(gb, false,true);
+	memSet8(gb, 0xFF06,gb->gbsTMA);
+	memSet8(gb, 0xFF07,gb->gbsTAC);
 	//set requested sp
-	sp = gbsSP;
+	gb->cpu.sp = gb->gbsSP;
 	//push back detect pc
-	sp--;
-	memSet8(sp, 0x87);
-	sp--;
-	memSet8(sp, 0x64);
+	gb->cpu.sp--;
+	memSet8(gb, gb->cpu.sp, 0x87);
+	gb->cpu.sp--;
+	memSet8(gb, gb->cpu.sp, 0x64);
 	//IMPORTANT: some GBS files dont work without this
-	a = 0, b = 0, c = 0, d = 0, e = 0, h = 0, l = 0;
+	gb->cpu.a = 0, gb->cpu.b = 0, gb->cpu.c = 0, gb->cpu.d = 0, gb->cpu.e = 0, gb->cpu.h = 0, gb->cpu.l = 0;
 	//set song and init routine
-	a = song;
-	pc = gbsInitAddr;
+	gb->cpu.a = song;
+	gb->cpu.pc = gb->gbsInitAddr;
 	//start getting instructions
-	cpuSetNopArr();
+	cpuSetNopArr(gb);
 	//printf("Init Start at %04x\n", pc);
 }
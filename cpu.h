@@ -8,11 +8,12 @@
 #ifndef _cpu_c_
 #define _cpu_h_
 
-void cpuInit();
-void cpuCycle();
-uint16_t cpuCurPC();
-void cpuSetSpeed(bool cgb);
-void cpuLoadGBS(uint8_t song);
-void cpuPlayGBS();
+void cpuInit(gb_t *gb);
+void cpuCycle(gb_t *gb);
+void cpuRunInstr(gb_t *gb);
+uint16_t cpuCurPC(gb_t *gb);
+void cpuSetSpeed(gb_t *gb, bool cgb);
+void cpuLoadGBS(gb_t *gb, uint8_t song);
+void cpuPlayGBS(gb_t *gb);
 
 #endif
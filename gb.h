@@ -0,0 +1,373 @@
+/*
+ * Copyright (C) 2017 FIX94
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef _gb_h_
+#define _gb_h_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+//all emulator state lives in here, every core
+//function gets the instance it should work on
+typedef struct _gb_t gb_t;
+
+typedef uint8_t (*get8FuncT)(gb_t*, uint16_t);
+typedef void (*set8FuncT)(gb_t*, uint16_t, uint8_t val);
+typedef void (*cpu_action_t)(gb_t*, uint8_t*);
+typedef void (*drawFunc)(gb_t*, size_t);
+typedef void (*lineFunc)(gb_t*);
+typedef void (*tileDecodeFunc)(const uint8_t*, uint8_t*, uint8_t*);
+typedef void (*lineExpandFunc)(uint32_t*, const uint8_t*, const uint32_t*, uint8_t);
+
+//things that can change what the cpu sees without it touching
+//any registers, in catch-up mode the cpu may run ahead until
+//the earliest one of them is due
+enum {
+	EMU_EVENT_PPU = 0,
+	EMU_EVENT_TIMER,
+	EMU_EVENT_SERIAL,
+	EMU_EVENT_HDMA,
+	EMU_EVENT_APU,
+	EMU_EVENT_FRAME,
+	EMU_EVENT_MAX
+};
+#define EMU_EVENT_NONE UINT32_MAX
+
+typedef struct _envelope_t {
+	bool modeadd;
+	uint8_t vol;
+	uint8_t curVol;
+	uint8_t period;
+	uint8_t divider;
+} envelope_t;
+
+typedef struct _sweep_t {
+	bool enabled;
+	bool negative;
+	bool inNegative;
+	uint8_t period;
+	uint8_t divider;
+	uint8_t shift;
+	uint16_t pfreq;
+} sweep_t;
+
+//used in for example VBA
+typedef struct _rtcsave_t {
+	int32_t secs;
+	int32_t mins;
+	int32_t hours;
+	int32_t days;
+	int32_t ctrl;
+	int32_t lsecs;
+	int32_t lmins;
+	int32_t lhours;
+	int32_t ldays;
+	int32_t lctrl;
+	int64_t lastTime;
+} rtcsave_t;
+
+//predecoded instruction, len 0 means it still has to be decoded
+typedef struct _memcode_t {
+	uint8_t op;
+	uint8_t len;
+	uint8_t imm[2];
+} memcode_t;
+
+typedef struct _cpu_t {
+	uint8_t cpuAddSpeed;
+	bool cpuCgbSpeed;
+	bool cpuDoStopSwitch;
+	bool cpu_oam_dma;
+	bool cpu_oam_dma_running;
+	uint16_t cpu_oam_dma_addr;
+	uint16_t sp, pc, cpuTmp16;
+	uint8_t a,b,c,d,e,h,l,cpuTmp;
+	//unpacked f, see cpuGetF
+	uint8_t cpuFlagZ, cpuFlagN;
+	uint16_t cpuFlagHC;
+	//gbs stuff
+	bool gbsInitRet, gbsPlayRet;
+	bool irqEnable;
+	bool cpuHaltLoop,cpuStopLoop,cpuHaltBug,cpuPrevInAny;
+	uint8_t curInstr;
+	bool cpu_oam_dma_started;
+	uint8_t cpu_oam_dma_pos;
+	bool cpuDmaHalt;
+	const uint8_t *cpu_action_arr;
+	uint8_t cpu_arr_pos;
+	cpu_action_t cpu_action_func;
+	//catch-up mode
+	bool cpuRunAhead;
+	bool cpuFetched;
+	//decoded form of curInstr, NULL if read from memory
+	memcode_t *cpuCode;
+	//start of the last polling loop and when the cpu got there
+	uint16_t cpuIdleLoopPC;
+	uint64_t cpuIdleLoopTime;
+} cpu_t;
+
+typedef struct _ppu_t {
+	drawFunc ppuDrawDot;
+	lineFunc ppuDrawLine;
+	tileDecodeFunc ppuDecodeTile;
+	lineExpandFunc ppuExpandLine;
+	uint8_t ppuCgbBank;
+	uint32_t ppuClock;
+	uint8_t ppuMode;
+	uint8_t ppuDots;
+	uint8_t ppuLines;
+	uint8_t ppuLineMatch;
+	uint8_t ppuOAMpos;
+	uint8_t ppuOAM2pos;
+	uint8_t ppuCgbBgPalPos;
+	uint8_t ppuCgbObjPalPos;
+	uint8_t PPU_Reg[12];
+	uint8_t PPU_OAM[0xA0];
+	uint8_t PPU_OAM2[0x28];
+	uint8_t PPU_VRAM[0x4000];
+	//decoded vram tiles of both banks, 1 byte per dot with a
+	//x flipped copy next to it, PPU_TileDirty marks outdated ones
+	uint8_t PPU_TileCache[0x300][2][0x40];
+	bool PPU_TileDirty[0x300];
+	uint32_t PPU_BGRLUT[4];
+	uint8_t PPU_CGB_BGPAL[0x40];
+	uint8_t PPU_CGB_OBJPAL[0x40];
+	uint32_t PPU_CGB_BGRLUT[0x8000];
+	bool ppuFrameDone;
+	bool ppuVBlank;
+	bool ppuVBlankTriggered;
+	bool ppuHBlank;
+	bool ppuHBlankTriggered;
+	bool ppuHadIRQs;
+	//frame skip, whether a frame gets drawn is decided when it starts,
+	//timing and irqs stay the same for frames that do not get drawn
+	bool ppuDrawFrame;
+	bool ppuNextFrameSet;
+	bool ppuNextFrameDraw;
+	uint8_t ppuFrameSkip;
+	uint8_t ppuFrameSkipPos;
+} ppu_t;
+
+typedef struct _apu_t {
+	uint8_t APU_IO_Reg[0x50];
+#if AUDIO_FLOAT
+	float lpVal;
+	float hpVal;
+	float *apuOutBuf;
+	float lastHPOutLeft, lastHPOutRight, lastLPOutLeft, lastLPOutRight;
+#else
+	int32_t lpVal;
+	int32_t hpVal;
+	int16_t *apuOutBuf;
+	int32_t lastHPOutLeft, lastHPOutRight, lastLPOutLeft, lastLPOutRight;
+#endif
+	uint32_t apuBufSize;
+	uint32_t apuBufSizeBytes;
+	uint32_t curBufPos;
+	uint32_t apuFrequency;
+	uint16_t freq1;
+	uint16_t freq2;
+	uint16_t wavFreq;
+	uint16_t noiseFreq;
+	uint16_t noiseShiftReg;
+	uint8_t p1LengthCtr, p2LengthCtr, noiseLengthCtr;
+	uint8_t wavLinearCtr;
+	uint16_t wavLengthCtr;
+	uint8_t wavVolShift;
+	uint16_t modeCurCtr;
+	uint8_t modePos;
+	uint16_t p1freqCtr, p2freqCtr, wavFreqCtr, noiseFreqCtr;
+	uint8_t p1Cycle, p2Cycle, wavCycle;
+	bool p1haltloop, p2haltloop, wavhaltloop, noisehaltloop;
+	bool p1dacenable, p2dacenable, wavdacenable, noisedacenable;
+	bool p1enable, p2enable, wavenable, noiseenable;
+	bool soundEnabled;
+	bool noiseMode1;
+	bool wavEqual;
+	envelope_t p1Env, p2Env, noiseEnv;
+	sweep_t p1Sweep;
+	const uint16_t *noisePeriod;
+	const uint8_t *p1seq, *p2seq;
+	uint8_t curP1Out, curP2Out, curWavOut, curNoiseOut;
+} apu_t;
+
+typedef struct _mem_t {
+	uint8_t Main_Mem[0x8000];
+	uint8_t High_Mem[0x80];
+	uint8_t gbs_prevValReads[8];
+	uint8_t memLastVal;
+	uint8_t irReq;
+	uint8_t serialReg;
+	uint8_t serialCtrlReg;
+	uint8_t irqEnableReg;
+	uint8_t irqFlagsReg;
+	uint8_t genericReg[4];
+	//div and tima only get brought up to date when they are
+	//accessed or tima overflows, these are the values as of
+	//timerClock, the main clock the timer got run up to
+	uint16_t divRegVal;
+	uint8_t timerReg;
+	uint8_t timerRegVal;
+	uint8_t timerResetVal;
+	uint16_t timerRegBit;
+	bool timerPrevTicked;
+	uint64_t timerClock;
+	//main clock tima overflows on next, UINT64_MAX if never
+	uint64_t timerNextClock;
+	uint8_t sioTimerRegClock;
+	uint8_t sioTimerRegTimer;
+	uint8_t sioBitsTransfered;
+	uint8_t cgbMainBank;
+	bool cgbDmaActive;
+	uint16_t cgbDmaSrc;
+	uint16_t cgbDmaDst;
+	uint8_t cgbDmaLen;
+	uint8_t memDmaClock;
+	bool cgbDmaHBlankMode;
+	bool cgbBootromEnabled;
+	bool timerRegEnable;
+	bool sioTimerRegEnable;
+	uint8_t curGBS;
+	//predecoded instructions, rom gets one page per 16KB
+	//bank so bank switches dont throw away anything
+	memcode_t **memCodeROM;
+	uint32_t memCodeROMPages;
+	memcode_t memCodeRAM[0x8000];
+	memcode_t memCodeHiRAM[0x80];
+	//one entry per 256 byte page, accesses go straight to
+	//memory through the page pointer if it is set and to the
+	//handler of its 4KB region otherwise, the I/O page
+	//dispatches further with one handler per register
+	uint8_t *memReadPage[0x100];
+	uint8_t *memWritePage[0x100];
+	get8FuncT memGet8Region[0x10];
+	set8FuncT memSet8Region[0x10];
+	get8FuncT memGetIO8ptr[0x100];
+	set8FuncT memSetIO8ptr[0x100];
+	//rom banks the rom pages point at right now
+	uint32_t memROMBank[2];
+	//cart ram window the ram pages point at, NULL if not mapped
+	uint8_t *memExtRAMPtr;
+	uint8_t memCGBBootrom[0x900];
+} mem_t;
+
+typedef struct _mbc_t {
+	uint8_t Ext_Mem[0x20000];
+	set8FuncT mbcSet8;
+	set8FuncT mbcSetRAM8;
+	get8FuncT mbcGetRAM8;
+	//multicart regs
+	uint16_t tBank0;
+	uint16_t tBank1;
+	uint16_t oBank;
+	uint16_t iBank;
+	uint16_t oBankAnd;
+	uint16_t iBankAnd;
+	uint8_t mcState;
+	bool mcLocked;
+	//normal regs
+	uint8_t rtcReg;
+	uint16_t cBank;
+	uint16_t extBank;
+	uint16_t bankMask;
+	uint16_t extMask;
+	uint16_t extAddrMask;
+	size_t extTotalSize;
+	bool RamIOAllowed;
+	bool extMemEnabled;
+	bool bankUsed;
+	bool extSelect;
+	bool rtcUsed;
+	bool rtcEnabled;
+	uint8_t lastRTCval;
+	rtcsave_t RTCSave;
+	//latched rtc regs by register number, 0xFF for the others
+	uint8_t rtcLatch[0x10];
+	//rtc runs off emulated time, the wall clock only gets read
+	//when the game gets loaded, or not at all with a fixed epoch
+	bool rtcEmuTime;
+	bool rtcFixedEpoch;
+	int64_t rtcEpoch;
+	//emuClock at the time rtcEpoch is for
+	uint64_t rtcEpochClock;
+	//256 byte pages of Ext_Mem written since the save
+	//journal last took them, rtc regs changed since then
+	uint8_t extDirty[0x200];
+	bool extDirtyAny;
+	bool rtcDirty;
+} mbc_t;
+
+typedef struct _input_t {
+	uint8_t inValReads[8];
+	uint8_t modeSelect;
+} input_t;
+
+struct _gb_t {
+	cpu_t cpu;
+	ppu_t ppu;
+	apu_t apu;
+	mem_t mem;
+	mbc_t mbc;
+	input_t input;
+
+	volatile bool emuRenderFrame;
+	int emuFileType;
+	char emuFileName[1024];
+	uint8_t *emuGBROM;
+	uint32_t emuGBROMsize;
+	//shared rom cache entry emuGBROM points into, NULL if private
+	struct _romcache_t *emuGBROMCache;
+	char emuSaveName[1024];
+	bool emuSaveEnabled;
+	//background save writer, NULL if not running
+	struct _savejournal_t *emuSaveJournal;
+	uint32_t textureImage[0x5A00];
+	//frontend window for the loaded game
+	char emuWindowTitle[256];
+	char emuWindowTitlePause[256];
+	uint32_t emuLinesToDraw;
+	uint8_t emuScaleFactor;
+	bool gbPause;
+	bool gbEmuGBSPlayback;
+	bool gbsTimerMode;
+	uint16_t gbsLoadAddr;
+	uint16_t gbsInitAddr;
+	uint16_t gbsPlayAddr;
+	uint32_t gbsRomSize;
+	uint16_t gbsSP;
+	uint8_t gbsTracksTotal, gbsTMA, gbsTAC;
+	uint8_t cpuTimer;
+	bool gbCgbGame;
+	bool gbCgbMode;
+	bool gbCgbBootrom;
+	bool gbAllowInvVRAM;
+	bool gbIsMulticart;
+	bool emuSkipVsync;
+	bool emuSkipFrame;
+	uint8_t mainClock;
+	uint8_t memClock;
+	//catch-up mode, the cpu runs a whole instruction ahead
+	//and the other parts get synced up to it when required
+	bool emuCatchUp;
+	bool emuPreDone;
+	uint32_t emuClocksAhead;
+	//event scheduler, times are in main clocks since reset
+	uint64_t emuClock;
+	uint64_t emuEventTime[EMU_EVENT_MAX];
+	uint64_t emuNextEvent;
+};
+
+gb_t *gbEmuCreate();
+void gbEmuDestroy(gb_t *gb);
+void gbEmuMainLoop(gb_t *gb);
+void gbEmuDeinit(gb_t *gb);
+void gbEmuCatchUp(gb_t *gb);
+void gbEmuReschedule(gb_t *gb);
+
+#endif
@@ -0,0 +1,608 @@
+/*
+ * Copyright (C) 2017 FIX94
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include "gb.h"
+#include "apu.h"
+#include "audio.h"
+#include "mem.h"
+#include "ppu.h"
+
+//batch frontend without window or audio device, the core
+//gets built the same way as for libretro and this file
+//provides the hooks the GLUT/OpenAL frontend normally does
+
+#define VISIBLE_DOTS 160
+#define VISIBLE_LINES 144
+//main clocks per frame in single speed mode
+#define FRAME_CLOCKS 70224
+
+int gbEmuLoadGame(gb_t *gb, const char *filename);
+void apuFrameEnd(gb_t *gb);
+
+static FILE *audioFile = NULL;
+static uint32_t audioBytes = 0;
+//fnv-1a over every frame and all audio, only kept up with -v
+static bool hashOutput = false;
+static uint64_t frameHash = 0xCBF29CE484222325ULL;
+static uint64_t audioHash = 0xCBF29CE484222325ULL;
+
+static void headlessHash(uint64_t *hash, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	while(len--)
+	{
+		*hash ^= *p++;
+		*hash *= 0x100000001B3ULL;
+	}
+}
+
+void memSaveGame(gb_t *gb)
+{
+	(void)gb;
+}
+
+int audioInit(gb_t *gb)
+{
+	(void)gb;
+	return 0;
+}
+
+int audioUpdate(gb_t *gb)
+{
+	(void)gb;
+	return 1;
+}
+
+void audioDeinit()
+{
+}
+
+void audioSleep()
+{
+}
+
+void audioFrameEnd(gb_t *gb, int samples)
+{
+	if(samples <= 0)
+		return;
+#if AUDIO_FLOAT
+	size_t bytes = samples*2*sizeof(float);
+#else
+	size_t bytes = samples*2*sizeof(int16_t);
+#endif
+	if(hashOutput)
+		headlessHash(&audioHash, apuGetBuf(gb), bytes);
+	if(audioFile)
+		audioBytes += fwrite(apuGetBuf(gb), 1, bytes, audioFile);
+}
+
+FILE *doOpenCGBBootrom()
+{
+	return fopen("gbc_bios.bin","rb");
+}
+
+static void headlessPut16(FILE *f, uint16_t v)
+{
+	fputc(v&0xFF,f); fputc(v>>8,f);
+}
+
+static void headlessPut32(FILE *f, uint32_t v)
+{
+	headlessPut16(f,v&0xFFFF); headlessPut16(f,v>>16);
+}
+
+//(re)writes the wav header, called once with the size
+//unknown and again after all samples got written
+static void headlessWriteWavHeader(gb_t *gb, FILE *f, uint32_t dataSize)
+{
+#if AUDIO_FLOAT
+	uint16_t fmtTag = 3, sampleBits = 32;
+#else
+	uint16_t fmtTag = 1, sampleBits = 16;
+#endif
+	uint32_t freq = apuGetFrequency(gb);
+	rewind(f);
+	fwrite("RIFF",1,4,f);
+	headlessPut32(f,36+dataSize);
+	fwrite("WAVEfmt ",1,8,f);
+	headlessPut32(f,16);
+	headlessPut16(f,fmtTag);
+	headlessPut16(f,2);
+	headlessPut32(f,freq);
+	headlessPut32(f,freq*2*(sampleBits/8));
+	headlessPut16(f,2*(sampleBits/8));
+	headlessPut16(f,sampleBits);
+	fwrite("data",1,4,f);
+	headlessPut32(f,dataSize);
+}
+
+static bool headlessDumpFrame(gb_t *gb, const char *name)
+{
+	FILE *f = fopen(name,"wb");
+	if(!f)
+		return false;
+	fprintf(f,"P6\n%i %i\n255\n",VISIBLE_DOTS,VISIBLE_LINES);
+	size_t i;
+	for(i = 0; i < VISIBLE_DOTS*VISIBLE_LINES; i++)
+	{
+		uint32_t px = gb->textureImage[i];
+		fputc((px>>16)&0xFF,f); fputc((px>>8)&0xFF,f); fputc(px&0xFF,f);
+	}
+	fclose(f);
+	return true;
+}
+
+//small cpu bound program with nothing but the lcd enabled and
+//no irqs, used to compare cpu interpreter builds against each
+//other, the lcd stays on since frames only end with it on
+static const uint8_t headlessBenchCode[] = {
+	0xF3,             //0x150: di
+	0x3E, 0x80,       //0x151: ld a,0x80
+	0xE0, 0x40,       //0x153: ldh (LCDC),a
+	0x31, 0xFE, 0xDF, //0x155: ld sp,0xDFFE
+	0x0E, 0x00,       //0x158: ld c,0
+	0x21, 0x00, 0xC0, //0x15A: ld hl,0xC000
+	0x06, 0x00,       //0x15D: ld b,0
+	0x7E,             //0x15F: ld a,(hl)
+	0x80,             //0x160: add a,b
+	0xA9,             //0x161: xor c
+	0xCB, 0x07,       //0x162: rlc a
+	0xCB, 0x37,       //0x164: swap a
+	0xCB, 0x5F,       //0x166: bit 3,a
+	0x28, 0x01,       //0x168: jr z,0x16B
+	0x0C,             //0x16A: inc c
+	0x22,             //0x16B: ld (hl+),a
+	0xCD, 0x75, 0x01, //0x16C: call 0x175
+	0x05,             //0x16F: dec b
+	0x20, 0xED,       //0x170: jr nz,0x15F
+	0xC3, 0x5A, 0x01, //0x172: jp 0x15A
+	0xC5,             //0x175: push bc
+	0xC1,             //0x176: pop bc
+	0xC9,             //0x177: ret
+};
+
+//cgb program that fills vram with tiles, tile attributes and bg
+//palettes, turns on bg and window and then only scrolls in vblank,
+//used to compare ppu builds against each other
+static const uint8_t headlessPPUBenchCode[] = {
+	0xF3,             //0x150: di
+	0x31, 0xFE, 0xFF, //0x151: ld sp,0xFFFE
+	0xF0, 0x44,       //0x154: ldh a,(LY)
+	0xFE, 0x90,       //0x156: cp 144
+	0x38, 0xFA,       //0x158: jr c,0x154
+	0xAF,             //0x15A: xor a
+	0xE0, 0x40,       //0x15B: ldh (LCDC),a
+	0x21, 0x00, 0x80, //0x15D: ld hl,0x8000
+	0x7D,             //0x160: ld a,l
+	0xAC,             //0x161: xor h
+	0x22,             //0x162: ld (hl+),a
+	0x7C,             //0x163: ld a,h
+	0xFE, 0x98,       //0x164: cp 0x98
+	0x20, 0xF8,       //0x166: jr nz,0x160
+	0x7D,             //0x168: ld a,l
+	0x22,             //0x169: ld (hl+),a
+	0x7C,             //0x16A: ld a,h
+	0xFE, 0xA0,       //0x16B: cp 0xA0
+	0x20, 0xF9,       //0x16D: jr nz,0x168
+	0x3E, 0x01,       //0x16F: ld a,1
+	0xE0, 0x4F,       //0x171: ldh (VBK),a
+	0x21, 0x00, 0x98, //0x173: ld hl,0x9800
+	0x7D,             //0x176: ld a,l
+	0xE6, 0x6F,       //0x177: and 0x6F
+	0x22,             //0x179: ld (hl+),a
+	0x7C,             //0x17A: ld a,h
+	0xFE, 0xA0,       //0x17B: cp 0xA0
+	0x20, 0xF7,       //0x17D: jr nz,0x176
+	0x3E, 0x80,       //0x17F: ld a,0x80
+	0xE0, 0x68,       //0x181: ldh (BCPS),a
+	0x06, 0x40,       //0x183: ld b,0x40
+	0x78,             //0x185: ld a,b
+	0xEE, 0x5A,       //0x186: xor 0x5A
+	0xE0, 0x69,       //0x188: ldh (BCPD),a
+	0x05,             //0x18A: dec b
+	0x20, 0xF8,       //0x18B: jr nz,0x185
+	0x3E, 0x28,       //0x18D: ld a,40
+	0xE0, 0x4A,       //0x18F: ldh (WY),a
+	0x3E, 0x50,       //0x191: ld a,80
+	0xE0, 0x4B,       //0x193: ldh (WX),a
+	0x3E, 0xF1,       //0x195: ld a,0xF1
+	0xE0, 0x40,       //0x197: ldh (LCDC),a
+	0x3E, 0x01,       //0x199: ld a,1
+	0xE0, 0xFF,       //0x19B: ldh (IE),a
+	0xFB,             //0x19D: ei
+	0x76,             //0x19E: halt
+	0xF0, 0x43,       //0x19F: ldh a,(SCX)
+	0x3C,             //0x1A1: inc a
+	0xE0, 0x43,       //0x1A2: ldh (SCX),a
+	0x18, 0xF8,       //0x1A4: jr 0x19E
+};
+
+//polls LY for 0, STAT for hblank and DIV for one value and puts
+//DIV and LY into the scroll and palette regs each frame, so any
+//timing difference between catch-up and per-clock mode shows up
+//in the frames, used by "make check"
+static const uint8_t headlessCheckCode[] = {
+	0xF3,             //0x150: di
+	0x31, 0xFE, 0xFF, //0x151: ld sp,0xFFFE
+	0xF0, 0x44,       //0x154: ldh a,(LY)
+	0xFE, 0x90,       //0x156: cp 144
+	0x38, 0xFA,       //0x158: jr c,0x154
+	0xAF,             //0x15A: xor a
+	0xE0, 0x40,       //0x15B: ldh (LCDC),a
+	0x21, 0x00, 0x80, //0x15D: ld hl,0x8000
+	0x7D,             //0x160: ld a,l
+	0x22,             //0x161: ld (hl+),a
+	0x7C,             //0x162: ld a,h
+	0xFE, 0x90,       //0x163: cp 0x90
+	0x20, 0xF9,       //0x165: jr nz,0x160
+	0x3E, 0xE4,       //0x167: ld a,0xE4
+	0xE0, 0x47,       //0x169: ldh (BGP),a
+	0x3E, 0x91,       //0x16B: ld a,0x91
+	0xE0, 0x40,       //0x16D: ldh (LCDC),a
+	0xF0, 0x44,       //0x16F: ldh a,(LY)
+	0xA7,             //0x171: and a
+	0x20, 0xFB,       //0x172: jr nz,0x16F
+	0xF0, 0x04,       //0x174: ldh a,(DIV)
+	0xE0, 0x43,       //0x176: ldh (SCX),a
+	0xF0, 0x41,       //0x178: ldh a,(STAT)
+	0xE6, 0x03,       //0x17A: and 3
+	0x20, 0xFA,       //0x17C: jr nz,0x178
+	0xF0, 0x04,       //0x17E: ldh a,(DIV)
+	0xE0, 0x42,       //0x180: ldh (SCY),a
+	0xF0, 0x04,       //0x182: ldh a,(DIV)
+	0xFE, 0x80,       //0x184: cp 0x80
+	0x20, 0xFA,       //0x186: jr nz,0x182
+	0xF0, 0x44,       //0x188: ldh a,(LY)
+	0xE0, 0x47,       //0x18A: ldh (BGP),a
+	0xF0, 0x44,       //0x18C: ldh a,(LY)
+	0xA7,             //0x18E: and a
+	0x28, 0xFB,       //0x18F: jr z,0x18C
+	0x18, 0xDC,       //0x191: jr 0x16F
+};
+
+//40 sprites using tiles from both vram banks with mixed flip,
+//priority and palette bits, starting out 16 (32 in 8x16 mode)
+//to a line and moved in vblank at different speeds so their x
+//positions cross and tie, SCX, 8x16 mode and every other frame
+//LCDC bit 0 change too, "make check" writes it as .gb and .gbc
+static const uint8_t headlessSpriteCheckCode[] = {
+	0xF3,             //0x150: di
+	0x31, 0xFE, 0xFF, //0x151: ld sp,0xFFFE
+	0xF0, 0x44,       //0x154: ldh a,(LY)
+	0xFE, 0x90,       //0x156: cp 144
+	0x38, 0xFA,       //0x158: jr c,0x154
+	0xAF,             //0x15A: xor a
+	0xE0, 0x40,       //0x15B: ldh (LCDC),a
+	0x3E, 0x01,       //0x15D: ld a,1
+	0xE0, 0x4F,       //0x15F: ldh (VBK),a
+	0x21, 0x00, 0x80, //0x161: ld hl,0x8000
+	0x7D,             //0x164: ld a,l
+	0x2F,             //0x165: cpl
+	0xAC,             //0x166: xor h
+	0x22,             //0x167: ld (hl+),a
+	0x7C,             //0x168: ld a,h
+	0xFE, 0x98,       //0x169: cp 0x98
+	0x20, 0xF7,       //0x16B: jr nz,0x164
+	0x7D,             //0x16D: ld a,l
+	0xE6, 0x8F,       //0x16E: and 0x8F
+	0x22,             //0x170: ld (hl+),a
+	0x7C,             //0x171: ld a,h
+	0xFE, 0xA0,       //0x172: cp 0xA0
+	0x20, 0xF7,       //0x174: jr nz,0x16D
+	0xAF,             //0x176: xor a
+	0xE0, 0x4F,       //0x177: ldh (VBK),a
+	0x21, 0x00, 0x80, //0x179: ld hl,0x8000
+	0x7D,             //0x17C: ld a,l
+	0xAC,             //0x17D: xor h
+	0x22,             //0x17E: ld (hl+),a
+	0x7C,             //0x17F: ld a,h
+	0xFE, 0x98,       //0x180: cp 0x98
+	0x20, 0xF8,       //0x182: jr nz,0x17C
+	0x7D,             //0x184: ld a,l
+	0xE6, 0x7F,       //0x185: and 0x7F
+	0x22,             //0x187: ld (hl+),a
+	0x7C,             //0x188: ld a,h
+	0xFE, 0xA0,       //0x189: cp 0xA0
+	0x20, 0xF7,       //0x18B: jr nz,0x184
+	0x3E, 0xE4,       //0x18D: ld a,0xE4
+	0xE0, 0x47,       //0x18F: ldh (BGP),a
+	0x3E, 0xD2,       //0x191: ld a,0xD2
+	0xE0, 0x48,       //0x193: ldh (OBP0),a
+	0x3E, 0x1B,       //0x195: ld a,0x1B
+	0xE0, 0x49,       //0x197: ldh (OBP1),a
+	0x3E, 0x80,       //0x199: ld a,0x80
+	0xE0, 0x68,       //0x19B: ldh (BCPS),a
+	0xE0, 0x6A,       //0x19D: ldh (OCPS),a
+	0x06, 0x40,       //0x19F: ld b,0x40
+	0x78,             //0x1A1: ld a,b
+	0xEE, 0x5A,       //0x1A2: xor 0x5A
+	0xE0, 0x69,       //0x1A4: ldh (BCPD),a
+	0x2F,             //0x1A6: cpl
+	0xE0, 0x6B,       //0x1A7: ldh (OCPD),a
+	0x05,             //0x1A9: dec b
+	0x20, 0xF5,       //0x1AA: jr nz,0x1A1
+	0x21, 0x00, 0xFE, //0x1AC: ld hl,0xFE00
+	0x06, 0x00,       //0x1AF: ld b,0
+	0x78,             //0x1B1: ld a,b
+	0xCB, 0x3F,       //0x1B2: srl a
+	0xC6, 0x18,       //0x1B4: add a,0x18
+	0x22,             //0x1B6: ld (hl+),a
+	0x78,             //0x1B7: ld a,b
+	0x87,             //0x1B8: add a,a
+	0x80,             //0x1B9: add a,b
+	0x87,             //0x1BA: add a,a
+	0xE6, 0x7F,       //0x1BB: and 0x7F
+	0x22,             //0x1BD: ld (hl+),a
+	0x78,             //0x1BE: ld a,b
+	0x87,             //0x1BF: add a,a
+	0x80,             //0x1C0: add a,b
+	0x22,             //0x1C1: ld (hl+),a
+	0x78,             //0x1C2: ld a,b
+	0xCB, 0x37,       //0x1C3: swap a
+	0xA8,             //0x1C5: xor b
+	0x22,             //0x1C6: ld (hl+),a
+	0x04,             //0x1C7: inc b
+	0x78,             //0x1C8: ld a,b
+	0xFE, 0x28,       //0x1C9: cp 40
+	0x20, 0xE4,       //0x1CB: jr nz,0x1B1
+	0x3E, 0x93,       //0x1CD: ld a,0x93
+	0xE0, 0x40,       //0x1CF: ldh (LCDC),a
+	0xF0, 0x44,       //0x1D1: ldh a,(LY)
+	0xFE, 0x90,       //0x1D3: cp 144
+	0x20, 0xFA,       //0x1D5: jr nz,0x1D1
+	0xF0, 0x40,       //0x1D7: ldh a,(LCDC)
+	0xEE, 0x04,       //0x1D9: xor 4
+	0xCB, 0x57,       //0x1DB: bit 2,a
+	0x20, 0x02,       //0x1DD: jr nz,0x1E1
+	0xEE, 0x01,       //0x1DF: xor 1
+	0xE0, 0x40,       //0x1E1: ldh (LCDC),a
+	0xF0, 0x43,       //0x1E3: ldh a,(SCX)
+	0x3C,             //0x1E5: inc a
+	0xE0, 0x43,       //0x1E6: ldh (SCX),a
+	0x21, 0x00, 0xFE, //0x1E8: ld hl,0xFE00
+	0x06, 0x28,       //0x1EB: ld b,40
+	0x78,             //0x1ED: ld a,b
+	0xE6, 0x04,       //0x1EE: and 4
+	0x0F,             //0x1F0: rrca
+	0x0F,             //0x1F1: rrca
+	0x86,             //0x1F2: add a,(hl)
+	0x22,             //0x1F3: ld (hl+),a
+	0x78,             //0x1F4: ld a,b
+	0xE6, 0x03,       //0x1F5: and 3
+	0x86,             //0x1F7: add a,(hl)
+	0x22,             //0x1F8: ld (hl+),a
+	0x23,             //0x1F9: inc hl
+	0x23,             //0x1FA: inc hl
+	0x05,             //0x1FB: dec b
+	0x20, 0xEF,       //0x1FC: jr nz,0x1ED
+	0xF0, 0x44,       //0x1FE: ldh a,(LY)
+	0xFE, 0x90,       //0x200: cp 144
+	0x28, 0xFA,       //0x202: jr z,0x1FE
+	0x18, 0xCB,       //0x204: jr 0x1D1
+};
+
+static bool headlessWriteRom(const char *name, const char *title, const uint8_t *code, size_t codeSize, bool cgb)
+{
+	static uint8_t rom[0x8000];
+	memset(rom,0,sizeof(rom));
+	//reti for vblank
+	rom[0x40] = 0xD9;
+	//nop, jp 0x150
+	rom[0x100] = 0x00; rom[0x101] = 0xC3; rom[0x102] = 0x50; rom[0x103] = 0x01;
+	memcpy(rom+0x134,title,strlen(title));
+	if(cgb)
+		rom[0x143] = 0x80;
+	memcpy(rom+0x150,code,codeSize);
+	uint8_t hdrcrc = 0;
+	size_t i;
+	for(i = 0x134; i < 0x14D; i++)
+		hdrcrc = hdrcrc-rom[i]-1;
+	rom[0x14D] = hdrcrc;
+	FILE *f = fopen(name,"wb");
+	if(!f)
+		return false;
+	bool ok = (fwrite(rom,1,sizeof(rom),f) == sizeof(rom));
+	fclose(f);
+	return ok;
+}
+
+static void headlessUsage(const char *name)
+{
+	printf("Usage: %s [-f frames | -c cycles] [-o frame.ppm] [-s skip] [-a audio.wav] [-e | -t time] [-k] [-v] file\n", name);
+	printf("       %s -g bench.gb | -p bench.gbc | -y check.gb | -x sprites.gb[c]\n", name);
+	printf("  -f  number of frames to run (default 600)\n");
+	printf("  -c  number of main clocks to run, rounded up to full frames\n");
+	printf("  -o  where to write the last frame (default fixgb_frame.ppm)\n");
+	printf("  -s  frames to skip drawing after each drawn one (0-255), the last one always gets drawn\n");
+	printf("  -a  where to write all audio output (default fixgb_audio.wav)\n");
+	printf("  -g  write the cpu benchmark rom to the given file and exit\n");
+	printf("  -p  write the ppu benchmark rom to the given file and exit\n");
+	printf("  -y  write the timing check rom to the given file and exit\n");
+	printf("  -x  write the sprite check rom to the given file and exit, a .gbc one runs in cgb mode\n");
+	printf("  -e  run the mbc3 rtc from emulated time instead of the wall clock\n");
+	printf("  -t  same as -e but start the rtc at the given unix time (utc)\n");
+	printf("  -k  clock every part each cycle and draw dot by dot instead of using catch-up mode\n");
+	printf("  -v  print a hash over every frame and all audio\n");
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t frames = 600;
+	uint8_t frameSkip = 0;
+	const char *frameName = "fixgb_frame.ppm";
+	const char *audioName = "fixgb_audio.wav";
+	const char *romName = NULL;
+	const char *benchName = NULL;
+	const char *ppuBenchName = NULL;
+	const char *checkName = NULL;
+	const char *spriteCheckName = NULL;
+	bool perClock = false;
+	bool rtcEmuTime = false;
+	bool rtcFixedEpoch = false;
+	int64_t rtcEpoch = 0;
+	int i;
+	for(i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i],"-f") == 0 && i+1 < argc)
+			frames = strtoull(argv[++i],NULL,0);
+		else if(strcmp(argv[i],"-c") == 0 && i+1 < argc)
+			frames = (strtoull(argv[++i],NULL,0)+FRAME_CLOCKS-1)/FRAME_CLOCKS;
+		else if(strcmp(argv[i],"-o") == 0 && i+1 < argc)
+			frameName = argv[++i];
+		else if(strcmp(argv[i],"-s") == 0 && i+1 < argc)
+		{
+			char *end;
+			unsigned long skip = strtoul(argv[++i],&end,0);
+			//the ppu keeps the skip count in a byte
+			if(end == argv[i] || *end != '\0' || argv[i][0] == '-' || skip > 255)
+			{
+				printf("Headless: Frames to skip has to be 0 to 255, got %s\n", argv[i]);
+				headlessUsage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			frameSkip = skip;
+		}
+		else if(strcmp(argv[i],"-a") == 0 && i+1 < argc)
+			audioName = argv[++i];
+		else if(strcmp(argv[i],"-g") == 0 && i+1 < argc)
+			benchName = argv[++i];
+		else if(strcmp(argv[i],"-p") == 0 && i+1 < argc)
+			ppuBenchName = argv[++i];
+		else if(strcmp(argv[i],"-y") == 0 && i+1 < argc)
+			checkName = argv[++i];
+		else if(strcmp(argv[i],"-x") == 0 && i+1 < argc)
+			spriteCheckName = argv[++i];
+		else if(strcmp(argv[i],"-k") == 0)
+			perClock = true;
+		else if(strcmp(argv[i],"-v") == 0)
+			hashOutput = true;
+		else if(strcmp(argv[i],"-e") == 0)
+			rtcEmuTime = true;
+		else if(strcmp(argv[i],"-t") == 0 && i+1 < argc)
+		{
+			char *end;
+			errno = 0;
+			rtcEpoch = strtoll(argv[++i],&end,0);
+			if(end == argv[i] || *end != '\0' || errno == ERANGE || rtcEpoch < 0)
+			{
+				printf("Headless: Start time has to be a unix time of 0 or more, got %s\n", argv[i]);
+				headlessUsage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			rtcFixedEpoch = true;
+		}
+		else if(argv[i][0] != '-' && !romName)
+			romName = argv[i];
+		else
+		{
+			headlessUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if(benchName || ppuBenchName || checkName || spriteCheckName)
+	{
+		bool ok;
+		const char *name;
+		if(benchName)
+		{
+			ok = headlessWriteRom(benchName,"CPUBENCH",headlessBenchCode,sizeof(headlessBenchCode),false);
+			name = benchName;
+		}
+		else if(ppuBenchName)
+		{
+			ok = headlessWriteRom(ppuBenchName,"PPUBENCH",headlessPPUBenchCode,sizeof(headlessPPUBenchCode),true);
+			name = ppuBenchName;
+		}
+		else if(checkName)
+		{
+			ok = headlessWriteRom(checkName,"TIMECHECK",headlessCheckCode,sizeof(headlessCheckCode),false);
+			name = checkName;
+		}
+		else
+		{
+			size_t len = strlen(spriteCheckName);
+			const char *ext = spriteCheckName+len-4;
+			bool cgb = (len > 4 && ext[0] == '.' && tolower(ext[1]) == 'g' && tolower(ext[2]) == 'b' && tolower(ext[3]) == 'c');
+			ok = headlessWriteRom(spriteCheckName,"SPRITECHECK",headlessSpriteCheckCode,sizeof(headlessSpriteCheckCode),cgb);
+			name = spriteCheckName;
+		}
+		if(!ok)
+		{
+			printf("Headless: Could not write %s!\n", name);
+			return EXIT_FAILURE;
+		}
+		printf("Headless: Done writing %s\n", name);
+		return EXIT_SUCCESS;
+	}
+	if(!romName)
+	{
+		headlessUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	gb_t *gb = gbEmuCreate();
+	if(!gb)
+		return EXIT_FAILURE;
+	gb->emuCatchUp = !perClock;
+	gb->mbc.rtcEmuTime = rtcEmuTime;
+	gb->mbc.rtcFixedEpoch = rtcFixedEpoch;
+	gb->mbc.rtcEpoch = rtcEpoch;
+	if(gbEmuLoadGame(gb, romName) != EXIT_SUCCESS || !gb->emuGBROM)
+	{
+		gbEmuDestroy(gb);
+		return EXIT_FAILURE;
+	}
+	ppuSetFrameSkip(gb, frameSkip);
+	audioFile = fopen(audioName,"wb");
+	if(audioFile)
+		headlessWriteWavHeader(gb, audioFile, 0);
+	else
+		printf("Headless: Could not open %s!\n", audioName);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	uint64_t frame;
+	for(frame = 0; frame < frames; frame++)
+	{
+		if(frame == frames-1)
+			ppuSetNextFrameDraw(gb, true);
+		gbEmuMainLoop(gb);
+		if(hashOutput)
+			headlessHash(&frameHash, gb->textureImage, VISIBLE_DOTS*VISIBLE_LINES*sizeof(uint32_t));
+		apuFrameEnd(gb);
+		gb->emuRenderFrame = false;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double secs = (end.tv_sec-start.tv_sec)+(end.tv_nsec-start.tv_nsec)/1000000000.0;
+
+	printf("Headless: Ran %" PRIu64 " frames in %.3f seconds, %.1f frames/sec (%.2fx realtime)\n",
+		frames, secs, secs > 0 ? frames/secs : 0.0,
+		secs > 0 ? (frames/secs)/(4194304.0/FRAME_CLOCKS) : 0.0);
+	if(hashOutput)
+		printf("Headless: Frame hash %016" PRIx64 ", audio hash %016" PRIx64 "\n", frameHash, audioHash);
+	if(headlessDumpFrame(gb, frameName))
+		printf("Headless: Done writing %s\n", frameName);
+	else
+		printf("Headless: Could not write %s!\n", frameName);
+	if(audioFile)
+	{
+		headlessWriteWavHeader(gb, audioFile, audioBytes);
+		fclose(audioFile);
+		audioFile = NULL;
+		printf("Headless: Done writing %s\n", audioName);
+	}
+	gbEmuDeinit(gb);
+	gbEmuDestroy(gb);
+	return EXIT_SUCCESS;
+}
@@ -10,64 +10,61 @@
 #include <string.h>
 #include <inttypes.h>
 #include <string.h>
+#include "gb.h"
 #include "input.h"
 
-//used externally by main.c
-uint8_t inValReads[8];
-uint8_t modeSelect = 3;
-
 #define DEBUG_INPUT 0
 
-void inputInit()
+void inputInit(gb_t *gb)
 {
-	modeSelect = 3;
+	gb->input.modeSelect = 3;
 }
 
-void inputClear()
+void inputClear(gb_t *gb)
 {
-	memset(inValReads, 0, 8);
+	memset(gb->input.inValReads, 0, 8);
 }
 
-void inputSet8(uint16_t addr, uint8_t in)
+void inputSet8(gb_t *gb, uint16_t addr, uint8_t in)
 {
 	(void)addr;
-	modeSelect = ((in)>>4)&0x3;
+	gb->input.modeSelect = ((in)>>4)&0x3;
 	#if DEBUG_INPUT
-	printf("Input: Set %02x->%02x\n",in,modeSelect);
+	printf("Input: Set %02x->%02x\n",in,gb->input.modeSelect);
 	#endif
 }
 
-uint8_t inputGet8(uint16_t addr)
+uint8_t inputGet8(gb_t *gb, uint16_t addr)
 {
 	(void)addr;
 	uint8_t outVal = 0;
-	if(modeSelect == 1)
+	if(gb->input.modeSelect == 1)
 	{
-		if(inValReads[BUTTON_A])
+		if(gb->input.inValReads[BUTTON_A])
 			outVal |= 1;
-		if(inValReads[BUTTON_B])
+		if(gb->input.inValReads[BUTTON_B])
 			outVal |= 2;
-		if(inValReads[BUTTON_SELECT])
+		if(gb->input.inValReads[BUTTON_SELECT])
 			outVal |= 4;
-		if(inValReads[BUTTON_START])
+		if(gb->input.inValReads[BUTTON_START])
 			outVal |= 8;
 	}
-	else if(modeSelect == 2)
+	else if(gb->input.modeSelect == 2)
 	{
-		if(inValReads[BUTTON_RIGHT])
+		if(gb->input.inValReads[BUTTON_RIGHT])
 			outVal |= 1;
-		if(inValReads[BUTTON_LEFT])
+		if(gb->input.inValReads[BUTTON_LEFT])
 			outVal |= 2;
-		if(inValReads[BUTTON_UP])
+		if(gb->input.inValReads[BUTTON_UP])
 			outVal |= 4;
-		if(inValReads[BUTTON_DOWN])
+		if(gb->input.inValReads[BUTTON_DOWN])
 			outVal |= 8;
 	}
-	return (~(outVal|(modeSelect<<4)));
+	return (~(outVal|(gb->input.modeSelect<<4)));
 }
 
-bool inputAny()
+bool inputAny(gb_t *gb)
 {
-	return !!(inValReads[BUTTON_A]|inValReads[BUTTON_B]|inValReads[BUTTON_SELECT]|inValReads[BUTTON_START]
-		|inValReads[BUTTON_RIGHT]|inValReads[BUTTON_LEFT]|inValReads[BUTTON_UP]|inValReads[BUTTON_DOWN]);
+	return !!(gb->input.inValReads[BUTTON_A]|gb->input.inValReads[BUTTON_B]|gb->input.inValReads[BUTTON_SELECT]|gb->input.inValReads[BUTTON_START]
+		|gb->input.inValReads[BUTTON_RIGHT]|gb->input.inValReads[BUTTON_LEFT]|gb->input.inValReads[BUTTON_UP]|gb->input.inValReads[BUTTON_DOWN]);
 }
@@ -17,10 +17,10 @@
 #define BUTTON_LEFT     6
 #define BUTTON_RIGHT    7
 
-void inputInit();
-void inputClear();
-uint8_t inputGet8(uint16_t addr);
-void inputSet8(uint16_t addr, uint8_t in);
-bool inputAny();
+void inputInit(gb_t *gb);
+void inputClear(gb_t *gb);
+uint8_t inputGet8(gb_t *gb, uint16_t addr);
+void inputSet8(gb_t *gb, uint16_t addr, uint8_t in);
+bool inputAny(gb_t *gb);
 
 #endif
@@ -7,6 +7,7 @@
 #include <inttypes.h>
 #include <time.h>
 #include <math.h>
+#include "gb.h"
 #include "cpu.h"
 #include "input.h"
 #include "ppu.h"
@@ -22,25 +23,24 @@ static retro_audio_sample_batch_t audio_batch_cb;
 static retro_environment_t environ_cb;
 
 static bool libretro_supports_bitmasks = false;
+static bool libretro_can_dupe = false;
 
 #define VISIBLE_DOTS 160
 #define VISIBLE_LINES 144
 
-int gbEmuLoadGame(const char *filename);
-void gbEmuMainLoop(void);
-void gbEmuDeinit(void);
-extern uint8_t inValReads[8];
-extern uint32_t textureImage[0x5A00];
-extern volatile bool emuRenderFrame;
+int gbEmuLoadGame(gb_t *gb, const char *filename);
 extern const char *VERSION_STRING;
 
-void memSaveGame()
-{
+static gb_t *gbEmu = NULL;
 
+void memSaveGame(gb_t *gb)
+{
+   (void)gb;
 }
-int audioInit()
+int audioInit(gb_t *gb)
 {
-
+   (void)gb;
+   return 0;
 }
 void audioDeinit()
 {
@@ -68,7 +68,7 @@ void retro_get_system_av_info(struct retro_system_av_info *info)
    info->geometry.max_height  = VISIBLE_LINES;
    info->geometry.aspect_ratio  = 0.0f;
    info->timing.fps           = 4194304.0 / 70224.0;
-   info->timing.sample_rate   = (float)apuGetFrequency();
+   info->timing.sample_rate   = (float)apuGetFrequency(gbEmu);
 }
 
 void retro_init(void)
@@ -80,11 +80,19 @@ void retro_init(void)
 
    if (environ_cb(RETRO_ENVIRONMENT_GET_INPUT_BITMASKS, NULL))
       libretro_supports_bitmasks = true;
+
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE, &libretro_can_dupe))
+      libretro_can_dupe = false;
+
+   gbEmu = gbEmuCreate();
 }
 
 void retro_deinit()
 {
    libretro_supports_bitmasks = false;
+   libretro_can_dupe = false;
+   gbEmuDestroy(gbEmu);
+   gbEmu = NULL;
 }
 
 void retro_set_environment(retro_environment_t cb)
@@ -155,7 +163,7 @@ bool retro_load_game(const struct retro_game_info *info)
       { 0 },
    };
 
-   if (gbEmuLoadGame(info->path) != EXIT_SUCCESS)
+   if (!gbEmu || gbEmuLoadGame(gbEmu, info->path) != EXIT_SUCCESS)
       return false;
 
    environ_cb(RETRO_ENVIRONMENT_SET_INPUT_DESCRIPTORS, desc);
@@ -190,7 +198,7 @@ bool retro_load_game_special(unsigned game_type, const struct retro_game_info *i
 
 void retro_unload_game()
 {
-   gbEmuDeinit();
+   gbEmuDeinit(gbEmu);
 }
 
 unsigned retro_get_region()
@@ -198,16 +206,13 @@ unsigned retro_get_region()
    return RETRO_REGION_NTSC;
 }
 
-extern bool emuSaveEnabled;
-extern char emuSaveName[1024];
-extern size_t extTotalSize;
 void *retro_get_memory_data(unsigned id)
 {
    switch(id & RETRO_MEMORY_MASK)
    {
    case RETRO_MEMORY_SAVE_RAM:
-      if(emuSaveName[0] && emuSaveEnabled && extTotalSize)
-         return Ext_Mem;
+      if(gbEmu->emuSaveName[0] && gbEmu->emuSaveEnabled && gbEmu->mbc.extTotalSize)
+         return gbEmu->mbc.Ext_Mem;
       break;
    }
    return NULL;
@@ -218,21 +223,21 @@ size_t retro_get_memory_size(unsigned id)
    switch(id & RETRO_MEMORY_MASK)
    {
    case RETRO_MEMORY_SAVE_RAM:
-      if(emuSaveName[0] && emuSaveEnabled && extTotalSize)
-         return extTotalSize;
+      if(gbEmu->emuSaveName[0] && gbEmu->emuSaveEnabled && gbEmu->mbc.extTotalSize)
+         return gbEmu->mbc.extTotalSize;
       break;
    }
    return 0;
 }
 
-int audioUpdate()
+int audioUpdate(gb_t *gb)
 {
 #if 0
 #if AUDIO_FLOAT
    static int16_t buffer[512 * 2];
-   float* buffer_in = (float*)apuGetBuf();
+   float* buffer_in = (float*)apuGetBuf(gb);
    int16_t* out_ptr = buffer;
-   int samples = apuGetBufSize() / sizeof(float);
+   int samples = apuGetBufSize(gb) / sizeof(float);
    while (samples)
    {
 #define CLAMP_16(x) (((x) > INT16_MAX)? INT16_MAX : ((x) < INT16_MIN)? INT16_MIN : (x))
@@ -249,8 +254,8 @@ int audioUpdate()
    if (out_ptr > buffer)
       audio_batch_cb(buffer, (out_ptr - buffer) / 2);
 #else
-   uint16_t* buffer_in = (uint16_t*)apuGetBuf();
-   int samples = apuGetBufSize() / (2 * sizeof(uint16_t));
+   uint16_t* buffer_in = (uint16_t*)apuGetBuf(gb);
+   int samples = apuGetBufSize(gb) / (2 * sizeof(uint16_t));
    while (samples > 512)
    {
      audio_batch_cb(buffer_in, 512);
@@ -263,12 +268,12 @@ int audioUpdate()
    return 1;
 }
 
-void apuFrameEnd();
-void audioFrameEnd(int samples)
+void apuFrameEnd(gb_t *gb);
+void audioFrameEnd(gb_t *gb, int samples)
 {
 #if AUDIO_FLOAT
 #else
-   uint16_t* buffer_in = (uint16_t*)apuGetBuf();
+   uint16_t* buffer_in = (uint16_t*)apuGetBuf(gb);
    while (samples > 512)
    {
      audio_batch_cb(buffer_in, 512);
@@ -295,9 +300,14 @@ void retro_run()
 {
    unsigned i;
    int16_t joypad_bits;
+   int av_enable;
 
    input_poll_cb();
 
+   /* the frontend throws away video it does not want, skip drawing it */
+   if (environ_cb(RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE, &av_enable) && !(av_enable & 1))
+      ppuSetNextFrameDraw(gbEmu, false);
+
    if (libretro_supports_bitmasks)
       joypad_bits = input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_MASK);
    else
@@ -307,21 +317,24 @@ void retro_run()
          joypad_bits |= input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, i) ? (1 << i) : 0;
    }
 
-   inValReads[BUTTON_A]      = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_A) ? 1 : 0;
-   inValReads[BUTTON_B]      = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_B) ? 1 : 0;
-   inValReads[BUTTON_SELECT] = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_SELECT) ? 1 : 0;
-   inValReads[BUTTON_START]  = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_START) ? 1 : 0;
-   inValReads[BUTTON_RIGHT]  = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_RIGHT) ? 1 : 0;
-   inValReads[BUTTON_LEFT]   = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_LEFT) ? 1 : 0;
-   inValReads[BUTTON_UP]     = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_UP) ? 1 : 0;
-   inValReads[BUTTON_DOWN]   = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_DOWN) ? 1 : 0;
+   gbEmu->input.inValReads[BUTTON_A]      = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_A) ? 1 : 0;
+   gbEmu->input.inValReads[BUTTON_B]      = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_B) ? 1 : 0;
+   gbEmu->input.inValReads[BUTTON_SELECT] = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_SELECT) ? 1 : 0;
+   gbEmu->input.inValReads[BUTTON_START]  = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_START) ? 1 : 0;
+   gbEmu->input.inValReads[BUTTON_RIGHT]  = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_RIGHT) ? 1 : 0;
+   gbEmu->input.inValReads[BUTTON_LEFT]   = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_LEFT) ? 1 : 0;
+   gbEmu->input.inValReads[BUTTON_UP]     = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_UP) ? 1 : 0;
+   gbEmu->input.inValReads[BUTTON_DOWN]   = joypad_bits & (1 << RETRO_DEVICE_ID_JOYPAD_DOWN) ? 1 : 0;
 
-   gbEmuMainLoop();
+   gbEmuMainLoop(gbEmu);
 
-   video_cb(textureImage, VISIBLE_DOTS, VISIBLE_LINES, VISIBLE_DOTS * sizeof(uint32_t));
-   apuFrameEnd();
+   if (!ppuFrameDrawn(gbEmu) && libretro_can_dupe)
+      video_cb(NULL, VISIBLE_DOTS, VISIBLE_LINES, VISIBLE_DOTS * sizeof(uint32_t));
+   else
+      video_cb(gbEmu->textureImage, VISIBLE_DOTS, VISIBLE_LINES, VISIBLE_DOTS * sizeof(uint32_t));
+   apuFrameEnd(gbEmu);
 
-   emuRenderFrame = false;
+   gbEmu->emuRenderFrame = false;
 }
 
 unsigned retro_api_version()
@@ -18,12 +18,21 @@
 #endif
 #include <time.h>
 #include <math.h>
+#if !WINDOWS_BUILD
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#endif
+#include "gb.h"
 #include "cpu.h"
 #include "input.h"
 #include "ppu.h"
 #include "mem.h"
 #include "apu.h"
 #include "audio.h"
+#ifndef __LIBRETRO__
+#include "save.h"
+#endif
 #if ZIPSUPPORT
 #include "unzip/unzip.h"
 #endif
@@ -33,8 +42,6 @@
 #define DEBUG_LOAD_INFO 1
 
 const char *VERSION_STRING = "fixGB Alpha v0.8.2";
-static char window_title[256];
-static char window_title_pause[256];
 
 enum {
 	FTYPE_UNK = 0,
@@ -46,54 +53,36 @@ enum {
 #endif
 };
 
-static void gbEmuFileOpen(const char *name);
-static bool gbEmuFileRead();
-static void gbEmuFileClose();
-static void gbEmuResetRegs();
+//state of the file being loaded, lives on the stack of the loader
+typedef struct _romfile_t {
+	FILE *fp;
+#if ZIPSUPPORT
+	bool isZip;
+	unzFile zipObj;
+	unz_file_info zipObjInfo;
+#endif
+} romfile_t;
+
+static void gbEmuFileOpen(gb_t *gb, romfile_t *file, const char *name);
+static bool gbEmuFileRead(gb_t *gb, romfile_t *file);
+static void gbEmuFilePatchHeader(gb_t *gb, romfile_t *file, uint8_t hdrcrc);
+static void gbEmuFileClose(romfile_t *file);
+static void gbEmuFreeROM(gb_t *gb);
+static void gbEmuResetRegs(gb_t *gb);
+#ifndef __LIBRETRO__
 static void gbEmuDisplayFrame(void);
-void gbEmuMainLoop(void);
-void gbEmuDeinit(void);
+static void gbEmuIdle(void);
+static void gbEmuExit(void);
 
 static void gbEmuHandleKeyDown(unsigned char key, int x, int y);
 static void gbEmuHandleKeyUp(unsigned char key, int x, int y);
 static void gbEmuHandleSpecialDown(int key, int x, int y);
 static void gbEmuHandleSpecialUp(int key, int x, int y);
-
-volatile bool emuRenderFrame;
-
-static int emuFileType;
-static char emuFileName[1024];
-uint8_t *emuGBROM = NULL;
-uint32_t emuGBROMsize;
-char emuSaveName[1024];
-bool emuSaveEnabled;
-//used externally
-uint32_t textureImage[0x5A00];
-bool gbPause;
-bool gbEmuGBSPlayback;
-bool gbsTimerMode;
-uint16_t gbsLoadAddr;
-uint16_t gbsInitAddr;
-uint16_t gbsPlayAddr;
-uint32_t gbsRomSize;
-uint16_t gbsSP;
-uint8_t gbsTracksTotal, gbsTMA, gbsTAC;
-uint8_t cpuTimer;
-bool gbCgbGame;
-bool gbCgbMode;
-bool gbCgbBootrom;
-bool gbAllowInvVRAM;
-bool gbIsMulticart;
+#endif
 
 static bool inPause;
 static bool inResize;
 
-//used externally
-bool emuSkipVsync;
-bool emuSkipFrame;
-
-static uint8_t mainClock;
-static uint8_t memClock;
 
 #if WINDOWS_BUILD
 #include <windows.h>
@@ -115,176 +104,215 @@ static DWORD emuMainTotalElapsed = 0;
 #define VISIBLE_DOTS 160
 #define VISIBLE_LINES 144
 
-static uint32_t linesToDraw;
 static const uint32_t visibleImg = VISIBLE_DOTS*VISIBLE_LINES*4;
-static uint8_t scaleFactor;
 #ifndef __LIBRETRO__
 static uint32_t mainLoopRuns;
 static uint16_t mainLoopPos;
 #endif
 
-static FILE *gbEmuFilePointer = NULL;
-#if ZIPSUPPORT
-static bool gbEmuFileIsZip;
-static uint8_t *gbEmuZipBuf = NULL;
-static uint32_t gbEmuZipLen;
-static unzFile gbEmuZipObj;
-static unz_file_info gbEmuZipObjInfo;
+//roms read straight from a file get mapped read-only and shared
+//by every instance that loads the same unchanged file, so they
+//all use the same physical pages, the list and the reference
+//counts are shared by all instances so only touch them locked
+typedef struct _romcache_t {
+	struct _romcache_t *next;
+	char path[1024];
+	//identifies the file version, see gbEmuROMCacheHash
+	uint64_t hash;
+	//header crc got fixed up, only that page is a private copy
+	bool patched;
+	uint32_t refs;
+	uint8_t *data;
+	uint32_t size;
+} romcache_t;
+#if !WINDOWS_BUILD
+static romcache_t *gbEmuROMCacheList = NULL;
+static pthread_mutex_t gbEmuROMCacheLock = PTHREAD_MUTEX_INITIALIZER;
 #endif
+static void gbEmuROMRelease(uint8_t *rom, romcache_t *entry);
 
-//from input.c
-extern uint8_t inValReads[8];
-//from mbc.c
-extern bool rtcUsed;
-extern size_t extTotalSize;
+gb_t *gbEmuCreate()
+{
+	gb_t *gb = calloc(1, sizeof(gb_t));
+	if(!gb)
+	{
+		printf("Main: Could not allocate emulator instance!\n");
+		return NULL;
+	}
+	//defaults used before the first game inits everything
+	gb->cpu.cpuAddSpeed = 1;
+	gb->cpuTimer = 3;
+	gb->emuCatchUp = true;
+	inputInit(gb);
+	return gb;
+}
+
+void gbEmuDestroy(gb_t *gb)
+{
+	if(!gb)
+		return;
+	gbEmuFreeROM(gb);
+	apuDeinitBufs(gb);
+	memDeinit(gb);
+	free(gb);
+}
 
 #ifdef __LIBRETRO__
-int gbEmuLoadGame(const char* filename)
+int gbEmuLoadGame(gb_t *gb, const char* filename)
 {
 	int argc = 2;
 	const char* argv[] = {"fixGB", filename};
 #else
+//instance driven by the GLUT frontend
+static gb_t *gbEmu = NULL;
 int main(int argc, char** argv)
 {
+	gb_t *gb = gbEmu = gbEmuCreate();
+	if(!gb)
+		return EXIT_FAILURE;
 #endif
 	puts(VERSION_STRING);
-	gbEmuResetRegs();
+	gbEmuResetRegs(gb);
+	romfile_t file;
+	memset(&file,0,sizeof(file));
 	if(argc >= 2)
-		gbEmuFileOpen(argv[1]);
-	if(emuFileType == FTYPE_GB || emuFileType == FTYPE_GBC)
+		gbEmuFileOpen(gb, &file, argv[1]);
+	if(gb->emuFileType == FTYPE_GB || gb->emuFileType == FTYPE_GBC)
 	{
-		if(!gbEmuFileRead())
+		if(!gbEmuFileRead(gb, &file))
 		{
-			gbEmuFileClose();
-			printf("Main: Could not read %s!\n", emuFileName);
+			gbEmuFileClose(&file);
+			printf("Main: Could not read %s!\n", gb->emuFileName);
 			puts("Press enter to exit");
 			getc(stdin);
 			return EXIT_SUCCESS;
 		}
-		gbEmuFileClose();
-		memcpy(emuSaveName, emuFileName, 1024);
-		if(emuFileType == FTYPE_GBC)
-			memcpy(emuSaveName+strlen(emuSaveName)-3,"sav",3);
+		memcpy(gb->emuSaveName, gb->emuFileName, 1024);
+		if(gb->emuFileType == FTYPE_GBC)
+			memcpy(gb->emuSaveName+strlen(gb->emuSaveName)-3,"sav",3);
 		else //.gb has one less character
-			memcpy(emuSaveName+strlen(emuSaveName)-2,"sav",3);
-		printf("Save Path: %s\n",emuSaveName); 
+			memcpy(gb->emuSaveName+strlen(gb->emuSaveName)-2,"sav",3);
+		printf("Save Path: %s\n",gb->emuSaveName); 
 		//Set Invalid VRAM allowed
-		gbAllowInvVRAM = (strstr(emuFileName,"InvVRAM") != NULL);
-		printf("Main: Invalid VRAM Access is %sallowed\n", gbAllowInvVRAM?"":"dis");
-		gbCgbBootrom = memInitCGBBootrom();
+		gb->gbAllowInvVRAM = (strstr(gb->emuFileName,"InvVRAM") != NULL);
+		printf("Main: Invalid VRAM Access is %sallowed\n", gb->gbAllowInvVRAM?"":"dis");
+		gb->gbCgbBootrom = memInitCGBBootrom(gb);
 		//Verify Header CRC
 		uint8_t hdrcrc = 0;
 		uint16_t hdrpos;
 		for(hdrpos = 0x134; hdrpos < 0x14D; hdrpos++)
-			hdrcrc = hdrcrc-emuGBROM[hdrpos]-1;
-		if(hdrcrc != emuGBROM[0x14D])
+			hdrcrc = hdrcrc-gb->emuGBROM[hdrpos]-1;
+		if(hdrcrc != gb->emuGBROM[0x14D])
 		{
 			printf("Main: WARNING: Invalid ROM Header CRC, ROM may not work\n");
-			if(gbCgbBootrom)
+			if(gb->gbCgbBootrom)
 			{
 				//Fix Header CRC for Bootrom
-				emuGBROM[0x14D] = hdrcrc;
+				gbEmuFilePatchHeader(gb, &file, hdrcrc);
 			}
 		}
+		gbEmuFileClose(&file);
 		//Set CGB Regs allowed
-		gbCgbGame = (emuGBROM[0x143] == 0x80 || emuGBROM[0x143] == 0xC0);
-		gbCgbMode = (gbCgbGame || gbCgbBootrom);
-		printf("Main: CGB Regs are %sallowed\n", gbCgbMode?"":"dis");
+		gb->gbCgbGame = (gb->emuGBROM[0x143] == 0x80 || gb->emuGBROM[0x143] == 0xC0);
+		gb->gbCgbMode = (gb->gbCgbGame || gb->gbCgbBootrom);
+		printf("Main: CGB Regs are %sallowed\n", gb->gbCgbMode?"":"dis");
 		//Quick multicart check
-		gbIsMulticart = (emuGBROMsize == 0x200000 && strcmp((char*)(emuGBROM+0x134), "QBILLION") == 0);
-		if(!memInit(true,false))
+		gb->gbIsMulticart = (gb->emuGBROMsize == 0x200000 && strcmp((char*)(gb->emuGBROM+0x134), "QBILLION") == 0);
+		if(!memInit(gb, true,false))
 		{
-			free(emuGBROM);
+			gbEmuFreeROM(gb);
 			puts("Press enter to exit");
 			getc(stdin);
 			return EXIT_SUCCESS;
 		}
 		//CPU DMG Mode
-		cpuSetSpeed(false);
-		apuInitBufs();
-		cpuInit();
-		ppuInit();
-		apuInit();
-		inputInit();
-		inputClear();
-		if(emuGBROM[0x134] != 0)
+		cpuSetSpeed(gb, false);
+		apuInitBufs(gb);
+		cpuInit(gb);
+		ppuInit(gb);
+		apuInit(gb);
+		inputInit(gb);
+		inputClear(gb);
+		if(gb->emuGBROM[0x134] != 0)
 		{
-			if(gbCgbMode)
+			if(gb->gbCgbMode)
 			{
-				printf("Game: %.11s\n", (char*)(emuGBROM+0x134));
-				sprintf(window_title, "%.11s (CGB) - %s\n", (char*)(emuGBROM+0x134), VERSION_STRING);
+				printf("Game: %.11s\n", (char*)(gb->emuGBROM+0x134));
+				sprintf(gb->emuWindowTitle, "%.11s (CGB) - %s\n", (char*)(gb->emuGBROM+0x134), VERSION_STRING);
 			}
 			else
 			{
-				printf("Game: %.16s\n", (char*)(emuGBROM+0x134));
-				sprintf(window_title, "%.16s (DMG) - %s\n", (char*)(emuGBROM+0x134), VERSION_STRING);
+				printf("Game: %.16s\n", (char*)(gb->emuGBROM+0x134));
+				sprintf(gb->emuWindowTitle, "%.16s (DMG) - %s\n", (char*)(gb->emuGBROM+0x134), VERSION_STRING);
 			}
 		}
 	}
-	else if(emuFileType == FTYPE_GBS)
+	else if(gb->emuFileType == FTYPE_GBS)
 	{
-		if(!gbEmuFileRead())
+		if(!gbEmuFileRead(gb, &file))
 		{
-			gbEmuFileClose();
-			printf("Main: Could not read %s!\n", emuFileName);
+			gbEmuFileClose(&file);
+			printf("Main: Could not read %s!\n", gb->emuFileName);
 			puts("Press enter to exit");
 			getc(stdin);
 			return EXIT_SUCCESS;
 		}
-		gbEmuFileClose();
-		uint8_t *tmpROM = emuGBROM;
-		uint32_t tmpROMsize = emuGBROMsize;
-		gbsTracksTotal = tmpROM[4];
-		gbsLoadAddr = (tmpROM[6])|(tmpROM[7]<<8);
-		gbsInitAddr = (tmpROM[8])|(tmpROM[9]<<8);
-		gbsPlayAddr = (tmpROM[0xA])|(tmpROM[0xB]<<8);
-		gbsSP = (tmpROM[0xC])|(tmpROM[0xD]<<8);
+		gbEmuFileClose(&file);
+		uint8_t *tmpROM = gb->emuGBROM;
+		romcache_t *tmpROMCache = gb->emuGBROMCache;
+		uint32_t tmpROMsize = gb->emuGBROMsize;
+		gb->emuGBROMCache = NULL;
+		gb->gbsTracksTotal = tmpROM[4];
+		gb->gbsLoadAddr = (tmpROM[6])|(tmpROM[7]<<8);
+		gb->gbsInitAddr = (tmpROM[8])|(tmpROM[9]<<8);
+		gb->gbsPlayAddr = (tmpROM[0xA])|(tmpROM[0xB]<<8);
+		gb->gbsSP = (tmpROM[0xC])|(tmpROM[0xD]<<8);
 		//should give more than enough room for everything
-		gbsRomSize = emuGBROMsize = (tmpROMsize-0x70+gbsLoadAddr+0x7FFF)&(~0x7FFF);
+		gb->gbsRomSize = gb->emuGBROMsize = (tmpROMsize-0x70+gb->gbsLoadAddr+0x7FFF)&(~0x7FFF);
 		//printf("Main: gbsLoadAddr %04x gbsInitAddr %04x gbsPlayAddr %04x gbsSP %04x\n",
 		//	gbsLoadAddr, gbsInitAddr, gbsPlayAddr, gbsSP);
-		emuGBROM = malloc(emuGBROMsize);
-		memset(emuGBROM,0xFF,emuGBROMsize);
-		memcpy(emuGBROM+gbsLoadAddr,tmpROM+0x70,tmpROMsize-0x70);
-		gbsTMA = tmpROM[0xE];
-		gbsTAC = tmpROM[0xF];
-		if(gbsTAC&0x80)
+		gb->emuGBROM = malloc(gb->emuGBROMsize);
+		memset(gb->emuGBROM,0xFF,gb->emuGBROMsize);
+		memcpy(gb->emuGBROM+gb->gbsLoadAddr,tmpROM+0x70,tmpROMsize-0x70);
+		gb->gbsTMA = tmpROM[0xE];
+		gb->gbsTAC = tmpROM[0xF];
+		if(gb->gbsTAC&0x80)
 		{
-			cpuSetSpeed(true);
-			gbCgbGame = gbCgbMode = true;
+			cpuSetSpeed(gb, true);
+			gb->gbCgbGame = gb->gbCgbMode = true;
 		}
 		else
 		{
-			cpuSetSpeed(false);
-			gbCgbGame = gbCgbMode = false;
+			cpuSetSpeed(gb, false);
+			gb->gbCgbGame = gb->gbCgbMode = false;
 		}
-		printf("Main: CGB Regs are %sallowed\n", gbCgbMode?"":"dis");
-		if(gbsTAC&4)
+		printf("Main: CGB Regs are %sallowed\n", gb->gbCgbMode?"":"dis");
+		if(gb->gbsTAC&4)
 		{
 			printf("Main: GBS Play Timing: Timer\n");
-			gbsTimerMode = true;
+			gb->gbsTimerMode = true;
 		}
 		else
 		{
 			printf("Main: GBS Play Timing: VSync\n");
-			gbsTimerMode = false;
+			gb->gbsTimerMode = false;
 		}
-		memInit(true,true);
+		memInit(gb, true,true);
 		if(tmpROM[0x10] != 0)
 		{
 			printf("Game: %.32s\n",(char*)(tmpROM+0x10));
-			sprintf(window_title, "%.32s (GBS) - %s\n", (char*)(tmpROM+0x10), VERSION_STRING);
+			sprintf(gb->emuWindowTitle, "%.32s (GBS) - %s\n", (char*)(tmpROM+0x10), VERSION_STRING);
 		}
-		free(tmpROM);
-		apuInitBufs();
-		inputClear();
+		gbEmuROMRelease(tmpROM, tmpROMCache);
+		apuInitBufs(gb);
+		inputClear(gb);
 		//does all inits for us
-		memStartGBS();
-		gbEmuGBSPlayback = true;
-		linesToDraw = 20;
-		scaleFactor = 4;
+		memStartGBS(gb);
+		gb->gbEmuGBSPlayback = true;
+		gb->emuLinesToDraw = 20;
+		gb->emuScaleFactor = 4;
 	}
-	if(emuGBROM == NULL)
+	if(gb->emuGBROM == NULL)
 	{
 #if ZIPSUPPORT
 		printf("Main: No File to Open! Make sure to call fixGB with a .gb/.gbc/.gbs/.zip File as Argument.\n");
@@ -295,7 +323,7 @@ int main(int argc, char** argv)
 		getc(stdin);
 		return EXIT_SUCCESS;
 	}
-	sprintf(window_title_pause, "%s (Pause)", window_title);
+	sprintf(gb->emuWindowTitlePause, "%s (Pause)", gb->emuWindowTitle);
 	#if WINDOWS_BUILD
 	#if DEBUG_HZ
 	emuFrameStart = GetTickCount();
@@ -309,24 +337,24 @@ int main(int argc, char** argv)
 	mainLoopRuns = 70224;
 	mainLoopPos = mainLoopRuns;
 	glutInit(&argc, argv);
-	glutInitWindowSize(VISIBLE_DOTS*scaleFactor, linesToDraw*scaleFactor);
+	glutInitWindowSize(VISIBLE_DOTS*gb->emuScaleFactor, gb->emuLinesToDraw*gb->emuScaleFactor);
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
-	glutCreateWindow(gbPause ? window_title_pause : window_title);
-	audioInit();
-	atexit(&gbEmuDeinit);
+	glutCreateWindow(gb->gbPause ? gb->emuWindowTitlePause : gb->emuWindowTitle);
+	audioInit(gb);
+	atexit(&gbEmuExit);
 	glutKeyboardFunc(&gbEmuHandleKeyDown);
 	glutKeyboardUpFunc(&gbEmuHandleKeyUp);
 	glutSpecialFunc(&gbEmuHandleSpecialDown);
 	glutSpecialUpFunc(&gbEmuHandleSpecialUp);
 	glutDisplayFunc(&gbEmuDisplayFrame);
-	glutIdleFunc(&gbEmuMainLoop);
+	glutIdleFunc(&gbEmuIdle);
 	#if WINDOWS_BUILD
 	/* Enable OpenGL VSync */
 	wglSwapIntervalEXT = (PFNWGLSWAPINTERVALEXTPROC)wglGetProcAddress("wglSwapIntervalEXT");
 	wglSwapIntervalEXT(1);
 	#endif
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-	glTexImage2D(GL_TEXTURE_2D, 0, 4, VISIBLE_DOTS, linesToDraw, 0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, textureImage);
+	glTexImage2D(GL_TEXTURE_2D, 0, 4, VISIBLE_DOTS, gb->emuLinesToDraw, 0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, gb->textureImage);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -339,57 +367,49 @@ int main(int argc, char** argv)
 	return EXIT_SUCCESS;
 }
 
-static void gbEmuResetRegs()
-{
-	strcpy(window_title, VERSION_STRING);
-
-	emuRenderFrame = false;
-	linesToDraw = VISIBLE_LINES;
-	scaleFactor = 3;
-
-	memset(textureImage,0,visibleImg);
-	emuFileType = FTYPE_UNK;
-	memset(emuFileName,0,1024);
-	memset(emuSaveName,0,1024);
-	emuSaveEnabled = false;
-	if(emuGBROM)
-		free(emuGBROM);
-	emuGBROM = NULL;
-	emuGBROMsize = 0;
-
-	gbPause = false;
-	gbEmuGBSPlayback = false;
-	gbsTimerMode = false;
-	gbsLoadAddr = 0, gbsInitAddr = 0;
-	gbsPlayAddr = 0, gbsRomSize = 0;
-	gbsSP = 0;
-	gbsTracksTotal = 0, gbsTMA = 0, gbsTAC = 0;
-	cpuTimer = 3;
-	gbCgbGame = false;
-	gbCgbMode = false;
-	gbCgbBootrom = false;
-	gbAllowInvVRAM = false;
-	gbIsMulticart = false;
+static void gbEmuResetRegs(gb_t *gb)
+{
+	strcpy(gb->emuWindowTitle, VERSION_STRING);
+
+	gb->emuRenderFrame = false;
+	gb->emuLinesToDraw = VISIBLE_LINES;
+	gb->emuScaleFactor = 3;
+
+	memset(gb->textureImage,0,visibleImg);
+	gb->emuFileType = FTYPE_UNK;
+	memset(gb->emuFileName,0,1024);
+	memset(gb->emuSaveName,0,1024);
+	gb->emuSaveEnabled = false;
+	gbEmuFreeROM(gb);
+	gb->emuGBROMsize = 0;
+
+	gb->gbPause = false;
+	gb->gbEmuGBSPlayback = false;
+	gb->gbsTimerMode = false;
+	gb->gbsLoadAddr = 0, gb->gbsInitAddr = 0;
+	gb->gbsPlayAddr = 0, gb->gbsRomSize = 0;
+	gb->gbsSP = 0;
+	gb->gbsTracksTotal = 0, gb->gbsTMA = 0, gb->gbsTAC = 0;
+	gb->cpuTimer = 3;
+	gb->gbCgbGame = false;
+	gb->gbCgbMode = false;
+	gb->gbCgbBootrom = false;
+	gb->gbAllowInvVRAM = false;
+	gb->gbIsMulticart = false;
 
 	inPause = false;
 	inResize = false;
 
-	emuSkipVsync = false;
-	emuSkipFrame = false;
+	gb->emuSkipVsync = false;
+	gb->emuSkipFrame = false;
 
-	mainClock = 0;
-	memClock = 0;
-
-	if(gbEmuFilePointer)
-		fclose(gbEmuFilePointer);
-	gbEmuFilePointer = NULL;
-#if ZIPSUPPORT
-	gbEmuFileIsZip = false;
-	if(gbEmuZipBuf)
-		free(gbEmuZipBuf);
-	gbEmuZipBuf = NULL;
-	gbEmuZipLen = 0;
-#endif
+	gb->mainClock = 0;
+	gb->memClock = 0;
+	gb->emuPreDone = false;
+	gb->emuClocksAhead = 0;
+	gb->emuClock = 0;
+	memset(gb->emuEventTime,0,sizeof(gb->emuEventTime));
+	gb->emuNextEvent = 0;
 }
 
 static int gbEmuGetFileType(const char *name)
@@ -414,49 +434,37 @@ static int gbEmuGetFileType(const char *name)
 	return FTYPE_UNK;
 }
 
-static void gbEmuFileOpen(const char *name)
+static void gbEmuFileOpen(gb_t *gb, romfile_t *file, const char *name)
 {
-	emuFileType = FTYPE_UNK;
-	memset(emuFileName,0,1024);
-	memset(emuSaveName,0,1024);
+	gb->emuFileType = FTYPE_UNK;
+	memset(gb->emuFileName,0,1024);
+	memset(gb->emuSaveName,0,1024);
 	int baseType = gbEmuGetFileType(name);
 #if ZIPSUPPORT
 	if(baseType == FTYPE_ZIP)
 	{
 		printf("Base ZIP File: %s\n", name);
-		FILE *tmp = fopen(name,"rb");
-		if(!tmp)
+		//reads straight from the archive file as needed
+		zlib_filefunc_def zipFuncs;
+		fill_fd_filefunc(&zipFuncs);
+		file->zipObj = unzOpen2(name, &zipFuncs);
+		if(!file->zipObj)
 		{
 			printf("Main: Could not open %s!\n", name);
 			return;
 		}
-		fseek(tmp,0,SEEK_END);
-		gbEmuZipLen = ftell(tmp);
-		rewind(tmp);
-		gbEmuZipBuf = malloc(gbEmuZipLen);
-		if(!gbEmuZipBuf)
-		{
-			printf("Main: Could not allocate ZIP buffer!\n");
-			fclose(tmp);
-			return;
-		}
-		fread(gbEmuZipBuf,1,gbEmuZipLen,tmp);
-		fclose(tmp);
-		char filepath[20];
-		snprintf(filepath,20,"%x+%x",(unsigned int)gbEmuZipBuf,gbEmuZipLen);
-		gbEmuZipObj = unzOpen(filepath);
-		int err = unzGoToFirstFile(gbEmuZipObj);
+		int err = unzGoToFirstFile(file->zipObj);
 		while (err == UNZ_OK)
 		{
 			char tmpName[256];
-			err = unzGetCurrentFileInfo(gbEmuZipObj,&gbEmuZipObjInfo,tmpName,256,NULL,0,NULL,0);
+			err = unzGetCurrentFileInfo(file->zipObj,&file->zipObjInfo,tmpName,256,NULL,0,NULL,0);
 			if(err == UNZ_OK)
 			{
 				int curInZipType = gbEmuGetFileType(tmpName);
 				if(curInZipType != FTYPE_ZIP && curInZipType != FTYPE_UNK)
 				{
-					emuFileType = curInZipType;
-					gbEmuFileIsZip = true;
+					gb->emuFileType = curInZipType;
+					file->isZip = true;
 					if(strchr(name,'/') != NULL || strchr(name,'\\') != NULL)
 					{
 						const char *nPath = name;
@@ -464,30 +472,26 @@ static void gbEmuFileOpen(const char *name)
 							nPath = (strrchr(nPath,'/')+1);
 						if(strchr(nPath,'\\') != NULL)
 							nPath = (strrchr(nPath,'\\')+1);
-						strncpy(emuFileName, name, nPath-name);
+						strncpy(gb->emuFileName, name, nPath-name);
 					}
 					char *zName = tmpName;
 					if(strchr(zName,'/') != NULL)
 						zName = (strrchr(zName,'/')+1);
 					if(strchr(zName,'\\') != NULL)
 						zName = (strrchr(zName,'\\')+1);
-					strcat(emuFileName, zName);
-					printf("File in ZIP Type: %s\n", emuFileType == FTYPE_GB ? "GB" : (emuFileType == FTYPE_GBC ? "GBC" : "GBS"));
-					printf("Full Path from ZIP: %s\n", emuFileName);
+					strcat(gb->emuFileName, zName);
+					printf("File in ZIP Type: %s\n", gb->emuFileType == FTYPE_GB ? "GB" : (gb->emuFileType == FTYPE_GBC ? "GBC" : "GBS"));
+					printf("Full Path from ZIP: %s\n", gb->emuFileName);
 					break;
 				}
 				else
-					err = unzGoToNextFile(gbEmuZipObj);
+					err = unzGoToNextFile(file->zipObj);
 			}
 		}
-		if(emuFileType == FTYPE_UNK)
+		if(gb->emuFileType == FTYPE_UNK)
 		{
 			printf("Found no usable file in ZIP\n");
-			unzClose(gbEmuZipObj);
-			if(gbEmuZipBuf)
-				free(gbEmuZipBuf);
-			gbEmuZipBuf = NULL;
-			gbEmuZipLen = 0;
+			unzClose(file->zipObj);
 		}
 	}
 	else if(baseType != FTYPE_UNK)
@@ -495,94 +499,484 @@ static void gbEmuFileOpen(const char *name)
 	if(baseType != FTYPE_UNK)
 #endif
 	{
-		gbEmuFilePointer = fopen(name,"rb");
-		if(!gbEmuFilePointer)
+		file->fp = fopen(name,"rb");
+		if(!file->fp)
 			printf("Main: Could not open %s!\n", name);
 		else
 		{
-			emuFileType = baseType;
-			strncpy(emuFileName, name, 1024);
+			gb->emuFileType = baseType;
+			strncpy(gb->emuFileName, name, 1024);
 			printf("File Type: %s\n", baseType == FTYPE_GB ? "GB" : (baseType == FTYPE_GBC ? "GBC" : "GBS"));
-			printf("Full Path: %s\n", emuFileName);
+			printf("Full Path: %s\n", gb->emuFileName);
 		}
 	}
 }
 
-static bool gbEmuFileRead()
+#if !WINDOWS_BUILD
+//identifies a file version without reading it, a rom that got
+//changed on disk gets a new entry instead of reusing the old one
+static uint64_t gbEmuROMCacheHash(const struct stat *st)
 {
+	uint64_t vals[4] = { (uint64_t)st->st_dev, (uint64_t)st->st_ino, (uint64_t)st->st_size, (uint64_t)st->st_mtime };
+	const uint8_t *p = (const uint8_t*)vals;
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	size_t i;
+	for(i = 0; i < sizeof(vals); i++)
+		hash = (hash^p[i])*0x100000001B3ULL;
+	return hash;
+}
+#endif
+
+//returns a new reference to the cached rom of the opened file,
+//patched ones have hdrcrc written to 0x14D, NULL if the file
+//can not be mapped and has to be read into a private copy
+static romcache_t *gbEmuROMCacheGet(FILE *fp, const char *path, bool patched, uint8_t hdrcrc)
+{
+#if !WINDOWS_BUILD
+	struct stat st;
+	int fd = fileno(fp);
+	if(fstat(fd,&st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 0x150 || st.st_size > UINT32_MAX)
+		return NULL;
+	uint64_t hash = gbEmuROMCacheHash(&st);
+	//held while mapping too so two loads of one rom share an entry
+	pthread_mutex_lock(&gbEmuROMCacheLock);
+	romcache_t *entry;
+	for(entry = gbEmuROMCacheList; entry; entry = entry->next)
+	{
+		if(entry->hash == hash && entry->patched == patched && strcmp(entry->path,path) == 0)
+		{
+			entry->refs++;
+			pthread_mutex_unlock(&gbEmuROMCacheLock);
+			return entry;
+		}
+	}
+	//private mapping, so writes only ever copy the page they hit
+	uint8_t *data = mmap(NULL, st.st_size, patched ? (PROT_READ|PROT_WRITE) : PROT_READ, MAP_PRIVATE, fd, 0);
+	if(data == MAP_FAILED)
+	{
+		pthread_mutex_unlock(&gbEmuROMCacheLock);
+		return NULL;
+	}
+	if(patched)
+	{
+		data[0x14D] = hdrcrc;
+		mprotect(data, st.st_size, PROT_READ);
+	}
+	entry = calloc(1, sizeof(romcache_t));
+	if(!entry)
+	{
+		pthread_mutex_unlock(&gbEmuROMCacheLock);
+		munmap(data, st.st_size);
+		return NULL;
+	}
+	strncpy(entry->path, path, sizeof(entry->path)-1);
+	entry->hash = hash;
+	entry->patched = patched;
+	entry->refs = 1;
+	entry->data = data;
+	entry->size = st.st_size;
+	entry->next = gbEmuROMCacheList;
+	gbEmuROMCacheList = entry;
+	pthread_mutex_unlock(&gbEmuROMCacheLock);
+	return entry;
+#else
+	(void)fp; (void)path; (void)patched; (void)hdrcrc;
+	return NULL;
+#endif
+}
+
+//drops a rom, either a cache reference or a private copy
+static void gbEmuROMRelease(uint8_t *rom, romcache_t *entry)
+{
+	if(!entry)
+	{
+		if(rom)
+			free(rom);
+		return;
+	}
+	//only mapped roms ever get an entry
+#if !WINDOWS_BUILD
+	pthread_mutex_lock(&gbEmuROMCacheLock);
+	if(--entry->refs)
+	{
+		pthread_mutex_unlock(&gbEmuROMCacheLock);
+		return;
+	}
+	romcache_t **prev = &gbEmuROMCacheList;
+	while(*prev != entry)
+		prev = &(*prev)->next;
+	*prev = entry->next;
+	pthread_mutex_unlock(&gbEmuROMCacheLock);
+	munmap(entry->data, entry->size);
+	free(entry);
+#endif
+}
+
+static void gbEmuFreeROM(gb_t *gb)
+{
+	gbEmuROMRelease(gb->emuGBROM, gb->emuGBROMCache);
+	gb->emuGBROM = NULL;
+	gb->emuGBROMCache = NULL;
+}
+
 #if ZIPSUPPORT
-	if(gbEmuFileIsZip)
+//extracted roms get kept in here if the directory exists, named
+//after their crc32 and size, so opening the same zip again maps
+//the rom from there instead of extracting it all over again
+#define ZIP_CACHE_DIR "zipcache"
+
+static void gbEmuZipCachePath(romfile_t *file, char *path, size_t len)
+{
+	snprintf(path, len, "%s/%08lx-%08lx.bin", ZIP_CACHE_DIR,
+		(unsigned long)file->zipObjInfo.crc, (unsigned long)file->zipObjInfo.uncompressed_size);
+}
+
+//decompresses straight into the rom buffer, then tries to store
+//a copy in the cache directory for the next time
+static bool gbEmuZipExtract(gb_t *gb, romfile_t *file, const char *cachePath)
+{
+	if(unzOpenCurrentFile(file->zipObj) != UNZ_OK)
+	{
+		printf("Main: Could not extract ROM!\n");
+		return false;
+	}
+	gb->emuGBROMsize = file->zipObjInfo.uncompressed_size;
+	gb->emuGBROM = malloc(gb->emuGBROMsize);
+	if(!gb->emuGBROM)
+	{
+		unzCloseCurrentFile(file->zipObj);
+		printf("Main: Could not allocate ROM buffer!\n");
+		return false;
+	}
+	bool ok = (unzReadCurrentFile(file->zipObj,gb->emuGBROM,gb->emuGBROMsize) == (int)gb->emuGBROMsize);
+	//also verifies the crc once everything got read
+	if(unzCloseCurrentFile(file->zipObj) != UNZ_OK)
+		ok = false;
+	if(!ok)
+	{
+		gbEmuFreeROM(gb);
+		printf("Main: Could not extract ROM!\n");
+		return false;
+	}
+#ifndef __LIBRETRO__
+	//written next to the old one and moved over it like a save,
+	//so a cached rom is never partial
+	FILE *f = saveFileOpen(cachePath);
+	if(f)
+	{
+		fwrite(gb->emuGBROM,1,gb->emuGBROMsize,f);
+		if(saveFileCommit(f, cachePath))
+			printf("Main: Cached ROM as %s\n", cachePath);
+	}
+#else
+	(void)cachePath;
+#endif
+	return true;
+}
+
+//the name only says what the rom should be, a cached file that got
+//damaged on disk has to match the crc32 stored in the zip as well
+static bool gbEmuZipCacheValid(gb_t *gb, romfile_t *file)
+{
+	return crc32(0, gb->emuGBROM, gb->emuGBROMsize) == file->zipObjInfo.crc;
+}
+#endif
+
+static bool gbEmuFileRead(gb_t *gb, romfile_t *file)
+{
+	const char *path = gb->emuFileName;
+#if ZIPSUPPORT
+	char cachePath[64];
+	if(file->isZip)
+	{
+		gbEmuZipCachePath(file, cachePath, sizeof(cachePath));
+		file->fp = fopen(cachePath,"rb");
+		if(file->fp)
+		{
+			fseek(file->fp,0,SEEK_END);
+			if((unsigned long)ftell(file->fp) != file->zipObjInfo.uncompressed_size)
+			{
+				fclose(file->fp);
+				file->fp = NULL;
+			}
+		}
+		if(!file->fp)
+			return gbEmuZipExtract(gb, file, cachePath);
+		//read it like any other file from here on
+		printf("Main: Using cached ROM %s\n", cachePath);
+		path = cachePath;
+	}
+#endif
+	gb->emuGBROMCache = gbEmuROMCacheGet(file->fp, path, false, 0);
+	if(gb->emuGBROMCache)
 	{
-		unzOpenCurrentFile(gbEmuZipObj);
-		emuGBROMsize = gbEmuZipObjInfo.uncompressed_size;
-		emuGBROM = malloc(emuGBROMsize);
-		if(emuGBROM)
-			unzReadCurrentFile(gbEmuZipObj,emuGBROM,emuGBROMsize);
-		unzCloseCurrentFile(gbEmuZipObj);
+		gb->emuGBROM = gb->emuGBROMCache->data;
+		gb->emuGBROMsize = gb->emuGBROMCache->size;
 	}
 	else
+	{
+		fseek(file->fp,0,SEEK_END);
+		gb->emuGBROMsize = ftell(file->fp);
+		rewind(file->fp);
+		gb->emuGBROM = malloc(gb->emuGBROMsize);
+		if(!gb->emuGBROM)
+		{
+			printf("Main: Could not allocate ROM buffer!\n");
+			return false;
+		}
+		fread(gb->emuGBROM,1,gb->emuGBROMsize,file->fp);
+	}
+#if ZIPSUPPORT
+	if(file->isZip && !gbEmuZipCacheValid(gb, file))
+	{
+		printf("Main: Cached ROM %s is damaged, extracting it again\n", cachePath);
+		gbEmuFreeROM(gb);
+		fclose(file->fp);
+		file->fp = NULL;
+		return gbEmuZipExtract(gb, file, cachePath);
+	}
 #endif
+	return true;
+}
+
+//writes the fixed header crc, a cached rom gets swapped for
+//the patched version so other instances keep the original
+static void gbEmuFilePatchHeader(gb_t *gb, romfile_t *file, uint8_t hdrcrc)
+{
+	if(!gb->emuGBROMCache)
 	{
-		fseek(gbEmuFilePointer,0,SEEK_END);
-		emuGBROMsize = ftell(gbEmuFilePointer);
-		rewind(gbEmuFilePointer);
-		emuGBROM = malloc(emuGBROMsize);
-		if(emuGBROM)
-			fread(emuGBROM,1,emuGBROMsize,gbEmuFilePointer);
+		gb->emuGBROM[0x14D] = hdrcrc;
+		return;
 	}
-	if(emuGBROM)
-		return true;
-	//else
-	printf("Main: Could not allocate ROM buffer!\n");
-	return false;
+	romcache_t *patched = gbEmuROMCacheGet(file->fp, gb->emuGBROMCache->path, true, hdrcrc);
+	if(!patched)
+	{
+		//fall back to a private copy of the whole rom
+		uint8_t *rom = malloc(gb->emuGBROMsize);
+		if(!rom)
+			return;
+		memcpy(rom, gb->emuGBROM, gb->emuGBROMsize);
+		rom[0x14D] = hdrcrc;
+		gbEmuFreeROM(gb);
+		gb->emuGBROM = rom;
+		return;
+	}
+	gbEmuFreeROM(gb);
+	gb->emuGBROMCache = patched;
+	gb->emuGBROM = patched->data;
 }
 
 //cleans up vars from read
-static void gbEmuFileClose()
+static void gbEmuFileClose(romfile_t *file)
 {
 #if ZIPSUPPORT
-	if(gbEmuFileIsZip)
-		unzClose(gbEmuZipObj);
-	gbEmuFileIsZip = false;
-	if(gbEmuZipBuf)
-		free(gbEmuZipBuf);
-	gbEmuZipBuf = NULL;
-	gbEmuZipLen = 0;
+	if(file->isZip)
+		unzClose(file->zipObj);
+	file->isZip = false;
 #endif
-	if(gbEmuFilePointer)
-		fclose(gbEmuFilePointer);
-	gbEmuFilePointer = NULL;
+	if(file->fp)
+		fclose(file->fp);
+	file->fp = NULL;
 }
 
-void gbEmuDeinit(void)
+void gbEmuDeinit(gb_t *gb)
 {
 	//printf("\n");
-	emuRenderFrame = false;
+	gb->emuRenderFrame = false;
 	audioDeinit();
-	apuDeinitBufs();
-	if(emuGBROM != NULL)
-		free(emuGBROM);
-	emuGBROM = NULL;
+	apuDeinitBufs(gb);
+	gbEmuFreeROM(gb);
 #ifndef __LIBRETRO__
-	memSaveGame();
+	memSaveGame(gb);
 #endif
-	emuFileType = FTYPE_UNK;
-	memset(emuFileName,0,1024);
-	memset(emuSaveName,0,1024);
-	extTotalSize = 0;
-	rtcUsed = false;
-	memDeinit();
-	gbIsMulticart = false;
+	gb->emuFileType = FTYPE_UNK;
+	memset(gb->emuFileName,0,1024);
+	memset(gb->emuSaveName,0,1024);
+	gb->mbc.extTotalSize = 0;
+	gb->mbc.rtcUsed = false;
+	memDeinit(gb);
+	gb->gbIsMulticart = false;
 	//printf("Bye!\n");
 }
 
-void gbEmuMainLoop(void)
+//clocked before the cpu, returns false if audio is full
+static inline bool gbEmuClockPre(gb_t *gb)
+{
+	//run APU first to make sure its synced
+	#ifndef __LIBRETRO__
+	if(!(gb->mainClock&15) && !apuCycle(gb))
+		return false;
+	#else
+	if(!(gb->mainClock&15))
+		apuCycle(gb);
+	#endif
+	//channel timer updates
+	apuClockTimers(gb);
+	//timer only has to run when tima overflows,
+	//reads and writes bring it up to date on their own
+	if(gb->emuClock >= gb->mem.timerNextClock)
+		memTimerRunTo(gb, gb->emuClock+1);
+	//run possible DMA next, the counter stays at 16 while idle
+	if(gb->mem.cgbDmaActive || gb->cpu.cpuDmaHalt || gb->mem.memDmaClock < 16)
+		memClockDma(gb);
+	return true;
+}
+
+static void gbEmuFrameDone(gb_t *gb)
+{
+	gb->emuRenderFrame = true;
+	//update console stats if requested
+	#if (WINDOWS_BUILD && DEBUG_HZ)
+	emuTimesCalled++;
+	DWORD end = GetTickCount();
+	emuTotalElapsed += end - emuFrameStart;
+	if(emuTotalElapsed >= 1000)
+	{
+		printf("\r%iHz   ", emuTimesCalled);
+		emuTimesCalled = 0;
+		emuTotalElapsed = 0;
+	}
+	emuFrameStart = end;
+	#endif
+	#ifndef __LIBRETRO__
+	glutPostRedisplay();
+	saveJournalFrame(gb);
+	#endif
+	//send VSync to GBS Player if required
+	if(gb->gbEmuGBSPlayback && !gb->gbsTimerMode)
+		cpuPlayGBS(gb);
+}
+
+//clocked after the cpu, returns true once a frame is done
+static inline bool gbEmuClockPost(gb_t *gb, bool cpuClocked)
+{
+	//mem clock tied to CPU clock, so
+	//double speed in CGB mode!
+	if(cpuClocked)
+	{
+		if(!(gb->memClock&3))
+			memClockTimers(gb);
+		gb->memClock++;
+	}
+	//run PPU last
+	ppuCycle(gb);
+	bool frameDone = ppuDrawDone(gb);
+	if(frameDone)
+		gbEmuFrameDone(gb);
+	gb->mainClock++;
+	gb->emuClock++;
+	return frameDone;
+}
+
+//asks every part when it needs the cpu to wait for it next,
+//only valid while everything is synced up to gb->emuClock
+void gbEmuReschedule(gb_t *gb)
+{
+	uint32_t frameLeft = ppuFrameClocksLeft(gb);
+	gb->emuEventTime[EMU_EVENT_PPU] = ppuNextEvent(gb);
+	memTimerRunTo(gb, gb->emuClock + gb->emuPreDone);
+	gb->emuEventTime[EMU_EVENT_TIMER] = memTimerNextEvent(gb);
+	gb->emuEventTime[EMU_EVENT_SERIAL] = memSerialNextEvent(gb);
+	gb->emuEventTime[EMU_EVENT_HDMA] = gb->mem.cgbDmaActive ? 0 : EMU_EVENT_NONE;
+	gb->emuEventTime[EMU_EVENT_APU] = apuNextEvent(gb);
+	//frame has to end exactly where it would normally
+	gb->emuEventTime[EMU_EVENT_FRAME] = (frameLeft == EMU_EVENT_NONE) ? EMU_EVENT_NONE :
+		((frameLeft > 32) ? frameLeft-32 : 0);
+	uint8_t i;
+	gb->emuNextEvent = UINT64_MAX;
+	for(i = 0; i < EMU_EVENT_MAX; i++)
+	{
+		uint64_t clocks = gb->emuEventTime[i];
+		gb->emuEventTime[i] = (clocks == EMU_EVENT_NONE) ? UINT64_MAX : gb->emuClock+clocks;
+		if(gb->emuEventTime[i] < gb->emuNextEvent)
+			gb->emuNextEvent = gb->emuEventTime[i];
+	}
+}
+
+//the cpu may only run ahead if nothing needs it clocked along
+static inline bool gbEmuCanRunAhead(gb_t *gb)
+{
+	if(!gb->emuCatchUp || gb->gbEmuGBSPlayback || ((gb->mainClock+gb->emuClocksAhead)&gb->cpuTimer))
+		return false;
+	if(gb->cpu.cpuDmaHalt || gb->cpu.cpu_oam_dma || gb->cpu.cpu_oam_dma_running || gb->mem.cgbDmaActive)
+		return false;
+	//speed switch changes the cpu clock rate
+	if(gb->cpu.curInstr == 0x10)
+		return false;
+	//close to frame end or waiting on audio
+	uint64_t cpuClock = gb->emuClock+gb->emuClocksAhead;
+	return (cpuClock < gb->emuEventTime[EMU_EVENT_FRAME] && cpuClock < gb->emuEventTime[EMU_EVENT_APU]);
+}
+
+//runs everything but the cpu for the clocks it got ahead, with
+//sync set pre also gets run for the clock the cpu is on right now
+static bool gbEmuRunAhead(gb_t *gb, bool sync)
+{
+	bool frameDone = false;
+	if(gb->mem.cgbDmaActive)
+	{
+		//dma checks the ppu mode, so go clock by clock
+		while(gb->emuClocksAhead)
+		{
+			if(!gb->emuPreDone)
+				gbEmuClockPre(gb);
+			gb->emuPreDone = false;
+			gb->emuClocksAhead--;
+			frameDone |= gbEmuClockPost(gb, !(gb->mainClock&gb->cpuTimer));
+		}
+		if(sync)
+		{
+			gbEmuClockPre(gb);
+			gb->emuPreDone = true;
+		}
+		return frameDone;
+	}
+	uint32_t clocks = gb->emuClocksAhead;
+	uint32_t preClocks = clocks - gb->emuPreDone + sync;
+	apuCatchUp(gb, gb->mainClock + gb->emuPreDone, preClocks);
+	memDmaCatchUp(gb, preClocks);
+	memTimerRunTo(gb, gb->emuClock + clocks + sync);
+	//mem clock tied to CPU clock, so
+	//double speed in CGB mode!
+	uint32_t first = ((gb->cpuTimer+1) - (gb->mainClock&gb->cpuTimer))&gb->cpuTimer;
+	uint32_t cpuClocks = (clocks > first) ? ((clocks-first-1)/(gb->cpuTimer+1))+1 : 0;
+	while(cpuClocks--)
+	{
+		if(!(gb->memClock&3))
+			memClockTimers(gb);
+		gb->memClock++;
+	}
+	ppuCatchUp(gb, clocks);
+	gb->mainClock += clocks;
+	gb->emuClock += clocks;
+	if(ppuDrawDone(gb))
+	{
+		gbEmuFrameDone(gb);
+		frameDone = true;
+	}
+	gb->emuClocksAhead = 0;
+	gb->emuPreDone = sync;
+	return frameDone;
+}
+
+//brings everything up to the clock the cpu is on right now,
+//called by the cpu before it touches anything timing related
+void gbEmuCatchUp(gb_t *gb)
+{
+	if(gb->emuClocksAhead || !gb->emuPreDone)
+	{
+		gbEmuRunAhead(gb, true);
+		gbEmuReschedule(gb);
+	}
+}
+
+void gbEmuMainLoop(gb_t *gb)
 {
 	//do one scanline loop
 	do
 	{
 		#ifndef __LIBRETRO__
-		if((!emuSkipVsync && emuRenderFrame) || gbPause)
+		if((!gb->emuSkipVsync && gb->emuRenderFrame) || gb->gbPause)
 		{
 			#if (WINDOWS_BUILD && DEBUG_MAIN_CALLS)
 			emuMainTimesSkipped++;
@@ -590,8 +984,30 @@ void gbEmuMainLoop(void)
 			audioSleep();
 			return;
 		}
-		//run APU first to make sure its synced
-		if(!(mainClock&15) && !apuCycle())
+		#endif
+		if(!gb->emuClocksAhead && gb->emuCatchUp)
+		{
+			gbEmuReschedule(gb);
+			//run the cpu ahead until the next event is due
+			while(gbEmuCanRunAhead(gb))
+			{
+				cpuRunInstr(gb);
+				if(gb->emuClock+gb->emuClocksAhead >= gb->emuNextEvent)
+					break;
+			}
+		}
+		if(gb->emuClocksAhead)
+		{
+			//catch up to the cpu
+			#ifndef __LIBRETRO__
+			//count all of them against this loop
+			uint32_t clocks = gb->emuClocksAhead;
+			mainLoopPos = (mainLoopPos >= clocks) ? (mainLoopPos-clocks+1) : 0;
+			#endif
+			gbEmuRunAhead(gb, false);
+			continue;
+		}
+		if(!gbEmuClockPre(gb))
 		{
 			#if (WINDOWS_BUILD && DEBUG_MAIN_CALLS)
 			emuMainTimesSkipped++;
@@ -599,58 +1015,18 @@ void gbEmuMainLoop(void)
 			audioSleep();
 			return;
 		}
-		#else
-		//run APU first to make sure its synced
-		if(!(mainClock&15))
-			apuCycle();
-		#endif
-		//channel timer updates
-		apuClockTimers();
-		//run possible DMA next
-		memDmaClockTimers();
 		//run CPU (and mem clocks) next
-		if(!(mainClock&cpuTimer))
-		{
-			//main CPU clock
-			cpuCycle();
-			//mem clock tied to CPU clock, so
-			//double speed in CGB mode!
-			if(!(memClock&3))
-				memClockTimers();
-			memClock++;
-		}
+		bool cpuClocked = !(gb->mainClock&gb->cpuTimer);
+		if(cpuClocked)
+			cpuCycle(gb);
 		//run PPU last
-		ppuCycle();
-		if(ppuDrawDone())
-		{
-			emuRenderFrame = true;
-			//update console stats if requested
-			#if (WINDOWS_BUILD && DEBUG_HZ)
-			emuTimesCalled++;
-			DWORD end = GetTickCount();
-			emuTotalElapsed += end - emuFrameStart;
-			if(emuTotalElapsed >= 1000)
-			{
-				printf("\r%iHz   ", emuTimesCalled);
-				emuTimesCalled = 0;
-				emuTotalElapsed = 0;
-			}
-			emuFrameStart = end;
-			#endif
-			#ifndef __LIBRETRO__
-			glutPostRedisplay();
-			#endif
-			//send VSync to GBS Player if required
-			if(gbEmuGBSPlayback && !gbsTimerMode)
-				cpuPlayGBS();
-		}
-		mainClock++;
+		gbEmuClockPost(gb, cpuClocked);
 	}
 	#ifndef __LIBRETRO__
 	while(mainLoopPos--);
 	mainLoopPos = mainLoopRuns;
 	#else
-	while(emuRenderFrame == false) ;
+	while(gb->emuRenderFrame == false) ;
 	#endif
 	//update console stats if requested
 	#if (WINDOWS_BUILD && DEBUG_MAIN_CALLS)
@@ -668,8 +1044,21 @@ void gbEmuMainLoop(void)
 	#endif
 }
 #ifndef __LIBRETRO__
+static void gbEmuIdle(void)
+{
+	gbEmuMainLoop(gbEmu);
+}
+
+static void gbEmuExit(void)
+{
+	gbEmuDeinit(gbEmu);
+	gbEmuDestroy(gbEmu);
+	gbEmu = NULL;
+}
+
 static void gbEmuHandleKeyDown(unsigned char key, int x, int y)
 {
+	gb_t *gb = gbEmu;
 	(void)x;
 	(void)y;
 	switch (key)
@@ -679,34 +1068,34 @@ static void gbEmuHandleKeyDown(unsigned char key, int x, int y)
 		case 'Y':
 		case 'Z':
 			#if DEBUG_KEY
-			if(inValReads[BUTTON_A]==0)
+			if(gb->input.inValReads[BUTTON_A]==0)
 				printf("a\n");
 			#endif
-			inValReads[BUTTON_A]=1;
+			gb->input.inValReads[BUTTON_A]=1;
 			break;
 		case 'x':
 		case 'X':
 			#if DEBUG_KEY
-			if(inValReads[BUTTON_B]==0)
+			if(gb->input.inValReads[BUTTON_B]==0)
 				printf("b\n");
 			#endif
-			inValReads[BUTTON_B]=1;
+			gb->input.inValReads[BUTTON_B]=1;
 			break;
 		case 's':
 		case 'S':
 			#if DEBUG_KEY
-			if(inValReads[BUTTON_SELECT]==0)
+			if(gb->input.inValReads[BUTTON_SELECT]==0)
 				printf("sel\n");
 			#endif
-			inValReads[BUTTON_SELECT]=1;
+			gb->input.inValReads[BUTTON_SELECT]=1;
 			break;
 		case 'a':
 		case 'A':
 			#if DEBUG_KEY
-			if(inValReads[BUTTON_START]==0)
+			if(gb->input.inValReads[BUTTON_START]==0)
 				printf("start\n");
 			#endif
-			inValReads[BUTTON_START]=1;
+			gb->input.inValReads[BUTTON_START]=1;
 			break;
 		case '\x1B': //Escape
 			//memDumpMainMem();
@@ -720,71 +1109,71 @@ static void gbEmuHandleKeyDown(unsigned char key, int x, int y)
 				printf("pause\n");
 				#endif
 				inPause = true;
-				gbPause ^= true;
-				glutSetWindowTitle(gbPause ? window_title_pause : window_title);
+				gb->gbPause ^= true;
+				glutSetWindowTitle(gb->gbPause ? gb->emuWindowTitlePause : gb->emuWindowTitle);
 			}
 			break;
 		case '1':
 			if(!inResize)
 			{
 				inResize = true;
-				glutReshapeWindow(VISIBLE_DOTS*1, linesToDraw*1);
+				glutReshapeWindow(VISIBLE_DOTS*1, gb->emuLinesToDraw*1);
 			}
 			break;
 		case '2':
 			if(!inResize)
 			{
 				inResize = true;
-				glutReshapeWindow(VISIBLE_DOTS*2, linesToDraw*2);
+				glutReshapeWindow(VISIBLE_DOTS*2, gb->emuLinesToDraw*2);
 			}
 			break;
 		case '3':
 			if(!inResize)
 			{
 				inResize = true;
-				glutReshapeWindow(VISIBLE_DOTS*3, linesToDraw*3);
+				glutReshapeWindow(VISIBLE_DOTS*3, gb->emuLinesToDraw*3);
 			}
 			break;
 		case '4':
 			if(!inResize)
 			{
 				inResize = true;
-				glutReshapeWindow(VISIBLE_DOTS*4, linesToDraw*4);
+				glutReshapeWindow(VISIBLE_DOTS*4, gb->emuLinesToDraw*4);
 			}
 			break;
 		case '5':
 			if(!inResize)
 			{
 				inResize = true;
-				glutReshapeWindow(VISIBLE_DOTS*5, linesToDraw*5);
+				glutReshapeWindow(VISIBLE_DOTS*5, gb->emuLinesToDraw*5);
 			}
 			break;
 		case '6':
 			if(!inResize)
 			{
 				inResize = true;
-				glutReshapeWindow(VISIBLE_DOTS*6, linesToDraw*6);
+				glutReshapeWindow(VISIBLE_DOTS*6, gb->emuLinesToDraw*6);
 			}
 			break;
 		case '7':
 			if(!inResize)
 			{
 				inResize = true;
-				glutReshapeWindow(VISIBLE_DOTS*7, linesToDraw*7);
+				glutReshapeWindow(VISIBLE_DOTS*7, gb->emuLinesToDraw*7);
 			}
 			break;
 		case '8':
 			if(!inResize)
 			{
 				inResize = true;
-				glutReshapeWindow(VISIBLE_DOTS*8, linesToDraw*8);
+				glutReshapeWindow(VISIBLE_DOTS*8, gb->emuLinesToDraw*8);
 			}
 			break;
 		case '9':
 			if(!inResize)
 			{
 				inResize = true;
-				glutReshapeWindow(VISIBLE_DOTS*9, linesToDraw*9);
+				glutReshapeWindow(VISIBLE_DOTS*9, gb->emuLinesToDraw*9);
 			}
 			break;
 		default:
@@ -794,6 +1183,7 @@ static void gbEmuHandleKeyDown(unsigned char key, int x, int y)
 
 static void gbEmuHandleKeyUp(unsigned char key, int x, int y)
 {
+	gb_t *gb = gbEmu;
 	(void)x;
 	(void)y;
 	switch (key)
@@ -805,28 +1195,28 @@ static void gbEmuHandleKeyUp(unsigned char key, int x, int y)
 			#if DEBUG_KEY
 			printf("a up\n");
 			#endif
-			inValReads[BUTTON_A]=0;
+			gb->input.inValReads[BUTTON_A]=0;
 			break;
 		case 'x':
 		case 'X':
 			#if DEBUG_KEY
 			printf("b up\n");
 			#endif
-			inValReads[BUTTON_B]=0;
+			gb->input.inValReads[BUTTON_B]=0;
 			break;
 		case 's':
 		case 'S':
 			#if DEBUG_KEY
 			printf("sel up\n");
 			#endif
-			inValReads[BUTTON_SELECT]=0;
+			gb->input.inValReads[BUTTON_SELECT]=0;
 			break;
 		case 'a':
 		case 'A':
 			#if DEBUG_KEY
 			printf("start up\n");
 			#endif
-			inValReads[BUTTON_START]=0;
+			gb->input.inValReads[BUTTON_START]=0;
 			break;
 		case 'p':
 		case 'P':
@@ -847,37 +1237,38 @@ static void gbEmuHandleKeyUp(unsigned char key, int x, int y)
 
 static void gbEmuHandleSpecialDown(int key, int x, int y)
 {
+	gb_t *gb = gbEmu;
 	(void)x;
 	(void)y;
 	switch(key)
 	{
 		case GLUT_KEY_UP:
 			#if DEBUG_KEY
-			if(inValReads[BUTTON_UP]==0)
+			if(gb->input.inValReads[BUTTON_UP]==0)
 				printf("up\n");
 			#endif
-			inValReads[BUTTON_UP]=1;
+			gb->input.inValReads[BUTTON_UP]=1;
 			break;	
 		case GLUT_KEY_DOWN:
 			#if DEBUG_KEY
-			if(inValReads[BUTTON_DOWN]==0)
+			if(gb->input.inValReads[BUTTON_DOWN]==0)
 				printf("down\n");
 			#endif
-			inValReads[BUTTON_DOWN]=1;
+			gb->input.inValReads[BUTTON_DOWN]=1;
 			break;
 		case GLUT_KEY_LEFT:
 			#if DEBUG_KEY
-			if(inValReads[BUTTON_LEFT]==0)
+			if(gb->input.inValReads[BUTTON_LEFT]==0)
 				printf("left\n");
 			#endif
-			inValReads[BUTTON_LEFT]=1;
+			gb->input.inValReads[BUTTON_LEFT]=1;
 			break;
 		case GLUT_KEY_RIGHT:
 			#if DEBUG_KEY
-			if(inValReads[BUTTON_RIGHT]==0)
+			if(gb->input.inValReads[BUTTON_RIGHT]==0)
 				printf("right\n");
 			#endif
-			inValReads[BUTTON_RIGHT]=1;
+			gb->input.inValReads[BUTTON_RIGHT]=1;
 			break;
 		default:
 			break;
@@ -886,6 +1277,7 @@ static void gbEmuHandleSpecialDown(int key, int x, int y)
 
 static void gbEmuHandleSpecialUp(int key, int x, int y)
 {
+	gb_t *gb = gbEmu;
 	(void)x;
 	(void)y;
 	switch(key)
@@ -894,25 +1286,25 @@ static void gbEmuHandleSpecialUp(int key, int x, int y)
 			#if DEBUG_KEY
 			printf("up up\n");
 			#endif
-			inValReads[BUTTON_UP]=0;
+			gb->input.inValReads[BUTTON_UP]=0;
 			break;	
 		case GLUT_KEY_DOWN:
 			#if DEBUG_KEY
 			printf("down up\n");
 			#endif
-			inValReads[BUTTON_DOWN]=0;
+			gb->input.inValReads[BUTTON_DOWN]=0;
 			break;
 		case GLUT_KEY_LEFT:
 			#if DEBUG_KEY
 			printf("left up\n");
 			#endif
-			inValReads[BUTTON_LEFT]=0;
+			gb->input.inValReads[BUTTON_LEFT]=0;
 			break;
 		case GLUT_KEY_RIGHT:
 			#if DEBUG_KEY
 			printf("right up\n");
 			#endif
-			inValReads[BUTTON_RIGHT]=0;
+			gb->input.inValReads[BUTTON_RIGHT]=0;
 			break;
 		default:
 			break;
@@ -921,15 +1313,16 @@ static void gbEmuHandleSpecialUp(int key, int x, int y)
 
 static void gbEmuDisplayFrame()
 {
-	if(emuRenderFrame)
+	gb_t *gb = gbEmu;
+	if(gb->emuRenderFrame)
 	{
-		if(emuSkipFrame)
+		if(gb->emuSkipFrame)
 		{
-			emuRenderFrame = false;
+			gb->emuRenderFrame = false;
 			return;
 		}
-		glTexImage2D(GL_TEXTURE_2D, 0, 4, VISIBLE_DOTS, linesToDraw, 0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, textureImage);
-		emuRenderFrame = false;
+		glTexImage2D(GL_TEXTURE_2D, 0, 4, VISIBLE_DOTS, gb->emuLinesToDraw, 0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, gb->textureImage);
+		gb->emuRenderFrame = false;
 	}
 
 	glClear(GL_COLOR_BUFFER_BIT);
@@ -940,10 +1333,10 @@ static void gbEmuDisplayFrame()
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
 
-	double upscaleVal = round((((double)glutGet(GLUT_WINDOW_HEIGHT))/((double)linesToDraw))*20.0)/20.0;
+	double upscaleVal = round((((double)glutGet(GLUT_WINDOW_HEIGHT))/((double)gb->emuLinesToDraw))*20.0)/20.0;
 	double windowMiddle = ((double)glutGet(GLUT_WINDOW_WIDTH))/2.0;
 	double drawMiddle = (((double)VISIBLE_DOTS)*upscaleVal)/2.0;
-	double drawHeight = ((double)linesToDraw)*upscaleVal;
+	double drawHeight = ((double)gb->emuLinesToDraw)*upscaleVal;
 
 	glBegin(GL_QUADS);
 		glTexCoord2f(0,0); glVertex2f(windowMiddle-drawMiddle,drawHeight);
@@ -10,588 +10,600 @@
 #include <inttypes.h>
 #include <string.h>
 #include <time.h>
+#include "gb.h"
 #include "mem.h"
 #include "mbc.h"
 
-uint8_t Ext_Mem[0x20000];
-set8FuncT mbcSet8;
-set8FuncT mbcSetRAM8;
-get8FuncT mbcGetRAM8;
-
-//multicart regs
-uint16_t tBank0;
-uint16_t tBank1;
-uint16_t oBank;
-uint16_t iBank;
-uint16_t oBankAnd;
-uint16_t iBankAnd;
-uint8_t mcState;
-bool mcLocked;
-
-//normal regs
-uint8_t rtcReg;
-uint16_t cBank;
-uint16_t extBank;
-uint16_t bankMask;
-uint16_t extMask;
-uint16_t extAddrMask;
-size_t extTotalSize;
-
-bool RamIOAllowed;
-bool extMemEnabled;
-bool bankUsed;
-bool extSelect;
-bool rtcUsed;
-bool rtcEnabled;
-
-uint8_t lastRTCval;
-
-//used in for example VBA
-static struct RTCSave_t {
-	int32_t secs;
-	int32_t mins;
-	int32_t hours;
-	int32_t days;
-	int32_t ctrl;
-	int32_t lsecs;
-	int32_t lmins;
-	int32_t lhours;
-	int32_t ldays;
-	int32_t lctrl;
-	int64_t lastTime;
-} RTCSave;
-
-static void noSet8(uint16_t addr, uint8_t val);
-static void mbc1Set8(uint16_t addr, uint8_t val);
-static void mbc1mcSet8(uint16_t addr, uint8_t val);
-static void mbc2Set8(uint16_t addr, uint8_t val);
-static void mbc3Set8(uint16_t addr, uint8_t val);
-static void mbc5Set8(uint16_t addr, uint8_t val);
-static void gbsSet8(uint16_t addr, uint8_t val);
-static void mbcRTCUpdate();
-
-static uint8_t mbcGetExtRAMBank8(uint16_t addr);
-static void mbcSetExtRAMBank8(uint16_t addr, uint8_t val);
-static uint8_t mbcGetExtRAMNoBank8(uint16_t addr);
-static void mbcSetExtRAMNoBank8(uint16_t addr, uint8_t val);
-static uint8_t mbcGetExtRAMRtc8(uint16_t addr);
-static void mbcSetExtRAMRtc8(uint16_t addr, uint8_t val);
-static uint8_t mbc2GetExtRAM8(uint16_t addr);
-static void mbc2SetExtRAM8(uint16_t addr, uint8_t val);
-static uint8_t mbcGetNoExtRAM8(uint16_t addr);
-static void mbcSetNoExtRAM8(uint16_t addr, uint8_t val);
-
-extern bool gbIsMulticart;
-void mbcInit(uint8_t type)
-{
-	if(gbIsMulticart)
-		mbcSet8 = mbc1mcSet8;
+static void noSet8(gb_t *gb, uint16_t addr, uint8_t val);
+static void mbc1Set8(gb_t *gb, uint16_t addr, uint8_t val);
+static void mbc1mcSet8(gb_t *gb, uint16_t addr, uint8_t val);
+static void mbc2Set8(gb_t *gb, uint16_t addr, uint8_t val);
+static void mbc3Set8(gb_t *gb, uint16_t addr, uint8_t val);
+static void mbc5Set8(gb_t *gb, uint16_t addr, uint8_t val);
+static void gbsSet8(gb_t *gb, uint16_t addr, uint8_t val);
+static void mbcRTCUpdate(gb_t *gb);
+static void mbcRTCLatch(gb_t *gb);
+
+static uint8_t mbcGetExtRAMBank8(gb_t *gb, uint16_t addr);
+static void mbcSetExtRAMBank8(gb_t *gb, uint16_t addr, uint8_t val);
+static uint8_t mbcGetExtRAMNoBank8(gb_t *gb, uint16_t addr);
+static void mbcSetExtRAMNoBank8(gb_t *gb, uint16_t addr, uint8_t val);
+static uint8_t mbcGetExtRAMRtc8(gb_t *gb, uint16_t addr);
+static void mbcSetExtRAMRtc8(gb_t *gb, uint16_t addr, uint8_t val);
+static uint8_t mbc2GetExtRAM8(gb_t *gb, uint16_t addr);
+static void mbc2SetExtRAM8(gb_t *gb, uint16_t addr, uint8_t val);
+static uint8_t mbcGetNoExtRAM8(gb_t *gb, uint16_t addr);
+static void mbcSetNoExtRAM8(gb_t *gb, uint16_t addr, uint8_t val);
+
+void mbcInit(gb_t *gb, uint8_t type)
+{
+	if(gb->gbIsMulticart)
+		gb->mbc.mbcSet8 = mbc1mcSet8;
 	else if(type == MBC_TYPE_1)
-		mbcSet8 = mbc1Set8;
+		gb->mbc.mbcSet8 = mbc1Set8;
 	else if(type == MBC_TYPE_2)
-		mbcSet8 = mbc2Set8;
+		gb->mbc.mbcSet8 = mbc2Set8;
 	else if(type == MBC_TYPE_3)
-		mbcSet8 = mbc3Set8;
+		gb->mbc.mbcSet8 = mbc3Set8;
 	else if(type == MBC_TYPE_5)
-		mbcSet8 = mbc5Set8;
+		gb->mbc.mbcSet8 = mbc5Set8;
 	else if(type == MBC_TYPE_GBS)
-		mbcSet8 = gbsSet8;
+		gb->mbc.mbcSet8 = gbsSet8;
 	else
-		mbcSet8 = noSet8;
+		gb->mbc.mbcSet8 = noSet8;
 
-	if(rtcUsed)
+	if(gb->mbc.rtcUsed)
 	{
-		mbcGetRAM8 = mbcGetExtRAMRtc8;
-		mbcSetRAM8 = mbcSetExtRAMRtc8;
+		gb->mbc.mbcGetRAM8 = mbcGetExtRAMRtc8;
+		gb->mbc.mbcSetRAM8 = mbcSetExtRAMRtc8;
 		printf("MBC: Set RAM+RTC Functions\n");
 	}
-	else if(extMemEnabled)
+	else if(gb->mbc.extMemEnabled)
 	{
 		if(type == MBC_TYPE_2)
 		{
-			mbcGetRAM8 = mbc2GetExtRAM8;
-			mbcSetRAM8 = mbc2SetExtRAM8;
+			gb->mbc.mbcGetRAM8 = mbc2GetExtRAM8;
+			gb->mbc.mbcSetRAM8 = mbc2SetExtRAM8;
 			printf("MBC: Set Special MBC2 RAM Functions\n");
 		}
-		else if(extTotalSize < 0x2000)
+		else if(gb->mbc.extTotalSize < 0x2000)
 		{
-			mbcGetRAM8 = mbcGetExtRAMNoBank8;
-			mbcSetRAM8 = mbcSetExtRAMNoBank8;
+			gb->mbc.mbcGetRAM8 = mbcGetExtRAMNoBank8;
+			gb->mbc.mbcSetRAM8 = mbcSetExtRAMNoBank8;
 			printf("MBC: Set RAM (No Bank) Functions\n");
 		}
 		else if(type == MBC_TYPE_GBS)
 		{
 			//GBS has 0x2000 bytes RAM but has no Bank or I/O Regs!
-			mbcGetRAM8 = mbcGetExtRAMNoBank8;
-			mbcSetRAM8 = mbcSetExtRAMNoBank8;
+			gb->mbc.mbcGetRAM8 = mbcGetExtRAMNoBank8;
+			gb->mbc.mbcSetRAM8 = mbcSetExtRAMNoBank8;
 			printf("MBC: Set GBS RAM (No Bank) Functions\n");
 		}
 		else
 		{
-			mbcGetRAM8 = mbcGetExtRAMBank8;
-			mbcSetRAM8 = mbcSetExtRAMBank8;
+			gb->mbc.mbcGetRAM8 = mbcGetExtRAMBank8;
+			gb->mbc.mbcSetRAM8 = mbcSetExtRAMBank8;
 			printf("MBC: Set Normal RAM Functions\n");
 		}
 	}
 	else
 	{
-		mbcGetRAM8 = mbcGetNoExtRAM8;
-		mbcSetRAM8 = mbcSetNoExtRAM8;
+		gb->mbc.mbcGetRAM8 = mbcGetNoExtRAM8;
+		gb->mbc.mbcSetRAM8 = mbcSetNoExtRAM8;
 		printf("MBC: No RAM Functions\n");
 	}
-	mbcExtRAMInit(type);
+	mbcExtRAMInit(gb, type);
 }
 
-void mbcResetRegs()
+void mbcResetRegs(gb_t *gb)
 {
 	//multicart regs
-	tBank0 = 0, tBank1 = 1;
-	oBank = 0, iBank = 1;
-	oBankAnd = 0x20, iBankAnd = 0x3F;
-	mcState = 0, mcLocked = false;
+	gb->mbc.tBank0 = 0, gb->mbc.tBank1 = 1;
+	gb->mbc.oBank = 0, gb->mbc.iBank = 1;
+	gb->mbc.oBankAnd = 0x20, gb->mbc.iBankAnd = 0x3F;
+	gb->mbc.mcState = 0, gb->mbc.mcLocked = false;
 	//normal regs
-	rtcReg = 0;
-	cBank = 1;
-	bankMask = 1;
-	extBank = 0;
-	extMask = 0;
-	extAddrMask = 0;
-	extTotalSize = 0;
-	RamIOAllowed = false;
-	extMemEnabled = false;
-	bankUsed = false;
-	extSelect = false;
-	rtcUsed = false;
-	rtcEnabled = false;
-	lastRTCval = 0;
-}
-
-static void noSet8(uint16_t addr, uint8_t val)
+	gb->mbc.rtcReg = 0;
+	gb->mbc.cBank = 1;
+	gb->mbc.bankMask = 1;
+	gb->mbc.extBank = 0;
+	gb->mbc.extMask = 0;
+	gb->mbc.extAddrMask = 0;
+	gb->mbc.extTotalSize = 0;
+	gb->mbc.RamIOAllowed = false;
+	gb->mbc.extMemEnabled = false;
+	gb->mbc.bankUsed = false;
+	gb->mbc.extSelect = false;
+	gb->mbc.rtcUsed = false;
+	gb->mbc.rtcEnabled = false;
+	gb->mbc.lastRTCval = 0;
+}
+
+static void noSet8(gb_t *gb, uint16_t addr, uint8_t val)
 {
+	(void)gb;
 	(void)addr;
 	(void)val;
 }
 
-static void mbc1Set8(uint16_t addr, uint8_t val)
+static void mbc1Set8(gb_t *gb, uint16_t addr, uint8_t val)
 {
 	if(addr < 0x2000)
-		RamIOAllowed = ((val&0xF) == 0xA);
+		gb->mbc.RamIOAllowed = ((val&0xF) == 0xA);
 	else if(addr >= 0x2000 && addr < 0x4000)
 	{
-		if(bankUsed)
+		if(gb->mbc.bankUsed)
 		{
 			//printf("%02x\n",val);
-			cBank &= ~0x1F;
-			cBank |= val&0x1F;
-			if((cBank&0x1F) == 0)
-				cBank |= 1;
-			cBank &= bankMask;
+			gb->mbc.cBank &= ~0x1F;
+			gb->mbc.cBank |= val&0x1F;
+			if((gb->mbc.cBank&0x1F) == 0)
+				gb->mbc.cBank |= 1;
+			gb->mbc.cBank &= gb->mbc.bankMask;
 		}
 	}
 	else if(addr >= 0x4000 && addr < 0x6000)
 	{
-		if(extSelect)
+		if(gb->mbc.extSelect)
 		{
-			if(extMemEnabled)
+			if(gb->mbc.extMemEnabled)
 			{
-				extBank = val&3;
-				extBank &= extMask;
+				gb->mbc.extBank = val&3;
+				gb->mbc.extBank &= gb->mbc.extMask;
 			}
 		}
 		else
 		{
-			if(bankUsed)
+			if(gb->mbc.bankUsed)
 			{
 				//printf("%02x\n",val);
-				cBank &= 0x1F;
-				cBank |= ((val&3)<<5);
-				if((cBank&0x1F) == 0)
-					cBank |= 1;
-				cBank &= bankMask;
+				gb->mbc.cBank &= 0x1F;
+				gb->mbc.cBank |= ((val&3)<<5);
+				if((gb->mbc.cBank&0x1F) == 0)
+					gb->mbc.cBank |= 1;
+				gb->mbc.cBank &= gb->mbc.bankMask;
 			}
 		}
 	}
 	else if(addr >= 0x6000 && addr < 0x8000)
-		extSelect = !!val;
+		gb->mbc.extSelect = !!val;
 }
 
-static void mbc1mcSet8(uint16_t addr, uint8_t val)
+static void mbc1mcSet8(gb_t *gb, uint16_t addr, uint8_t val)
 {
 	if(addr >= 0x2000 && addr < 0x4000)
 	{
-		iBank = val&0x3F;
-		if(iBank == 0)
-			iBank |= 1;
-		tBank1 = ((oBank&oBankAnd)<<1)+(iBank&iBankAnd);
+		gb->mbc.iBank = val&0x3F;
+		if(gb->mbc.iBank == 0)
+			gb->mbc.iBank |= 1;
+		gb->mbc.tBank1 = ((gb->mbc.oBank&gb->mbc.oBankAnd)<<1)+(gb->mbc.iBank&gb->mbc.iBankAnd);
 	}
-	else if(addr >= 0x6000 && addr < 0x8000 && !mcLocked)
+	else if(addr >= 0x6000 && addr < 0x8000 && !gb->mbc.mcLocked)
 	{
-		if(mcState == 0)
+		if(gb->mbc.mcState == 0)
 		{
-			oBank = val&0x3F;
-			tBank0 = ((oBank&oBankAnd)<<1);
-			tBank1 = ((oBank&oBankAnd)<<1)+(iBank&iBankAnd);
+			gb->mbc.oBank = val&0x3F;
+			gb->mbc.tBank0 = ((gb->mbc.oBank&gb->mbc.oBankAnd)<<1);
+			gb->mbc.tBank1 = ((gb->mbc.oBank&gb->mbc.oBankAnd)<<1)+(gb->mbc.iBank&gb->mbc.iBankAnd);
 		}
 		else
 		{
-			iBankAnd=(~(val<<1))&0x3F;
-			oBankAnd=0x20|(val&0x1F);
-			tBank0 = ((oBank&oBankAnd)<<1);
-			tBank1 = ((oBank&oBankAnd)<<1)+(iBank&iBankAnd);
-			mcLocked = !!(val&0x20);
+			gb->mbc.iBankAnd=(~(val<<1))&0x3F;
+			gb->mbc.oBankAnd=0x20|(val&0x1F);
+			gb->mbc.tBank0 = ((gb->mbc.oBank&gb->mbc.oBankAnd)<<1);
+			gb->mbc.tBank1 = ((gb->mbc.oBank&gb->mbc.oBankAnd)<<1)+(gb->mbc.iBank&gb->mbc.iBankAnd);
+			gb->mbc.mcLocked = !!(val&0x20);
 		}
-		mcState^=1;
+		gb->mbc.mcState^=1;
 	}
 }
 
-static void mbc2Set8(uint16_t addr, uint8_t val)
+static void mbc2Set8(gb_t *gb, uint16_t addr, uint8_t val)
 {
 	if(addr < 0x2000 && ((addr&0x100) == 0))
-		RamIOAllowed = ((val&0xF) == 0xA);
+		gb->mbc.RamIOAllowed = ((val&0xF) == 0xA);
 	else if(addr >= 0x2000 && addr < 0x4000 && ((addr&0x100) == 0x100))
 	{
-		if(bankUsed)
+		if(gb->mbc.bankUsed)
 		{
-			cBank = val&0x7F;
-			if(cBank == 0)
-				cBank |= 1;
-			cBank &= bankMask;
+			gb->mbc.cBank = val&0x7F;
+			if(gb->mbc.cBank == 0)
+				gb->mbc.cBank |= 1;
+			gb->mbc.cBank &= gb->mbc.bankMask;
 		}
 	}
 }
 
-static void mbc3Set8(uint16_t addr, uint8_t val)
+static void mbc3Set8(gb_t *gb, uint16_t addr, uint8_t val)
 {
 	if(addr < 0x2000)
-		RamIOAllowed = ((val&0xF) == 0xA);
+		gb->mbc.RamIOAllowed = ((val&0xF) == 0xA);
 	else if(addr >= 0x2000 && addr < 0x4000)
 	{
-		if(bankUsed)
+		if(gb->mbc.bankUsed)
 		{
 			//printf("%02x\n",val);
-			cBank = val&0x7F;
-			if(cBank == 0)
-				cBank |= 1;
-			cBank &= bankMask;
+			gb->mbc.cBank = val&0x7F;
+			if(gb->mbc.cBank == 0)
+				gb->mbc.cBank |= 1;
+			gb->mbc.cBank &= gb->mbc.bankMask;
 		}
 	}
 	else if(addr >= 0x4000 && addr < 0x6000)
 	{
 		if((val & 0xC) == 0)
 		{
-			if(extMemEnabled)
+			if(gb->mbc.extMemEnabled)
 			{
-				extBank = val&3;
-				extBank &= extMask;
+				gb->mbc.extBank = val&3;
+				gb->mbc.extBank &= gb->mbc.extMask;
 			}
-			rtcEnabled = false;
+			gb->mbc.rtcEnabled = false;
 		}
-		else if(rtcUsed)
+		else if(gb->mbc.rtcUsed)
 		{
-			rtcReg = val&0xF;
-			rtcEnabled = true;
+			gb->mbc.rtcReg = val&0xF;
+			gb->mbc.rtcEnabled = true;
 		}
 	}
 	else if(addr >= 0x6000 && addr < 0x8000)
 	{
 		//update latched regs with current vals
-		if(lastRTCval == 0 && val == 1)
+		if(gb->mbc.lastRTCval == 0 && val == 1)
 		{
-			mbcRTCUpdate();
-			RTCSave.lsecs = RTCSave.secs;
-			RTCSave.lmins = RTCSave.mins;
-			RTCSave.lhours = RTCSave.hours;
-			RTCSave.ldays = RTCSave.days;
-			RTCSave.lctrl = RTCSave.ctrl;
+			mbcRTCUpdate(gb);
+			gb->mbc.RTCSave.lsecs = gb->mbc.RTCSave.secs;
+			gb->mbc.RTCSave.lmins = gb->mbc.RTCSave.mins;
+			gb->mbc.RTCSave.lhours = gb->mbc.RTCSave.hours;
+			gb->mbc.RTCSave.ldays = gb->mbc.RTCSave.days;
+			gb->mbc.RTCSave.lctrl = gb->mbc.RTCSave.ctrl;
+			gb->mbc.rtcDirty = true;
+			mbcRTCLatch(gb);
 		}
-		lastRTCval = val;
+		gb->mbc.lastRTCval = val;
 	}
 }
 
-static void mbc5Set8(uint16_t addr, uint8_t val)
+static void mbc5Set8(gb_t *gb, uint16_t addr, uint8_t val)
 {
 	if(addr < 0x2000)
-		RamIOAllowed = ((val&0xF) == 0xA);
+		gb->mbc.RamIOAllowed = ((val&0xF) == 0xA);
 	else if(addr >= 0x2000 && addr < 0x3000)
 	{
-		if(bankUsed)
+		if(gb->mbc.bankUsed)
 		{
-			cBank &= ~0xFF;
-			cBank |= val;
-			cBank &= bankMask;
+			gb->mbc.cBank &= ~0xFF;
+			gb->mbc.cBank |= val;
+			gb->mbc.cBank &= gb->mbc.bankMask;
 		}
 	}
 	else if(addr >= 0x3000 && addr < 0x4000)
 	{
-		if(bankUsed)
+		if(gb->mbc.bankUsed)
 		{
-			cBank &= 0xFF;
-			cBank |= (val&1)<<8;
-			cBank &= bankMask;
+			gb->mbc.cBank &= 0xFF;
+			gb->mbc.cBank |= (val&1)<<8;
+			gb->mbc.cBank &= gb->mbc.bankMask;
 		}
 	}
 	else if(addr >= 0x4000 && addr < 0x6000)
 	{
-		if(extMemEnabled)
+		if(gb->mbc.extMemEnabled)
 		{
-			extBank = val&0xF;
-			extBank &= extMask;
+			gb->mbc.extBank = val&0xF;
+			gb->mbc.extBank &= gb->mbc.extMask;
 		}
 	}
 }
 
-static void gbsSet8(uint16_t addr, uint8_t val)
+static void gbsSet8(gb_t *gb, uint16_t addr, uint8_t val)
 {
 	if(addr >= 0x2000 && addr < 0x3000)
 	{
 		//Some GBS files seem to follow VERY strange behaviour
 		//similar to the MBC1 but mixing in bank mask
-		cBank = (val&bankMask);
-		if(cBank == 0)
-			cBank |= 1;
+		gb->mbc.cBank = (val&gb->mbc.bankMask);
+		if(gb->mbc.cBank == 0)
+			gb->mbc.cBank |= 1;
 	}
 }
 
-void mbcExtRAMInit(uint8_t type)
+void mbcExtRAMInit(gb_t *gb, uint8_t type)
 {
-	if(extTotalSize == 0)
+	if(gb->mbc.extTotalSize == 0)
 		printf("MBC: No RAM Cleared\n");
 	else if(type == MBC_TYPE_2)
 	{
 		printf("MBC: Cleared MBC2 RAM\n");
-		memset(Ext_Mem,0xF0,0x200);
+		memset(gb->mbc.Ext_Mem,0xF0,0x200);
 	}
 	else
 	{
 		printf("MBC: Cleared Normal RAM\n");
-		memset(Ext_Mem,0,extTotalSize);
+		memset(gb->mbc.Ext_Mem,0,gb->mbc.extTotalSize);
 	}
 }
 
-void mbcExtRAMGBSClear()
+void mbcExtRAMGBSClear(gb_t *gb)
 {
-	memset(Ext_Mem,0,0x2000);
+	memset(gb->mbc.Ext_Mem,0,0x2000);
 }
 
-void mbcExtRAMLoad(FILE *f)
+void mbcExtRAMLoad(gb_t *gb, FILE *f)
 {
-	fread(Ext_Mem,1,extTotalSize,f);
+	fread(gb->mbc.Ext_Mem,1,gb->mbc.extTotalSize,f);
 	printf("MBC: Read in saved game\n");
 }
 
-void mbcExtRAMStore(FILE *f)
+void mbcExtRAMStore(gb_t *gb, FILE *f)
 {
 	printf("MBC: Saved game\n");
-	fwrite(Ext_Mem,1,extTotalSize,f);
+	fwrite(gb->mbc.Ext_Mem,1,gb->mbc.extTotalSize,f);
+}
+
+//remembers the page got written for the save journal
+static inline void mbcExtRAMDirty(gb_t *gb, uint32_t pos)
+{
+	gb->mbc.extDirty[pos>>8] = 1;
+	gb->mbc.extDirtyAny = true;
 }
 
 //Regular RAM for regular Controllers
-uint8_t mbcGetExtRAMBank8(uint16_t addr)
+uint8_t mbcGetExtRAMBank8(gb_t *gb, uint16_t addr)
 {
-	if(RamIOAllowed)
-		return Ext_Mem[((extBank<<13)|(addr&extAddrMask))];
+	if(gb->mbc.RamIOAllowed)
+		return gb->mbc.Ext_Mem[((gb->mbc.extBank<<13)|(addr&gb->mbc.extAddrMask))];
 	return 0xFF;
 }
 
-void mbcSetExtRAMBank8(uint16_t addr, uint8_t val)
+void mbcSetExtRAMBank8(gb_t *gb, uint16_t addr, uint8_t val)
 {
-	if(RamIOAllowed)
-		Ext_Mem[((extBank<<13)|(addr&extAddrMask))] = val;
+	if(gb->mbc.RamIOAllowed)
+	{
+		uint32_t pos = (gb->mbc.extBank<<13)|(addr&gb->mbc.extAddrMask);
+		gb->mbc.Ext_Mem[pos] = val;
+		mbcExtRAMDirty(gb, pos);
+	}
 }
 
 //Allow Only 4 Bits to read/write
-static uint8_t mbc2GetExtRAM8(uint16_t addr)
+static uint8_t mbc2GetExtRAM8(gb_t *gb, uint16_t addr)
 {
-	if(RamIOAllowed)
-		return Ext_Mem[addr&0x1FF] | 0xF0;
+	if(gb->mbc.RamIOAllowed)
+		return gb->mbc.Ext_Mem[addr&0x1FF] | 0xF0;
 	return 0xFF;
 }
 
-static void mbc2SetExtRAM8(uint16_t addr, uint8_t val)
+static void mbc2SetExtRAM8(gb_t *gb, uint16_t addr, uint8_t val)
 {
-	if(RamIOAllowed)
-		Ext_Mem[addr&0x1FF] = val | 0xF0;
+	if(gb->mbc.RamIOAllowed)
+	{
+		gb->mbc.Ext_Mem[addr&0x1FF] = val | 0xF0;
+		mbcExtRAMDirty(gb, addr&0x1FF);
+	}
 }
 
 //No Banks and No RAM IO Regs to be set
-static uint8_t mbcGetExtRAMNoBank8(uint16_t addr)
+static uint8_t mbcGetExtRAMNoBank8(gb_t *gb, uint16_t addr)
 {
-	return Ext_Mem[addr&extAddrMask];
+	return gb->mbc.Ext_Mem[addr&gb->mbc.extAddrMask];
 }
 
-static void mbcSetExtRAMNoBank8(uint16_t addr, uint8_t val)
+static void mbcSetExtRAMNoBank8(gb_t *gb, uint16_t addr, uint8_t val)
 {
-	Ext_Mem[addr&extAddrMask] = val;
+	gb->mbc.Ext_Mem[addr&gb->mbc.extAddrMask] = val;
+	mbcExtRAMDirty(gb, addr&gb->mbc.extAddrMask);
+}
+
+//start of the 8KB window 0xA000 reads can go to directly, NULL
+//while they need the handler for disabled ram, rtc or mbc2
+uint8_t *mbcGetRAMPtr(gb_t *gb)
+{
+	if(gb->mbc.mbcGetRAM8 == mbcGetExtRAMNoBank8)
+		return gb->mbc.Ext_Mem;
+	if(!gb->mbc.RamIOAllowed)
+		return NULL;
+	if(gb->mbc.mbcGetRAM8 == mbcGetExtRAMBank8
+		|| (gb->mbc.mbcGetRAM8 == mbcGetExtRAMRtc8 && !gb->mbc.rtcEnabled && gb->mbc.extMemEnabled))
+		return gb->mbc.Ext_Mem+(gb->mbc.extBank<<13);
+	return NULL;
 }
 
 //No RAM, just dummy functions
-static uint8_t mbcGetNoExtRAM8(uint16_t addr)
+static uint8_t mbcGetNoExtRAM8(gb_t *gb, uint16_t addr)
 {
+	(void)gb;
 	(void)addr;
 	return 0xFF;
 }
 
-static void mbcSetNoExtRAM8(uint16_t addr, uint8_t val)
+static void mbcSetNoExtRAM8(gb_t *gb, uint16_t addr, uint8_t val)
 {
+	(void)gb;
 	(void)addr;
 	(void)val;
 }
 
-size_t mbcRTCSize()
+size_t mbcRTCSize(gb_t *gb)
 {
-	return sizeof(RTCSave);
+	return sizeof(gb->mbc.RTCSave);
 }
 
-void mbcRTCInit()
+//main clocks per rtc second
+#define MBC_RTC_CLOCKS 4194304
+
+//current time the rtc runs on in seconds, the cpu may
+//be ahead of emuClock since cart writes are not timed
+static int64_t mbcRTCNow(gb_t *gb)
 {
-	rtcUsed = true;
+	if(!gb->mbc.rtcEmuTime)
+		return (int64_t)time(NULL);
+	uint64_t clocks = gb->emuClock+gb->emuClocksAhead-gb->mbc.rtcEpochClock;
+	return gb->mbc.rtcEpoch+(int64_t)(clocks/MBC_RTC_CLOCKS);
+}
+
+//copies the latched regs over so reads only have to look them up
+static void mbcRTCLatch(gb_t *gb)
+{
+	memset(gb->mbc.rtcLatch,0xFF,sizeof(gb->mbc.rtcLatch));
+	gb->mbc.rtcLatch[0x8] = gb->mbc.RTCSave.lsecs;
+	gb->mbc.rtcLatch[0x9] = gb->mbc.RTCSave.lmins;
+	gb->mbc.rtcLatch[0xA] = gb->mbc.RTCSave.lhours;
+	gb->mbc.rtcLatch[0xB] = gb->mbc.RTCSave.ldays;
+	gb->mbc.rtcLatch[0xC] = gb->mbc.RTCSave.lctrl;
+}
+
+void mbcRTCInit(gb_t *gb)
+{
+	gb->mbc.rtcUsed = true;
+	if(gb->mbc.rtcFixedEpoch)
+		gb->mbc.rtcEmuTime = true;
+	if(gb->mbc.rtcEmuTime)
+	{
+		//only place the wall clock gets read in this mode
+		if(!gb->mbc.rtcFixedEpoch)
+			gb->mbc.rtcEpoch = (int64_t)time(NULL);
+		gb->mbc.rtcEpochClock = gb->emuClock;
+	}
 	//Set default values already in
 	//case no save exists
-	time_t curtime;
-	time(&curtime);
-	struct tm *lt = localtime(&curtime);
-	RTCSave.secs = lt->tm_sec;
-	RTCSave.mins = lt->tm_min;
-	RTCSave.hours = lt->tm_hour;
-	RTCSave.days = lt->tm_yday & 255;
-	RTCSave.ctrl = (lt->tm_yday > 255 ? 1: 0);
-	RTCSave.lastTime = curtime;
-	printf("MBC: RTC allowed\n");
+	time_t curtime = (time_t)mbcRTCNow(gb);
+	//fixed epochs should give the same time everywhere
+	struct tm *lt = gb->mbc.rtcFixedEpoch ? gmtime(&curtime) : localtime(&curtime);
+	gb->mbc.RTCSave.secs = lt->tm_sec;
+	gb->mbc.RTCSave.mins = lt->tm_min;
+	gb->mbc.RTCSave.hours = lt->tm_hour;
+	gb->mbc.RTCSave.days = lt->tm_yday & 255;
+	gb->mbc.RTCSave.ctrl = (lt->tm_yday > 255 ? 1: 0);
+	gb->mbc.RTCSave.lastTime = curtime;
+	mbcRTCLatch(gb);
+	if(gb->mbc.rtcFixedEpoch)
+		printf("MBC: RTC allowed, running from emulated time at %" PRId64 "\n", gb->mbc.rtcEpoch);
+	else if(gb->mbc.rtcEmuTime)
+		printf("MBC: RTC allowed, running from emulated time\n");
+	else
+		printf("MBC: RTC allowed\n");
 }
 
-static void mbcRTCUpdate()
+static void mbcRTCUpdate(gb_t *gb)
 {
-	if(RTCSave.ctrl & 0x40) //Halted!
+	if(gb->mbc.RTCSave.ctrl & 0x40) //Halted!
 		return;
 
-	time_t curtime;
-	time(&curtime);
-	time_t diff = curtime - ((time_t)RTCSave.lastTime);
-	if(diff == 0) //No Time Diff!
+	int64_t curtime = mbcRTCNow(gb);
+	int64_t diff = curtime - gb->mbc.RTCSave.lastTime;
+	//no time diff, or emulated time ran ahead of the
+	//wall clock the save got loaded with
+	if(diff <= 0)
 		return;
 
-	RTCSave.secs += diff % 60;
-	if(RTCSave.secs > 59)
+	gb->mbc.RTCSave.secs += diff % 60;
+	if(gb->mbc.RTCSave.secs > 59)
 	{
-		RTCSave.secs -= 60;
-		RTCSave.mins++;
+		gb->mbc.RTCSave.secs -= 60;
+		gb->mbc.RTCSave.mins++;
 	}
 
 	diff /= 60;
 
-	RTCSave.mins += diff % 60;
-	if(RTCSave.mins > 60)
+	gb->mbc.RTCSave.mins += diff % 60;
+	if(gb->mbc.RTCSave.mins > 60)
 	{
-		RTCSave.mins -= 60;
-		RTCSave.hours++;
+		gb->mbc.RTCSave.mins -= 60;
+		gb->mbc.RTCSave.hours++;
 	}
 
 	diff /= 60;
 
-	RTCSave.hours += diff % 24;
-	if(RTCSave.hours > 24)
+	gb->mbc.RTCSave.hours += diff % 24;
+	if(gb->mbc.RTCSave.hours > 24)
 	{
-		RTCSave.hours -= 24;
-		RTCSave.days++;
+		gb->mbc.RTCSave.hours -= 24;
+		gb->mbc.RTCSave.days++;
 	}
 	diff /= 24;
 
-	RTCSave.days += diff;
-	if(RTCSave.days > 511)
+	gb->mbc.RTCSave.days += diff;
+	if(gb->mbc.RTCSave.days > 511)
 	{
-		RTCSave.days %= 512;
-		RTCSave.ctrl |= (RTCSave.ctrl&0x7E)|0x80|(RTCSave.days > 255 ? 1 : 0);
+		gb->mbc.RTCSave.days %= 512;
+		gb->mbc.RTCSave.ctrl |= (gb->mbc.RTCSave.ctrl&0x7E)|0x80|(gb->mbc.RTCSave.days > 255 ? 1 : 0);
 	}
-	RTCSave.lastTime = curtime;
+	gb->mbc.RTCSave.lastTime = curtime;
 }
 
-void mbcRTCLoad(FILE *f)
+void mbcRTCLoad(gb_t *gb, FILE *f)
 {
-	fread(&RTCSave,1,mbcRTCSize(),f);
+	fread(&gb->mbc.RTCSave,1,mbcRTCSize(gb),f);
 	printf("MBC: Read in RTC Save\n");
+	//a fixed epoch has nothing to do with the wall clock the
+	//save got written at, so just continue from the saved regs
+	if(gb->mbc.rtcFixedEpoch)
+		gb->mbc.RTCSave.lastTime = mbcRTCNow(gb);
 	//refresh timestamps
-	mbcRTCUpdate();
+	mbcRTCUpdate(gb);
+	mbcRTCLatch(gb);
 }
 
-void mbcRTCStore(FILE *f)
+void mbcRTCStore(gb_t *gb, FILE *f)
 {
 	//update regs one last time before saving
-	mbcRTCUpdate();
-	fwrite(&RTCSave,1,mbcRTCSize(),f);
+	mbcRTCUpdate(gb);
+	fwrite(&gb->mbc.RTCSave,1,mbcRTCSize(gb),f);
 	printf("MBC: Saved RTC\n");
 }
 
-uint8_t mbcGetExtRAMRtc8(uint16_t addr)
+uint8_t mbcGetExtRAMRtc8(gb_t *gb, uint16_t addr)
 {
-	if(!RamIOAllowed)
+	if(!gb->mbc.RamIOAllowed)
 		return 0xFF;
-	if(rtcEnabled)
-	{
-		uint8_t ret = 0xFF;
-		//return currently latched regs
-		switch(rtcReg)
-		{
-			case 0x8:
-				ret = RTCSave.lsecs;
-				break;
-			case 0x9:
-				ret = RTCSave.lmins;
-				break;
-			case 0xA:
-				ret = RTCSave.lhours;
-				break;
-			case 0xB:
-				ret = RTCSave.ldays;
-				break;
-			case 0xC:
-				ret = RTCSave.lctrl;
-				break;
-			default:
-				break;
-		}
-		return ret;
-	}
-	else if(extMemEnabled)
+	//return currently latched regs
+	if(gb->mbc.rtcEnabled)
+		return gb->mbc.rtcLatch[gb->mbc.rtcReg];
+	else if(gb->mbc.extMemEnabled)
 	{
-		uint8_t ret = Ext_Mem[((extBank<<13)|(addr&extAddrMask))];
+		uint8_t ret = gb->mbc.Ext_Mem[((gb->mbc.extBank<<13)|(addr&gb->mbc.extAddrMask))];
 		return ret;
 	}
 	return 0xFF;
 }
 
-void mbcSetExtRAMRtc8(uint16_t addr, uint8_t val)
+void mbcSetExtRAMRtc8(gb_t *gb, uint16_t addr, uint8_t val)
 {
-	if(!RamIOAllowed)
+	if(!gb->mbc.RamIOAllowed)
 		return;
-	if(rtcEnabled)
+	if(gb->mbc.rtcEnabled)
 	{
 		//refresh time to set time of write
-		time_t curtime;
-		time(&curtime);
-		RTCSave.lastTime = curtime;
+		gb->mbc.RTCSave.lastTime = mbcRTCNow(gb);
+		gb->mbc.rtcDirty = true;
 		//write into rtc regs
-		switch(rtcReg)
+		switch(gb->mbc.rtcReg)
 		{
 			case 0x08:
-				RTCSave.secs = val;
+				gb->mbc.RTCSave.secs = val;
 				break;
 			case 0x09:
-				RTCSave.mins = val;
+				gb->mbc.RTCSave.mins = val;
 				break;
 			case 0x0A:
-				RTCSave.hours = val;
+				gb->mbc.RTCSave.hours = val;
 				break;
 			case 0x0B:
-				RTCSave.days = (RTCSave.days&0x100)|val;
+				gb->mbc.RTCSave.days = (gb->mbc.RTCSave.days&0x100)|val;
 				break;
 			case 0x0C:
-				RTCSave.ctrl = val;
-				RTCSave.days = (RTCSave.days&0xFF)|((val&1)<<8);
+				gb->mbc.RTCSave.ctrl = val;
+				gb->mbc.RTCSave.days = (gb->mbc.RTCSave.days&0xFF)|((val&1)<<8);
 				break;
 			default:
 				break;
 		}
 	}
-	else if(extMemEnabled)
-		Ext_Mem[((extBank<<13)|(addr&extAddrMask))] = val;
+	else if(gb->mbc.extMemEnabled)
+	{
+		uint32_t pos = (gb->mbc.extBank<<13)|(addr&gb->mbc.extAddrMask);
+		gb->mbc.Ext_Mem[pos] = val;
+		mbcExtRAMDirty(gb, pos);
+	}
 }
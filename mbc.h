@@ -19,18 +19,15 @@ enum {
 	MBC_TYPE_GBS,
 };
 
-void mbcInit(uint8_t type);
-void mbcResetRegs();
-size_t mbcRTCSize();
-void mbcRTCInit();
-void mbcRTCLoad(FILE *f);
-void mbcRTCStore(FILE *f);
-void mbcExtRAMInit(uint8_t type);
-void mbcExtRAMLoad(FILE *f);
-void mbcExtRAMStore(FILE *f);
-void mbcExtRAMGBSClear();
-extern set8FuncT mbcSet8;
-extern set8FuncT mbcSetRAM8;
-extern get8FuncT mbcGetRAM8;
-
+void mbcInit(gb_t *gb, uint8_t type);
+void mbcResetRegs(gb_t *gb);
+size_t mbcRTCSize(gb_t *gb);
+void mbcRTCInit(gb_t *gb);
+void mbcRTCLoad(gb_t *gb, FILE *f);
+void mbcRTCStore(gb_t *gb, FILE *f);
+void mbcExtRAMInit(gb_t *gb, uint8_t type);
+void mbcExtRAMLoad(gb_t *gb, FILE *f);
+void mbcExtRAMStore(gb_t *gb, FILE *f);
+void mbcExtRAMGBSClear(gb_t *gb);
+uint8_t *mbcGetRAMPtr(gb_t *gb);
 #endif
\ No newline at end of file
@@ -6,565 +6,569 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
 #include <inttypes.h>
 #include <string.h>
+#include "gb.h"
 #include "mem.h"
 #include "cpu.h"
 #include "ppu.h"
 #include "apu.h"
 #include "input.h"
 #include "mbc.h"
+#ifndef __LIBRETRO__
+#include "save.h"
+#endif
 
-//used externally
-extern uint8_t Ext_Mem[0x20000];
-static uint8_t Main_Mem[0x8000];
-static uint8_t High_Mem[0x80];
-static uint8_t gbs_prevValReads[8];
-static uint8_t memLastVal;
-static uint8_t irReq;
-static uint8_t serialReg;
-static uint8_t serialCtrlReg;
-static uint8_t irqEnableReg;
-static uint8_t irqFlagsReg;
-//writable, undocumented regs
-static uint8_t genericReg[4];
-static uint16_t divRegVal;
-static uint8_t timerReg;
-static uint8_t timerRegVal;
-static uint8_t timerResetVal;
-static uint16_t timerRegBit;
-static bool timerPrevTicked;
-static uint8_t sioTimerRegClock;
-static uint8_t sioTimerRegTimer;
-static uint8_t sioBitsTransfered;
-static uint8_t cgbMainBank;
-static bool cgbDmaActive;
-static uint16_t cgbDmaSrc;
-static uint16_t cgbDmaDst;
-static uint8_t cgbDmaLen;
-static uint8_t memDmaClock;
-static bool cgbDmaHBlankMode;
-static bool cgbBootromEnabled = false;
-static bool timerRegEnable = false;
-static bool sioTimerRegEnable = false;
-
-//from main.c
-extern bool gbCgbGame;
-extern bool gbCgbMode;
-extern bool gbCgbBootrom;
-extern uint8_t *emuGBROM;
-extern bool gbIsMulticart;
-
-//from mbc.c
-//multicart regs
-extern uint16_t tBank0;
-extern uint16_t tBank1;
-extern uint16_t oBank;
-extern uint16_t iBank;
-extern uint16_t oBankAnd;
-extern uint16_t iBankAnd;
-extern uint8_t mcState;
-extern bool mcLocked;
-//normal regs
-extern uint8_t rtcReg;
-extern uint16_t cBank;
-extern uint16_t extBank;
-extern uint16_t bankMask;
-extern uint16_t extMask;
-extern uint16_t extAddrMask;
-extern size_t extTotalSize;
-
-//from cpu.c
-extern bool cpuCgbSpeed;
-extern bool cpuDoStopSwitch;
-
-//from ppu.c
-extern uint8_t ppuCgbBank;
-
-//from mbc.c
-extern bool RamIOAllowed;
-extern bool extMemEnabled;
-extern bool bankUsed;
-extern bool extSelect;
-extern bool rtcUsed;
-extern bool rtcEnabled;
-extern uint8_t lastRTCval;
-
-static get8FuncT memGet8ptr[0x10000];
-static set8FuncT memSet8ptr[0x10000];
-static uint8_t memCGBBootrom[0x900];
-static uint8_t memGetROMBank8(uint16_t addr);
-static uint8_t memGetROMNoBank8(uint16_t addr);
-static uint8_t memGetROM0Multicart8(uint16_t addr);
-static uint8_t memGetROM1Multicart8(uint16_t addr);
-static uint8_t memGetBootROMNoBank8(uint16_t addr);
-static uint8_t memGetRAMBank8(uint16_t addr);
-static uint8_t memGetRAMNoBank8(uint16_t addr);
-static uint8_t memGetHiRAM8(uint16_t addr);
-static uint8_t memGetGeneralReg8(uint16_t addr);
-static uint8_t memGetInvalid8(uint16_t addr);
-static void memSetRAMBank8(uint16_t addr, uint8_t val);
-static void memSetRAMNoBank8(uint16_t addr, uint8_t val);
-static void memSetHiRAM8(uint16_t addr, uint8_t val);
-static void memSetGeneralReg8(uint16_t addr, uint8_t val);
-static void memSetInvalid8(uint16_t addr, uint8_t val);
+static void memMapExtRAM(gb_t *gb);
+static uint8_t memGetROMBank8(gb_t *gb, uint16_t addr);
+static uint8_t memGetROMNoBank8(gb_t *gb, uint16_t addr);
+static uint8_t memGetROM0Multicart8(gb_t *gb, uint16_t addr);
+static uint8_t memGetROM1Multicart8(gb_t *gb, uint16_t addr);
+static uint8_t memGetBootROMNoBank8(gb_t *gb, uint16_t addr);
+static uint8_t memGetHiRAM8(gb_t *gb, uint16_t addr);
+static uint8_t memGetOAMPage8(gb_t *gb, uint16_t addr);
+static uint8_t memGetGeneralReg8(gb_t *gb, uint16_t addr);
+static uint8_t memGetInvalid8(gb_t *gb, uint16_t addr);
+static void memSetHiRAM8(gb_t *gb, uint16_t addr, uint8_t val);
+static void memSetOAMPage8(gb_t *gb, uint16_t addr, uint8_t val);
+static void memSetGeneralReg8(gb_t *gb, uint16_t addr, uint8_t val);
+static void memSetInvalid8(gb_t *gb, uint16_t addr, uint8_t val);
+static void memTimerAdvance(gb_t *gb, uint64_t clocks);
+static void memTimerSchedule(gb_t *gb);
 
-void memLoadSave();
+void memLoadSave(gb_t *gb);
 
-static void memSetBankVal()
+static void memSetBankVal(gb_t *gb)
 {
-	bankUsed = true;
-	switch(emuGBROM[0x148])
+	gb->mbc.bankUsed = true;
+	switch(gb->emuGBROM[0x148])
 	{
 		case 0:
 			printf("Mem: 32KB ROM allowed\n");
-			bankMask = 1;
+			gb->mbc.bankMask = 1;
 			break;
 		case 1:
 			printf("Mem: 64KB ROM allowed\n");
-			bankMask = 3;
+			gb->mbc.bankMask = 3;
 			break;
 		case 2:
 			printf("Mem: 128KB ROM allowed\n");
-			bankMask = 7;
+			gb->mbc.bankMask = 7;
 			break;
 		case 3:
 			printf("Mem: 256KB ROM allowed\n");
-			bankMask = 15;
+			gb->mbc.bankMask = 15;
 			break;
 		case 4:
 			printf("Mem: 512KB ROM allowed\n");
-			bankMask = 31;
+			gb->mbc.bankMask = 31;
 			break;
 		case 5:
 			printf("Mem: 1MB ROM allowed\n");
-			bankMask = 63;
+			gb->mbc.bankMask = 63;
 			break;
 		case 6:
 			printf("Mem: 2MB ROM allowed\n");
-			bankMask = 127;
+			gb->mbc.bankMask = 127;
 			break;
 		case 7:
 			printf("Mem: 4MB ROM allowed\n");
-			bankMask = 255;
+			gb->mbc.bankMask = 255;
 			break;
 		case 8:
 			printf("Mem: 8MB ROM allowed\n");
-			bankMask = 511;
+			gb->mbc.bankMask = 511;
 			break;
 		case 0x52:
 			printf("Mem: 1.1MB ROM allowed\n");
-			bankMask = 71;
+			gb->mbc.bankMask = 71;
 			break;
 		case 0x53:
 			printf("Mem: 1.2MB ROM allowed\n");
-			bankMask = 79;
+			gb->mbc.bankMask = 79;
 			break;
 		case 0x54:
 			printf("Mem: 1.5MB ROM allowed\n");
-			bankMask = 95;
+			gb->mbc.bankMask = 95;
 			break;
 		default:
 			printf("Mem: Unknown ROM Size, allowing 32KB ROM\n");
-			bankMask = 1;
+			gb->mbc.bankMask = 1;
 			break;
 	}
 }
 
-static void memSetExtVal()
+static void memSetExtVal(gb_t *gb)
 {
-	extAddrMask = 0x1FFF;
-	extMemEnabled = true;
-	switch(emuGBROM[0x149])
+	gb->mbc.extAddrMask = 0x1FFF;
+	gb->mbc.extMemEnabled = true;
+	switch(gb->emuGBROM[0x149])
 	{
 		case 0:
-			if(emuGBROM[0x147] == 6)
+			if(gb->emuGBROM[0x147] == 6)
 			{
 				printf("Mem: MBC2 Special RAM\n");
-				extAddrMask = 0x1FF; //special case
-				extTotalSize = 0x200;
-				extMask = 1;
+				gb->mbc.extAddrMask = 0x1FF; //special case
+				gb->mbc.extTotalSize = 0x200;
+				gb->mbc.extMask = 1;
 			}
 			else
 			{
 				printf("Mem: No RAM allowed\n");
-				extMemEnabled = false;
-				extAddrMask = 0; //special case
-				extTotalSize = 0;
-				extMask = 0;
+				gb->mbc.extMemEnabled = false;
+				gb->mbc.extAddrMask = 0; //special case
+				gb->mbc.extTotalSize = 0;
+				gb->mbc.extMask = 0;
 			}
 			break;
 		case 1:
 			printf("Mem: 2KB RAM allowed\n");
-			extAddrMask = 0x7FF; //special case
-			extTotalSize = 0x800;
-			extMask = 1;
+			gb->mbc.extAddrMask = 0x7FF; //special case
+			gb->mbc.extTotalSize = 0x800;
+			gb->mbc.extMask = 1;
 			break;
 		case 2:
 			printf("Mem: 8KB RAM allowed\n");
-			extTotalSize = 0x2000;
-			extMask = 1;
+			gb->mbc.extTotalSize = 0x2000;
+			gb->mbc.extMask = 1;
 			break;
 		case 3:
 			printf("Mem: 32KB RAM allowed\n");
-			extTotalSize = 0x8000;
-			extMask = 3;
+			gb->mbc.extTotalSize = 0x8000;
+			gb->mbc.extMask = 3;
 			break;
 		case 4:
 			printf("Mem: 128KB RAM allowed\n");
-			extTotalSize = 0x20000;
-			extMask = 15;
+			gb->mbc.extTotalSize = 0x20000;
+			gb->mbc.extMask = 15;
 			break;
 		case 5:
 			printf("Mem: 64KB RAM allowed\n");
-			extTotalSize = 0x10000;
-			extMask = 7;
+			gb->mbc.extTotalSize = 0x10000;
+			gb->mbc.extMask = 7;
 			break;
 		default:
 			printf("Mem: Unknown RAM Size, allowing 8KB RAM\n");
-			extTotalSize = 0x2000;
-			extMask = 1;
+			gb->mbc.extTotalSize = 0x2000;
+			gb->mbc.extMask = 1;
 			break;
 	}
 }
 
-static uint8_t curGBS;
-extern uint8_t gbsTracksTotal;
-extern uint32_t gbsRomSize;
-bool memInit(bool romcheck, bool gbs)
+static void memFreeCode(gb_t *gb)
+{
+	uint32_t i;
+	if(!gb->mem.memCodeROM)
+		return;
+	for(i = 0; i < gb->mem.memCodeROMPages; i++)
+	{
+		if(gb->mem.memCodeROM[i])
+			free(gb->mem.memCodeROM[i]);
+	}
+	free(gb->mem.memCodeROM);
+	gb->mem.memCodeROM = NULL;
+	gb->mem.memCodeROMPages = 0;
+}
+
+bool memInit(gb_t *gb, bool romcheck, bool gbs)
 {
 	if(romcheck)
 	{
-		mbcResetRegs();
+		memFreeCode(gb);
+		//pages themselves get allocated once code runs in them
+		gb->mem.memCodeROM = calloc((gb->emuGBROMsize+0x3FFF)>>14, sizeof(memcode_t*));
+		if(gb->mem.memCodeROM)
+			gb->mem.memCodeROMPages = (gb->emuGBROMsize+0x3FFF)>>14;
+		mbcResetRegs(gb);
 		if(gbs)
 		{
-			curGBS = 0;
-			bankUsed = true;
+			gb->mem.curGBS = 0;
+			gb->mbc.bankUsed = true;
 			//Get ROM Size multiple
-			if(gbsRomSize <= 0x8000)
+			if(gb->gbsRomSize <= 0x8000)
 			{
 				printf("Mem: 32KB ROM allowed\n");
-				bankMask = 1;
+				gb->mbc.bankMask = 1;
 			}
-			else if(gbsRomSize <= 0x10000)
+			else if(gb->gbsRomSize <= 0x10000)
 			{
 				printf("Mem: 64KB ROM allowed\n");
-				bankMask = 3;
+				gb->mbc.bankMask = 3;
 			}
-			else if(gbsRomSize <= 0x20000)
+			else if(gb->gbsRomSize <= 0x20000)
 			{
 				printf("Mem: 128KB ROM allowed\n");
-				bankMask = 7;
+				gb->mbc.bankMask = 7;
 			}
-			else if(gbsRomSize <= 0x40000)
+			else if(gb->gbsRomSize <= 0x40000)
 			{
 				printf("Mem: 256KB ROM allowed\n");
-				bankMask = 15;
+				gb->mbc.bankMask = 15;
 			}
-			else if(gbsRomSize <= 0x80000)
+			else if(gb->gbsRomSize <= 0x80000)
 			{
 				printf("Mem: 512KB ROM allowed\n");
-				bankMask = 31;
+				gb->mbc.bankMask = 31;
 			}
-			else if(gbsRomSize <= 0x100000)
+			else if(gb->gbsRomSize <= 0x100000)
 			{
 				printf("Mem: 1MB ROM allowed\n");
-				bankMask = 63;
+				gb->mbc.bankMask = 63;
 			}
-			else if(gbsRomSize <= 0x200000)
+			else if(gb->gbsRomSize <= 0x200000)
 			{
 				printf("Mem: 2MB ROM allowed\n");
-				bankMask = 127;
+				gb->mbc.bankMask = 127;
 			}
-			else if(gbsRomSize <= 0x400000)
+			else if(gb->gbsRomSize <= 0x400000)
 			{
 				printf("Mem: 4MB ROM allowed\n");
-				bankMask = 255;
+				gb->mbc.bankMask = 255;
 			}
 			else
 			{
 				printf("Mem: 8MB ROM allowed\n");
-				bankMask = 511;
+				gb->mbc.bankMask = 511;
 			}
 			//Always have 8KB RAM enabled
-			extMemEnabled = true;
+			gb->mbc.extMemEnabled = true;
 			printf("Mem: 8KB RAM allowed\n");
-			extTotalSize = 0x2000;
-			extAddrMask = 0x1FFF;
-			extMask = 1;
+			gb->mbc.extTotalSize = 0x2000;
+			gb->mbc.extAddrMask = 0x1FFF;
+			gb->mbc.extMask = 1;
 			printf("Mem: ROM and RAM (GBS)\n");
-			mbcInit(MBC_TYPE_GBS);
-			memset(gbs_prevValReads,0,8);
+			mbcInit(gb, MBC_TYPE_GBS);
+			memset(gb->mem.gbs_prevValReads,0,8);
 		}
 		else
 		{
-			switch(emuGBROM[0x147])
+			switch(gb->emuGBROM[0x147])
 			{
 				case 0x00:
 					printf("Mem: ROM Only\n");
-					mbcInit(MBC_TYPE_NONE);
+					mbcInit(gb, MBC_TYPE_NONE);
 					break;
 				case 0x01:
-					memSetBankVal();
+					memSetBankVal(gb);
 					printf("Mem: ROM Only (MBC1)\n");
-					mbcInit(MBC_TYPE_1);
+					mbcInit(gb, MBC_TYPE_1);
 					break;
 				case 0x02:
-					memSetBankVal();
-					memSetExtVal();
+					memSetBankVal(gb);
+					memSetExtVal(gb);
 					printf("Mem: ROM and RAM (without save) (MBC1)\n");
-					mbcInit(MBC_TYPE_1);
+					mbcInit(gb, MBC_TYPE_1);
 					break;
 				case 0xFF:
 					//TODO: Actually implement HuC1 functionality
 				case 0x03:
-					memSetBankVal();
-					memSetExtVal();
+					memSetBankVal(gb);
+					memSetExtVal(gb);
 					printf("Mem: ROM and RAM (with save) (MBC1)\n");
-					mbcInit(MBC_TYPE_1);
-					memLoadSave();
+					mbcInit(gb, MBC_TYPE_1);
+					memLoadSave(gb);
 					break;
 				case 0x05:
-					memSetBankVal();
+					memSetBankVal(gb);
 					printf("Mem: ROM only (MBC2)\n");
-					mbcInit(MBC_TYPE_1);
+					mbcInit(gb, MBC_TYPE_1);
 					break;
 				case 0x06:
-					memSetBankVal();
-					memSetExtVal();
+					memSetBankVal(gb);
+					memSetExtVal(gb);
 					printf("Mem: ROM and RAM (with save) (MBC2)\n");
-					mbcInit(MBC_TYPE_2);
-					memLoadSave();
+					mbcInit(gb, MBC_TYPE_2);
+					memLoadSave(gb);
 					break;
 				case 0x08:
-					memSetBankVal();
-					memSetExtVal();
+					memSetBankVal(gb);
+					memSetExtVal(gb);
 					printf("Mem: ROM and RAM (without save)\n");
-					mbcInit(MBC_TYPE_NONE);
+					mbcInit(gb, MBC_TYPE_NONE);
 					break;
 				case 0x09:
-					memSetBankVal();
-					memSetExtVal();
+					memSetBankVal(gb);
+					memSetExtVal(gb);
 					printf("Mem: ROM and RAM (with save)\n");
-					mbcInit(MBC_TYPE_NONE);
-					memLoadSave();
+					mbcInit(gb, MBC_TYPE_NONE);
+					memLoadSave(gb);
 					break;
 				case 0x0F:
-					memSetBankVal();
-					mbcRTCInit();
+					memSetBankVal(gb);
+					mbcRTCInit(gb);
 					printf("Mem: ROM and RTC (MBC3)\n");
-					mbcInit(MBC_TYPE_3);
-					memLoadSave();
+					mbcInit(gb, MBC_TYPE_3);
+					memLoadSave(gb);
 					break;
 				case 0x11:
-					memSetBankVal();
+					memSetBankVal(gb);
 					printf("Mem: ROM Only (MBC3)\n");
-					mbcInit(MBC_TYPE_3);
+					mbcInit(gb, MBC_TYPE_3);
 					break;
 				case 0x12:
-					memSetBankVal();
-					memSetExtVal();
+					memSetBankVal(gb);
+					memSetExtVal(gb);
 					printf("Mem: ROM and RAM (without save) (MBC3)\n");
-					mbcInit(MBC_TYPE_3);
+					mbcInit(gb, MBC_TYPE_3);
 					break;
 				case 0x10:
-					memSetBankVal();
-					memSetExtVal();
-					mbcRTCInit();
+					memSetBankVal(gb);
+					memSetExtVal(gb);
+					mbcRTCInit(gb);
 					printf("Mem: ROM and RAM (with save) and RTC (MBC3)\n");
-					mbcInit(MBC_TYPE_3);
-					memLoadSave();
+					mbcInit(gb, MBC_TYPE_3);
+					memLoadSave(gb);
 					break;
 				case 0x13:
-					memSetBankVal();
-					memSetExtVal();
+					memSetBankVal(gb);
+					memSetExtVal(gb);
 					printf("Mem: ROM and RAM (with save) (MBC3)\n");
-					mbcInit(MBC_TYPE_3);
-					memLoadSave();
+					mbcInit(gb, MBC_TYPE_3);
+					memLoadSave(gb);
 					break;
 				case 0x19:
 				case 0x1C:
-					memSetBankVal();
+					memSetBankVal(gb);
 					printf("Mem: ROM Only (MBC5)\n");
-					mbcInit(MBC_TYPE_5);
+					mbcInit(gb, MBC_TYPE_5);
 					break;
 				case 0x1A:
 				case 0x1D:
-					memSetBankVal();
-					memSetExtVal();
+					memSetBankVal(gb);
+					memSetExtVal(gb);
 					printf("Mem: ROM and RAM (without save) (MBC5)\n");
-					mbcInit(MBC_TYPE_5);
+					mbcInit(gb, MBC_TYPE_5);
 					break;
 				case 0x1B:
 				case 0x1E:
-					memSetBankVal();
-					memSetExtVal();
+					memSetBankVal(gb);
+					memSetExtVal(gb);
 					printf("Mem: ROM and RAM (with save) (MBC5)\n");
-					mbcInit(MBC_TYPE_5);
-					memLoadSave();
+					mbcInit(gb, MBC_TYPE_5);
+					memLoadSave(gb);
 					break;
 				default:
-					printf("Mem Error: Unsupported MBC Type %02x!\n", emuGBROM[0x147]);
+					printf("Mem Error: Unsupported MBC Type %02x!\n", gb->emuGBROM[0x147]);
 					return false;
 			}
 		}
 	}
-	memset(Main_Mem,0,0x8000);
-	memset(High_Mem,0,0x80);
-	memset(genericReg,0,4);
+	memset(gb->mem.Main_Mem,0,0x8000);
+	memset(gb->mem.High_Mem,0,0x80);
+	memset(gb->mem.memCodeRAM,0,sizeof(gb->mem.memCodeRAM));
+	memset(gb->mem.memCodeHiRAM,0,sizeof(gb->mem.memCodeHiRAM));
+	memset(gb->mem.genericReg,0,4);
 	//IMPORTANT: Clear Ext RAM
 	if(gbs) //On song switches
 	{
-		mbcExtRAMGBSClear();
+		mbcExtRAMGBSClear(gb);
 		//and reset ROM Bank as well
-		cBank = 1;
+		gb->mbc.cBank = 1;
 	}
-	memLastVal = 0;
-	irReq = 0;
-	serialReg = 0;
-	serialCtrlReg = 0;
-	irqEnableReg = 0;
-	irqFlagsReg = 0;
-	divRegVal = 0;
-	timerReg = 0;
-	timerRegVal = 0;
-	timerResetVal = 0;
-	timerRegBit = (1<<9); //Freq 0
-	timerPrevTicked = false;
-	sioTimerRegClock = 1;
-	sioTimerRegTimer = 32;
-	sioBitsTransfered = 0;
-	cgbMainBank = 1;
-	cgbDmaActive = false;
-	cgbDmaSrc = 0;
-	cgbDmaDst = 0;
-	cgbDmaLen = 0;
-	memDmaClock = 1;
-	cgbDmaHBlankMode = false;
-	timerRegEnable = false;
-	sioTimerRegEnable = false;
-	memInitGetSetPointers();
+	gb->mem.memLastVal = 0;
+	gb->mem.irReq = 0;
+	gb->mem.serialReg = 0;
+	gb->mem.serialCtrlReg = 0;
+	gb->mem.irqEnableReg = 0;
+	gb->mem.irqFlagsReg = 0;
+	gb->mem.divRegVal = 0;
+	gb->mem.timerReg = 0;
+	gb->mem.timerRegVal = 0;
+	gb->mem.timerResetVal = 0;
+	gb->mem.timerRegBit = (1<<9); //Freq 0
+	gb->mem.timerPrevTicked = false;
+	gb->mem.timerClock = gb->emuClock;
+	gb->mem.timerNextClock = UINT64_MAX;
+	gb->mem.sioTimerRegClock = 1;
+	gb->mem.sioTimerRegTimer = 32;
+	gb->mem.sioBitsTransfered = 0;
+	gb->mem.cgbMainBank = 1;
+	gb->mem.cgbDmaActive = false;
+	gb->mem.cgbDmaSrc = 0;
+	gb->mem.cgbDmaDst = 0;
+	gb->mem.cgbDmaLen = 0;
+	gb->mem.memDmaClock = 1;
+	gb->mem.cgbDmaHBlankMode = false;
+	gb->mem.timerRegEnable = false;
+	gb->mem.sioTimerRegEnable = false;
+	memInitGetSetPointers(gb);
 	return true;
 }
 
-void memDeinit()
+void memDeinit(gb_t *gb)
+{
+	gb->mem.cgbBootromEnabled = false;
+	memFreeCode(gb);
+}
+
+//points the rom pages at whatever banks are mapped in right now,
+//pages outside of the rom or under the bootrom keep their handler
+static void memMapROM(gb_t *gb)
 {
-	cgbBootromEnabled = false;
+	uint32_t bank0, bank1, page;
+	if(gb->gbIsMulticart)
+		bank0 = gb->mem.cgbBootromEnabled ? 0 : gb->mbc.tBank0, bank1 = gb->mbc.tBank1;
+	else
+		bank0 = 0, bank1 = gb->mbc.bankUsed ? gb->mbc.cBank : 1;
+	if(bank0 == gb->mem.memROMBank[0] && bank1 == gb->mem.memROMBank[1])
+		return;
+	gb->mem.memROMBank[0] = bank0;
+	gb->mem.memROMBank[1] = bank1;
+	for(page = 0; page < 0x80; page++)
+	{
+		uint32_t pos = (((page < 0x40) ? bank0 : bank1)<<14)|((page&0x3F)<<8);
+		if(pos+0x100 > gb->emuGBROMsize || (gb->mem.cgbBootromEnabled && (page == 0 || (page >= 2 && page < 9))))
+			gb->mem.memReadPage[page] = NULL;
+		else
+			gb->mem.memReadPage[page] = gb->emuGBROM+pos;
+	}
 }
 
-void memInitGetSetPointers()
+//main ram is read and written directly, only 0xD000-0xDFFF
+//and its echo depend on the current cgb bank
+static void memMapRAM(gb_t *gb)
+{
+	uint32_t page;
+	for(page = 0xC0; page < 0xFE; page++)
+	{
+		uint32_t pos = (page&0xF)<<8;
+		if(page&0x10)
+			pos |= gb->gbCgbMode ? (gb->mem.cgbMainBank<<12) : 0x1000;
+		gb->mem.memReadPage[page] = gb->mem.Main_Mem+pos;
+		gb->mem.memWritePage[page] = gb->mem.Main_Mem+pos;
+	}
+}
+
+//cart ram gets read directly while the mbc has plain ram mapped,
+//writes always go through the handler so the page gets marked dirty
+static void memMapExtRAM(gb_t *gb)
+{
+	uint8_t *ram = mbcGetRAMPtr(gb);
+	if(ram == gb->mem.memExtRAMPtr)
+		return;
+	gb->mem.memExtRAMPtr = ram;
+	uint32_t page;
+	for(page = 0xA0; page < 0xC0; page++)
+		gb->mem.memReadPage[page] = ram ? ram+(((page&0x1F)<<8)&gb->mbc.extAddrMask) : NULL;
+}
+
+//cartridge rom handlers, depend on the bootrom and mbc
+static void memMapROMHandlers(gb_t *gb)
+{
+	uint32_t region;
+	for(region = 0; region < 0x8; region++)
+	{
+		if(region < 0x4) //0x0000 - 0x3FFF = Cartridge ROM
+			gb->mem.memGet8Region[region] = gb->mem.cgbBootromEnabled?memGetBootROMNoBank8:(gb->gbIsMulticart?memGetROM0Multicart8:memGetROMNoBank8);
+		else //0x4000 - 0x7FFF = Cartridge ROM (possibly banked)
+			gb->mem.memGet8Region[region] = gb->gbIsMulticart?memGetROM1Multicart8:(gb->mbc.bankUsed?memGetROMBank8:memGetROMNoBank8);
+		gb->mem.memSet8Region[region] = gb->mbc.mbcSet8;
+	}
+	//pages under the bootrom have to be pointed at the rom again
+	gb->mem.memROMBank[0] = gb->mem.memROMBank[1] = UINT32_MAX;
+	memMapROM(gb);
+}
+
+//everything that changes between cgb and dmg mode
+static void memMapCGBHandlers(gb_t *gb)
 {
-	//init memGet8 and memSet8 arrays
 	uint32_t addr;
-	for(addr = 0; addr < 0x10000; addr++)
+	//0x8000 - 0x9FFF = PPU VRAM
+	gb->mem.memGet8Region[0x8] = gb->mem.memGet8Region[0x9] = gb->gbCgbMode?ppuGetVRAMBank8:ppuGetVRAMNoBank8;
+	gb->mem.memSet8Region[0x8] = gb->mem.memSet8Region[0x9] = gb->gbCgbMode?ppuSetVRAMBank8:ppuSetVRAMNoBank8;
+	for(addr = 0xFF4C; addr < 0xFF6C; addr++)
 	{
-		if(addr < 0x4000) //0x0000 - 0x3FFF = Cartridge ROM
-		{
-			memGet8ptr[addr] = cgbBootromEnabled?memGetBootROMNoBank8:(gbIsMulticart?memGetROM0Multicart8:memGetROMNoBank8);
-			memSet8ptr[addr] = mbcSet8;
-		}
-		else if(addr < 0x8000) //0x4000 - 0x7FFF = Cartridge ROM (possibly banked)
-		{
-			memGet8ptr[addr] = gbIsMulticart?memGetROM1Multicart8:(bankUsed?memGetROMBank8:memGetROMNoBank8);
-			memSet8ptr[addr] = mbcSet8;
-		}
-		else if(addr < 0xA000) //0x8000 - 0x9FFF = PPU VRAM
-		{
-			memGet8ptr[addr] = gbCgbMode?ppuGetVRAMBank8:ppuGetVRAMNoBank8;
-			memSet8ptr[addr] = gbCgbMode?ppuSetVRAMBank8:ppuSetVRAMNoBank8;
-		}
-		else if(addr < 0xC000) //0xA000 - 0xBFFF = Cartridge RAM
-		{
-			memGet8ptr[addr] = mbcGetRAM8;
-			memSet8ptr[addr] = mbcSetRAM8;
-		}
-		else if(addr < 0xD000) //0xC000 - 0xCFFF = Main RAM
-		{
-			memGet8ptr[addr] = memGetRAMNoBank8;
-			memSet8ptr[addr] = memSetRAMNoBank8;
-		}
-		else if(addr < 0xE000) //0xD000 - 0xDFFF = Main RAM (possibly banked)
-		{
-			memGet8ptr[addr] = gbCgbMode?memGetRAMBank8:memGetRAMNoBank8;
-			memSet8ptr[addr] = gbCgbMode?memSetRAMBank8:memSetRAMNoBank8;
-		}
-		else if(addr < 0xF000) //0xE000 - 0xEFFF = Echo Main RAM
+		uint8_t pos = addr&0xFF;
+		if(addr < 0xFF68) //0xFF4C - 0xFF67 = General CGB Features
 		{
-			memGet8ptr[addr] = memGetRAMNoBank8;
-			memSet8ptr[addr] = memSetRAMNoBank8;
+			gb->mem.memGetIO8ptr[pos] = gb->gbCgbMode?memGetGeneralReg8:memGetInvalid8;
+			gb->mem.memSetIO8ptr[pos] = gb->gbCgbMode?memSetGeneralReg8:memSetInvalid8;
 		}
-		else if(addr < 0xFE00) //0xF000 - 0xFCFF = Echo Main RAM (possibly banked)
+		else //0xFF68 - 0xFF6B = PPU CGB Regs
 		{
-			memGet8ptr[addr] = gbCgbMode?memGetRAMBank8:memGetRAMNoBank8;
-			memSet8ptr[addr] = gbCgbMode?memSetRAMBank8:memSetRAMNoBank8;
+			gb->mem.memGetIO8ptr[pos] = gb->gbCgbMode?ppuGetReg8:memGetInvalid8;
+			gb->mem.memSetIO8ptr[pos] = gb->gbCgbMode?ppuSetReg8:memSetInvalid8;
 		}
-		else if(addr < 0xFEA0) //0xFE00 - 0xFE9F = PPU OAM
-		{
-			memGet8ptr[addr] = ppuGetOAM8;
-			memSet8ptr[addr] = ppuSetOAM8;
-		}
-		else if(addr < 0xFF00) //0xFEA0 - 0xFEFF = Unusable
-		{
-			memGet8ptr[addr] = memGetInvalid8;
-			memSet8ptr[addr] = memSetInvalid8;
-		}
-		else if(addr == 0xFF00) //FF00 = Inputs
+	}
+	//0xD000 - 0xDFFF is only banked in cgb mode
+	memMapRAM(gb);
+}
+
+void memInitGetSetPointers(gb_t *gb)
+{
+	uint32_t page, addr;
+	for(page = 0; page < 0x100; page++)
+	{
+		gb->mem.memReadPage[page] = NULL;
+		gb->mem.memWritePage[page] = NULL;
+	}
+	//init region handlers, only used for pages without a pointer
+	//0xA000 - 0xBFFF = Cartridge RAM
+	gb->mem.memGet8Region[0xA] = gb->mem.memGet8Region[0xB] = gb->mbc.mbcGetRAM8;
+	gb->mem.memSet8Region[0xA] = gb->mem.memSet8Region[0xB] = gb->mbc.mbcSetRAM8;
+	//0xC000 - 0xEFFF = Main RAM and its echo, always mapped
+	gb->mem.memGet8Region[0xC] = gb->mem.memGet8Region[0xD] = gb->mem.memGet8Region[0xE] = memGetInvalid8;
+	gb->mem.memSet8Region[0xC] = gb->mem.memSet8Region[0xD] = gb->mem.memSet8Region[0xE] = memSetInvalid8;
+	//0xF000 - 0xFDFF is echo ram and 0xFF00 - 0xFFFF has its
+	//own table, so that leaves 0xFE00 - 0xFEFF = PPU OAM and unusable
+	gb->mem.memGet8Region[0xF] = memGetOAMPage8;
+	gb->mem.memSet8Region[0xF] = memSetOAMPage8;
+	//init I/O page handlers
+	for(addr = 0xFF00; addr < 0x10000; addr++)
+	{
+		uint8_t pos = addr&0xFF;
+		if(addr == 0xFF00) //FF00 = Inputs
 		{
-			memGet8ptr[addr] = inputGet8;
-			memSet8ptr[addr] = inputSet8;
+			gb->mem.memGetIO8ptr[pos] = inputGet8;
+			gb->mem.memSetIO8ptr[pos] = inputSet8;
 		}
 		else if(addr < 0xFF10) //0xFF01 - 0xFF0F = General Features
 		{
-			memGet8ptr[addr] = memGetGeneralReg8;
-			memSet8ptr[addr] = memSetGeneralReg8;
+			gb->mem.memGetIO8ptr[pos] = memGetGeneralReg8;
+			gb->mem.memSetIO8ptr[pos] = memSetGeneralReg8;
 		}
 		else if(addr < 0xFF40) //0xFF10 - 0xFF3F = APU Regs
 		{
-			memGet8ptr[addr] = apuGetReg8;
-			memSet8ptr[addr] = apuSetReg8;
+			gb->mem.memGetIO8ptr[pos] = apuGetReg8;
+			gb->mem.memSetIO8ptr[pos] = apuSetReg8;
 		}
 		else if(addr < 0xFF4C) //0xFF40 - 0xFF4B = PPU Regs
 		{
-			memGet8ptr[addr] = ppuGetReg8;
-			memSet8ptr[addr] = ppuSetReg8;
-		}
-		else if(addr < 0xFF68) //0xFF4C - 0xFF67 = General CGB Features
-		{
-			memGet8ptr[addr] = gbCgbMode?memGetGeneralReg8:memGetInvalid8;
-			memSet8ptr[addr] = gbCgbMode?memSetGeneralReg8:memSetInvalid8;
-		}
-		else if(addr < 0xFF6C) //0xFF68 - 0xFF6B = PPU CGB Regs
-		{
-			memGet8ptr[addr] = gbCgbMode?ppuGetReg8:memGetInvalid8;
-			memSet8ptr[addr] = gbCgbMode?ppuSetReg8:memSetInvalid8;
+			gb->mem.memGetIO8ptr[pos] = ppuGetReg8;
+			gb->mem.memSetIO8ptr[pos] = ppuSetReg8;
 		}
+		else if(addr < 0xFF6C) //0xFF4C - 0xFF6B = CGB Regs, see memMapCGBHandlers
+			continue;
 		else if(addr < 0xFF80) //0xFF6C - 0xFF7F = General CGB Features
 		{
-			memGet8ptr[addr] = memGetGeneralReg8;
-			memSet8ptr[addr] = memSetGeneralReg8;
+			gb->mem.memGetIO8ptr[pos] = memGetGeneralReg8;
+			gb->mem.memSetIO8ptr[pos] = memSetGeneralReg8;
 		}
 		else if(addr < 0xFFFF) //0xFF80 - 0xFFFE = High RAM
 		{
-			memGet8ptr[addr] = memGetHiRAM8;
-			memSet8ptr[addr] = memSetHiRAM8;
+			gb->mem.memGetIO8ptr[pos] = memGetHiRAM8;
+			gb->mem.memSetIO8ptr[pos] = memSetHiRAM8;
 		}
-		else if(addr == 0xFFFF) //FFFF = General Features
+		else //FFFF = General Features
 		{
-			memGet8ptr[addr] = memGetGeneralReg8;
-			memSet8ptr[addr] = memSetGeneralReg8;
+			gb->mem.memGetIO8ptr[pos] = memGetGeneralReg8;
+			gb->mem.memSetIO8ptr[pos] = memSetGeneralReg8;
 		}
-		else //Should never happen
-			printf("Mem Warning: Address %04x uninitialized!\n", addr);
 	}
+	memMapROMHandlers(gb);
+	memMapCGBHandlers(gb);
+	gb->mem.memExtRAMPtr = NULL;
+	memMapExtRAM(gb);
 }
 
 #ifdef __LIBRETRO__
 FILE *doOpenCGBBootrom();
 #endif
 
-bool memInitCGBBootrom()
+bool memInitCGBBootrom(gb_t *gb)
 {
 #ifndef __LIBRETRO__
 	FILE *f = fopen("gbc_bios.bin","rb");
@@ -579,346 +583,434 @@ bool memInitCGBBootrom()
 		return false;
 	}
 	fseek(f,0,SEEK_SET);
-	fread(memCGBBootrom,1,0x900,f);
+	fread(gb->mem.memCGBBootrom,1,0x900,f);
 	fclose(f);
-	cgbBootromEnabled = true;
+	gb->mem.cgbBootromEnabled = true;
 	return true;
 }
 
-void memDisableCGBBootrom(uint8_t val)
+void memDisableCGBBootrom(gb_t *gb, uint8_t val)
 {
-	if(val == 0x11 && cgbBootromEnabled)
+	if(val == 0x11 && gb->mem.cgbBootromEnabled)
 	{
-		cgbBootromEnabled = false;
+		gb->mem.cgbBootromEnabled = false;
 		//Update CGB/DMG Mode if needed
-		if(!gbCgbGame) gbCgbMode = false;
+		bool cgbMode = gb->gbCgbMode;
+		if(!gb->gbCgbGame) gb->gbCgbMode = false;
 		//Memory Map changes
-		memInitGetSetPointers();
-		ppuInitDrawPointer();
+		memMapROMHandlers(gb);
+		if(cgbMode != gb->gbCgbMode)
+			memMapCGBHandlers(gb);
+		ppuInitDrawPointer(gb);
 	}
 }
 
-void memStartGBS()
+void memStartGBS(gb_t *gb)
 {
-	curGBS = 1;
+	gb->mem.curGBS = 1;
 	//printf("Track %i/%i         ", curGBS, gbsTracksTotal);
-	ppuDrawGBSTrackNum(curGBS, gbsTracksTotal);
-	cpuLoadGBS(curGBS-1);
+	ppuDrawGBSTrackNum(gb, gb->mem.curGBS, gb->gbsTracksTotal);
+	cpuLoadGBS(gb, gb->mem.curGBS-1);
 }
 
-uint8_t memGetCurIrqList()
+uint8_t memGetCurIrqList(gb_t *gb)
 {
-	return (irqEnableReg & irqFlagsReg);
+	return (gb->mem.irqEnableReg & gb->mem.irqFlagsReg);
 }
 
-void memClearCurIrqList(uint8_t num)
+void memClearCurIrqList(gb_t *gb, uint8_t num)
 {
-	irqFlagsReg &= ~num;
+	gb->mem.irqFlagsReg &= ~num;
 }
 
-void memEnableVBlankIrq()
+void memEnableVBlankIrq(gb_t *gb)
 {
 	//printf("VBlank IRQ\n");
-	irqFlagsReg |= 1;
+	gb->mem.irqFlagsReg |= 1;
 }
 
-void memEnableStatIrq()
+void memEnableStatIrq(gb_t *gb)
 {
 	//printf("STAT IRQ\n");
-	irqFlagsReg |= 2;
+	gb->mem.irqFlagsReg |= 2;
 }
 
-uint8_t memGet8(uint16_t addr)
+//memGet8 for pages without a read pointer
+uint8_t memGet8Handler(gb_t *gb, uint16_t addr)
 {
-	return memGet8ptr[addr](addr);
+	if(addr >= 0xFF00)
+		return gb->mem.memGetIO8ptr[addr&0xFF](gb, addr);
+	return gb->mem.memGet8Region[addr>>12](gb, addr);
 }
 
-static uint8_t memGetROMBank8(uint16_t addr)
+static uint8_t memGetROMBank8(gb_t *gb, uint16_t addr)
 {
-	return emuGBROM[(cBank<<14)|(addr&0x3FFF)];
+	return gb->emuGBROM[(gb->mbc.cBank<<14)|(addr&0x3FFF)];
 }
 
-static uint8_t memGetROMNoBank8(uint16_t addr)
+static uint8_t memGetROMNoBank8(gb_t *gb, uint16_t addr)
 {
-	return emuGBROM[addr&0x7FFF];
+	return gb->emuGBROM[addr&0x7FFF];
 }
 
-static uint8_t memGetROM0Multicart8(uint16_t addr)
+static uint8_t memGetROM0Multicart8(gb_t *gb, uint16_t addr)
 {
-	return emuGBROM[(tBank0<<14)|(addr&0x3FFF)];
+	return gb->emuGBROM[(gb->mbc.tBank0<<14)|(addr&0x3FFF)];
 }
 
-static uint8_t memGetROM1Multicart8(uint16_t addr)
+static uint8_t memGetROM1Multicart8(gb_t *gb, uint16_t addr)
 {
-	return emuGBROM[(tBank1<<14)|(addr&0x3FFF)];
+	return gb->emuGBROM[(gb->mbc.tBank1<<14)|(addr&0x3FFF)];
 }
 
-static uint8_t memGetBootROMNoBank8(uint16_t addr)
+static uint8_t memGetBootROMNoBank8(gb_t *gb, uint16_t addr)
 {
 	if(addr < 0x100 || (addr >= 0x200 && addr < 0x900))
-		return memCGBBootrom[addr];
-	return emuGBROM[addr&0x7FFF];
+		return gb->mem.memCGBBootrom[addr];
+	return gb->emuGBROM[addr&0x7FFF];
 }
 
-static uint8_t memGetRAMBank8(uint16_t addr)
+static uint8_t memGetHiRAM8(gb_t *gb, uint16_t addr)
 {
-	return Main_Mem[(cgbMainBank<<12)|(addr&0xFFF)];
+	return gb->mem.High_Mem[addr&0x7F];
 }
 
-static uint8_t memGetRAMNoBank8(uint16_t addr)
+//runs the timer up to but not including the given main clock
+void memTimerRunTo(gb_t *gb, uint64_t clock)
 {
-	return Main_Mem[addr&0x1FFF];
+	if(clock <= gb->mem.timerClock)
+		return;
+	memTimerAdvance(gb, clock-gb->mem.timerClock);
+	gb->mem.timerClock = clock;
+	memTimerSchedule(gb);
 }
 
-static uint8_t memGetHiRAM8(uint16_t addr)
+//cpu accesses happen after the timer ran for the current clock
+static void memTimerCatchUp(gb_t *gb)
 {
-	return High_Mem[addr&0x7F];
+	memTimerRunTo(gb, gb->emuClock+1);
 }
 
-extern uint8_t curP1Out, curP2Out, curWavOut, curNoiseOut;
-static uint8_t memGetGeneralReg8(uint16_t addr)
+static uint8_t memGetGeneralReg8(gb_t *gb, uint16_t addr)
 {
 	switch(addr&0xFF)
 	{
 		case 0x01:
-			return serialReg;
+			return gb->mem.serialReg;
 		case 0x02:
-			return serialCtrlReg | (gbCgbMode ? 0x7C : 0x7E);
+			return gb->mem.serialCtrlReg | (gb->gbCgbMode ? 0x7C : 0x7E);
 		case 0x04:
-			return (divRegVal>>8);
+			memTimerCatchUp(gb);
+			return (gb->mem.divRegVal>>8);
 		case 0x05:
-			return timerRegVal;
+			memTimerCatchUp(gb);
+			return gb->mem.timerRegVal;
 		case 0x06:
-			return timerResetVal;
+			return gb->mem.timerResetVal;
 		case 0x07:
-			return timerReg|0xF8;
+			return gb->mem.timerReg|0xF8;
 		case 0x0F:
-			return irqFlagsReg|0xE0;
+			return gb->mem.irqFlagsReg|0xE0;
 		case 0x4D:
-			return (cpuDoStopSwitch | (cpuCgbSpeed<<7)) | 0x7E;
+			return (gb->cpu.cpuDoStopSwitch | (gb->cpu.cpuCgbSpeed<<7)) | 0x7E;
 		case 0x4F:
-			return ppuCgbBank;
+			return gb->ppu.ppuCgbBank;
 		case 0x51:
-			return cgbDmaSrc>>8;
+			return gb->mem.cgbDmaSrc>>8;
 		case 0x52:
-			return (cgbDmaSrc&0xFF);
+			return (gb->mem.cgbDmaSrc&0xFF);
 		case 0x53:
-			return (cgbDmaDst>>8)&0x1F;
+			return (gb->mem.cgbDmaDst>>8)&0x1F;
 		case 0x54:
-			return (cgbDmaDst&0xFF);
+			return (gb->mem.cgbDmaDst&0xFF);
 		case 0x55:
 			//bit 7 = 1 means NOT active
-			if(!cgbDmaActive)
-				return (0x80|(cgbDmaLen-1));
+			if(!gb->mem.cgbDmaActive)
+				return (0x80|(gb->mem.cgbDmaLen-1));
 			else
-				return cgbDmaLen-1;
+				return gb->mem.cgbDmaLen-1;
 		case 0x56:
-			return irReq|0x3C;
+			return gb->mem.irReq|0x3C;
 		case 0x6C:
-			return (!(gbCgbMode))|0xFE;
+			return (!(gb->gbCgbMode))|0xFE;
 		case 0x70:
-			return (gbCgbMode)?(cgbMainBank|0xF8):0xFF;
+			return (gb->gbCgbMode)?(gb->mem.cgbMainBank|0xF8):0xFF;
 		case 0x72:
-			return genericReg[0];
+			return gb->mem.genericReg[0];
 		case 0x73:
-			return genericReg[1];
+			return gb->mem.genericReg[1];
 		case 0x74:
-			return (gbCgbMode)?genericReg[2]:0xFF;
+			return (gb->gbCgbMode)?gb->mem.genericReg[2]:0xFF;
 		case 0x75:
-			return genericReg[3]|0x8F;
+			return gb->mem.genericReg[3]|0x8F;
 		case 0x76:
-			return curP1Out|(curP2Out<<4);
+			return gb->apu.curP1Out|(gb->apu.curP2Out<<4);
 		case 0x77:
-			return curWavOut|(curNoiseOut<<4);
+			return gb->apu.curWavOut|(gb->apu.curNoiseOut<<4);
 		case 0xFF:
-			return irqEnableReg|0xE0;
+			return gb->mem.irqEnableReg|0xE0;
 		default:
 			break;
 	}
 	return 0xFF;
 }
 
-static uint8_t memGetInvalid8(uint16_t addr)
+static uint8_t memGetInvalid8(gb_t *gb, uint16_t addr)
 {
+	(void)gb;
 	(void)addr;
 	return 0xFF;
 }
 
-void memSet8(uint16_t addr, uint8_t val)
+static uint8_t memGetOAMPage8(gb_t *gb, uint16_t addr)
 {
-	memSet8ptr[addr](addr,val);
+	if(addr < 0xFEA0)
+		return ppuGetOAM8(gb, addr);
+	return memGetInvalid8(gb, addr);
 }
 
-static void memSetRAMBank8(uint16_t addr, uint8_t val)
+//returns where the decoded instruction starting at addr
+//is kept, NULL for memory that cant be cached like IO
+memcode_t *memGetCode(gb_t *gb, uint16_t addr)
 {
-	Main_Mem[(cgbMainBank<<12)|(addr&0xFFF)] = val;
+	uint32_t bank;
+	switch(addr>>12)
+	{
+		case 0x0: case 0x1: case 0x2: case 0x3:
+			if(gb->mem.cgbBootromEnabled && (addr < 0x100 || (addr >= 0x200 && addr < 0x900)))
+				return NULL;
+			bank = gb->gbIsMulticart ? gb->mbc.tBank0 : 0;
+			break;
+		case 0x4: case 0x5: case 0x6: case 0x7:
+			if(gb->gbIsMulticart)
+				bank = gb->mbc.tBank1;
+			else
+				bank = gb->mbc.bankUsed ? gb->mbc.cBank : 1;
+			break;
+		case 0xC:
+			return &gb->mem.memCodeRAM[addr&0xFFF];
+		case 0xD:
+			if(gb->gbCgbMode)
+				return &gb->mem.memCodeRAM[(gb->mem.cgbMainBank<<12)|(addr&0xFFF)];
+			return &gb->mem.memCodeRAM[addr&0x1FFF];
+		case 0xF:
+			if(addr >= 0xFF80 && addr < 0xFFFF)
+				return &gb->mem.memCodeHiRAM[addr&0x7F];
+			return NULL;
+		default:
+			return NULL;
+	}
+	if(bank >= gb->mem.memCodeROMPages)
+		return NULL;
+	if(!gb->mem.memCodeROM[bank])
+	{
+		gb->mem.memCodeROM[bank] = calloc(0x4000, sizeof(memcode_t));
+		if(!gb->mem.memCodeROM[bank])
+			return NULL;
+	}
+	return &gb->mem.memCodeROM[bank][addr&0x3FFF];
 }
 
-static void memSetRAMNoBank8(uint16_t addr, uint8_t val)
+//memSet8 for pages without a write pointer
+void memSet8Handler(gb_t *gb, uint16_t addr, uint8_t val)
 {
-	Main_Mem[addr&0x1FFF] = val;
+	if(addr >= 0xFF00)
+	{
+		gb->mem.memSetIO8ptr[addr&0xFF](gb, addr, val);
+		return;
+	}
+	gb->mem.memSet8Region[addr>>12](gb, addr, val);
+	//mbc writes may have switched banks or enabled ram
+	if(addr < 0x8000)
+	{
+		memMapROM(gb);
+		memMapExtRAM(gb);
+	}
 }
 
-static void memSetHiRAM8(uint16_t addr, uint8_t val)
+static void memSetHiRAM8(gb_t *gb, uint16_t addr, uint8_t val)
 {
-	High_Mem[addr&0x7F] = val;
+	gb->mem.High_Mem[addr&0x7F] = val;
+	memClearCode(gb->mem.memCodeHiRAM, addr&0x7F, 0x7F);
 }
 
-static void memSetGeneralReg8(uint16_t addr, uint8_t val)
+static void memSetGeneralReg8(gb_t *gb, uint16_t addr, uint8_t val)
 {
 	switch(addr&0xFF)
 	{
 		case 0x01:
-			serialReg = val;
+			gb->mem.serialReg = val;
 			break;
 		case 0x02:
-			serialCtrlReg = val&(gbCgbMode ? 0x83 : 0x81);
-			sioTimerRegTimer = (serialCtrlReg&2) ? 1 : 32;
-			sioTimerRegEnable = (serialCtrlReg&0x81) == 0x81;
-			sioBitsTransfered = 0;
-			sioTimerRegClock = 1;
+			gb->mem.serialCtrlReg = val&(gb->gbCgbMode ? 0x83 : 0x81);
+			gb->mem.sioTimerRegTimer = (gb->mem.serialCtrlReg&2) ? 1 : 32;
+			gb->mem.sioTimerRegEnable = (gb->mem.serialCtrlReg&0x81) == 0x81;
+			gb->mem.sioBitsTransfered = 0;
+			gb->mem.sioTimerRegClock = 1;
 			break;
 		case 0x04:
-			divRegVal = 0; //writing any val resets to 0
+			memTimerCatchUp(gb);
+			gb->mem.divRegVal = 0; //writing any val resets to 0
+			memTimerSchedule(gb);
 			break;
 		case 0x05:
-			timerRegVal = val;
+			memTimerCatchUp(gb);
+			gb->mem.timerRegVal = val;
+			memTimerSchedule(gb);
 			break;
 		case 0x06:
-			timerResetVal = val;
+			memTimerCatchUp(gb);
+			gb->mem.timerResetVal = val;
+			memTimerSchedule(gb);
 			break;
 		case 0x07:
 			//if(val != 0)
 			//	printf("memSet8 %04x %02x\n", addr, val);
-			timerReg = val; //for readback
-			timerRegEnable = ((val&4)!=0);
+			memTimerCatchUp(gb);
+			gb->mem.timerReg = val; //for readback
+			gb->mem.timerRegEnable = ((val&4)!=0);
 			if((val&3)==0) //0 for 4096 Hz
-				timerRegBit = (1<<9);
+				gb->mem.timerRegBit = (1<<9);
 			else if((val&3)==1) //1 for 262144 Hz
-				timerRegBit = (1<<3);
+				gb->mem.timerRegBit = (1<<3);
 			else if((val&3)==2) //2 for 65536 Hz
-				timerRegBit = (1<<5);
+				gb->mem.timerRegBit = (1<<5);
 			else if((val&3)==3) //3 for 16384 Hz
-				timerRegBit = (1<<7);
+				gb->mem.timerRegBit = (1<<7);
+			memTimerSchedule(gb);
 			break;
 		case 0x0F:
-			irqFlagsReg = val&0x1F;
+			gb->mem.irqFlagsReg = val&0x1F;
 			break;
 		case 0x4D:
-			cpuDoStopSwitch = !!(val&1);
+			gb->cpu.cpuDoStopSwitch = !!(val&1);
 			break;
 		case 0x4F:
-			ppuCgbBank = (val&1);
+			gb->ppu.ppuCgbBank = (val&1);
 			break;
 		case 0x50:
-			memDisableCGBBootrom(val);
+			memDisableCGBBootrom(gb, val);
 			break;
 		case 0x51:
-			cgbDmaSrc = (cgbDmaSrc&0x00FF)|(val<<8);
+			gb->mem.cgbDmaSrc = (gb->mem.cgbDmaSrc&0x00FF)|(val<<8);
 			break;
 		case 0x52:
-			cgbDmaSrc = (cgbDmaSrc&0xFF00)|(val&~0xF);
+			gb->mem.cgbDmaSrc = (gb->mem.cgbDmaSrc&0xFF00)|(val&~0xF);
 			break;
 		case 0x53:
-			cgbDmaDst = (cgbDmaDst&0x00FF)|((val&0x1F)<<8)|0x8000;
+			gb->mem.cgbDmaDst = (gb->mem.cgbDmaDst&0x00FF)|((val&0x1F)<<8)|0x8000;
 			break;
 		case 0x54:
-			cgbDmaDst = (cgbDmaDst&0xFF00)|(val&~0xF);
+			gb->mem.cgbDmaDst = (gb->mem.cgbDmaDst&0xFF00)|(val&~0xF);
 			break;
 		case 0x55:
 			//disabling ongoing HBlank DMA when disabling HBlank mode
-			if(cgbDmaActive && cgbDmaHBlankMode && !(val&0x80))
-				cgbDmaActive = false;
+			if(gb->mem.cgbDmaActive && gb->mem.cgbDmaHBlankMode && !(val&0x80))
+				gb->mem.cgbDmaActive = false;
 			else //enable DMA in all other cases
 			{
-				cgbDmaActive = true;
-				cgbDmaLen = (val&0x7F)+1;
-				cgbDmaHBlankMode = !!(val&0x80);
-				//trigger immediately
-				memDmaClock = 16;
-				memDmaClockTimers();
+				gb->mem.cgbDmaActive = true;
+				gb->mem.cgbDmaLen = (val&0x7F)+1;
+				gb->mem.cgbDmaHBlankMode = !!(val&0x80);
+				//trigger immediately, this also always ran
+				//the timer for one more clock than usual
+				gb->mem.memDmaClock = 16;
+				memTimerCatchUp(gb);
+				memTimerAdvance(gb, 1);
+				memTimerSchedule(gb);
+				memClockDma(gb);
 			}
 			break;
 		case 0x56:
-			irReq = val;
+			gb->mem.irReq = val;
 			break;
 		case 0x70:
-			if(gbCgbMode)
+			if(gb->gbCgbMode)
 			{
-				cgbMainBank = (val&7);
-				if(cgbMainBank == 0)
-					cgbMainBank = 1;
+				gb->mem.cgbMainBank = (val&7);
+				if(gb->mem.cgbMainBank == 0)
+					gb->mem.cgbMainBank = 1;
+				memMapRAM(gb);
 			}
 			break;
 		case 0x72:
-			genericReg[0] = val;
+			gb->mem.genericReg[0] = val;
 			break;
 		case 0x73:
-			genericReg[1] = val;
+			gb->mem.genericReg[1] = val;
 			break;
 		case 0x74:
-			if(gbCgbMode)
-				genericReg[2] = val;
+			if(gb->gbCgbMode)
+				gb->mem.genericReg[2] = val;
 			break;
 		case 0x75:
-			genericReg[3] = val;
+			gb->mem.genericReg[3] = val;
 			break;
 		case 0xFF:
-			irqEnableReg = val&0x1F;
+			gb->mem.irqEnableReg = val&0x1F;
 			break;
 		default:
 			break;
 	}
 }
 
-static void memSetInvalid8(uint16_t addr, uint8_t val)
+static void memSetInvalid8(gb_t *gb, uint16_t addr, uint8_t val)
 {
+	(void)gb;
 	(void)addr;
 	(void)val;
 }
 
+static void memSetOAMPage8(gb_t *gb, uint16_t addr, uint8_t val)
+{
+	if(addr < 0xFEA0)
+		ppuSetOAM8(gb, addr, val);
+}
+
 #define DEBUG_MEM_DUMP 0
 
-void memDumpMainMem()
+void memDumpMainMem(gb_t *gb)
 {
 	#if DEBUG_MEM_DUMP
 	FILE *f = fopen("MainMem.bin","wb");
 	if(f)
 	{
-		fwrite(Main_Mem,1,gbCgbMode?0x8000:0x2000,f);
+		fwrite(gb->mem.Main_Mem,1,gb->gbCgbMode?0x8000:0x2000,f);
 		fclose(f);
 	}
 	f = fopen("HighMem.bin","wb");
 	if(f)
 	{
-		fwrite(High_Mem,1,0x80,f);
+		fwrite(gb->mem.High_Mem,1,0x80,f);
 		fclose(f);
 	}
-	ppuDumpMem();
+	ppuDumpMem(gb);
+	#else
+	(void)gb;
 	#endif
 }
-extern bool emuSaveEnabled;
-extern char emuSaveName[1024];
-void memLoadSave()
+void memLoadSave(gb_t *gb)
 {
-	if(emuSaveName[0] && (extTotalSize || rtcUsed))
+	if(gb->emuSaveName[0] && (gb->mbc.extTotalSize || gb->mbc.rtcUsed))
 	{
-		emuSaveEnabled = true;
+		gb->emuSaveEnabled = true;
 #ifndef __LIBRETRO__
-		FILE *save = fopen(emuSaveName, "rb");
+		//folds in whatever the last run left in the journal
+		saveJournalInit(gb);
+		FILE *save = fopen(gb->emuSaveName, "rb");
 		if(save)
 		{
 			fseek(save,0,SEEK_END);
 			size_t saveSize = ftell(save);
-			if(extTotalSize && (saveSize >= extTotalSize))
+			if(gb->mbc.extTotalSize && (saveSize >= gb->mbc.extTotalSize))
 			{
 				rewind(save);
-				mbcExtRAMLoad(save);
-				saveSize -= extTotalSize;
+				mbcExtRAMLoad(gb, save);
+				saveSize -= gb->mbc.extTotalSize;
 			}
-			if(rtcUsed && (saveSize >= mbcRTCSize()))
-				mbcRTCLoad(save);
-			printf("Mem: Done reading %s\n", emuSaveName);
+			if(gb->mbc.rtcUsed && (saveSize >= mbcRTCSize(gb)))
+				mbcRTCLoad(gb, save);
+			printf("Mem: Done reading %s\n", gb->emuSaveName);
 			fclose(save);
 		}
 #endif
@@ -926,131 +1018,236 @@ void memLoadSave()
 }
 
 #ifndef __LIBRETRO__
-void memSaveGame()
+void memSaveGame(gb_t *gb)
 {
-	if(emuSaveName[0] && ((emuSaveEnabled && extTotalSize) || rtcUsed))
+	if(gb->emuSaveName[0] && ((gb->emuSaveEnabled && gb->mbc.extTotalSize) || gb->mbc.rtcUsed))
 	{
-		FILE *save = fopen(emuSaveName, "wb");
+		//journal gets the last changes, it is only
+		//dropped once the full save is in place
+		saveJournalClose(gb);
+		FILE *save = saveFileOpen(gb->emuSaveName);
 		if(save)
 		{
-			if(emuSaveEnabled && extTotalSize)
-				mbcExtRAMStore(save);
-			if(rtcUsed)
-				mbcRTCStore(save);
-			printf("Mem: Done writing %s\n", emuSaveName);
-			fclose(save);
+			if(gb->emuSaveEnabled && gb->mbc.extTotalSize)
+				mbcExtRAMStore(gb, save);
+			if(gb->mbc.rtcUsed)
+				mbcRTCStore(gb, save);
+			if(saveFileCommit(save, gb->emuSaveName))
+			{
+				saveJournalRemove(gb);
+				printf("Mem: Done writing %s\n", gb->emuSaveName);
+			}
 		}
 	}
 }
 #endif
 
-extern bool gbEmuGBSPlayback;
-extern bool gbsTimerMode;
-extern uint8_t inValReads[8];
 //clocked at 262144 Hz (or 2x that in CGB Mode)
-void memClockTimers()
+void memClockTimers(gb_t *gb)
 {
-	if(gbEmuGBSPlayback)
+	if(gb->gbEmuGBSPlayback)
 	{
-		if(inValReads[BUTTON_RIGHT] && !gbs_prevValReads[BUTTON_RIGHT])
+		if(gb->input.inValReads[BUTTON_RIGHT] && !gb->mem.gbs_prevValReads[BUTTON_RIGHT])
 		{
-			gbs_prevValReads[BUTTON_RIGHT] = inValReads[BUTTON_RIGHT];
-			curGBS++;
-			if(curGBS > gbsTracksTotal)
-				curGBS = 1;
+			gb->mem.gbs_prevValReads[BUTTON_RIGHT] = gb->input.inValReads[BUTTON_RIGHT];
+			gb->mem.curGBS++;
+			if(gb->mem.curGBS > gb->gbsTracksTotal)
+				gb->mem.curGBS = 1;
 			//printf("\rTrack %i/%i         ", curGBS, gbsTracksTotal);
-			ppuDrawGBSTrackNum(curGBS, gbsTracksTotal);
-			cpuLoadGBS(curGBS-1);
+			ppuDrawGBSTrackNum(gb, gb->mem.curGBS, gb->gbsTracksTotal);
+			cpuLoadGBS(gb, gb->mem.curGBS-1);
 		}
-		else if(!inValReads[BUTTON_RIGHT])
-			gbs_prevValReads[BUTTON_RIGHT] = 0;
+		else if(!gb->input.inValReads[BUTTON_RIGHT])
+			gb->mem.gbs_prevValReads[BUTTON_RIGHT] = 0;
 		
-		if(inValReads[BUTTON_LEFT] && !gbs_prevValReads[BUTTON_LEFT])
+		if(gb->input.inValReads[BUTTON_LEFT] && !gb->mem.gbs_prevValReads[BUTTON_LEFT])
 		{
-			gbs_prevValReads[BUTTON_LEFT] = inValReads[BUTTON_LEFT];
-			curGBS--;
-			if(curGBS < 1)
-				curGBS = gbsTracksTotal;
+			gb->mem.gbs_prevValReads[BUTTON_LEFT] = gb->input.inValReads[BUTTON_LEFT];
+			gb->mem.curGBS--;
+			if(gb->mem.curGBS < 1)
+				gb->mem.curGBS = gb->gbsTracksTotal;
 			//printf("\rTrack %i/%i         ", curGBS, gbsTracksTotal);
-			ppuDrawGBSTrackNum(curGBS, gbsTracksTotal);
-			cpuLoadGBS(curGBS-1);
+			ppuDrawGBSTrackNum(gb, gb->mem.curGBS, gb->gbsTracksTotal);
+			cpuLoadGBS(gb, gb->mem.curGBS-1);
 		}
-		else if(!inValReads[BUTTON_LEFT])
-			gbs_prevValReads[BUTTON_LEFT] = 0;
+		else if(!gb->input.inValReads[BUTTON_LEFT])
+			gb->mem.gbs_prevValReads[BUTTON_LEFT] = 0;
 	}
 
-	if(sioTimerRegEnable)
+	if(gb->mem.sioTimerRegEnable)
 	{
 		//clocked at specified rate
-		if(sioTimerRegClock == sioTimerRegTimer)
+		if(gb->mem.sioTimerRegClock == gb->mem.sioTimerRegTimer)
 		{
-			sioTimerRegClock = 1;
-			serialReg <<= 1;
-			serialReg |= 1; //no serial cable=bit set
-			sioBitsTransfered++;
-			if(sioBitsTransfered == 8)
+			gb->mem.sioTimerRegClock = 1;
+			gb->mem.serialReg <<= 1;
+			gb->mem.serialReg |= 1; //no serial cable=bit set
+			gb->mem.sioBitsTransfered++;
+			if(gb->mem.sioBitsTransfered == 8)
 			{
 				//printf("SIO interrupt\n");
-				sioBitsTransfered = 0;
-				irqFlagsReg |= 8;
-				sioTimerRegEnable = false;
-				serialCtrlReg &= 3;
+				gb->mem.sioBitsTransfered = 0;
+				gb->mem.irqFlagsReg |= 8;
+				gb->mem.sioTimerRegEnable = false;
+				gb->mem.serialCtrlReg &= 3;
 			}
 		}
 		else
-			sioTimerRegClock++;
+			gb->mem.sioTimerRegClock++;
 	}
 }
 
-extern bool cpuDmaHalt;
-extern uint8_t cpuAddSpeed;
-//clocked at 131072 Hz
-void memDmaClockTimers()
+//checks for dma every clock, triggers every 16 clocks
+void memClockDma(gb_t *gb)
 {
-	divRegVal += cpuAddSpeed;
-	//clocked at specified rate
-	if((timerRegBit&divRegVal) && timerRegEnable)
-			timerPrevTicked = true;
-	else if(timerPrevTicked)
-	{
-		timerRegVal++;
-		if(timerRegVal == 0) //set on overflow
-		{
-			//printf("Timer interrupt\n");
-			timerRegVal = timerResetVal;
-			if(!gbEmuGBSPlayback)
-				irqFlagsReg |= 4;
-			else if(gbsTimerMode)
-				cpuPlayGBS();
-		}
-		timerPrevTicked = false;
-	}
-
-	if(memDmaClock >= 16)
+	if(gb->mem.memDmaClock >= 16)
 	{
-		cpuDmaHalt = false;
-		if(!cgbDmaActive)
+		gb->cpu.cpuDmaHalt = false;
+		if(!gb->mem.cgbDmaActive)
 			return;
 		//printf("%04x %04x %02x\n", cgbDmaSrc, cgbDmaDst, cgbDmaLen);
-		if(cgbDmaLen && ((cgbDmaSrc < 0x8000) || (cgbDmaSrc >= 0xA000 && cgbDmaSrc < 0xE000)) && (cgbDmaDst >= 0x8000 && cgbDmaDst < 0xA000))
+		if(gb->mem.cgbDmaLen && ((gb->mem.cgbDmaSrc < 0x8000) || (gb->mem.cgbDmaSrc >= 0xA000 && gb->mem.cgbDmaSrc < 0xE000)) && (gb->mem.cgbDmaDst >= 0x8000 && gb->mem.cgbDmaDst < 0xA000))
 		{
-			if(!cgbDmaHBlankMode || (cgbDmaHBlankMode && ppuInHBlank()))
+			if(!gb->mem.cgbDmaHBlankMode || (gb->mem.cgbDmaHBlankMode && ppuInHBlank(gb)))
 			{
-				uint8_t i;
-				for(i = 0; i < 0x10; i++)
-					memSet8(cgbDmaDst+i, memGet8(cgbDmaSrc+i));
-				cgbDmaLen--;
-				if(cgbDmaLen == 0)
-					cgbDmaActive = false;
-				cgbDmaSrc += 0x10;
-				cgbDmaDst += 0x10;
-				cpuDmaHalt = true;
+				//blocks are 16 byte aligned so they never cross a
+				//page, rom and main ram can be copied from directly
+				const uint8_t *src = gb->mem.memReadPage[gb->mem.cgbDmaSrc>>8];
+				uint8_t buf[0x10];
+				if(src)
+					src += (gb->mem.cgbDmaSrc&0xFF);
+				else
+				{
+					uint8_t i;
+					for(i = 0; i < 0x10; i++)
+						buf[i] = memGet8(gb, gb->mem.cgbDmaSrc+i);
+					src = buf;
+				}
+				ppuSetVRAMBlock(gb, gb->mem.cgbDmaDst, src, 0x10);
+				gb->mem.cgbDmaLen--;
+				if(gb->mem.cgbDmaLen == 0)
+					gb->mem.cgbDmaActive = false;
+				gb->mem.cgbDmaSrc += 0x10;
+				gb->mem.cgbDmaDst += 0x10;
+				gb->cpu.cpuDmaHalt = true;
 			}
 		}
 		else
-			cgbDmaActive = false;
-		memDmaClock = 1;
+			gb->mem.cgbDmaActive = false;
+		gb->mem.memDmaClock = 1;
 	}
 	else
-		memDmaClock++;
+		gb->mem.memDmaClock++;
+}
+
+//catch-up mode, same as calling memClockDma the given amount of
+//times while no dma is active, the counter just stops at 16 then
+void memDmaCatchUp(gb_t *gb, uint32_t clocks)
+{
+	if(!clocks)
+		return;
+	if(gb->mem.memDmaClock+clocks > 16)
+		gb->cpu.cpuDmaHalt = false;
+	gb->mem.memDmaClock = (gb->mem.memDmaClock+clocks > 16) ? 16 : (gb->mem.memDmaClock+clocks);
+}
+
+static void memTimerTick(gb_t *gb, uint32_t ticks)
+{
+	while(ticks)
+	{
+		uint32_t left = 0x100-gb->mem.timerRegVal;
+		if(ticks < left)
+		{
+			gb->mem.timerRegVal += ticks;
+			return;
+		}
+		ticks -= left;
+		//set on overflow
+		//printf("Timer interrupt\n");
+		gb->mem.timerRegVal = gb->mem.timerResetVal;
+		if(!gb->gbEmuGBSPlayback)
+			gb->mem.irqFlagsReg |= 4;
+		else if(gb->gbsTimerMode)
+			cpuPlayGBS(gb);
+	}
+}
+
+//same as running the timer clock by clock, div goes up every clock
+//and tima ticks when the selected div bit falls, the bit only gets
+//checked after each clock, so tac and div writes that make it fall
+//right after a clock it was set in still make tima tick once
+static void memTimerAdvance(gb_t *gb, uint64_t clocks)
+{
+	uint32_t speed = gb->cpu.cpuAddSpeed;
+	uint32_t period = gb->mem.timerRegBit<<1;
+	uint64_t first = gb->mem.divRegVal+speed;
+	uint64_t last = gb->mem.divRegVal+clocks*speed;
+	bool firstSet = gb->mem.timerRegEnable && (first&gb->mem.timerRegBit);
+	uint64_t ticks = (gb->mem.timerPrevTicked && !firstSet);
+	//every time the bit falls after the first clock
+	if(gb->mem.timerRegEnable)
+		ticks += (last/period) - (first/period);
+	gb->mem.divRegVal = (uint16_t)last;
+	gb->mem.timerPrevTicked = gb->mem.timerRegEnable && (last&gb->mem.timerRegBit);
+	while(ticks > UINT32_MAX)
+	{
+		memTimerTick(gb, UINT32_MAX);
+		ticks -= UINT32_MAX;
+	}
+	memTimerTick(gb, ticks);
+}
+
+//finds the clock tima overflows on next
+static void memTimerSchedule(gb_t *gb)
+{
+	uint32_t speed = gb->cpu.cpuAddSpeed;
+	uint32_t period = gb->mem.timerRegBit<<1;
+	uint64_t first = gb->mem.divRegVal+speed;
+	bool firstSet = gb->mem.timerRegEnable && (first&gb->mem.timerRegBit);
+	uint32_t ticks = 0x100-gb->mem.timerRegVal;
+	gb->mem.timerNextClock = UINT64_MAX;
+	//the first clock may tick no matter what
+	if(gb->mem.timerPrevTicked && !firstSet)
+	{
+		if(ticks == 1)
+		{
+			gb->mem.timerNextClock = gb->mem.timerClock;
+			return;
+		}
+		ticks--;
+	}
+	if(!gb->mem.timerRegEnable)
+		return;
+	//clock the bit falls on for the last tick
+	uint64_t fall = ((first/period)+ticks)*period;
+	uint64_t clocks = (fall-gb->mem.divRegVal+speed-1)/speed;
+	gb->mem.timerNextClock = gb->mem.timerClock+clocks-1;
+}
+
+
+//clocks until the timer may overflow next, can be early
+uint32_t memTimerNextEvent(gb_t *gb)
+{
+	if(gb->mem.timerNextClock == UINT64_MAX)
+		return EMU_EVENT_NONE;
+	uint64_t clocks = gb->mem.timerNextClock-gb->mem.timerClock;
+	return (clocks < EMU_EVENT_NONE) ? clocks : (EMU_EVENT_NONE-1);
+}
+
+//clocks until DIV may read as something else, can be early
+uint32_t memDivNextChange(gb_t *gb)
+{
+	uint32_t clocks = (0x100-(gb->mem.divRegVal&0xFF))/gb->cpu.cpuAddSpeed;
+	return (clocks > 2) ? clocks-2 : 0;
+}
+
+//clocks until the serial transfer may finish, can be early
+uint32_t memSerialNextEvent(gb_t *gb)
+{
+	if(!gb->mem.sioTimerRegEnable)
+		return EMU_EVENT_NONE;
+	uint32_t calls = (gb->mem.sioTimerRegTimer-gb->mem.sioTimerRegClock)
+		+ (7-gb->mem.sioBitsTransfered)*gb->mem.sioTimerRegTimer;
+	//memClockTimers runs every 4 cpu clocks
+	return calls*((gb->cpuTimer+1)<<2);
 }
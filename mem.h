@@ -8,26 +8,64 @@
 #ifndef _mem_h_
 #define _mem_h_
 
-typedef uint8_t (*get8FuncT)(uint16_t);
-typedef void (*set8FuncT)(uint16_t, uint8_t val);
+bool memInit(gb_t *gb, bool romcheck, bool gbs);
+void memDeinit(gb_t *gb);
+void memInitGetSetPointers(gb_t *gb);
+bool memInitCGBBootrom(gb_t *gb);
+uint8_t memGet8Handler(gb_t *gb, uint16_t addr);
+void memSet8Handler(gb_t *gb, uint16_t addr, uint8_t val);
+memcode_t *memGetCode(gb_t *gb, uint16_t addr);
+void memStartGBS(gb_t *gb);
+void memDumpMainMem(gb_t *gb);
+void memClockTimers(gb_t *gb);
+void memClockDma(gb_t *gb);
+void memDmaCatchUp(gb_t *gb, uint32_t clocks);
+void memTimerRunTo(gb_t *gb, uint64_t clock);
+uint32_t memTimerNextEvent(gb_t *gb);
+uint32_t memDivNextChange(gb_t *gb);
+uint32_t memSerialNextEvent(gb_t *gb);
+void memSaveGame(gb_t *gb);
 
-bool memInit(bool romcheck, bool gbs);
-void memDeinit();
-void memInitGetSetPointers();
-bool memInitCGBBootrom();
-uint8_t memGet8(uint16_t addr);
-void memSet8(uint16_t addr, uint8_t val);
-void memStartGBS();
-void memDumpMainMem();
-void memClockTimers();
-void memDmaClockTimers();
-void memSaveGame();
+uint8_t memGetCurIrqList(gb_t *gb);
+void memClearCurIrqList(gb_t *gb, uint8_t num);
+void memEnableVBlankIrq(gb_t *gb);
+void memEnableStatIrq(gb_t *gb);
 
-uint8_t memGetCurIrqList();
-void memClearCurIrqList(uint8_t num);
-void memEnableVBlankIrq();
-void memEnableStatIrq();
+//decoded instructions are up to 3 bytes long and never
+//cross a 4KB block, so only these could contain pos
+static inline void memClearCode(memcode_t *code, uint16_t pos, uint16_t blockMask)
+{
+	code[pos].len = 0;
+	if(pos&blockMask)
+	{
+		code[pos-1].len = 0;
+		if((pos&blockMask) > 1)
+			code[pos-2].len = 0;
+	}
+}
 
-extern uint8_t Ext_Mem[0x20000];
+//pages with a pointer get accessed right here so the cpu
+//interpreter has them inlined, which mbc is used only
+//changes where the pointers go
+static inline uint8_t memGet8(gb_t *gb, uint16_t addr)
+{
+	const uint8_t *page = gb->mem.memReadPage[addr>>8];
+	if(page)
+		return page[addr&0xFF];
+	return memGet8Handler(gb, addr);
+}
+
+static inline void memSet8(gb_t *gb, uint16_t addr, uint8_t val)
+{
+	uint8_t *page = gb->mem.memWritePage[addr>>8];
+	if(page)
+	{
+		//only main ram gets written directly
+		page[addr&0xFF] = val;
+		memClearCode(gb->mem.memCodeRAM, (page+(addr&0xFF))-gb->mem.Main_Mem, 0xFFF);
+		return;
+	}
+	memSet8Handler(gb, addr, val);
+}
 
 #endif
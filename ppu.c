@@ -10,10 +10,26 @@
 #include <string.h>
 #include <inttypes.h>
 #include <string.h>
+#include "gb.h"
 #include "cpu.h"
 #include "ppu.h"
 #include "mem.h"
 
+//tile decode and palette kernels with sse2 and avx2, picked at
+//runtime from what the cpu has, build with PPU_SIMD=0 to only
+//ever use the plain c versions
+#ifndef PPU_SIMD
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PPU_SIMD 1
+#else
+#define PPU_SIMD 0
+#endif
+#endif
+
+#if PPU_SIMD
+#include <immintrin.h>
+#endif
+
 //FF40
 #define PPU_BG_ENABLE (1<<0)
 #define PPU_SPRITE_ENABLE (1<<1)
@@ -40,43 +56,15 @@
 #define PPU_TILE_FLIP_Y (1<<6)
 #define PPU_TILE_PRIO (1<<7)
 
-static void ppuDrawDotDMG(size_t drawPos);
-static void ppuDrawDotCGB_DMGMode(size_t drawPos);
-static void ppuDrawDotCGB(size_t drawPos);
-
-typedef void (*drawFunc)(size_t);
-static drawFunc ppuDrawDot = NULL;
-
-//from main.c
-extern uint32_t textureImage[0x5A00];
-extern bool gbCgbMode;
-extern bool gbCgbBootrom;
-extern bool gbAllowInvVRAM;
-//used externally
-uint8_t ppuCgbBank = 0;
-
-static uint32_t ppuClock;
-static uint8_t ppuMode;
-static uint8_t ppuDots;
-static uint8_t ppuLines;
-static uint8_t ppuLineMatch;
-static uint8_t ppuOAMpos;
-static uint8_t ppuOAM2pos;
-static uint8_t ppuCgbBgPalPos;
-static uint8_t ppuCgbObjPalPos;
-static uint8_t PPU_Reg[12];
-static uint8_t PPU_OAM[0xA0];
-static uint8_t PPU_OAM2[0x28];
-static uint8_t PPU_VRAM[0x4000];
-static uint32_t PPU_BGRLUT[4];
-static uint8_t PPU_CGB_BGPAL[0x40];
-static uint8_t PPU_CGB_OBJPAL[0x40];
-static uint32_t PPU_CGB_BGRLUT[0x8000];
-static bool ppuFrameDone;
-static bool ppuVBlank;
-static bool ppuVBlankTriggered;
-static bool ppuHBlank;
-static bool ppuHBlankTriggered;
+//tiles 0x8000-0x97FF of one vram bank
+#define PPU_BANK_TILES 0x180
+
+static void ppuDrawDotDMG(gb_t *gb, size_t drawPos);
+static void ppuDrawDotCGB_DMGMode(gb_t *gb, size_t drawPos);
+static void ppuDrawDotCGB(gb_t *gb, size_t drawPos);
+static void ppuDrawLineDMG(gb_t *gb);
+static void ppuDrawLineCGB_DMGMode(gb_t *gb);
+static void ppuDrawLineCGB(gb_t *gb);
 
 //default values when starting ROM with 0x80 and 0xC0 at 0x143
 static const uint8_t defaultCGBBgPal[0x40] = {
@@ -93,59 +81,153 @@ static const uint8_t defaultCGBObjPal[0x40] = {
 	0x0E, 0x08, 0xFE, 0xAF, 0x20, 0x02, 0xD7, 0xFF, 0x07, 0x6A, 0x55, 0xEC, 0x83, 0x40, 0x0B, 0x77, 
 };
 
-void ppuInit()
+//decodes all 8 rows of a tile into 1 byte per dot, dec gets them
+//as they are and decFlip with each row mirrored
+static void ppuDecodeTileC(const uint8_t *chr, uint8_t *dec, uint8_t *decFlip)
+{
+	uint8_t y, x;
+	for(y = 0; y < 8; y++)
+	{
+		uint8_t ChrRegA = chr[y<<1], ChrRegB = chr[(y<<1)+1];
+		for(x = 0; x < 8; x++)
+		{
+			uint8_t color = ((ChrRegA>>(7-x))&1)|(((ChrRegB>>(7-x))&1)<<1);
+			dec[(y<<3)+x] = color;
+			decFlip[(y<<3)+(x^7)] = color;
+		}
+	}
+}
+
+//writes the line colors of the given palette indices
+static void ppuExpandLineC(uint32_t *line, const uint8_t *idx, const uint32_t *pal, uint8_t len)
+{
+	while(len--)
+		*line++ = pal[*idx++];
+}
+
+#if PPU_SIMD
+//2 rows at once, every plane byte gets spread over 8 bytes and
+//tested against the bit each dot in it stands for
+__attribute__((target("sse2")))
+static void ppuDecodeTileSSE2(const uint8_t *chr, uint8_t *dec, uint8_t *decFlip)
+{
+	const __m128i bits = _mm_set_epi8(1,2,4,8,16,32,64,-128,1,2,4,8,16,32,64,-128);
+	const __m128i bitsFlip = _mm_set_epi8(-128,64,32,16,8,4,2,1,-128,64,32,16,8,4,2,1);
+	const __m128i one = _mm_set1_epi8(1), two = _mm_set1_epi8(2);
+	uint8_t y;
+	for(y = 0; y < 8; y += 2)
+	{
+		__m128i planeA = _mm_set_epi64x(chr[(y<<1)+2]*0x0101010101010101ULL, chr[y<<1]*0x0101010101010101ULL);
+		__m128i planeB = _mm_set_epi64x(chr[(y<<1)+3]*0x0101010101010101ULL, chr[(y<<1)+1]*0x0101010101010101ULL);
+		__m128i color = _mm_or_si128(
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(planeA, bits), bits), one),
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(planeB, bits), bits), two));
+		__m128i colorFlip = _mm_or_si128(
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(planeA, bitsFlip), bitsFlip), one),
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(planeB, bitsFlip), bitsFlip), two));
+		_mm_storeu_si128((__m128i*)(dec+(y<<3)), color);
+		_mm_storeu_si128((__m128i*)(decFlip+(y<<3)), colorFlip);
+	}
+}
+
+//8 dots at once, each group of 8 palette colors is a table for
+//vpermd and bits 3 and 4 of the index pick which group to use
+__attribute__((target("avx2")))
+static void ppuExpandLineAVX2(uint32_t *line, const uint8_t *idx, const uint32_t *pal, uint8_t len)
+{
+	const __m256i pal0 = _mm256_loadu_si256((const __m256i*)pal);
+	const __m256i pal1 = _mm256_loadu_si256((const __m256i*)(pal+8));
+	const __m256i pal2 = _mm256_loadu_si256((const __m256i*)(pal+16));
+	const __m256i pal3 = _mm256_loadu_si256((const __m256i*)(pal+24));
+	while(len >= 8)
+	{
+		__m256i sel = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)idx));
+		__m256 sel3 = _mm256_castsi256_ps(_mm256_slli_epi32(sel, 28));
+		__m256 sel4 = _mm256_castsi256_ps(_mm256_slli_epi32(sel, 27));
+		__m256 lo = _mm256_blendv_ps(_mm256_castsi256_ps(_mm256_permutevar8x32_epi32(pal0, sel)),
+			_mm256_castsi256_ps(_mm256_permutevar8x32_epi32(pal1, sel)), sel3);
+		__m256 hi = _mm256_blendv_ps(_mm256_castsi256_ps(_mm256_permutevar8x32_epi32(pal2, sel)),
+			_mm256_castsi256_ps(_mm256_permutevar8x32_epi32(pal3, sel)), sel3);
+		_mm256_storeu_si256((__m256i*)line, _mm256_castps_si256(_mm256_blendv_ps(lo, hi, sel4)));
+		line += 8;
+		idx += 8;
+		len -= 8;
+	}
+	ppuExpandLineC(line, idx, pal, len);
+}
+#endif
+
+static void ppuInitKernels(gb_t *gb)
+{
+	gb->ppu.ppuDecodeTile = ppuDecodeTileC;
+	gb->ppu.ppuExpandLine = ppuExpandLineC;
+#if PPU_SIMD
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2"))
+		gb->ppu.ppuDecodeTile = ppuDecodeTileSSE2;
+	if(__builtin_cpu_supports("avx2"))
+		gb->ppu.ppuExpandLine = ppuExpandLineAVX2;
+#endif
+}
+
+void ppuInit(gb_t *gb)
 {
 	//Set start line
-	if(gbCgbBootrom)
+	if(gb->gbCgbBootrom)
 	{
-		ppuClock = 4;
-		ppuMode = 2;
-		ppuLines = 0;
+		gb->ppu.ppuClock = 4;
+		gb->ppu.ppuMode = 2;
+		gb->ppu.ppuLines = 0;
 	}
 	else
 	{
-		if(gbCgbMode)
+		if(gb->gbCgbMode)
 		{
-			ppuClock = 170;
-			ppuMode = 1;
-			ppuLines = 144;
+			gb->ppu.ppuClock = 170;
+			gb->ppu.ppuMode = 1;
+			gb->ppu.ppuLines = 144;
 		}
 		else
 		{
-			ppuClock = 400;
-			ppuMode = 1;
-			ppuLines = 153;
+			gb->ppu.ppuClock = 400;
+			gb->ppu.ppuMode = 1;
+			gb->ppu.ppuLines = 153;
 		}
 	}
-	ppuDots = 0;
-	ppuLineMatch = 0;
-	ppuOAMpos = 0;
-	ppuOAM2pos = 0;
-	ppuCgbBgPalPos = 0;
-	ppuCgbObjPalPos = 0;
-	ppuCgbBank = 0;
-	ppuFrameDone = false;
-	ppuVBlank = false;
-	ppuVBlankTriggered = false;
-	ppuHBlank = false;
-	ppuHBlankTriggered = false;
-	ppuInitDrawPointer();
+	gb->ppu.ppuDots = 0;
+	gb->ppu.ppuLineMatch = 0;
+	gb->ppu.ppuOAMpos = 0;
+	gb->ppu.ppuOAM2pos = 0;
+	gb->ppu.ppuCgbBgPalPos = 0;
+	gb->ppu.ppuCgbObjPalPos = 0;
+	gb->ppu.ppuCgbBank = 0;
+	gb->ppu.ppuFrameDone = false;
+	gb->ppu.ppuVBlank = false;
+	gb->ppu.ppuVBlankTriggered = false;
+	gb->ppu.ppuHBlank = false;
+	gb->ppu.ppuHBlankTriggered = false;
+	//frame skip settings stay, the first frame always gets drawn
+	gb->ppu.ppuDrawFrame = true;
+	gb->ppu.ppuFrameSkipPos = 0;
+	ppuInitKernels(gb);
+	ppuInitDrawPointer(gb);
 	//init buffers
-	memset(PPU_Reg,0,12);
-	memset(PPU_OAM,0,0xA0);
-	memset(PPU_OAM2,0,0x28);
-	memset(PPU_VRAM,0,0x4000);
-	PPU_Reg[4] = ppuLines;
+	memset(gb->ppu.PPU_Reg,0,12);
+	memset(gb->ppu.PPU_OAM,0,0xA0);
+	memset(gb->ppu.PPU_OAM2,0,0x28);
+	memset(gb->ppu.PPU_VRAM,0,0x4000);
+	memset(gb->ppu.PPU_TileDirty,true,sizeof(gb->ppu.PPU_TileDirty));
+	gb->ppu.PPU_Reg[4] = gb->ppu.ppuLines;
 	//set DMG BGR32 LUT
-	PPU_BGRLUT[0] = 0xFFFFFFFF; //White
-	PPU_BGRLUT[1] = 0xFFAAAAAA; //Light Gray
-	PPU_BGRLUT[2] = 0xFF555555; //Dark Gray
-	PPU_BGRLUT[3] = 0xFF000000; //Black
+	gb->ppu.PPU_BGRLUT[0] = 0xFFFFFFFF; //White
+	gb->ppu.PPU_BGRLUT[1] = 0xFFAAAAAA; //Light Gray
+	gb->ppu.PPU_BGRLUT[2] = 0xFF555555; //Dark Gray
+	gb->ppu.PPU_BGRLUT[3] = 0xFF000000; //Black
 	//from GBC Bootrom
-	if(gbCgbMode && !gbCgbBootrom)
+	if(gb->gbCgbMode && !gb->gbCgbBootrom)
 	{
-		memcpy(PPU_CGB_BGPAL,defaultCGBBgPal,0x40);
-		memcpy(PPU_CGB_OBJPAL,defaultCGBObjPal,0x40);
+		memcpy(gb->ppu.PPU_CGB_BGPAL,defaultCGBBgPal,0x40);
+		memcpy(gb->ppu.PPU_CGB_OBJPAL,defaultCGBObjPal,0x40);
 	}
 	//generate CGB BGR32 LUT
 	uint8_t r, g, b;
@@ -158,7 +240,7 @@ void ppuInit()
 			{
 				//this color mixing makes it look closer
 				//to what an actual GBC screen produces
-				PPU_CGB_BGRLUT[cgb_palpos++] = 
+				gb->ppu.PPU_CGB_BGRLUT[cgb_palpos++] = 
 					(r+(g*2)+(b*5)) //Blue
 					| ((r+(g*6)+b)<<8) //Green
 					| (((r*7)+g)<<16) //Red
@@ -166,221 +248,396 @@ void ppuInit()
 			}
 		}
 	}
-	if(!gbCgbBootrom)
+	if(!gb->gbCgbBootrom)
 	{
 		//From GB Bootrom
-		PPU_Reg[0] = 0x91;
-		PPU_Reg[7] = 0xFC;
-		PPU_Reg[8] = 0xFF;
-		PPU_Reg[9] = 0xFF;
+		gb->ppu.PPU_Reg[0] = 0x91;
+		gb->ppu.PPU_Reg[7] = 0xFC;
+		gb->ppu.PPU_Reg[8] = 0xFF;
+		gb->ppu.PPU_Reg[9] = 0xFF;
+	}
+}
+
+//marks the decoded copy of the tile at the given vram position as
+//outdated, pos includes the vram bank in bit 13
+static void ppuTileChanged(gb_t *gb, uint16_t pos)
+{
+	if((pos&0x1FFF) < 0x1800)
+		gb->ppu.PPU_TileDirty[((pos>>13)*PPU_BANK_TILES)+((pos&0x1FFF)>>4)] = true;
+}
+
+//one row of a tile with 1 byte per dot, the tile number counts
+//on from the first tile of bank 0 into bank 1, outdated tiles
+//get decoded again first, normal and flipped in one go
+static const uint8_t *ppuTileRow(gb_t *gb, uint16_t tile, uint8_t row, bool flipX)
+{
+	if(gb->ppu.PPU_TileDirty[tile])
+	{
+		const uint8_t *chr = gb->ppu.PPU_VRAM+((tile/PPU_BANK_TILES)<<13)+((tile%PPU_BANK_TILES)<<4);
+		gb->ppu.ppuDecodeTile(chr, gb->ppu.PPU_TileCache[tile][0], gb->ppu.PPU_TileCache[tile][1]);
+		gb->ppu.PPU_TileDirty[tile] = false;
+	}
+	return gb->ppu.PPU_TileCache[tile][flipX]+(row<<3);
+}
+
+//draws the current line up to the given dot, the whole line at
+//once if nothing of it got drawn yet and dot by dot otherwise,
+//per-clock mode always goes dot by dot so "make check" compares
+//the line renderers against it
+static void ppuDrawDots(gb_t *gb, uint8_t endDot)
+{
+	if(!gb->ppu.ppuDrawFrame || gb->ppu.ppuDots >= endDot)
+		return;
+	if(gb->ppu.ppuDots == 0 && endDot == 160 && gb->emuCatchUp)
+	{
+		gb->ppu.ppuDrawLine(gb);
+		gb->ppu.ppuDots = 160;
+		return;
+	}
+	size_t linePos = gb->ppu.ppuLines*160;
+	while(gb->ppu.ppuDots < endDot)
+	{
+		gb->ppu.ppuDrawDot(gb, linePos+gb->ppu.ppuDots);
+		gb->ppu.ppuDots++;
 	}
 }
 
-void ppuInitDrawPointer()
+//has to be called before anything the dots depend on changes,
+//draws all the dots the current line already went past
+static void ppuDrawPending(gb_t *gb)
+{
+	if((gb->ppu.PPU_Reg[0] & PPU_ENABLE) && gb->ppu.ppuMode == 3)
+		ppuDrawDots(gb, (gb->ppu.ppuClock > 92) ? gb->ppu.ppuClock-92 : 0);
+}
+
+void ppuInitDrawPointer(gb_t *gb)
 {
+	ppuDrawPending(gb);
 	//set draw method depending on DMG or CGB Mode
-	if(gbCgbMode)
-		ppuDrawDot = ppuDrawDotCGB;
-	else if(gbCgbBootrom)
-		ppuDrawDot = ppuDrawDotCGB_DMGMode;
+	if(gb->gbCgbMode)
+	{
+		gb->ppu.ppuDrawDot = ppuDrawDotCGB;
+		gb->ppu.ppuDrawLine = ppuDrawLineCGB;
+	}
+	else if(gb->gbCgbBootrom)
+	{
+		gb->ppu.ppuDrawDot = ppuDrawDotCGB_DMGMode;
+		gb->ppu.ppuDrawLine = ppuDrawLineCGB_DMGMode;
+	}
 	else
-		ppuDrawDot = ppuDrawDotDMG;
+	{
+		gb->ppu.ppuDrawDot = ppuDrawDotDMG;
+		gb->ppu.ppuDrawLine = ppuDrawLineDMG;
+	}
+}
+
+//decides if the frame starting on line 0 gets drawn
+static void ppuStartFrame(gb_t *gb)
+{
+	if(gb->ppu.ppuNextFrameSet)
+		gb->ppu.ppuDrawFrame = gb->ppu.ppuNextFrameDraw;
+	else
+		gb->ppu.ppuDrawFrame = (gb->ppu.ppuFrameSkipPos == 0);
+	gb->ppu.ppuNextFrameSet = false;
+	if(gb->ppu.ppuFrameSkipPos < gb->ppu.ppuFrameSkip)
+		gb->ppu.ppuFrameSkipPos++;
+	else
+		gb->ppu.ppuFrameSkipPos = 0;
+}
+
+//frames to leave undrawn after every drawn one, 0 draws all
+void ppuSetFrameSkip(gb_t *gb, uint8_t skip)
+{
+	gb->ppu.ppuFrameSkip = skip;
+	gb->ppu.ppuFrameSkipPos = 0;
+}
+
+//overrides the frame skip once for the next frame that starts
+void ppuSetNextFrameDraw(gb_t *gb, bool draw)
+{
+	gb->ppu.ppuNextFrameSet = true;
+	gb->ppu.ppuNextFrameDraw = draw;
 }
 
-static bool ppuHadIRQs = false;
-void ppuCheckIRQs()
+//whether the frame that just got done is in textureImage,
+//the image is left at the last drawn frame otherwise
+bool ppuFrameDrawn(gb_t *gb)
+{
+	return gb->ppu.ppuDrawFrame;
+}
+
+void ppuCheckIRQs(gb_t *gb)
 {
 	bool ppuHasIRQs = false;
-	if(ppuLineMatch && (PPU_Reg[1]&PPU_LINEMATCH_IRQ))
+	if(gb->ppu.ppuLineMatch && (gb->ppu.PPU_Reg[1]&PPU_LINEMATCH_IRQ))
 	{
 		//printf("Line STAT IRQ line %i clock %i\n", ppuLines, ppuClock);
 		ppuHasIRQs = true;
 	}
-	else if(ppuMode == 0 && (PPU_Reg[1]&PPU_HBLANK_IRQ))
+	else if(gb->ppu.ppuMode == 0 && (gb->ppu.PPU_Reg[1]&PPU_HBLANK_IRQ))
 	{
 		//printf("HBlank STAT IRQ line %i clock %i\n", ppuLines, ppuClock);
 		ppuHasIRQs = true;
 	}
-	else if((ppuMode == 1) && PPU_Reg[1]&PPU_VBLANK_IRQ)
+	else if((gb->ppu.ppuMode == 1) && gb->ppu.PPU_Reg[1]&PPU_VBLANK_IRQ)
 	{
 		//printf("VBlank STAT IRQ line %i clock %i\n", ppuLines, ppuClock);
 		ppuHasIRQs = true;
 	}
-	else if((ppuMode == 1 || ppuMode == 2) && (PPU_Reg[1]&PPU_OAM_IRQ))
+	else if((gb->ppu.ppuMode == 1 || gb->ppu.ppuMode == 2) && (gb->ppu.PPU_Reg[1]&PPU_OAM_IRQ))
 	{
 		//printf("OAM STAT IRQ line %i clock %i\n", ppuLines, ppuClock);
 		ppuHasIRQs = true;
 	}
 	if(ppuHasIRQs)
 	{
-		if(ppuHadIRQs == false)
+		if(gb->ppu.ppuHadIRQs == false)
 		{
 			//printf("Setting CPU IRQ\n");
-			memEnableStatIrq();
+			memEnableStatIrq(gb);
 		}
-		ppuHadIRQs = true;
+		gb->ppu.ppuHadIRQs = true;
 	}
 	else
-		ppuHadIRQs = false;
+		gb->ppu.ppuHadIRQs = false;
 }
 
-extern bool gbEmuGBSPlayback;
-void ppuCycle()
+void ppuCycle(gb_t *gb)
 {
-	if(gbEmuGBSPlayback)
+	if(gb->gbEmuGBSPlayback)
 		goto ppuIncreasePos;
-	if(!(PPU_Reg[0] & PPU_ENABLE))
+	if(!(gb->ppu.PPU_Reg[0] & PPU_ENABLE))
 		return;
 	//Update line match stat
-	ppuLineMatch = ((PPU_Reg[4] == PPU_Reg[5]) ? PPU_LINEMATCH : 0);
+	gb->ppu.ppuLineMatch = ((gb->ppu.PPU_Reg[4] == gb->ppu.PPU_Reg[5]) ? PPU_LINEMATCH : 0);
 	//check for line IRQ on first clock
-	if(ppuClock == 0)
+	if(gb->ppu.ppuClock == 0)
 	{
-		if(ppuLines > 0) //DONT check line 0 here, already done further below
-			ppuCheckIRQs();
+		if(gb->ppu.ppuLines > 0) //DONT check line 0 here, already done further below
+			ppuCheckIRQs(gb);
 	}
-	if(ppuLines < 144)
+	if(gb->ppu.ppuLines < 144)
 	{
 		//do OAM updates
-		if(ppuClock < 80)
+		if(gb->ppu.ppuClock < 80)
 		{
-			if(ppuClock == 0) //set OAM mode
+			if(gb->ppu.ppuClock == 0) //set OAM mode
 			{
-				ppuOAMpos = 0; //Reset check pos
-				ppuOAM2pos = 0; //Reset array pos
-				ppuMode = 2; //OAM
-				ppuHBlank = false;
-				ppuCheckIRQs();
+				if(gb->ppu.ppuLines == 0)
+					ppuStartFrame(gb);
+				gb->ppu.ppuOAMpos = 0; //Reset check pos
+				gb->ppu.ppuOAM2pos = 0; //Reset array pos
+				gb->ppu.ppuMode = 2; //OAM
+				gb->ppu.ppuHBlank = false;
+				ppuCheckIRQs(gb);
 			}
-			if(((ppuClock&1) == 0) && ppuOAM2pos < 10)
+			//selected sprites only matter for drawing
+			if(((gb->ppu.ppuClock&1) == 0) && gb->ppu.ppuOAM2pos < 10 && gb->ppu.ppuDrawFrame)
 			{
-				uint8_t OAMcYpos = PPU_OAM[(ppuOAMpos<<2)];
+				uint8_t OAMcYpos = gb->ppu.PPU_OAM[(gb->ppu.ppuOAMpos<<2)];
 				if(OAMcYpos < 160)
 				{
 					int16_t cmpPos = ((int16_t)OAMcYpos)-16;
-					uint8_t cSpriteAdd = (PPU_Reg[0] & PPU_SPRITE_8_16) ? 16 : 8;
-					if(cmpPos <= ppuLines && (cmpPos+cSpriteAdd) > ppuLines)
+					uint8_t cSpriteAdd = (gb->ppu.PPU_Reg[0] & PPU_SPRITE_8_16) ? 16 : 8;
+					if(cmpPos <= gb->ppu.ppuLines && (cmpPos+cSpriteAdd) > gb->ppu.ppuLines)
 					{
-						memcpy(PPU_OAM2+(ppuOAM2pos<<2), PPU_OAM+(ppuOAMpos<<2), 4);
-						ppuOAM2pos++;
+						memcpy(gb->ppu.PPU_OAM2+(gb->ppu.ppuOAM2pos<<2), gb->ppu.PPU_OAM+(gb->ppu.ppuOAMpos<<2), 4);
+						gb->ppu.ppuOAM2pos++;
 					}
 				}
-				ppuOAMpos++;
+				gb->ppu.ppuOAMpos++;
 			}
 		} //enter main mode
-		else if(ppuClock == 80)
+		else if(gb->ppu.ppuClock == 80)
 		{
-			ppuDots = 0; //Reset Draw Pos
-			ppuMode = 3; //Main Mode
-			ppuHBlank = false;
-		} //draw point
-		else if(ppuClock >= 92 && ppuClock < 252)
+			gb->ppu.ppuDots = 0; //Reset Draw Pos
+			gb->ppu.ppuMode = 3; //Main Mode
+			gb->ppu.ppuHBlank = false;
+		} //dots get drawn from 92 on, all of them at once here unless
+		//something they depend on changed while this line got drawn
+		else if(gb->ppu.ppuClock == 252)
 		{
-			//makes it possible to draw 160x144 in here :)
-			size_t drawPos = (ppuDots)+(ppuLines*160);
-			//heavy cpu load from this
-			ppuDrawDot(drawPos);
-			ppuDots++;
-		}
-		else if(ppuClock == 252)
-		{
-			ppuMode = 0; //HBlank
-			ppuHBlank = true;
-			ppuCheckIRQs();
+			ppuDrawDots(gb, 160);
+			gb->ppu.ppuMode = 0; //HBlank
+			gb->ppu.ppuHBlank = true;
+			ppuCheckIRQs(gb);
 		}
 	} //VERY important, reg 4 to the outside gets set back to 0 early!
-	else if(ppuLines == 153 && ppuClock == 4)
+	else if(gb->ppu.ppuLines == 153 && gb->ppu.ppuClock == 4)
 	{
-		PPU_Reg[4] = 0;
+		gb->ppu.PPU_Reg[4] = 0;
 		//check for linematch and IRQ early too
-		ppuLineMatch = ((PPU_Reg[4] == PPU_Reg[5]) ? PPU_LINEMATCH : 0);
-		ppuCheckIRQs();
+		gb->ppu.ppuLineMatch = ((gb->ppu.PPU_Reg[4] == gb->ppu.PPU_Reg[5]) ? PPU_LINEMATCH : 0);
+		ppuCheckIRQs(gb);
 	}
 ppuIncreasePos:
 	/* increase pos */
-	ppuClock++;
-	if(ppuClock == 456)
+	gb->ppu.ppuClock++;
+	if(gb->ppu.ppuClock == 456)
 	{
-		ppuClock = 0;
-		ppuLines++;
+		gb->ppu.ppuClock = 0;
+		gb->ppu.ppuLines++;
 		//check for vblank or draw done
-		if(ppuLines == 144)
+		if(gb->ppu.ppuLines == 144)
 		{
-			ppuMode = 1; //VBlank
-			ppuHBlank = false;
-			ppuVBlank = true;
-			memEnableVBlankIrq();
-			ppuCheckIRQs();
+			gb->ppu.ppuMode = 1; //VBlank
+			gb->ppu.ppuHBlank = false;
+			gb->ppu.ppuVBlank = true;
+			memEnableVBlankIrq(gb);
+			ppuCheckIRQs(gb);
 			//printf("VBlank Start\n");
 		}
-		else if(ppuLines == 154)
+		else if(gb->ppu.ppuLines == 154)
 		{
-			ppuLines = 0; //Draw Done!
-			ppuFrameDone = true;
-			ppuVBlank = false;
+			gb->ppu.ppuLines = 0; //Draw Done!
+			gb->ppu.ppuFrameDone = true;
+			gb->ppu.ppuVBlank = false;
 		}
 		//copy our line val into public reg
-		PPU_Reg[4] = ppuLines;
+		gb->ppu.PPU_Reg[4] = gb->ppu.ppuLines;
 	}
 	return;
 }
 
-bool ppuDrawDone()
+//clocks from now ppuCycle would do nothing in but
+//update the line match and move on to the next clock
+static uint32_t ppuIdleClocks(gb_t *gb)
+{
+	uint32_t clock = gb->ppu.ppuClock;
+	if(gb->ppu.ppuLines < 144)
+	{
+		//no sprites get selected for lines that do not get drawn
+		if(!gb->ppu.ppuDrawFrame && clock > 0 && clock < 80)
+			return 80-clock;
+		if(clock > 80 && clock < 252)
+			return 252-clock;
+		if(clock > 252 && clock < 455)
+			return 455-clock;
+		return 0;
+	}
+	//clock 4 of line 153 sets LY back to 0 early
+	if(gb->ppu.ppuLines == 153 && clock <= 4)
+		return (clock > 0 && clock < 4) ? 4-clock : 0;
+	if(clock > 0 && clock < 455)
+		return 455-clock;
+	return 0;
+}
+
+//catch-up mode, same as calling ppuCycle the given amount of times
+void ppuCatchUp(gb_t *gb, uint32_t clocks)
+{
+	if(gb->gbEmuGBSPlayback)
+	{
+		while(clocks--)
+			ppuCycle(gb);
+		return;
+	}
+	if(!(gb->ppu.PPU_Reg[0] & PPU_ENABLE))
+		return;
+	while(clocks)
+	{
+		uint32_t idle = ppuIdleClocks(gb);
+		if(idle)
+		{
+			if(idle > clocks)
+				idle = clocks;
+			gb->ppu.ppuLineMatch = ((gb->ppu.PPU_Reg[4] == gb->ppu.PPU_Reg[5]) ? PPU_LINEMATCH : 0);
+			gb->ppu.ppuClock += idle;
+			clocks -= idle;
+			continue;
+		}
+		ppuCycle(gb);
+		clocks--;
+	}
+}
+
+//clocks until ppuCycle may raise an interrupt next
+uint32_t ppuNextEvent(gb_t *gb)
+{
+	if(gb->gbEmuGBSPlayback || !(gb->ppu.PPU_Reg[0] & PPU_ENABLE))
+		return EMU_EVENT_NONE;
+	uint32_t clock = gb->ppu.ppuClock;
+	if(clock == 0)
+		return 0;
+	if(gb->ppu.ppuLines < 144 && clock <= 252)
+		return 252-clock;
+	if(gb->ppu.ppuLines == 153 && clock <= 4)
+		return 4-clock;
+	return 455-clock;
+}
+
+//clocks until LY or STAT may read as something else, can be early
+uint32_t ppuNextRegChange(gb_t *gb)
 {
-	if(ppuFrameDone)
+	//mode 3 starts without raising anything
+	if((gb->ppu.PPU_Reg[0] & PPU_ENABLE) && gb->ppu.ppuLines < 144 && gb->ppu.ppuClock > 0 && gb->ppu.ppuClock <= 80)
+		return 80-gb->ppu.ppuClock;
+	return ppuNextEvent(gb);
+}
+
+//clocks until ppuDrawDone gets set again
+uint32_t ppuFrameClocksLeft(gb_t *gb)
+{
+	if(!gb->gbEmuGBSPlayback && !(gb->ppu.PPU_Reg[0] & PPU_ENABLE))
+		return UINT32_MAX;
+	return ((153-gb->ppu.ppuLines)*456)+(456-gb->ppu.ppuClock);
+}
+
+bool ppuDrawDone(gb_t *gb)
+{
+	if(gb->ppu.ppuFrameDone)
 	{
-		ppuFrameDone = false;
+		gb->ppu.ppuFrameDone = false;
 		return true;
 	}
 	return false;
 }
 
-uint8_t ppuGetVRAMBank8(uint16_t addr)
+uint8_t ppuGetVRAMBank8(gb_t *gb, uint16_t addr)
 {
-	if(gbAllowInvVRAM || !(PPU_Reg[0] & PPU_ENABLE) || (ppuMode != 3))
-		return PPU_VRAM[(ppuCgbBank<<13)|(addr&0x1FFF)];
+	if(gb->gbAllowInvVRAM || !(gb->ppu.PPU_Reg[0] & PPU_ENABLE) || (gb->ppu.ppuMode != 3))
+		return gb->ppu.PPU_VRAM[(gb->ppu.ppuCgbBank<<13)|(addr&0x1FFF)];
 	return 0xFF;
 }
 
-uint8_t ppuGetVRAMNoBank8(uint16_t addr)
+uint8_t ppuGetVRAMNoBank8(gb_t *gb, uint16_t addr)
 {
-	if(gbAllowInvVRAM || !(PPU_Reg[0] & PPU_ENABLE) || (ppuMode != 3))
-		return PPU_VRAM[addr&0x1FFF];
+	if(gb->gbAllowInvVRAM || !(gb->ppu.PPU_Reg[0] & PPU_ENABLE) || (gb->ppu.ppuMode != 3))
+		return gb->ppu.PPU_VRAM[addr&0x1FFF];
 	return 0xFF;
 }
 
-extern bool cpu_oam_dma_running;
-uint8_t ppuGetOAM8(uint16_t addr)
+uint8_t ppuGetOAM8(gb_t *gb, uint16_t addr)
 {
-	if(gbAllowInvVRAM || ((!(PPU_Reg[0] & PPU_ENABLE) || (ppuMode == 0) || (ppuMode == 1)) && !cpu_oam_dma_running))
-		return PPU_OAM[addr&0xFF];
+	if(gb->gbAllowInvVRAM || ((!(gb->ppu.PPU_Reg[0] & PPU_ENABLE) || (gb->ppu.ppuMode == 0) || (gb->ppu.ppuMode == 1)) && !gb->cpu.cpu_oam_dma_running))
+		return gb->ppu.PPU_OAM[addr&0xFF];
 	return 0xFF;
 }
 
-uint8_t ppuGetReg8(uint16_t addr)
+uint8_t ppuGetReg8(gb_t *gb, uint16_t addr)
 {
 	uint8_t reg = addr&0x3F;
 	switch(reg)
 	{
 		case 0x0: /*case 0x1:*/ case 0x2: case 0x3: case 0x4: case 0x5:
 		case 0x6: case 0x7: case 0x8: case 0x9: case 0xA: case 0xB:
-			return PPU_Reg[reg];
+			return gb->ppu.PPU_Reg[reg];
 		case 0x1:
-			if(!(PPU_Reg[0] & PPU_ENABLE))
+			if(!(gb->ppu.PPU_Reg[0] & PPU_ENABLE))
 				return 0x80;
 			else
-				return (PPU_Reg[1]&(~7))|(ppuMode&3)|(ppuLineMatch&4)|0x80;
+				return (gb->ppu.PPU_Reg[1]&(~7))|(gb->ppu.ppuMode&3)|(gb->ppu.ppuLineMatch&4)|0x80;
 		case 0x28: //FF68
-			return ppuCgbBgPalPos|0x40;
+			return gb->ppu.ppuCgbBgPalPos|0x40;
 		case 0x29: //FF69
-			if(gbAllowInvVRAM || !(PPU_Reg[0] & PPU_ENABLE) || (ppuMode != 3))
-				return PPU_CGB_BGPAL[ppuCgbBgPalPos&0x3F];
+			if(gb->gbAllowInvVRAM || !(gb->ppu.PPU_Reg[0] & PPU_ENABLE) || (gb->ppu.ppuMode != 3))
+				return gb->ppu.PPU_CGB_BGPAL[gb->ppu.ppuCgbBgPalPos&0x3F];
 			return 0xFF;
 		case 0x2A: //FF6A
-			return ppuCgbObjPalPos|0x40;
+			return gb->ppu.ppuCgbObjPalPos|0x40;
 		case 0x2B: //FF6B
-			if(gbAllowInvVRAM || !(PPU_Reg[0] & PPU_ENABLE) || (ppuMode != 3))
-				return PPU_CGB_OBJPAL[ppuCgbObjPalPos&0x3F];
+			if(gb->gbAllowInvVRAM || !(gb->ppu.PPU_Reg[0] & PPU_ENABLE) || (gb->ppu.ppuMode != 3))
+				return gb->ppu.PPU_CGB_OBJPAL[gb->ppu.ppuCgbObjPalPos&0x3F];
 			return 0xFF;
 		default:
 			break;
@@ -388,28 +645,58 @@ uint8_t ppuGetReg8(uint16_t addr)
 	return 0xFF;
 }
 
-void ppuSetVRAMBank8(uint16_t addr, uint8_t val)
+void ppuSetVRAMBank8(gb_t *gb, uint16_t addr, uint8_t val)
 {
-	if(gbAllowInvVRAM || !(PPU_Reg[0] & PPU_ENABLE) || (ppuMode != 3))
-		PPU_VRAM[(ppuCgbBank<<13)|(addr&0x1FFF)] = val;
+	if(gb->gbAllowInvVRAM || !(gb->ppu.PPU_Reg[0] & PPU_ENABLE) || (gb->ppu.ppuMode != 3))
+	{
+		uint16_t pos = (gb->ppu.ppuCgbBank<<13)|(addr&0x1FFF);
+		if(gb->ppu.PPU_VRAM[pos] == val)
+			return;
+		ppuDrawPending(gb);
+		gb->ppu.PPU_VRAM[pos] = val;
+		ppuTileChanged(gb, pos);
+	}
 }
 
-void ppuSetVRAMNoBank8(uint16_t addr, uint8_t val)
+void ppuSetVRAMNoBank8(gb_t *gb, uint16_t addr, uint8_t val)
 {
-	if(gbAllowInvVRAM || !(PPU_Reg[0] & PPU_ENABLE) || (ppuMode != 3))
-		PPU_VRAM[addr&0x1FFF] = val;
+	if(gb->gbAllowInvVRAM || !(gb->ppu.PPU_Reg[0] & PPU_ENABLE) || (gb->ppu.ppuMode != 3))
+	{
+		uint16_t pos = addr&0x1FFF;
+		if(gb->ppu.PPU_VRAM[pos] == val)
+			return;
+		ppuDrawPending(gb);
+		gb->ppu.PPU_VRAM[pos] = val;
+		ppuTileChanged(gb, pos);
+	}
 }
 
-void ppuSetOAM8(uint16_t addr, uint8_t val)
+//same as calling the matching set function for each byte,
+//used by cgb dma which always writes whole 16 byte blocks
+void ppuSetVRAMBlock(gb_t *gb, uint16_t addr, const uint8_t *src, uint8_t len)
 {
-	if(gbAllowInvVRAM || ((!(PPU_Reg[0] & PPU_ENABLE) || (ppuMode == 0) || (ppuMode == 1)) && !cpu_oam_dma_running))
-		PPU_OAM[addr&0xFF] = val;
+	if(gb->gbAllowInvVRAM || !(gb->ppu.PPU_Reg[0] & PPU_ENABLE) || (gb->ppu.ppuMode != 3))
+	{
+		ppuDrawPending(gb);
+		uint16_t pos = addr&0x1FFF;
+		if(gb->gbCgbMode)
+			pos |= (gb->ppu.ppuCgbBank<<13);
+		memcpy(gb->ppu.PPU_VRAM+pos, src, len);
+		uint8_t i;
+		for(i = 0; i < len; i += 16)
+			ppuTileChanged(gb, pos+i);
+		if(len)
+			ppuTileChanged(gb, pos+len-1);
+	}
 }
 
-extern bool cpu_oam_dma;
-extern uint16_t cpu_oam_dma_addr;
+void ppuSetOAM8(gb_t *gb, uint16_t addr, uint8_t val)
+{
+	if(gb->gbAllowInvVRAM || ((!(gb->ppu.PPU_Reg[0] & PPU_ENABLE) || (gb->ppu.ppuMode == 0) || (gb->ppu.ppuMode == 1)) && !gb->cpu.cpu_oam_dma_running))
+		gb->ppu.PPU_OAM[addr&0xFF] = val;
+}
 
-void ppuSetReg8(uint16_t addr, uint8_t val)
+void ppuSetReg8(gb_t *gb, uint16_t addr, uint8_t val)
 {
 	bool prevEnable;
 	uint8_t reg = addr&0x3F;
@@ -418,82 +705,89 @@ void ppuSetReg8(uint16_t addr, uint8_t val)
 	{
 		/*case 0x0: case 0x1:*/ case 0x2: case 0x3: /*case 0x4: case 0x5:*/
 		/*case 0x6:*/ case 0x7: case 0x8: case 0x9: case 0xA: case 0xB:
-			PPU_Reg[reg] = val;
+			if(gb->ppu.PPU_Reg[reg] != val)
+				ppuDrawPending(gb);
+			gb->ppu.PPU_Reg[reg] = val;
 			break;
 		case 0x0: //Control reg
-			prevEnable = (PPU_Reg[0]&PPU_ENABLE);
-			PPU_Reg[0] = val;
+			if(gb->ppu.PPU_Reg[0] != val)
+				ppuDrawPending(gb);
+			prevEnable = (gb->ppu.PPU_Reg[0]&PPU_ENABLE);
+			gb->ppu.PPU_Reg[0] = val;
 			if(prevEnable && !(val&PPU_ENABLE))
 			{
-				PPU_Reg[4] = 0;
-				ppuMode = 0;
-				ppuHadIRQs = false;
+				gb->ppu.PPU_Reg[4] = 0;
+				gb->ppu.ppuMode = 0;
+				gb->ppu.ppuHadIRQs = false;
 			}
 			else if((val&PPU_ENABLE) && !prevEnable)
 			{
-				ppuLines = 0;
-				PPU_Reg[4] = 0;
+				gb->ppu.ppuLines = 0;
+				gb->ppu.PPU_Reg[4] = 0;
+				ppuStartFrame(gb);
 				//since it resets a bit into the screen
 				//it wont get through OAM fully
-				ppuClock = 4;
-				ppuOAMpos = 0; //Reset check pos
-				ppuOAM2pos = 0; //Reset array pos
-				ppuMode = 2; //OAM
-				ppuHBlank = false;
+				gb->ppu.ppuClock = 4;
+				gb->ppu.ppuOAMpos = 0; //Reset check pos
+				gb->ppu.ppuOAM2pos = 0; //Reset array pos
+				gb->ppu.ppuMode = 2; //OAM
+				gb->ppu.ppuHBlank = false;
 				//re-check IRQs right on enable
-				ppuLineMatch = ((PPU_Reg[4] == PPU_Reg[5]) ? PPU_LINEMATCH : 0);
-				ppuCheckIRQs();
+				gb->ppu.ppuLineMatch = ((gb->ppu.PPU_Reg[4] == gb->ppu.PPU_Reg[5]) ? PPU_LINEMATCH : 0);
+				ppuCheckIRQs(gb);
 			}
 			break;
 		case 0x1: //STAT RO Regs
-			if(!gbCgbMode)
+			if(!gb->gbCgbMode)
 			{
 				//printf("DMG Write STAT at line %i clock %i, %d %d %d\n", ppuLines, ppuClock, (ppuMode == 0 && !(PPU_Reg[1]&PPU_HBLANK_IRQ)),
 				//	(ppuMode == 1 && !(PPU_Reg[1]&PPU_VBLANK_IRQ)), !(ppuLineMatch && (PPU_Reg[1]&PPU_LINEMATCH_IRQ)));
 				//DMG STAT IRQ on HBlank/VBlank when no other IRQs previously enabled
-				if((ppuMode == 0 || ppuMode == 1) && !ppuHadIRQs)
+				if((gb->ppu.ppuMode == 0 || gb->ppu.ppuMode == 1) && !gb->ppu.ppuHadIRQs)
 				{
 					//printf("DMG Write STAT IRQ line %i clock %i\n", ppuLines, ppuClock);
-					memEnableStatIrq();
+					memEnableStatIrq(gb);
 				}
 			}
-			PPU_Reg[1] = (val&(~7));
-			if(PPU_Reg[0]&PPU_ENABLE)
-				ppuCheckIRQs();
+			gb->ppu.PPU_Reg[1] = (val&(~7));
+			if(gb->ppu.PPU_Reg[0]&PPU_ENABLE)
+				ppuCheckIRQs(gb);
 			break;
 		case 0x5: //LYC
-			PPU_Reg[5] = val;
-			ppuLineMatch = ((PPU_Reg[4] == PPU_Reg[5]) ? PPU_LINEMATCH : 0);
-			if(PPU_Reg[0]&PPU_ENABLE)
-				ppuCheckIRQs();
+			gb->ppu.PPU_Reg[5] = val;
+			gb->ppu.ppuLineMatch = ((gb->ppu.PPU_Reg[4] == gb->ppu.PPU_Reg[5]) ? PPU_LINEMATCH : 0);
+			if(gb->ppu.PPU_Reg[0]&PPU_ENABLE)
+				ppuCheckIRQs(gb);
 			break;
 		case 0x6: //OAM DMA
-			PPU_Reg[6] = val;
-			cpu_oam_dma = true;
-			cpu_oam_dma_addr = (val<<8);
+			gb->ppu.PPU_Reg[6] = val;
+			gb->cpu.cpu_oam_dma = true;
+			gb->cpu.cpu_oam_dma_addr = (val<<8);
 			break;
 		case 0x28: //FF68
-			ppuCgbBgPalPos = val;
+			gb->ppu.ppuCgbBgPalPos = val;
 			break;
 		case 0x29: //FF69
-			if(gbAllowInvVRAM || !(PPU_Reg[0] & PPU_ENABLE) || (ppuMode != 3))
+			if(gb->gbAllowInvVRAM || !(gb->ppu.PPU_Reg[0] & PPU_ENABLE) || (gb->ppu.ppuMode != 3))
 			{
 				//printf("BG Write %02x to %02x\n", val, ppuCgbBgPalPos&0x3F);
-				PPU_CGB_BGPAL[ppuCgbBgPalPos&0x3F] = val;
-				if(ppuCgbBgPalPos&0x80) //auto-increment
-					ppuCgbBgPalPos = ((ppuCgbBgPalPos+1)&0x3F)|0x80;
+				ppuDrawPending(gb);
+				gb->ppu.PPU_CGB_BGPAL[gb->ppu.ppuCgbBgPalPos&0x3F] = val;
+				if(gb->ppu.ppuCgbBgPalPos&0x80) //auto-increment
+					gb->ppu.ppuCgbBgPalPos = ((gb->ppu.ppuCgbBgPalPos+1)&0x3F)|0x80;
 			}
 			break;
 		case 0x2A: //FF6A
-			ppuCgbObjPalPos = val;
+			gb->ppu.ppuCgbObjPalPos = val;
 			break;
 		case 0x2B: //FF6B
-			if(gbAllowInvVRAM || !(PPU_Reg[0] & PPU_ENABLE) || (ppuMode != 3))
+			if(gb->gbAllowInvVRAM || !(gb->ppu.PPU_Reg[0] & PPU_ENABLE) || (gb->ppu.ppuMode != 3))
 			{
 				//printf("OBJ Write %02x to %02x\n", val, ppuCgbObjPalPos&0x3F);
-				PPU_CGB_OBJPAL[ppuCgbObjPalPos&0x3F] = val;
-				if(ppuCgbObjPalPos&0x80) //auto-increment
-					ppuCgbObjPalPos = ((ppuCgbObjPalPos+1)&0x3F)|0x80;
+				ppuDrawPending(gb);
+				gb->ppu.PPU_CGB_OBJPAL[gb->ppu.ppuCgbObjPalPos&0x3F] = val;
+				if(gb->ppu.ppuCgbObjPalPos&0x80) //auto-increment
+					gb->ppu.ppuCgbObjPalPos = ((gb->ppu.ppuCgbObjPalPos+1)&0x3F)|0x80;
 			}
 			break;
 		default:
@@ -501,18 +795,18 @@ void ppuSetReg8(uint16_t addr, uint8_t val)
 	}
 }
 
-void ppuDumpMem()
+void ppuDumpMem(gb_t *gb)
 {
 	FILE *f = fopen("PPU_VRAM.bin","wb");
 	if(f)
 	{
-		fwrite(PPU_VRAM,1,gbCgbMode?0x4000:0x2000,f);
+		fwrite(gb->ppu.PPU_VRAM,1,gb->gbCgbMode?0x4000:0x2000,f);
 		fclose(f);
 	}
 	f = fopen("PPU_OAM.bin","wb");
 	if(f)
 	{
-		fwrite(PPU_OAM,1,0xA0,f);
+		fwrite(gb->ppu.PPU_OAM,1,0xA0,f);
 		fclose(f);
 	}
 	/*f = fopen("PPU_Sprites.bin","wb");
@@ -523,79 +817,79 @@ void ppuDumpMem()
 	}*/
 }
 
-bool ppuInVBlank()
+bool ppuInVBlank(gb_t *gb)
 {
-	if(ppuVBlank)
+	if(gb->ppu.ppuVBlank)
 	{
-		if(ppuVBlankTriggered == false)
+		if(gb->ppu.ppuVBlankTriggered == false)
 		{
-			ppuVBlankTriggered = true;
+			gb->ppu.ppuVBlankTriggered = true;
 			return true;
 		}
 		else
 			return false;
 	}
-	ppuVBlankTriggered = false;
+	gb->ppu.ppuVBlankTriggered = false;
 	return false;
 }
 
-bool ppuInHBlank()
+bool ppuInHBlank(gb_t *gb)
 {
-	if(ppuHBlank)
+	if(gb->ppu.ppuHBlank)
 	{
-		if(ppuHBlankTriggered == false)
+		if(gb->ppu.ppuHBlankTriggered == false)
 		{
-			ppuHBlankTriggered = true;
+			gb->ppu.ppuHBlankTriggered = true;
 			return true;
 		}
 		else
 			return false;
 	}
-	ppuHBlankTriggered = false;
+	gb->ppu.ppuHBlankTriggered = false;
 	return false;
 }
 
-static uint8_t ppuDoSpritesDMG(uint8_t color, uint8_t tCol)
+static uint8_t ppuDoSpritesDMG(gb_t *gb, uint8_t color, uint8_t tCol)
 {
 	uint8_t i;
-	uint8_t cSpriteAnd = (PPU_Reg[0] & PPU_SPRITE_8_16) ? 15 : 7;
+	uint8_t cSpriteAnd = (gb->ppu.PPU_Reg[0] & PPU_SPRITE_8_16) ? 15 : 7;
 	uint8_t cPrioSpriteX = 0xFF;
 	uint8_t ChrRegA = 0, ChrRegB = 0;
-	for(i = 0; i < ppuOAM2pos; i++)
+	for(i = 0; i < gb->ppu.ppuOAM2pos; i++)
 	{
-		uint8_t OAMcXpos = PPU_OAM2[(i<<2)+1];
+		uint8_t OAMcXpos = gb->ppu.PPU_OAM2[(i<<2)+1];
 		if(OAMcXpos >= 168)
 			continue;
 		int16_t cmpPos = ((int16_t)OAMcXpos)-8;
-		if(cmpPos <= ppuDots && (cmpPos+8) > ppuDots)
+		if(cmpPos <= gb->ppu.ppuDots && (cmpPos+8) > gb->ppu.ppuDots)
 		{
-			uint8_t cSpriteByte3 = PPU_OAM2[(i<<2)+3];
-			uint8_t tVal = PPU_OAM2[(i<<2)+2];
+			uint8_t cSpriteByte3 = gb->ppu.PPU_OAM2[(i<<2)+3];
+			uint8_t tVal = gb->ppu.PPU_OAM2[(i<<2)+2];
 
-			uint8_t OAMcYpos = PPU_OAM2[(i<<2)];
+			uint8_t OAMcYpos = gb->ppu.PPU_OAM2[(i<<2)];
 			uint8_t cmpYPos = OAMcYpos-16;
-			uint8_t cSpriteY = (ppuLines - cmpYPos)&cSpriteAnd;
+			uint8_t cSpriteY = (gb->ppu.ppuLines - cmpYPos)&cSpriteAnd;
 			uint8_t cSpriteAdd = 0; //used to select which 8 by 16 tile
 			if(cSpriteY > 7) //8 by 16 select
 			{
 				cSpriteAdd = 16;
 				cSpriteY &= 7;
 			}
-			if(PPU_Reg[0] & PPU_SPRITE_8_16)
+			if(gb->ppu.PPU_Reg[0] & PPU_SPRITE_8_16)
 				tVal &= ~1; //clear low bit since its ALL 8 by 16 (2x the space)
 			if(cSpriteByte3 & PPU_TILE_FLIP_Y)
 			{
 				cSpriteY ^= 7;
-				if(PPU_Reg[0] & PPU_SPRITE_8_16)
+				if(gb->ppu.PPU_Reg[0] & PPU_SPRITE_8_16)
 					cSpriteAdd ^= 16; //8 by 16 select
 			}
 			uint16_t tPos = tVal<<4;
 			tPos+=(cSpriteY)<<1;
 
-			ChrRegA = PPU_VRAM[(tPos+cSpriteAdd)&0x1FFF];
-			ChrRegB = PPU_VRAM[(tPos+cSpriteAdd+1)&0x1FFF];
+			ChrRegA = gb->ppu.PPU_VRAM[(tPos+cSpriteAdd)&0x1FFF];
+			ChrRegB = gb->ppu.PPU_VRAM[(tPos+cSpriteAdd+1)&0x1FFF];
 
-			uint8_t cSpriteX = (ppuDots - OAMcXpos)&7;
+			uint8_t cSpriteX = (gb->ppu.ppuDots - OAMcXpos)&7;
 			if(cSpriteByte3 & PPU_TILE_FLIP_X)
 				cSpriteX ^= 7;
 			uint8_t sprCol = 0;
@@ -615,9 +909,9 @@ static uint8_t ppuDoSpritesDMG(uint8_t color, uint8_t tCol)
 				{
 					//sprite so far has highest prio so set color
 					if(cSpriteByte3 & PPU_TILE_DMG_PAL)
-						tCol = (PPU_Reg[9]>>(sprCol<<1));
+						tCol = (gb->ppu.PPU_Reg[9]>>(sprCol<<1));
 					else
-						tCol = (PPU_Reg[8]>>(sprCol<<1));
+						tCol = (gb->ppu.PPU_Reg[8]>>(sprCol<<1));
 					//keep looking if there is a lower X
 					cPrioSpriteX = OAMcXpos;
 					continue;
@@ -626,9 +920,9 @@ static uint8_t ppuDoSpritesDMG(uint8_t color, uint8_t tCol)
 					continue;
 				//background is 0 so set color
 				if(cSpriteByte3 & PPU_TILE_DMG_PAL)
-					tCol = (PPU_Reg[9]>>(sprCol<<1));
+					tCol = (gb->ppu.PPU_Reg[9]>>(sprCol<<1));
 				else
-					tCol = (PPU_Reg[8]>>(sprCol<<1));
+					tCol = (gb->ppu.PPU_Reg[8]>>(sprCol<<1));
 				//keep looking if there is a lower X
 				cPrioSpriteX = OAMcXpos;
 				continue;
@@ -639,112 +933,112 @@ static uint8_t ppuDoSpritesDMG(uint8_t color, uint8_t tCol)
 	return tCol;
 }
 
-static void ppuDrawDotDMG(size_t drawPos)
+static void ppuDrawDotDMG(gb_t *gb, size_t drawPos)
 {
 	uint8_t ChrRegA = 0, ChrRegB = 0, color = 0, tCol = 0;
-	if(PPU_Reg[0]&PPU_BG_ENABLE)
+	if(gb->ppu.PPU_Reg[0]&PPU_BG_ENABLE)
 	{
-		uint8_t bgXPos = ppuDots+PPU_Reg[3];
-		uint8_t bgYPos = ppuLines+PPU_Reg[2];
-		uint16_t vramTilePos = ((PPU_Reg[0]&PPU_BG_TILEMAP_UP)?0x1C00:0x1800)|(((bgXPos>>3)+((bgYPos>>3)<<5))&0x3FF);
-		if(PPU_Reg[0]&PPU_BG_TILEDAT_LOW)
+		uint8_t bgXPos = gb->ppu.ppuDots+gb->ppu.PPU_Reg[3];
+		uint8_t bgYPos = gb->ppu.ppuLines+gb->ppu.PPU_Reg[2];
+		uint16_t vramTilePos = ((gb->ppu.PPU_Reg[0]&PPU_BG_TILEMAP_UP)?0x1C00:0x1800)|(((bgXPos>>3)+((bgYPos>>3)<<5))&0x3FF);
+		if(gb->ppu.PPU_Reg[0]&PPU_BG_TILEDAT_LOW)
 		{
-			uint8_t tVal = PPU_VRAM[vramTilePos&0x1FFF];
+			uint8_t tVal = gb->ppu.PPU_VRAM[vramTilePos&0x1FFF];
 			uint16_t tPos = tVal<<4;
 			tPos+=(bgYPos&7)<<1;
-			ChrRegA = PPU_VRAM[(tPos)&0x1FFF];
-			ChrRegB = PPU_VRAM[(tPos+1)&0x1FFF];
+			ChrRegA = gb->ppu.PPU_VRAM[(tPos)&0x1FFF];
+			ChrRegB = gb->ppu.PPU_VRAM[(tPos+1)&0x1FFF];
 		}
 		else
 		{
-			int8_t tVal = (int8_t)PPU_VRAM[vramTilePos&0x1FFF];
+			int8_t tVal = (int8_t)gb->ppu.PPU_VRAM[vramTilePos&0x1FFF];
 			int16_t tPos = tVal<<4;
 			tPos+=(bgYPos&7)<<1;
-			ChrRegA = PPU_VRAM[(0x1000+tPos)&0x1FFF];
-			ChrRegB = PPU_VRAM[(0x1000+tPos+1)&0x1FFF];
+			ChrRegA = gb->ppu.PPU_VRAM[(0x1000+tPos)&0x1FFF];
+			ChrRegB = gb->ppu.PPU_VRAM[(0x1000+tPos+1)&0x1FFF];
 		}
 		if(ChrRegA & (0x80>>(bgXPos&7)))
 			color |= 1;
 		if(ChrRegB & (0x80>>(bgXPos&7)))
 			color |= 2;
-		tCol = (PPU_Reg[7]>>(color<<1));
+		tCol = (gb->ppu.PPU_Reg[7]>>(color<<1));
 	}
-	if(PPU_Reg[0]&PPU_WINDOW_ENABLE && (PPU_Reg[0xB]) <= ppuDots+7 && PPU_Reg[0xA] <= ppuLines)
+	if(gb->ppu.PPU_Reg[0]&PPU_WINDOW_ENABLE && (gb->ppu.PPU_Reg[0xB]) <= gb->ppu.ppuDots+7 && gb->ppu.PPU_Reg[0xA] <= gb->ppu.ppuLines)
 	{
-		uint8_t windowXPos = ppuDots+7-PPU_Reg[0xB];
-		uint8_t windowYPos = ppuLines-PPU_Reg[0xA];
-		uint16_t vramTilePos = ((PPU_Reg[0]&PPU_WINDOW_TILEMAP_UP)?0x1C00:0x1800)|(((windowXPos>>3)+((windowYPos>>3)<<5))&0x3FF);
-		if(PPU_Reg[0]&PPU_BG_TILEDAT_LOW)
+		uint8_t windowXPos = gb->ppu.ppuDots+7-gb->ppu.PPU_Reg[0xB];
+		uint8_t windowYPos = gb->ppu.ppuLines-gb->ppu.PPU_Reg[0xA];
+		uint16_t vramTilePos = ((gb->ppu.PPU_Reg[0]&PPU_WINDOW_TILEMAP_UP)?0x1C00:0x1800)|(((windowXPos>>3)+((windowYPos>>3)<<5))&0x3FF);
+		if(gb->ppu.PPU_Reg[0]&PPU_BG_TILEDAT_LOW)
 		{
-			uint8_t tVal = PPU_VRAM[vramTilePos&0x1FFF];
+			uint8_t tVal = gb->ppu.PPU_VRAM[vramTilePos&0x1FFF];
 			uint16_t tPos = tVal<<4;
 			tPos+=(windowYPos&7)<<1;
-			ChrRegA = PPU_VRAM[(tPos)&0x1FFF];
-			ChrRegB = PPU_VRAM[(tPos+1)&0x1FFF];
+			ChrRegA = gb->ppu.PPU_VRAM[(tPos)&0x1FFF];
+			ChrRegB = gb->ppu.PPU_VRAM[(tPos+1)&0x1FFF];
 		}
 		else
 		{
-			int8_t tVal = (int8_t)PPU_VRAM[vramTilePos&0x1FFF];
+			int8_t tVal = (int8_t)gb->ppu.PPU_VRAM[vramTilePos&0x1FFF];
 			int16_t tPos = tVal<<4;
 			tPos+=(windowYPos&7)<<1;
-			ChrRegA = PPU_VRAM[(0x1000+tPos)&0x1FFF];
-			ChrRegB = PPU_VRAM[(0x1000+tPos+1)&0x1FFF];
+			ChrRegA = gb->ppu.PPU_VRAM[(0x1000+tPos)&0x1FFF];
+			ChrRegB = gb->ppu.PPU_VRAM[(0x1000+tPos+1)&0x1FFF];
 		}
 		color = 0;
 		if(ChrRegA & (0x80>>(windowXPos&7)))
 			color |= 1;
 		if(ChrRegB & (0x80>>(windowXPos&7)))
 			color |= 2;
-		tCol = (PPU_Reg[7]>>(color<<1));
+		tCol = (gb->ppu.PPU_Reg[7]>>(color<<1));
 	}
-	if(PPU_Reg[0]&PPU_SPRITE_ENABLE)
-		tCol = ppuDoSpritesDMG(color, tCol);
+	if(gb->ppu.PPU_Reg[0]&PPU_SPRITE_ENABLE)
+		tCol = ppuDoSpritesDMG(gb, color, tCol);
 	//copy grayscale value from BGR32 LUT
-	textureImage[drawPos] = PPU_BGRLUT[tCol&3];
+	gb->textureImage[drawPos] = gb->ppu.PPU_BGRLUT[tCol&3];
 }
 
 //follows same logic as DMG function, only returned color is different
-static uint16_t ppuDoSpritesCGB_DMGMode(uint8_t color, uint16_t cgbRGB)
+static uint16_t ppuDoSpritesCGB_DMGMode(gb_t *gb, uint8_t color, uint16_t cgbRGB)
 {
 	uint8_t i;
-	uint8_t cSpriteAnd = (PPU_Reg[0] & PPU_SPRITE_8_16) ? 15 : 7;
+	uint8_t cSpriteAnd = (gb->ppu.PPU_Reg[0] & PPU_SPRITE_8_16) ? 15 : 7;
 	uint8_t cPrioSpriteX = 0xFF;
 	uint8_t ChrRegA = 0, ChrRegB = 0;
-	for(i = 0; i < ppuOAM2pos; i++)
+	for(i = 0; i < gb->ppu.ppuOAM2pos; i++)
 	{
-		uint8_t OAMcXpos = PPU_OAM2[(i<<2)+1];
+		uint8_t OAMcXpos = gb->ppu.PPU_OAM2[(i<<2)+1];
 		if(OAMcXpos >= 168)
 			continue;
 		int16_t cmpPos = ((int16_t)OAMcXpos)-8;
-		if(cmpPos <= ppuDots && (cmpPos+8) > ppuDots)
+		if(cmpPos <= gb->ppu.ppuDots && (cmpPos+8) > gb->ppu.ppuDots)
 		{
-			uint8_t cSpriteByte3 = PPU_OAM2[(i<<2)+3];
-			uint8_t tVal = PPU_OAM2[(i<<2)+2];
+			uint8_t cSpriteByte3 = gb->ppu.PPU_OAM2[(i<<2)+3];
+			uint8_t tVal = gb->ppu.PPU_OAM2[(i<<2)+2];
 
-			uint8_t OAMcYpos = PPU_OAM2[(i<<2)];
+			uint8_t OAMcYpos = gb->ppu.PPU_OAM2[(i<<2)];
 			uint8_t cmpYPos = OAMcYpos-16;
-			uint8_t cSpriteY = (ppuLines - cmpYPos)&cSpriteAnd;
+			uint8_t cSpriteY = (gb->ppu.ppuLines - cmpYPos)&cSpriteAnd;
 			uint8_t cSpriteAdd = 0; //used to select which 8 by 16 tile
 			if(cSpriteY > 7) //8 by 16 select
 			{
 				cSpriteAdd = 16;
 				cSpriteY &= 7;
 			}
-			if(PPU_Reg[0] & PPU_SPRITE_8_16)
+			if(gb->ppu.PPU_Reg[0] & PPU_SPRITE_8_16)
 				tVal &= ~1; //clear low bit since its ALL 8 by 16 (2x the space)
 			if(cSpriteByte3 & PPU_TILE_FLIP_Y)
 			{
 				cSpriteY ^= 7;
-				if(PPU_Reg[0] & PPU_SPRITE_8_16)
+				if(gb->ppu.PPU_Reg[0] & PPU_SPRITE_8_16)
 					cSpriteAdd ^= 16; //8 by 16 select
 			}
 			uint16_t tPos = tVal<<4;
 			tPos+=(cSpriteY)<<1;
 
-			ChrRegA = PPU_VRAM[(tPos+cSpriteAdd)&0x1FFF];
-			ChrRegB = PPU_VRAM[(tPos+cSpriteAdd+1)&0x1FFF];
+			ChrRegA = gb->ppu.PPU_VRAM[(tPos+cSpriteAdd)&0x1FFF];
+			ChrRegB = gb->ppu.PPU_VRAM[(tPos+cSpriteAdd+1)&0x1FFF];
 
-			uint8_t cSpriteX = (ppuDots - OAMcXpos)&7;
+			uint8_t cSpriteX = (gb->ppu.ppuDots - OAMcXpos)&7;
 			if(cSpriteByte3 & PPU_TILE_FLIP_X)
 				cSpriteX ^= 7;
 			uint8_t sprCol = 0;
@@ -764,10 +1058,10 @@ static uint16_t ppuDoSpritesCGB_DMGMode(uint8_t color, uint16_t cgbRGB)
 					uint8_t pByte;
 					//sprite so far has highest prio so set color
 					if(cSpriteByte3 & PPU_TILE_DMG_PAL)
-						pByte = ((PPU_Reg[9]>>(sprCol<<1))&3)<<1;
+						pByte = ((gb->ppu.PPU_Reg[9]>>(sprCol<<1))&3)<<1;
 					else
-						pByte = ((PPU_Reg[8]>>(sprCol<<1))&3)<<1;
-					cgbRGB = (PPU_CGB_OBJPAL[pByte])|(PPU_CGB_OBJPAL[pByte+1]<<8);
+						pByte = ((gb->ppu.PPU_Reg[8]>>(sprCol<<1))&3)<<1;
+					cgbRGB = (gb->ppu.PPU_CGB_OBJPAL[pByte])|(gb->ppu.PPU_CGB_OBJPAL[pByte+1]<<8);
 					//keep looking if there is a lower X
 					cPrioSpriteX = OAMcXpos;
 					continue;
@@ -777,10 +1071,10 @@ static uint16_t ppuDoSpritesCGB_DMGMode(uint8_t color, uint16_t cgbRGB)
 				uint8_t pByte;
 				//background is 0 so set color
 				if(cSpriteByte3 & PPU_TILE_DMG_PAL)
-					pByte = ((PPU_Reg[9]>>(sprCol<<1))&3)<<1;
+					pByte = ((gb->ppu.PPU_Reg[9]>>(sprCol<<1))&3)<<1;
 				else
-					pByte = ((PPU_Reg[8]>>(sprCol<<1))&3)<<1;
-				cgbRGB = (PPU_CGB_OBJPAL[pByte])|(PPU_CGB_OBJPAL[pByte+1]<<8);
+					pByte = ((gb->ppu.PPU_Reg[8]>>(sprCol<<1))&3)<<1;
+				cgbRGB = (gb->ppu.PPU_CGB_OBJPAL[pByte])|(gb->ppu.PPU_CGB_OBJPAL[pByte+1]<<8);
 				//keep looking if there is a lower X
 				cPrioSpriteX = OAMcXpos;
 				continue;
@@ -792,115 +1086,115 @@ static uint16_t ppuDoSpritesCGB_DMGMode(uint8_t color, uint16_t cgbRGB)
 }
 
 //follows same logic as DMG function, only displayed color is different
-static void ppuDrawDotCGB_DMGMode(size_t drawPos)
+static void ppuDrawDotCGB_DMGMode(gb_t *gb, size_t drawPos)
 {
 	uint8_t ChrRegA = 0, ChrRegB = 0, color = 0;
-	uint8_t pByte = (PPU_Reg[7]&3)<<1;
-	uint16_t cgbRGB = (PPU_CGB_OBJPAL[pByte])|(PPU_CGB_OBJPAL[pByte+1]<<8);
-	if(PPU_Reg[0]&PPU_BG_ENABLE)
-	{
-		uint8_t bgXPos = ppuDots+PPU_Reg[3];
-		uint8_t bgYPos = ppuLines+PPU_Reg[2];
-		uint16_t vramTilePos = ((PPU_Reg[0]&PPU_BG_TILEMAP_UP)?0x1C00:0x1800)|(((bgXPos>>3)+((bgYPos>>3)<<5))&0x3FF);
-		if(PPU_Reg[0]&PPU_BG_TILEDAT_LOW)
+	uint8_t pByte = (gb->ppu.PPU_Reg[7]&3)<<1;
+	uint16_t cgbRGB = (gb->ppu.PPU_CGB_OBJPAL[pByte])|(gb->ppu.PPU_CGB_OBJPAL[pByte+1]<<8);
+	if(gb->ppu.PPU_Reg[0]&PPU_BG_ENABLE)
+	{
+		uint8_t bgXPos = gb->ppu.ppuDots+gb->ppu.PPU_Reg[3];
+		uint8_t bgYPos = gb->ppu.ppuLines+gb->ppu.PPU_Reg[2];
+		uint16_t vramTilePos = ((gb->ppu.PPU_Reg[0]&PPU_BG_TILEMAP_UP)?0x1C00:0x1800)|(((bgXPos>>3)+((bgYPos>>3)<<5))&0x3FF);
+		if(gb->ppu.PPU_Reg[0]&PPU_BG_TILEDAT_LOW)
 		{
-			uint8_t tVal = PPU_VRAM[vramTilePos&0x1FFF];
+			uint8_t tVal = gb->ppu.PPU_VRAM[vramTilePos&0x1FFF];
 			uint16_t tPos = tVal<<4;
 			tPos+=(bgYPos&7)<<1;
-			ChrRegA = PPU_VRAM[(tPos)&0x1FFF];
-			ChrRegB = PPU_VRAM[(tPos+1)&0x1FFF];
+			ChrRegA = gb->ppu.PPU_VRAM[(tPos)&0x1FFF];
+			ChrRegB = gb->ppu.PPU_VRAM[(tPos+1)&0x1FFF];
 		}
 		else
 		{
-			int8_t tVal = (int8_t)PPU_VRAM[vramTilePos&0x1FFF];
+			int8_t tVal = (int8_t)gb->ppu.PPU_VRAM[vramTilePos&0x1FFF];
 			int16_t tPos = tVal<<4;
 			tPos+=(bgYPos&7)<<1;
-			ChrRegA = PPU_VRAM[(0x1000+tPos)&0x1FFF];
-			ChrRegB = PPU_VRAM[(0x1000+tPos+1)&0x1FFF];
+			ChrRegA = gb->ppu.PPU_VRAM[(0x1000+tPos)&0x1FFF];
+			ChrRegB = gb->ppu.PPU_VRAM[(0x1000+tPos+1)&0x1FFF];
 		}
 		if(ChrRegA & (0x80>>(bgXPos&7)))
 			color |= 1;
 		if(ChrRegB & (0x80>>(bgXPos&7)))
 			color |= 2;
-		pByte = ((PPU_Reg[7]>>(color<<1))&3)<<1;
-		cgbRGB = (PPU_CGB_BGPAL[pByte])|(PPU_CGB_BGPAL[pByte+1]<<8);
+		pByte = ((gb->ppu.PPU_Reg[7]>>(color<<1))&3)<<1;
+		cgbRGB = (gb->ppu.PPU_CGB_BGPAL[pByte])|(gb->ppu.PPU_CGB_BGPAL[pByte+1]<<8);
 	}
-	if(PPU_Reg[0]&PPU_WINDOW_ENABLE && (PPU_Reg[0xB]) <= ppuDots+7 && PPU_Reg[0xA] <= ppuLines)
+	if(gb->ppu.PPU_Reg[0]&PPU_WINDOW_ENABLE && (gb->ppu.PPU_Reg[0xB]) <= gb->ppu.ppuDots+7 && gb->ppu.PPU_Reg[0xA] <= gb->ppu.ppuLines)
 	{
-		uint8_t windowXPos = ppuDots+7-PPU_Reg[0xB];
-		uint8_t windowYPos = ppuLines-PPU_Reg[0xA];
-		uint16_t vramTilePos = ((PPU_Reg[0]&PPU_WINDOW_TILEMAP_UP)?0x1C00:0x1800)|(((windowXPos>>3)+((windowYPos>>3)<<5))&0x3FF);
-		if(PPU_Reg[0]&PPU_BG_TILEDAT_LOW)
+		uint8_t windowXPos = gb->ppu.ppuDots+7-gb->ppu.PPU_Reg[0xB];
+		uint8_t windowYPos = gb->ppu.ppuLines-gb->ppu.PPU_Reg[0xA];
+		uint16_t vramTilePos = ((gb->ppu.PPU_Reg[0]&PPU_WINDOW_TILEMAP_UP)?0x1C00:0x1800)|(((windowXPos>>3)+((windowYPos>>3)<<5))&0x3FF);
+		if(gb->ppu.PPU_Reg[0]&PPU_BG_TILEDAT_LOW)
 		{
-			uint8_t tVal = PPU_VRAM[vramTilePos&0x1FFF];
+			uint8_t tVal = gb->ppu.PPU_VRAM[vramTilePos&0x1FFF];
 			uint16_t tPos = tVal<<4;
 			tPos+=(windowYPos&7)<<1;
-			ChrRegA = PPU_VRAM[(tPos)&0x1FFF];
-			ChrRegB = PPU_VRAM[(tPos+1)&0x1FFF];
+			ChrRegA = gb->ppu.PPU_VRAM[(tPos)&0x1FFF];
+			ChrRegB = gb->ppu.PPU_VRAM[(tPos+1)&0x1FFF];
 		}
 		else
 		{
-			int8_t tVal = (int8_t)PPU_VRAM[vramTilePos&0x1FFF];
+			int8_t tVal = (int8_t)gb->ppu.PPU_VRAM[vramTilePos&0x1FFF];
 			int16_t tPos = tVal<<4;
 			tPos+=(windowYPos&7)<<1;
-			ChrRegA = PPU_VRAM[(0x1000+tPos)&0x1FFF];
-			ChrRegB = PPU_VRAM[(0x1000+tPos+1)&0x1FFF];
+			ChrRegA = gb->ppu.PPU_VRAM[(0x1000+tPos)&0x1FFF];
+			ChrRegB = gb->ppu.PPU_VRAM[(0x1000+tPos+1)&0x1FFF];
 		}
 		color = 0;
 		if(ChrRegA & (0x80>>(windowXPos&7)))
 			color |= 1;
 		if(ChrRegB & (0x80>>(windowXPos&7)))
 			color |= 2;
-		pByte = ((PPU_Reg[7]>>(color<<1))&3)<<1;
-		cgbRGB = (PPU_CGB_BGPAL[pByte])|(PPU_CGB_BGPAL[pByte+1]<<8);
+		pByte = ((gb->ppu.PPU_Reg[7]>>(color<<1))&3)<<1;
+		cgbRGB = (gb->ppu.PPU_CGB_BGPAL[pByte])|(gb->ppu.PPU_CGB_BGPAL[pByte+1]<<8);
 	}
-	if(PPU_Reg[0]&PPU_SPRITE_ENABLE)
-		cgbRGB = ppuDoSpritesCGB_DMGMode(color, cgbRGB);
+	if(gb->ppu.PPU_Reg[0]&PPU_SPRITE_ENABLE)
+		cgbRGB = ppuDoSpritesCGB_DMGMode(gb, color, cgbRGB);
 	//copy color value from BGR32 LUT
-	textureImage[drawPos] = PPU_CGB_BGRLUT[cgbRGB&0x7FFF];
+	gb->textureImage[drawPos] = gb->ppu.PPU_CGB_BGRLUT[cgbRGB&0x7FFF];
 }
 
-static uint16_t ppuDoSpritesCGB(uint8_t color, uint16_t cgbRGB)
+static uint16_t ppuDoSpritesCGB(gb_t *gb, uint8_t color, uint16_t cgbRGB)
 {
 	uint8_t i;
-	uint8_t cSpriteAnd = (PPU_Reg[0] & PPU_SPRITE_8_16) ? 15 : 7;
+	uint8_t cSpriteAnd = (gb->ppu.PPU_Reg[0] & PPU_SPRITE_8_16) ? 15 : 7;
 	uint8_t ChrRegA = 0, ChrRegB = 0;
-	for(i = 0; i < ppuOAM2pos; i++)
+	for(i = 0; i < gb->ppu.ppuOAM2pos; i++)
 	{
-		uint8_t OAMcXpos = PPU_OAM2[(i<<2)+1];
+		uint8_t OAMcXpos = gb->ppu.PPU_OAM2[(i<<2)+1];
 		if(OAMcXpos >= 168)
 			continue;
 		int16_t cmpPos = ((int16_t)OAMcXpos)-8;
-		if(cmpPos <= ppuDots && (cmpPos+8) > ppuDots)
+		if(cmpPos <= gb->ppu.ppuDots && (cmpPos+8) > gb->ppu.ppuDots)
 		{
-			uint8_t cSpriteByte3 = PPU_OAM2[(i<<2)+3];
+			uint8_t cSpriteByte3 = gb->ppu.PPU_OAM2[(i<<2)+3];
 			uint16_t tCgbBank = (cSpriteByte3&PPU_TILE_CGB_BANK)?0x2000:0x0;
-			uint8_t tVal = PPU_OAM2[(i<<2)+2];
+			uint8_t tVal = gb->ppu.PPU_OAM2[(i<<2)+2];
 
-			uint8_t OAMcYpos = PPU_OAM2[(i<<2)];
+			uint8_t OAMcYpos = gb->ppu.PPU_OAM2[(i<<2)];
 			uint8_t cmpYPos = OAMcYpos-16;
-			uint8_t cSpriteY = (ppuLines - cmpYPos)&cSpriteAnd;
+			uint8_t cSpriteY = (gb->ppu.ppuLines - cmpYPos)&cSpriteAnd;
 			uint8_t cSpriteAdd = 0; //used to select which 8 by 16 tile
 			if(cSpriteY > 7) //8 by 16 select
 			{
 				cSpriteAdd = 16;
 				cSpriteY &= 7;
 			}
-			if(PPU_Reg[0] & PPU_SPRITE_8_16)
+			if(gb->ppu.PPU_Reg[0] & PPU_SPRITE_8_16)
 				tVal &= ~1; //clear low bit since its ALL 8 by 16 (2x the space)
 			if(cSpriteByte3 & PPU_TILE_FLIP_Y)
 			{
 				cSpriteY ^= 7;
-				if(PPU_Reg[0] & PPU_SPRITE_8_16)
+				if(gb->ppu.PPU_Reg[0] & PPU_SPRITE_8_16)
 					cSpriteAdd ^= 16; //8 by 16 select
 			}
 			uint16_t tPos = tVal<<4;
 			tPos+=(cSpriteY)<<1;
 
-			ChrRegA = PPU_VRAM[tCgbBank|((tPos+cSpriteAdd)&0x1FFF)];
-			ChrRegB = PPU_VRAM[tCgbBank|((tPos+cSpriteAdd+1)&0x1FFF)];
+			ChrRegA = gb->ppu.PPU_VRAM[tCgbBank|((tPos+cSpriteAdd)&0x1FFF)];
+			ChrRegB = gb->ppu.PPU_VRAM[tCgbBank|((tPos+cSpriteAdd+1)&0x1FFF)];
 
-			uint8_t cSpriteX = (ppuDots - OAMcXpos)&7;
+			uint8_t cSpriteX = (gb->ppu.ppuDots - OAMcXpos)&7;
 			if(cSpriteByte3 & PPU_TILE_FLIP_X)
 				cSpriteX ^= 7;
 			uint8_t sprCol = 0;
@@ -913,24 +1207,24 @@ static uint16_t ppuDoSpritesCGB(uint8_t color, uint16_t cgbRGB)
 			if(sprCol != 0)
 			{
 				//BG Master Disable, return sprite
-				if((PPU_Reg[0] & PPU_BG_WINDOW_PRIO) == 0)
+				if((gb->ppu.PPU_Reg[0] & PPU_BG_WINDOW_PRIO) == 0)
 				{
 					uint8_t pByte = ((cSpriteByte3&7)<<3)|(sprCol<<1);
-					cgbRGB = (PPU_CGB_OBJPAL[pByte])|(PPU_CGB_OBJPAL[pByte+1]<<8);
+					cgbRGB = (gb->ppu.PPU_CGB_OBJPAL[pByte])|(gb->ppu.PPU_CGB_OBJPAL[pByte+1]<<8);
 					break;
 				}
 				//sprite has highest priority, return sprite
 				if((cSpriteByte3 & PPU_TILE_PRIO) == 0)
 				{
 					uint8_t pByte = ((cSpriteByte3&7)<<3)|(sprCol<<1);
-					cgbRGB = (PPU_CGB_OBJPAL[pByte])|(PPU_CGB_OBJPAL[pByte+1]<<8);
+					cgbRGB = (gb->ppu.PPU_CGB_OBJPAL[pByte])|(gb->ppu.PPU_CGB_OBJPAL[pByte+1]<<8);
 					break;
 				} //sprite has low priority and BG is not 0, keep BG for now
 				else if((color&3) != 0)
 					continue;
 				//background is 0 so set color
 				uint8_t pByte = ((cSpriteByte3&7)<<3)|(sprCol<<1);
-				cgbRGB = (PPU_CGB_OBJPAL[pByte])|(PPU_CGB_OBJPAL[pByte+1]<<8);
+				cgbRGB = (gb->ppu.PPU_CGB_OBJPAL[pByte])|(gb->ppu.PPU_CGB_OBJPAL[pByte+1]<<8);
 				break;
 			}
 			//Sprite is 0, keep looking for sprites
@@ -939,31 +1233,31 @@ static uint16_t ppuDoSpritesCGB(uint8_t color, uint16_t cgbRGB)
 	return cgbRGB;
 }
 
-static void ppuDrawDotCGB(size_t drawPos)
+static void ppuDrawDotCGB(gb_t *gb, size_t drawPos)
 {
 	uint8_t ChrRegA = 0, ChrRegB = 0, color = 0;
-	uint8_t bgXPos = ppuDots+PPU_Reg[3];
-	uint8_t bgYPos = ppuLines+PPU_Reg[2];
-	uint16_t vramTilePos = ((PPU_Reg[0]&PPU_BG_TILEMAP_UP)?0x1C00:0x1800)|(((bgXPos>>3)+((bgYPos>>3)<<5))&0x3FF);
-	uint8_t tCgbVal = PPU_VRAM[0x2000|(vramTilePos&0x1FFF)];
+	uint8_t bgXPos = gb->ppu.ppuDots+gb->ppu.PPU_Reg[3];
+	uint8_t bgYPos = gb->ppu.ppuLines+gb->ppu.PPU_Reg[2];
+	uint16_t vramTilePos = ((gb->ppu.PPU_Reg[0]&PPU_BG_TILEMAP_UP)?0x1C00:0x1800)|(((bgXPos>>3)+((bgYPos>>3)<<5))&0x3FF);
+	uint8_t tCgbVal = gb->ppu.PPU_VRAM[0x2000|(vramTilePos&0x1FFF)];
 	uint16_t tCgbBank = (tCgbVal&PPU_TILE_CGB_BANK)?0x2000:0x0;
 	if(tCgbVal & PPU_TILE_FLIP_Y)
 		bgYPos ^= 7;
-	if(PPU_Reg[0]&PPU_BG_TILEDAT_LOW)
+	if(gb->ppu.PPU_Reg[0]&PPU_BG_TILEDAT_LOW)
 	{
-		uint8_t tVal = PPU_VRAM[vramTilePos&0x1FFF];
+		uint8_t tVal = gb->ppu.PPU_VRAM[vramTilePos&0x1FFF];
 		uint16_t tPos = tVal<<4;
 		tPos+=(bgYPos&7)<<1;
-		ChrRegA = PPU_VRAM[tCgbBank|((tPos)&0x1FFF)];
-		ChrRegB = PPU_VRAM[tCgbBank|((tPos+1)&0x1FFF)];
+		ChrRegA = gb->ppu.PPU_VRAM[tCgbBank|((tPos)&0x1FFF)];
+		ChrRegB = gb->ppu.PPU_VRAM[tCgbBank|((tPos+1)&0x1FFF)];
 	}
 	else
 	{
-		int8_t tVal = (int8_t)PPU_VRAM[vramTilePos&0x1FFF];
+		int8_t tVal = (int8_t)gb->ppu.PPU_VRAM[vramTilePos&0x1FFF];
 		int16_t tPos = tVal<<4;
 		tPos+=(bgYPos&7)<<1;
-		ChrRegA = PPU_VRAM[tCgbBank|((0x1000+tPos)&0x1FFF)];
-		ChrRegB = PPU_VRAM[tCgbBank|((0x1000+tPos+1)&0x1FFF)];
+		ChrRegA = gb->ppu.PPU_VRAM[tCgbBank|((0x1000+tPos)&0x1FFF)];
+		ChrRegB = gb->ppu.PPU_VRAM[tCgbBank|((0x1000+tPos+1)&0x1FFF)];
 	}
 	if(tCgbVal & PPU_TILE_FLIP_X)
 		bgXPos ^= 7;
@@ -971,34 +1265,34 @@ static void ppuDrawDotCGB(size_t drawPos)
 		color |= 1;
 	if(ChrRegB & (0x80>>(bgXPos&7)))
 		color |= 2;
-	bool bgHighestPrio = (color && (tCgbVal & PPU_TILE_PRIO) && (PPU_Reg[0] & PPU_BG_WINDOW_PRIO));
+	bool bgHighestPrio = (color && (tCgbVal & PPU_TILE_PRIO) && (gb->ppu.PPU_Reg[0] & PPU_BG_WINDOW_PRIO));
 	uint8_t pByte = ((tCgbVal&7)<<3)|(color<<1);
-	uint16_t cgbRGB = (PPU_CGB_BGPAL[pByte])|(PPU_CGB_BGPAL[pByte+1]<<8);
-	if(PPU_Reg[0]&PPU_WINDOW_ENABLE && (PPU_Reg[0xB]) <= ppuDots+7 && PPU_Reg[0xA] <= ppuLines)
+	uint16_t cgbRGB = (gb->ppu.PPU_CGB_BGPAL[pByte])|(gb->ppu.PPU_CGB_BGPAL[pByte+1]<<8);
+	if(gb->ppu.PPU_Reg[0]&PPU_WINDOW_ENABLE && (gb->ppu.PPU_Reg[0xB]) <= gb->ppu.ppuDots+7 && gb->ppu.PPU_Reg[0xA] <= gb->ppu.ppuLines)
 	{
-		uint8_t windowXPos = ppuDots+7-PPU_Reg[0xB];
-		uint8_t windowYPos = ppuLines-PPU_Reg[0xA];
-		vramTilePos = ((PPU_Reg[0]&PPU_WINDOW_TILEMAP_UP)?0x1C00:0x1800)|(((windowXPos>>3)+((windowYPos>>3)<<5))&0x3FF);
-		tCgbVal = PPU_VRAM[0x2000|(vramTilePos&0x1FFF)];
+		uint8_t windowXPos = gb->ppu.ppuDots+7-gb->ppu.PPU_Reg[0xB];
+		uint8_t windowYPos = gb->ppu.ppuLines-gb->ppu.PPU_Reg[0xA];
+		vramTilePos = ((gb->ppu.PPU_Reg[0]&PPU_WINDOW_TILEMAP_UP)?0x1C00:0x1800)|(((windowXPos>>3)+((windowYPos>>3)<<5))&0x3FF);
+		tCgbVal = gb->ppu.PPU_VRAM[0x2000|(vramTilePos&0x1FFF)];
 		tCgbBank = (tCgbVal&PPU_TILE_CGB_BANK)?0x2000:0x0;
-		bgHighestPrio = (color && (tCgbVal & PPU_TILE_PRIO) && (PPU_Reg[0] & PPU_BG_WINDOW_PRIO));
+		bgHighestPrio = (color && (tCgbVal & PPU_TILE_PRIO) && (gb->ppu.PPU_Reg[0] & PPU_BG_WINDOW_PRIO));
 		if(tCgbVal & PPU_TILE_FLIP_Y)
 			windowYPos ^= 7;
-		if(PPU_Reg[0]&PPU_BG_TILEDAT_LOW)
+		if(gb->ppu.PPU_Reg[0]&PPU_BG_TILEDAT_LOW)
 		{
-			uint8_t tVal = PPU_VRAM[vramTilePos&0x1FFF];
+			uint8_t tVal = gb->ppu.PPU_VRAM[vramTilePos&0x1FFF];
 			uint16_t tPos = tVal<<4;
 			tPos+=(windowYPos&7)<<1;
-			ChrRegA = PPU_VRAM[tCgbBank|((tPos)&0x1FFF)];
-			ChrRegB = PPU_VRAM[tCgbBank|((tPos+1)&0x1FFF)];
+			ChrRegA = gb->ppu.PPU_VRAM[tCgbBank|((tPos)&0x1FFF)];
+			ChrRegB = gb->ppu.PPU_VRAM[tCgbBank|((tPos+1)&0x1FFF)];
 		}
 		else
 		{
-			int8_t tVal = (int8_t)PPU_VRAM[vramTilePos&0x1FFF];
+			int8_t tVal = (int8_t)gb->ppu.PPU_VRAM[vramTilePos&0x1FFF];
 			int16_t tPos = tVal<<4;
 			tPos+=(windowYPos&7)<<1;
-			ChrRegA = PPU_VRAM[tCgbBank|((0x1000+tPos)&0x1FFF)];
-			ChrRegB = PPU_VRAM[tCgbBank|((0x1000+tPos+1)&0x1FFF)];
+			ChrRegA = gb->ppu.PPU_VRAM[tCgbBank|((0x1000+tPos)&0x1FFF)];
+			ChrRegB = gb->ppu.PPU_VRAM[tCgbBank|((0x1000+tPos+1)&0x1FFF)];
 		}
 		if(tCgbVal & PPU_TILE_FLIP_X)
 			windowXPos ^= 7;
@@ -1008,12 +1302,266 @@ static void ppuDrawDotCGB(size_t drawPos)
 		if(ChrRegB & (0x80>>(windowXPos&7)))
 			color |= 2;
 		pByte = ((tCgbVal&7)<<3)|(color<<1);
-		cgbRGB = (PPU_CGB_BGPAL[pByte])|(PPU_CGB_BGPAL[pByte+1]<<8);
+		cgbRGB = (gb->ppu.PPU_CGB_BGPAL[pByte])|(gb->ppu.PPU_CGB_BGPAL[pByte+1]<<8);
 	}
-	if(!bgHighestPrio && PPU_Reg[0]&PPU_SPRITE_ENABLE)
-		cgbRGB = ppuDoSpritesCGB(color, cgbRGB);
+	if(!bgHighestPrio && gb->ppu.PPU_Reg[0]&PPU_SPRITE_ENABLE)
+		cgbRGB = ppuDoSpritesCGB(gb, color, cgbRGB);
 	//copy color value from BGR32 LUT
-	textureImage[drawPos] = PPU_CGB_BGRLUT[cgbRGB&0x7FFF];
+	gb->textureImage[drawPos] = gb->ppu.PPU_CGB_BGRLUT[cgbRGB&0x7FFF];
+}
+
+//fills in the bg or window colors from the given dot to the end
+//of the line, xPos and yPos are the map position of that dot,
+//cgb tile attributes only get read and stored when attrs is set
+static void ppuLineTiles(gb_t *gb, uint8_t *colors, uint8_t *attrs, uint8_t dot, uint8_t xPos, uint8_t yPos, uint16_t mapPos)
+{
+	const uint8_t *vram = gb->ppu.PPU_VRAM;
+	while(dot < 160)
+	{
+		uint16_t vramTilePos = mapPos|(((xPos>>3)+((yPos>>3)<<5))&0x3FF);
+		uint8_t tCgbVal = 0, tileY = yPos&7;
+		uint16_t tile = 0;
+		if(attrs)
+		{
+			tCgbVal = vram[0x2000|vramTilePos];
+			if(tCgbVal & PPU_TILE_CGB_BANK)
+				tile = PPU_BANK_TILES;
+			if(tCgbVal & PPU_TILE_FLIP_Y)
+				tileY ^= 7;
+		}
+		if(gb->ppu.PPU_Reg[0]&PPU_BG_TILEDAT_LOW)
+			tile += vram[vramTilePos];
+		else
+			tile += 0x100+((int8_t)vram[vramTilePos]);
+		const uint8_t *tRow = ppuTileRow(gb, tile, tileY, (tCgbVal & PPU_TILE_FLIP_X) != 0);
+		uint8_t tileX = xPos&7;
+		uint8_t len = 8-tileX;
+		if(len > 160-dot)
+			len = 160-dot;
+		memcpy(colors+dot, tRow+tileX, len);
+		if(attrs)
+			memset(attrs+dot, tCgbVal, len);
+		dot += len;
+		xPos += len;
+	}
+}
+
+//first dot of the current line the window covers, 160 if none
+static uint8_t ppuLineWindowStart(gb_t *gb)
+{
+	if(!(gb->ppu.PPU_Reg[0]&PPU_WINDOW_ENABLE) || gb->ppu.PPU_Reg[0xA] > gb->ppu.ppuLines)
+		return 160;
+	if(gb->ppu.PPU_Reg[0xB] < 7)
+		return 0;
+	if(gb->ppu.PPU_Reg[0xB]-7 >= 160)
+		return 160;
+	return gb->ppu.PPU_Reg[0xB]-7;
+}
+
+//priority resolved sprite dots of the current line as sprite color
+//plus palette<<2, 0 where there is no sprite; front is what shows
+//over a bg color other than 0 and back what shows over color 0,
+//cgb picks the first sprite in oam order, dmg the lowest x one
+static bool ppuLineSprites(gb_t *gb, uint8_t *front, uint8_t *back, bool cgb)
+{
+	uint8_t frontX[160], backX[160];
+	uint8_t cSpriteAnd = (gb->ppu.PPU_Reg[0] & PPU_SPRITE_8_16) ? 15 : 7;
+	bool bgPrio = cgb && (gb->ppu.PPU_Reg[0] & PPU_BG_WINDOW_PRIO);
+	bool found = false;
+	uint8_t i;
+	memset(front, 0, 160);
+	memset(back, 0, 160);
+	memset(frontX, 0xFF, 160);
+	memset(backX, 0xFF, 160);
+	for(i = 0; i < gb->ppu.ppuOAM2pos; i++)
+	{
+		uint8_t OAMcXpos = gb->ppu.PPU_OAM2[(i<<2)+1];
+		if(OAMcXpos == 0 || OAMcXpos >= 168)
+			continue;
+		uint8_t cSpriteByte3 = gb->ppu.PPU_OAM2[(i<<2)+3];
+		uint8_t cmpYPos = gb->ppu.PPU_OAM2[(i<<2)]-16;
+		uint8_t cSpriteY = (gb->ppu.ppuLines - cmpYPos)&cSpriteAnd;
+		uint16_t tile = gb->ppu.PPU_OAM2[(i<<2)+2];
+		if(gb->ppu.PPU_Reg[0] & PPU_SPRITE_8_16)
+			tile &= ~1; //clear low bit since its ALL 8 by 16 (2x the space)
+		if(cSpriteByte3 & PPU_TILE_FLIP_Y)
+			cSpriteY ^= cSpriteAnd;
+		tile += cSpriteY>>3;
+		if(cgb && (cSpriteByte3 & PPU_TILE_CGB_BANK))
+			tile += PPU_BANK_TILES;
+		const uint8_t *tRow = ppuTileRow(gb, tile, cSpriteY&7, (cSpriteByte3 & PPU_TILE_FLIP_X) != 0);
+		uint8_t pal = cgb ? ((cSpriteByte3&7)<<2) : ((cSpriteByte3 & PPU_TILE_DMG_PAL) ? 4 : 0);
+		//low priority sprites only show over bg color 0
+		bool inFront = !(cSpriteByte3 & PPU_TILE_PRIO) || (cgb && !bgPrio);
+		int16_t startDot = ((int16_t)OAMcXpos)-8;
+		uint8_t x = (startDot < 0) ? -startDot : 0;
+		for(; x < 8 && startDot+x < 160; x++)
+		{
+			if(!tRow[x])
+				continue;
+			uint8_t dot = startDot+x;
+			uint8_t val = pal|tRow[x];
+			if(cgb)
+			{
+				if(!back[dot])
+					back[dot] = val;
+				if(inFront && !front[dot])
+					front[dot] = val;
+			}
+			else
+			{
+				//on equal x the later sprite wins, same as ppuDoSpritesDMG
+				if(backX[dot] >= OAMcXpos)
+				{
+					back[dot] = val;
+					backX[dot] = OAMcXpos;
+				}
+				if(inFront && frontX[dot] >= OAMcXpos)
+				{
+					front[dot] = val;
+					frontX[dot] = OAMcXpos;
+				}
+			}
+			found = true;
+		}
+	}
+	return found;
+}
+
+//whole line versions of the draw functions above, same output
+//as drawing the line dot by dot with nothing changing in between
+static void ppuDrawLineDMG(gb_t *gb)
+{
+	//palette 0 is for the bg and palette 1 for the window
+	uint8_t colors[160];
+	uint8_t shade[8] = { 0, 0, 0, 0 };
+	uint32_t pal[0x20];
+	uint8_t i, dot;
+	for(i = 0; i < 4; i++)
+		shade[4+i] = gb->ppu.PPU_Reg[7]>>(i<<1);
+	if(gb->ppu.PPU_Reg[0]&PPU_BG_ENABLE)
+	{
+		ppuLineTiles(gb, colors, NULL, 0, gb->ppu.PPU_Reg[3], gb->ppu.ppuLines+gb->ppu.PPU_Reg[2],
+			(gb->ppu.PPU_Reg[0]&PPU_BG_TILEMAP_UP)?0x1C00:0x1800);
+		memcpy(shade, shade+4, 4);
+	}
+	else
+		memset(colors, 0, 160);
+	uint8_t winStart = ppuLineWindowStart(gb);
+	if(winStart < 160)
+	{
+		ppuLineTiles(gb, colors, NULL, winStart, winStart+7-gb->ppu.PPU_Reg[0xB], gb->ppu.ppuLines-gb->ppu.PPU_Reg[0xA],
+			(gb->ppu.PPU_Reg[0]&PPU_WINDOW_TILEMAP_UP)?0x1C00:0x1800);
+		for(dot = winStart; dot < 160; dot++)
+			colors[dot] |= 4;
+	}
+	for(i = 0; i < 0x20; i++)
+		pal[i] = gb->ppu.PPU_BGRLUT[shade[i&7]&3];
+	uint32_t *line = gb->textureImage+(gb->ppu.ppuLines*160);
+	gb->ppu.ppuExpandLine(line, colors, pal, 160);
+	uint8_t front[160], back[160];
+	if(!(gb->ppu.PPU_Reg[0]&PPU_SPRITE_ENABLE) || !gb->ppu.ppuOAM2pos || !ppuLineSprites(gb, front, back, false))
+		return;
+	for(i = 0; i < 8; i++)
+		pal[i] = gb->ppu.PPU_BGRLUT[(gb->ppu.PPU_Reg[8+(i>>2)]>>((i&3)<<1))&3];
+	for(dot = 0; dot < 160; dot++)
+	{
+		uint8_t spr = (colors[dot]&3) ? front[dot] : back[dot];
+		if(spr)
+			line[dot] = pal[spr];
+	}
+}
+
+static void ppuDrawLineCGB_DMGMode(gb_t *gb)
+{
+	//palette 0 is for the bg and palette 1 for the window
+	uint8_t colors[160];
+	uint16_t palRGB[8];
+	uint32_t pal[0x20];
+	uint8_t i, dot;
+	for(i = 0; i < 4; i++)
+	{
+		uint8_t pByte = ((gb->ppu.PPU_Reg[7]>>(i<<1))&3)<<1;
+		palRGB[4+i] = (gb->ppu.PPU_CGB_BGPAL[pByte])|(gb->ppu.PPU_CGB_BGPAL[pByte+1]<<8);
+	}
+	if(gb->ppu.PPU_Reg[0]&PPU_BG_ENABLE)
+	{
+		ppuLineTiles(gb, colors, NULL, 0, gb->ppu.PPU_Reg[3], gb->ppu.ppuLines+gb->ppu.PPU_Reg[2],
+			(gb->ppu.PPU_Reg[0]&PPU_BG_TILEMAP_UP)?0x1C00:0x1800);
+		memcpy(palRGB, palRGB+4, 4*sizeof(uint16_t));
+	}
+	else
+	{
+		memset(colors, 0, 160);
+		uint8_t pByte = (gb->ppu.PPU_Reg[7]&3)<<1;
+		palRGB[0] = palRGB[1] = palRGB[2] = palRGB[3] = (gb->ppu.PPU_CGB_OBJPAL[pByte])|(gb->ppu.PPU_CGB_OBJPAL[pByte+1]<<8);
+	}
+	uint8_t winStart = ppuLineWindowStart(gb);
+	if(winStart < 160)
+	{
+		ppuLineTiles(gb, colors, NULL, winStart, winStart+7-gb->ppu.PPU_Reg[0xB], gb->ppu.ppuLines-gb->ppu.PPU_Reg[0xA],
+			(gb->ppu.PPU_Reg[0]&PPU_WINDOW_TILEMAP_UP)?0x1C00:0x1800);
+		for(dot = winStart; dot < 160; dot++)
+			colors[dot] |= 4;
+	}
+	for(i = 0; i < 0x20; i++)
+		pal[i] = gb->ppu.PPU_CGB_BGRLUT[palRGB[i&7]&0x7FFF];
+	uint32_t *line = gb->textureImage+(gb->ppu.ppuLines*160);
+	gb->ppu.ppuExpandLine(line, colors, pal, 160);
+	uint8_t front[160], back[160];
+	if(!(gb->ppu.PPU_Reg[0]&PPU_SPRITE_ENABLE) || !gb->ppu.ppuOAM2pos || !ppuLineSprites(gb, front, back, false))
+		return;
+	for(i = 0; i < 8; i++)
+	{
+		uint8_t pByte = ((gb->ppu.PPU_Reg[8+(i>>2)]>>((i&3)<<1))&3)<<1;
+		pal[i] = gb->ppu.PPU_CGB_BGRLUT[((gb->ppu.PPU_CGB_OBJPAL[pByte])|(gb->ppu.PPU_CGB_OBJPAL[pByte+1]<<8))&0x7FFF];
+	}
+	for(dot = 0; dot < 160; dot++)
+	{
+		uint8_t spr = (colors[dot]&3) ? front[dot] : back[dot];
+		if(spr)
+			line[dot] = pal[spr];
+	}
+}
+
+static void ppuDrawLineCGB(gb_t *gb)
+{
+	uint8_t colors[160], attrs[160];
+	uint8_t winColors[160], winAttrs[160];
+	uint8_t idx[160];
+	uint8_t dot;
+	ppuLineTiles(gb, colors, attrs, 0, gb->ppu.PPU_Reg[3], gb->ppu.ppuLines+gb->ppu.PPU_Reg[2],
+		(gb->ppu.PPU_Reg[0]&PPU_BG_TILEMAP_UP)?0x1C00:0x1800);
+	uint8_t winStart = ppuLineWindowStart(gb);
+	if(winStart < 160)
+		ppuLineTiles(gb, winColors, winAttrs, winStart, winStart+7-gb->ppu.PPU_Reg[0xB], gb->ppu.ppuLines-gb->ppu.PPU_Reg[0xA],
+			(gb->ppu.PPU_Reg[0]&PPU_WINDOW_TILEMAP_UP)?0x1C00:0x1800);
+	for(dot = 0; dot < winStart; dot++)
+		idx[dot] = ((attrs[dot]&7)<<2)|colors[dot];
+	for(; dot < 160; dot++)
+		idx[dot] = ((winAttrs[dot]&7)<<2)|winColors[dot];
+	//all 8 palettes with 4 colors each, the way they show up on screen
+	uint32_t pal[0x20];
+	for(dot = 0; dot < 0x20; dot++)
+		pal[dot] = gb->ppu.PPU_CGB_BGRLUT[((gb->ppu.PPU_CGB_BGPAL[dot<<1])|(gb->ppu.PPU_CGB_BGPAL[(dot<<1)+1]<<8))&0x7FFF];
+	uint32_t *line = gb->textureImage+(gb->ppu.ppuLines*160);
+	gb->ppu.ppuExpandLine(line, idx, pal, 160);
+	uint8_t front[160], back[160];
+	if(!(gb->ppu.PPU_Reg[0]&PPU_SPRITE_ENABLE) || !gb->ppu.ppuOAM2pos || !ppuLineSprites(gb, front, back, true))
+		return;
+	for(dot = 0; dot < 0x20; dot++)
+		pal[dot] = gb->ppu.PPU_CGB_BGRLUT[((gb->ppu.PPU_CGB_OBJPAL[dot<<1])|(gb->ppu.PPU_CGB_OBJPAL[(dot<<1)+1]<<8))&0x7FFF];
+	bool bgPrio = (gb->ppu.PPU_Reg[0] & PPU_BG_WINDOW_PRIO);
+	for(dot = 0; dot < 160; dot++)
+	{
+		uint8_t tCgbVal = (dot < winStart) ? attrs[dot] : winAttrs[dot];
+		//the window keeps using the bg color for its priority
+		if(colors[dot] && (tCgbVal & PPU_TILE_PRIO) && bgPrio)
+			continue;
+		uint8_t spr = (idx[dot]&3) ? front[dot] : back[dot];
+		if(spr)
+			line[dot] = pal[spr];
+	}
 }
 
 //64x12 1BPP "Track"
@@ -1044,7 +1592,7 @@ static const uint8_t ppuGbsTextRest[192] =
 	0x0E, 0x03, 0x81, 0xE0, 0xF8, 0x03, 0x9F, 0xC0, 0xF9, 0xFE, 0x1F, 0x07, 0xC0, 0x18, 0x00, 0x00, 
 };
 
-static void ppuDrawRest(uint8_t curX, uint8_t sym)
+static void ppuDrawRest(gb_t *gb, uint8_t curX, uint8_t sym)
 {
 	uint8_t i, j;
 	for(i = 0; i < 12; i++)
@@ -1054,16 +1602,16 @@ static void ppuDrawRest(uint8_t curX, uint8_t sym)
 			size_t drawPos = (j+curX)+((i+4)*160);
 			uint8_t xSel = (j+(sym*10));
 			if(ppuGbsTextRest[((11-i)<<4)+(xSel>>3)]&(0x80>>(xSel&7)))
-				textureImage[drawPos] = 0xFFFFFFFF; //White
+				gb->textureImage[drawPos] = 0xFFFFFFFF; //White
 			else
-				textureImage[drawPos] = 0xFF000000; //Black
+				gb->textureImage[drawPos] = 0xFF000000; //Black
 		}
 	}
 }
 
-void ppuDrawGBSTrackNum(uint8_t cTrack, uint8_t trackTotal)
+void ppuDrawGBSTrackNum(gb_t *gb, uint8_t cTrack, uint8_t trackTotal)
 {
-	memset(textureImage,0,0x16800);
+	memset(gb->textureImage,0,0x16800);
 	uint8_t curX = 4;
 	//draw "Track"
 	uint8_t i, j;
@@ -1073,9 +1621,9 @@ void ppuDrawGBSTrackNum(uint8_t cTrack, uint8_t trackTotal)
 		{
 			size_t drawPos = (j+curX)+((i+4)*160);
 			if(ppuGBSTextTrack[((11-i)<<3)+(j>>3)]&(0x80>>(j&7)))
-				textureImage[drawPos] = 0xFFFFFFFF; //White
+				gb->textureImage[drawPos] = 0xFFFFFFFF; //White
 			else
-				textureImage[drawPos] = 0xFF000000; //Black
+				gb->textureImage[drawPos] = 0xFF000000; //Black
 		}
 	}
 	//"Track" len+space
@@ -1083,35 +1631,35 @@ void ppuDrawGBSTrackNum(uint8_t cTrack, uint8_t trackTotal)
 	//draw current num
 	if(cTrack > 99)
 	{
-		ppuDrawRest(curX, (cTrack/100)%10);
+		ppuDrawRest(gb, curX, (cTrack/100)%10);
 		curX+=10;
 	}
 	if(cTrack > 9)
 	{
-		ppuDrawRest(curX, (cTrack/10)%10);
+		ppuDrawRest(gb, curX, (cTrack/10)%10);
 		curX+=10;
 	}
-	ppuDrawRest(curX, cTrack%10);
+	ppuDrawRest(gb, curX, cTrack%10);
 	curX+=10;
 	//draw the "/"
-	ppuDrawRest(curX, 10);
+	ppuDrawRest(gb, curX, 10);
 	curX+=10;
 	//draw total num
 	if(trackTotal > 99)
 	{
-		ppuDrawRest(curX, (trackTotal/100)%10);
+		ppuDrawRest(gb, curX, (trackTotal/100)%10);
 		curX+=10;
 	}
 	if(trackTotal > 9)
 	{
-		ppuDrawRest(curX, (trackTotal/10)%10);
+		ppuDrawRest(gb, curX, (trackTotal/10)%10);
 		curX+=10;
 	}
-	ppuDrawRest(curX, trackTotal%10);
+	ppuDrawRest(gb, curX, trackTotal%10);
 	curX+=10;
 }
 
-void ppuSetOAMDMAVal(uint8_t pos, uint8_t val)
+void ppuSetOAMDMA(gb_t *gb, const uint8_t *src)
 {
-	PPU_OAM[pos] = val;
+	memcpy(gb->ppu.PPU_OAM, src, 0xA0);
 }
@@ -8,22 +8,30 @@
 #ifndef _ppu_h_
 #define _ppu_h_
 
-void ppuInit();
-void ppuInitDrawPointer();
-void ppuCycle();
-bool ppuDrawDone();
-uint8_t ppuGetVRAMBank8(uint16_t addr);
-uint8_t ppuGetVRAMNoBank8(uint16_t addr);
-uint8_t ppuGetOAM8(uint16_t addr);
-uint8_t ppuGetReg8(uint16_t addr);
-void ppuSetVRAMBank8(uint16_t addr, uint8_t val);
-void ppuSetVRAMNoBank8(uint16_t addr, uint8_t val);
-void ppuSetOAM8(uint16_t addr, uint8_t val);
-void ppuSetReg8(uint16_t addr, uint8_t val);
-void ppuSetOAMDMAVal(uint8_t pos, uint8_t val);
-bool ppuInVBlank();
-bool ppuInHBlank();
-void ppuDumpMem();
-void ppuDrawGBSTrackNum(uint8_t cTrack, uint8_t trackTotal);
+void ppuInit(gb_t *gb);
+void ppuInitDrawPointer(gb_t *gb);
+void ppuCycle(gb_t *gb);
+void ppuCatchUp(gb_t *gb, uint32_t clocks);
+uint32_t ppuNextEvent(gb_t *gb);
+uint32_t ppuNextRegChange(gb_t *gb);
+bool ppuDrawDone(gb_t *gb);
+uint32_t ppuFrameClocksLeft(gb_t *gb);
+void ppuSetFrameSkip(gb_t *gb, uint8_t skip);
+void ppuSetNextFrameDraw(gb_t *gb, bool draw);
+bool ppuFrameDrawn(gb_t *gb);
+uint8_t ppuGetVRAMBank8(gb_t *gb, uint16_t addr);
+uint8_t ppuGetVRAMNoBank8(gb_t *gb, uint16_t addr);
+uint8_t ppuGetOAM8(gb_t *gb, uint16_t addr);
+uint8_t ppuGetReg8(gb_t *gb, uint16_t addr);
+void ppuSetVRAMBank8(gb_t *gb, uint16_t addr, uint8_t val);
+void ppuSetVRAMNoBank8(gb_t *gb, uint16_t addr, uint8_t val);
+void ppuSetVRAMBlock(gb_t *gb, uint16_t addr, const uint8_t *src, uint8_t len);
+void ppuSetOAM8(gb_t *gb, uint16_t addr, uint8_t val);
+void ppuSetReg8(gb_t *gb, uint16_t addr, uint8_t val);
+void ppuSetOAMDMA(gb_t *gb, const uint8_t *src);
+bool ppuInVBlank(gb_t *gb);
+bool ppuInHBlank(gb_t *gb);
+void ppuDumpMem(gb_t *gb);
+void ppuDrawGBSTrackNum(gb_t *gb, uint8_t cTrack, uint8_t trackTotal);
 
 #endif
@@ -0,0 +1,443 @@
+/*
+ * Copyright (C) 2017 FIX94
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include <pthread.h>
+#if WINDOWS_BUILD
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "gb.h"
+#include "mbc.h"
+#include "save.h"
+
+//battery ram gets written out while the game runs, the emulation
+//thread only copies the pages written since the last batch and
+//hands them to a writer thread, which appends them to a journal
+//next to the save and syncs it, so nothing on the emulation thread
+//ever waits on the disk and a crash only loses the last batch
+
+//frames between batches, about a second
+#define SAVE_JOURNAL_FRAMES 60
+//journal gets folded into the save once it is that many times its size
+#define SAVE_JOURNAL_COMPACT 4
+#define SAVE_PAGE_SIZE 0x100
+
+#define SAVE_JOURNAL_MAGIC 0x4A424746 //FGBJ
+#define SAVE_JOURNAL_VERSION 1
+#define SAVE_REC_PAGE 0x45474150 //PAGE
+#define SAVE_REC_RTC 0x20435452 //RTC
+#define SAVE_REC_DONE 0x454E4F44 //DONE
+
+typedef struct _savehdr_t {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t extSize;
+	uint32_t rtcSize;
+} savehdr_t;
+
+//followed by len bytes of data, offset is into the save file,
+//records only count once the done record of their batch is
+//there, its offset is the number of records in the batch
+typedef struct _saverec_t {
+	uint32_t tag;
+	uint32_t offset;
+	uint32_t len;
+	uint32_t sum;
+} saverec_t;
+
+typedef struct _savejournal_t {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	//set once a batch is ready, cleared by the writer once it is on disk
+	bool busy;
+	bool quit;
+	uint32_t frames;
+	FILE *f;
+	long size;
+	char path[1040];
+	char saveName[1024];
+	//what save and journal hold together, laid out like the save file
+	size_t extSize;
+	size_t rtcSize;
+	uint8_t *image;
+	//batch, only touched by the writer while busy is set
+	uint32_t numPages;
+	uint16_t pages[0x200];
+	uint8_t pageData[0x20000];
+	bool rtcValid;
+	rtcsave_t rtc;
+} savejournal_t;
+
+static void saveJournalPath(char *path, size_t len, const char *name)
+{
+	size_t namelen = strlen(name);
+	if(namelen >= 3 && strcmp(name+namelen-3,"sav") == 0)
+		snprintf(path, len, "%.*sjnl", (int)(namelen-3), name);
+	else
+		snprintf(path, len, "%s.jnl", name);
+}
+
+static void saveSync(FILE *f)
+{
+	fflush(f);
+#if WINDOWS_BUILD
+	_commit(_fileno(f));
+#else
+	fsync(fileno(f));
+#endif
+}
+
+//saves get written next to the old one and then moved over
+//it, so there always is one complete save on disk
+FILE *saveFileOpen(const char *name)
+{
+	char tmpName[1040];
+	snprintf(tmpName, sizeof(tmpName), "%s.tmp", name);
+	return fopen(tmpName, "wb");
+}
+
+bool saveFileCommit(FILE *f, const char *name)
+{
+	char tmpName[1040];
+	snprintf(tmpName, sizeof(tmpName), "%s.tmp", name);
+	saveSync(f);
+	bool ok = !ferror(f);
+	if(fclose(f) != 0)
+		ok = false;
+#if WINDOWS_BUILD
+	if(ok && !MoveFileExA(tmpName, name, MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH))
+		ok = false;
+#else
+	if(ok && rename(tmpName, name) != 0)
+		ok = false;
+#endif
+	if(!ok)
+	{
+		printf("Save: Could not write %s!\n", name);
+		remove(tmpName);
+	}
+	return ok;
+}
+
+static uint32_t saveSum(uint32_t sum, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	while(len--)
+	{
+		sum ^= *p++;
+		sum *= 16777619;
+	}
+	return sum;
+}
+
+static uint32_t saveRecSum(const saverec_t *rec, const void *data)
+{
+	uint32_t sum = 2166136261u;
+	sum = saveSum(sum, rec, offsetof(saverec_t, sum));
+	return saveSum(sum, data, rec->len);
+}
+
+static bool saveJournalWriteRec(savejournal_t *j, uint32_t tag, uint32_t offset, const void *data, uint32_t len)
+{
+	saverec_t rec;
+	rec.tag = tag;
+	rec.offset = offset;
+	rec.len = len;
+	rec.sum = saveRecSum(&rec, data);
+	if(fwrite(&rec, 1, sizeof(rec), j->f) != sizeof(rec))
+		return false;
+	if(len && fwrite(data, 1, len, j->f) != len)
+		return false;
+	j->size += sizeof(rec)+len;
+	return true;
+}
+
+//starts a new journal that has nothing on top of the save
+static bool saveJournalReset(savejournal_t *j)
+{
+	if(j->f)
+		fclose(j->f);
+	j->f = fopen(j->path, "wb");
+	if(!j->f)
+	{
+		printf("Save: Could not open %s!\n", j->path);
+		return false;
+	}
+	savehdr_t hdr;
+	hdr.magic = SAVE_JOURNAL_MAGIC;
+	hdr.version = SAVE_JOURNAL_VERSION;
+	hdr.extSize = j->extSize;
+	hdr.rtcSize = j->rtcSize;
+	fwrite(&hdr, 1, sizeof(hdr), j->f);
+	saveSync(j->f);
+	j->size = sizeof(hdr);
+	return !ferror(j->f);
+}
+
+//writes the image as new save, the journal only gets
+//started over once the save is in place
+static bool saveJournalCompact(savejournal_t *j)
+{
+	FILE *f = saveFileOpen(j->saveName);
+	if(!f)
+	{
+		printf("Save: Could not open %s!\n", j->saveName);
+		return false;
+	}
+	fwrite(j->image, 1, j->extSize+j->rtcSize, f);
+	if(!saveFileCommit(f, j->saveName))
+		return false;
+	return saveJournalReset(j);
+}
+
+//writes out the batch, called by the writer thread
+static void saveJournalAppend(savejournal_t *j)
+{
+	bool ok = (j->f != NULL);
+	uint32_t i, recs = 0;
+	for(i = 0; ok && i < j->numPages; i++)
+	{
+		uint32_t pos = j->pages[i]*SAVE_PAGE_SIZE;
+		uint32_t len = j->extSize-pos < SAVE_PAGE_SIZE ? j->extSize-pos : SAVE_PAGE_SIZE;
+		const uint8_t *data = j->pageData+i*SAVE_PAGE_SIZE;
+		ok = saveJournalWriteRec(j, SAVE_REC_PAGE, pos, data, len);
+		memcpy(j->image+pos, data, len);
+		recs++;
+	}
+	if(ok && j->rtcValid)
+	{
+		ok = saveJournalWriteRec(j, SAVE_REC_RTC, j->extSize, &j->rtc, j->rtcSize);
+		memcpy(j->image+j->extSize, &j->rtc, j->rtcSize);
+		recs++;
+	}
+	if(ok)
+		ok = saveJournalWriteRec(j, SAVE_REC_DONE, recs, NULL, 0);
+	if(ok)
+	{
+		saveSync(j->f);
+		ok = !ferror(j->f);
+	}
+	//a broken tail would hide everything appended after it,
+	//so start over from a full save instead
+	if(!ok || j->size > (long)(SAVE_JOURNAL_COMPACT*(j->extSize+j->rtcSize)))
+		saveJournalCompact(j);
+}
+
+static void *saveJournalThread(void *arg)
+{
+	savejournal_t *j = arg;
+	pthread_mutex_lock(&j->lock);
+	while(true)
+	{
+		while(!j->busy && !j->quit)
+			pthread_cond_wait(&j->cond, &j->lock);
+		if(!j->busy)
+			break;
+		pthread_mutex_unlock(&j->lock);
+		saveJournalAppend(j);
+		pthread_mutex_lock(&j->lock);
+		j->busy = false;
+	}
+	pthread_mutex_unlock(&j->lock);
+	return NULL;
+}
+
+//applies all complete batches of the journal onto the image,
+//returns true if there was anything to apply
+static bool saveJournalReplay(savejournal_t *j)
+{
+	FILE *f = fopen(j->path, "rb");
+	if(!f)
+		return false;
+	bool replayed = false;
+	size_t total = j->extSize+j->rtcSize;
+	savehdr_t hdr;
+	if(fread(&hdr, 1, sizeof(hdr), f) == sizeof(hdr) && hdr.magic == SAVE_JOURNAL_MAGIC
+		&& hdr.version == SAVE_JOURNAL_VERSION && hdr.extSize == j->extSize && hdr.rtcSize == j->rtcSize)
+	{
+		uint8_t *batch = malloc(total);
+		uint8_t *data = malloc(total);
+		memcpy(batch, j->image, total);
+		uint32_t recs = 0;
+		saverec_t rec;
+		while(fread(&rec, 1, sizeof(rec), f) == sizeof(rec))
+		{
+			if(rec.len > total || (rec.tag != SAVE_REC_DONE && rec.offset > total-rec.len))
+				break;
+			if(rec.len && fread(data, 1, rec.len, f) != rec.len)
+				break;
+			if(saveRecSum(&rec, data) != rec.sum)
+				break;
+			if(rec.tag == SAVE_REC_DONE)
+			{
+				if(rec.offset != recs)
+					break;
+				memcpy(j->image, batch, total);
+				replayed = true;
+				recs = 0;
+			}
+			else if(rec.tag == SAVE_REC_PAGE || rec.tag == SAVE_REC_RTC)
+			{
+				memcpy(batch+rec.offset, data, rec.len);
+				recs++;
+			}
+			else
+				break;
+		}
+		free(data);
+		free(batch);
+	}
+	fclose(f);
+	return replayed;
+}
+
+//brings the save up to date with what a previous run left in the
+//journal and starts the writer, has to run before the save gets read
+void saveJournalInit(gb_t *gb)
+{
+	if(gb->emuSaveJournal)
+		saveJournalClose(gb);
+	size_t extSize = gb->mbc.extTotalSize;
+	size_t rtcSize = gb->mbc.rtcUsed ? mbcRTCSize(gb) : 0;
+	if(extSize+rtcSize == 0)
+		return;
+	savejournal_t *j = calloc(1, sizeof(savejournal_t));
+	if(!j)
+		return;
+	j->extSize = extSize;
+	j->rtcSize = rtcSize;
+	snprintf(j->saveName, sizeof(j->saveName), "%s", gb->emuSaveName);
+	saveJournalPath(j->path, sizeof(j->path), gb->emuSaveName);
+	//start from what is in the save, or from cleared ram if
+	//there is no save yet so a journal never has nothing below it
+	j->image = malloc(extSize+rtcSize);
+	memcpy(j->image, gb->mbc.Ext_Mem, extSize);
+	memcpy(j->image+extSize, &gb->mbc.RTCSave, rtcSize);
+	bool haveSave = false;
+	FILE *save = fopen(j->saveName, "rb");
+	if(save)
+	{
+		haveSave = (fread(j->image, 1, extSize+rtcSize, save) == extSize+rtcSize);
+		fclose(save);
+	}
+	bool replayed = saveJournalReplay(j);
+	if(replayed)
+		printf("Save: Applied %s\n", j->path);
+	bool ok;
+	if(replayed || !haveSave)
+		ok = saveJournalCompact(j);
+	else
+		ok = saveJournalReset(j);
+	memset(gb->mbc.extDirty, 0, sizeof(gb->mbc.extDirty));
+	gb->mbc.extDirtyAny = false;
+	gb->mbc.rtcDirty = false;
+	if(ok)
+	{
+		pthread_mutex_init(&j->lock, NULL);
+		pthread_cond_init(&j->cond, NULL);
+		if(pthread_create(&j->thread, NULL, saveJournalThread, j) == 0)
+		{
+			gb->emuSaveJournal = j;
+			return;
+		}
+		pthread_cond_destroy(&j->cond);
+		pthread_mutex_destroy(&j->lock);
+	}
+	//only gets saved on exit then
+	printf("Save: Could not start journal\n");
+	if(j->f)
+		fclose(j->f);
+	free(j->image);
+	free(j);
+}
+
+//copies everything dirty into the batch
+static void saveJournalTake(gb_t *gb, savejournal_t *j)
+{
+	uint32_t page, pages = (j->extSize+SAVE_PAGE_SIZE-1)/SAVE_PAGE_SIZE;
+	j->numPages = 0;
+	if(gb->mbc.extDirtyAny)
+	{
+		for(page = 0; page < pages; page++)
+		{
+			if(!gb->mbc.extDirty[page])
+				continue;
+			j->pages[j->numPages] = page;
+			memcpy(j->pageData+j->numPages*SAVE_PAGE_SIZE, gb->mbc.Ext_Mem+page*SAVE_PAGE_SIZE, SAVE_PAGE_SIZE);
+			j->numPages++;
+		}
+		memset(gb->mbc.extDirty, 0, sizeof(gb->mbc.extDirty));
+		gb->mbc.extDirtyAny = false;
+	}
+	j->rtcValid = (j->rtcSize && gb->mbc.rtcDirty);
+	if(j->rtcValid)
+		memcpy(&j->rtc, &gb->mbc.RTCSave, j->rtcSize);
+	gb->mbc.rtcDirty = false;
+}
+
+//called once per frame, hands the dirty pages to the writer
+//every so often, if it is still busy it just gets tried again
+void saveJournalFrame(gb_t *gb)
+{
+	savejournal_t *j = gb->emuSaveJournal;
+	if(!j || ++j->frames < SAVE_JOURNAL_FRAMES)
+		return;
+	if(!gb->mbc.extDirtyAny && !gb->mbc.rtcDirty)
+		return;
+	if(pthread_mutex_trylock(&j->lock) != 0)
+		return;
+	if(!j->busy)
+	{
+		saveJournalTake(gb, j);
+		j->busy = true;
+		j->frames = 0;
+		pthread_cond_signal(&j->cond);
+	}
+	pthread_mutex_unlock(&j->lock);
+}
+
+//stops the writer, whatever is still dirty goes into the journal
+//right away so it never ends up behind the save written after
+void saveJournalClose(gb_t *gb)
+{
+	savejournal_t *j = gb->emuSaveJournal;
+	if(!j)
+		return;
+	pthread_mutex_lock(&j->lock);
+	j->quit = true;
+	pthread_cond_signal(&j->cond);
+	pthread_mutex_unlock(&j->lock);
+	pthread_join(j->thread, NULL);
+	if(gb->mbc.extDirtyAny || gb->mbc.rtcDirty)
+	{
+		saveJournalTake(gb, j);
+		saveJournalAppend(j);
+	}
+	if(j->f)
+		fclose(j->f);
+	pthread_cond_destroy(&j->cond);
+	pthread_mutex_destroy(&j->lock);
+	free(j->image);
+	free(j);
+	gb->emuSaveJournal = NULL;
+}
+
+//once a full save is in place the journal has nothing left to add
+void saveJournalRemove(gb_t *gb)
+{
+	char path[1040];
+	saveJournalPath(path, sizeof(path), gb->emuSaveName);
+	remove(path);
+}
@@ -0,0 +1,18 @@
+/*
+ * Copyright (C) 2017 FIX94
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef _save_h_
+#define _save_h_
+
+void saveJournalInit(gb_t *gb);
+void saveJournalFrame(gb_t *gb);
+void saveJournalClose(gb_t *gb);
+void saveJournalRemove(gb_t *gb);
+FILE *saveFileOpen(const char *name);
+bool saveFileCommit(FILE *f, const char *name);
+
+#endif
@@ -56,6 +56,7 @@ typedef struct zlib_filefunc_def_s
 
 
 void fill_memory_filefunc OF((zlib_filefunc_def* pzlib_filefunc_def));
+void fill_fd_filefunc OF((zlib_filefunc_def* pzlib_filefunc_def));
 
 #define ZREAD(filefunc,filestream,buf,size) ((*((filefunc).zread_file))((filefunc).opaque,filestream,buf,size))
 #define ZWRITE(filefunc,filestream,buf,size) ((*((filefunc).zwrite_file))((filefunc).opaque,filestream,buf,size))
@@ -0,0 +1,230 @@
+/* ioapi_fd.c -- IO base function header for compress/uncompress .zip
+   files using zlib + zip or unzip API
+   This version of ioapi reads straight from the archive file, so the
+   archive never has to be loaded into memory as a whole. Reads use
+   pread with an offset kept here, so nothing but the current position
+   is tracked per opened archive. Only reading is supported.
+   Based on ioapi_mem.c, same license as the Unzip tool it is
+   distributed with.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if WINDOWS_BUILD
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include <fcntl.h>
+
+#include "zlib.h"
+#include "ioapi.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+
+voidpf ZCALLBACK fopen_fd_func OF((
+   voidpf opaque,
+   const char* filename,
+   int mode));
+
+uLong ZCALLBACK fread_fd_func OF((
+   voidpf opaque,
+   voidpf stream,
+   void* buf,
+   uLong size));
+
+uLong ZCALLBACK fwrite_fd_func OF((
+   voidpf opaque,
+   voidpf stream,
+   const void* buf,
+   uLong size));
+
+long ZCALLBACK ftell_fd_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+long ZCALLBACK fseek_fd_func OF((
+   voidpf opaque,
+   voidpf stream,
+   uLong offset,
+   int origin));
+
+int ZCALLBACK fclose_fd_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+int ZCALLBACK ferror_fd_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+
+typedef struct ourfd_s {
+  int fd; /* Archive file we're reading from */
+  uLong size; /* Size of the archive */
+  uLong cur_offset; /* Current offset in the archive */
+  int error; /* Set once a read failed */
+} ourfd_t;
+
+voidpf ZCALLBACK fopen_fd_func (opaque, filename, mode)
+   voidpf opaque;
+   const char* filename;
+   int mode;
+{
+	(void)opaque;
+    if (mode & ZLIB_FILEFUNC_MODE_CREATE)
+      return NULL; /* Read only */
+
+    ourfd_t *f = malloc(sizeof(*f));
+    if (f==NULL)
+      return NULL; /* Can't allocate space, so failed */
+
+    f->fd = open(filename, O_RDONLY|O_BINARY);
+    if (f->fd < 0)
+    {
+      free(f);
+      return NULL;
+    }
+    long end = lseek(f->fd, 0, SEEK_END);
+    if (end < 0)
+    {
+      close(f->fd);
+      free(f);
+      return NULL;
+    }
+    f->size = end;
+    f->cur_offset = 0;
+    f->error = 0;
+
+    return f;
+}
+
+
+uLong ZCALLBACK fread_fd_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   void* buf;
+   uLong size;
+{
+	(void)opaque;
+    ourfd_t *f = (ourfd_t *)stream;
+    uLong done = 0;
+
+    if (size > f->size - f->cur_offset)
+      size = f->size - f->cur_offset;
+
+    while (done < size)
+    {
+#if WINDOWS_BUILD
+      /* no pread, reads are never shared between threads anyway */
+      long got = -1;
+      if (lseek(f->fd, f->cur_offset + done, SEEK_SET) >= 0)
+        got = read(f->fd, (char*)buf + done, size - done);
+#else
+      long got = pread(f->fd, (char*)buf + done, size - done, f->cur_offset + done);
+#endif
+      if (got <= 0)
+      {
+        f->error = 1;
+        break;
+      }
+      done += got;
+    }
+    f->cur_offset += done;
+
+    return done;
+}
+
+
+uLong ZCALLBACK fwrite_fd_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   const void* buf;
+   uLong size;
+{
+	(void)opaque;
+	(void)stream;
+	(void)buf;
+	(void)size;
+    /* Read only */
+    return 0;
+}
+
+long ZCALLBACK ftell_fd_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+	(void)opaque;
+    ourfd_t *f = (ourfd_t *)stream;
+
+    return f->cur_offset;
+}
+
+long ZCALLBACK fseek_fd_func (opaque, stream, offset, origin)
+   voidpf opaque;
+   voidpf stream;
+   uLong offset;
+   int origin;
+{
+	(void)opaque;
+    ourfd_t *f = (ourfd_t *)stream;
+    uLong new_pos;
+    switch (origin)
+    {
+    case ZLIB_FILEFUNC_SEEK_CUR :
+        new_pos = f->cur_offset + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_END :
+        new_pos = f->size + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_SET :
+        new_pos = offset;
+        break;
+    default: return -1;
+    }
+
+    if (new_pos > f->size)
+      return 1; /* Failed to seek that far */
+
+    f->cur_offset = new_pos;
+    return 0;
+}
+
+int ZCALLBACK fclose_fd_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+	(void)opaque;
+    ourfd_t *f = (ourfd_t *)stream;
+
+    close(f->fd);
+    free (f);
+    return 0;
+}
+
+int ZCALLBACK ferror_fd_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+	(void)opaque;
+    ourfd_t *f = (ourfd_t *)stream;
+
+    return f->error;
+}
+
+void fill_fd_filefunc (pzlib_filefunc_def)
+  zlib_filefunc_def* pzlib_filefunc_def;
+{
+    pzlib_filefunc_def->zopen_file = fopen_fd_func;
+    pzlib_filefunc_def->zread_file = fread_fd_func;
+    pzlib_filefunc_def->zwrite_file = fwrite_fd_func;
+    pzlib_filefunc_def->ztell_file = ftell_fd_func;
+    pzlib_filefunc_def->zseek_file = fseek_fd_func;
+    pzlib_filefunc_def->zclose_file = fclose_fd_func;
+    pzlib_filefunc_def->zerror_file = ferror_fd_func;
+    pzlib_filefunc_def->opaque = NULL;
+}